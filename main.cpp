@@ -1,37 +1,310 @@
 #include "parser.h"
+#include "compile_server.h"
+#include "compile_cache.h"
+#include "incremental.h"
+#include "modules.h"
+#include "compile_report.h"
+#include <csignal>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace {
+    parasl::CompileServer* server = nullptr;
+
+    void stopServer(int) {
+        server->Stop();
+    }
+
+    volatile std::sig_atomic_t watchStopped = 0;
+
+    void stopWatching(int) {
+        watchStopped = 1;
+    }
+}
 
 int main(int argc, char *argv[]) {
-    char const* filename;
-    if (argc > 1) {
-        filename = argv[1];
+    po::options_description visible("Options");
+    visible.add_options()
+            ("help,h", "Print this message")
+            ("bounds-checks", po::value<std::string>()->default_value("elide"),
+             "Array bounds checks: full | elide | off")
+            ("opt-report", "Print summaries of optimization analyses")
+            ("reorder-fields", "Reorder struct fields by decreasing alignment to reduce padding")
+            ("pack-ints", "Store arrays of narrow int(N) bit-packed")
+            ("no-loop-nest-opt", "Disable interchange and tiling of nested loops")
+            ("if-conversion-limit", po::value<unsigned>()->default_value(4),
+             "Max statements in both arms of if turned into selects, 0 disables if-conversion")
+            ("unroll-budget", po::value<size_t>()->default_value(64),
+             "Max size of unrolled loop body in AST nodes, 0 disables unrolling")
+            ("pipeline-threads", po::value<size_t>()->default_value(0),
+             "Threads to schedule layers onto, 0 uses all cores")
+            ("processes", "Run groups of layers as separate processes")
+            ("placement", po::value<std::string>(),
+             "Placement config of layers into processes, implies --processes")
+            ("transport", po::value<std::string>()->default_value("shm"),
+             "Channels between processes: shm | socket")
+            ("serve", po::value<std::string>(),
+             "Run as a resident compiler listening on the Unix socket")
+            ("serve-threads", po::value<size_t>()->default_value(0),
+             "Compilation threads of the resident compiler, 0 uses all cores")
+            ("cache-size", po::value<size_t>()->default_value(256),
+             "Compiled programs kept by the resident compiler")
+            ("connect", po::value<std::string>(),
+             "Compile on the resident compiler listening on the Unix socket")
+            ("cache-dir", po::value<std::string>(),
+             "Keep compilation results in the directory and reuse them for unchanged programs")
+            ("cache-limit", po::value<size_t>()->default_value(256),
+             "Size of the cache directory in MiB")
+            ("cache-stats", "Print entries, size and hit rate of the cache directory")
+            ("emit-ast-bin", po::value<std::string>(),
+             "Write the checked AST to the file as a binary image")
+            ("load-ast-bin", po::value<std::string>(),
+             "Take the checked AST from a binary image instead of a source file")
+            ("watch", "Compile the input file again on every change, checking only the changed parts, "
+                      "and report how long each compilation takes")
+            ("module-threads", po::value<size_t>()->default_value(0),
+             "Threads compiling imported modules, 0 uses all cores")
+            ("time-report", "Report wall time of the compilation phases")
+            ("mem-report", "Report allocations of the compilation phases, AST nodes and bytes by node kind, "
+                           "type table sizes and symbol table depth")
+            ("report-format", po::value<std::string>()->default_value("text"),
+             "Format of time and memory reports: text | json")
+            ("report-file", po::value<std::string>(),
+             "Write time and memory reports to the file instead of stderr");
+
+    po::options_description hidden;
+    hidden.add_options()
+            ("input-file", po::value<std::string>(), "ParaSL source file");
+
+    po::options_description all;
+    all.add(visible).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("input-file", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(all).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch (po::error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << "Usage: " << argv[0] << " [options] <file.psl>\n" << visible << std::endl;
+        return 0;
+    }
+
+    if (vm.count("serve")) {
+        parasl::CompileServer compile_server(vm["serve"].as<std::string>(), vm["serve-threads"].as<size_t>(),
+                                             vm["cache-size"].as<size_t>());
+        server = &compile_server;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        try {
+            compile_server.Run();
+        } catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Compiled programs cache: " << compile_server.Hits() << " hits, "
+                  << compile_server.Misses() << " misses" << std::endl;
+        return 0;
+    }
+
+    parasl::Options options;
+
+    auto bounds_checks = vm["bounds-checks"].as<std::string>();
+    if (bounds_checks == "full") {
+        options.bounds_checks = parasl::ast::bounds_check_mode_t::FULL;
+    } else if (bounds_checks == "elide") {
+        options.bounds_checks = parasl::ast::bounds_check_mode_t::ELIDE;
+    } else if (bounds_checks == "off") {
+        options.bounds_checks = parasl::ast::bounds_check_mode_t::OFF;
+    } else {
+        std::cerr << "Error: Unknown bounds checks mode: " << bounds_checks << std::endl;
+        return 1;
+    }
+
+    options.opt_report = vm.count("opt-report");
+    options.reorder_fields = vm.count("reorder-fields");
+    options.pack_ints = vm.count("pack-ints");
+    options.loop_nest_opt = !vm.count("no-loop-nest-opt");
+    options.if_conversion_limit = vm["if-conversion-limit"].as<unsigned>();
+    options.unroll_budget = vm["unroll-budget"].as<size_t>();
+    options.pipeline_threads = vm["pipeline-threads"].as<size_t>();
+    options.processes = vm.count("processes") || vm.count("placement");
+
+    auto transport = vm["transport"].as<std::string>();
+    if (transport == "shm") {
+        options.transport = parasl::ast::transport_t::SHARED_MEMORY;
+    } else if (transport == "socket") {
+        options.transport = parasl::ast::transport_t::UNIX_SOCKET;
     } else {
-        std::cerr << "Error: No input file provided." << std::endl;
+        std::cerr << "Error: Unknown transport: " << transport << std::endl;
         return 1;
     }
 
-    std::ifstream in(filename, std::ios_base::in);
+    // Imports are relative to the source file, also for a resident compiler running elsewhere
+    if (vm.count("input-file"))
+        options.module_dir = std::filesystem::absolute(vm["input-file"].as<std::string>()).parent_path().string();
+
+    if (vm.count("placement")) {
+        auto placement_file = vm["placement"].as<std::string>();
+        std::ifstream placement(placement_file);
+        if (!placement) {
+            std::cerr << "Error: Could not open placement config: "
+                      << placement_file << std::endl;
+            return 1;
+        }
+        options.placement.assign(std::istreambuf_iterator<char>(placement), std::istreambuf_iterator<char>());
+    }
+
+    std::optional<parasl::CompileCache> cache;
+    if (vm.count("cache-dir")) {
+        try {
+            cache.emplace(vm["cache-dir"].as<std::string>(), uint64_t(vm["cache-limit"].as<size_t>()) << 20);
+        } catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    } else if (vm.count("cache-stats")) {
+        std::cerr << "Error: --cache-stats needs --cache-dir" << std::endl;
+        return 1;
+    }
 
-    if (!in) {
-        std::cerr << "Error: Could not open input file: "
-                  << filename << std::endl;
+    if (vm.count("emit-ast-bin"))
+        options.emit_ast_bin = vm["emit-ast-bin"].as<std::string>();
+    if (vm.count("load-ast-bin"))
+        options.load_ast_bin = vm["load-ast-bin"].as<std::string>();
+    if ((vm.count("emit-ast-bin") || vm.count("load-ast-bin")) && (cache || vm.count("connect"))) {
+        std::cerr << "Error: AST images are emitted and loaded by local compilation only" << std::endl;
         return 1;
     }
 
+    // Timings of a compilation replayed from a cache or made elsewhere would tell nothing
+    std::optional<parasl::CompileReport> report;
+    std::ofstream report_file;
+    bool json_report = false;
+    if (vm.count("time-report") || vm.count("mem-report")) {
+        if (cache || vm.count("connect") || vm.count("watch")) {
+            std::cerr << "Error: Time and memory reports are made by local compilation only" << std::endl;
+            return 1;
+        }
+        auto format = vm["report-format"].as<std::string>();
+        if (format != "text" && format != "json") {
+            std::cerr << "Error: Unknown report format: " << format << std::endl;
+            return 1;
+        }
+        json_report = format == "json";
+        if (vm.count("report-file")) {
+            report_file.open(vm["report-file"].as<std::string>(), std::ios::trunc);
+            if (!report_file) {
+                std::cerr << "Error: Could not open report file: " << vm["report-file"].as<std::string>() << std::endl;
+                return 1;
+            }
+        }
+        report.emplace(vm.count("time-report"), vm.count("mem-report"));
+    }
+
+    if (vm.count("watch")) {
+        if (cache || vm.count("connect") || vm.count("emit-ast-bin") || vm.count("load-ast-bin")) {
+            std::cerr << "Error: --watch compiles the source file locally, without caches or AST images" << std::endl;
+            return 1;
+        }
+        if (!vm.count("input-file")) {
+            std::cerr << "Error: No input file provided." << std::endl;
+            return 1;
+        }
+        std::signal(SIGINT, stopWatching);
+        std::signal(SIGTERM, stopWatching);
+        return parasl::Watch(vm["input-file"].as<std::string>(), options, watchStopped) ? 0 : 1;
+    }
+
     std::string source_code; // Read the contents here.
-    in.unsetf(std::ios::skipws); // No white space skipping
-    std::copy(
-            std::istream_iterator<char>(in),
-            std::istream_iterator<char>(),
-            std::back_inserter(source_code));
+    if (options.load_ast_bin.empty()) {
+        parasl::CompileReport::Phase phase(report ? &*report : nullptr, "read source");
+        if (!vm.count("input-file")) {
+            if (cache && vm.count("cache-stats")) {
+                cache->Dump(std::cout);
+                return 0;
+            }
+            std::cerr << "Error: No input file provided." << std::endl;
+            return 1;
+        }
+        auto filename = vm["input-file"].as<std::string>();
+
+        std::ifstream in(filename, std::ios_base::in);
+
+        if (!in) {
+            std::cerr << "Error: Could not open input file: "
+                      << filename << std::endl;
+            return 1;
+        }
+
+        in.unsetf(std::ios::skipws); // No white space skipping
+        std::copy(
+                std::istream_iterator<char>(in),
+                std::istream_iterator<char>(),
+                std::back_inserter(source_code));
+    }
+
+    parasl::ModuleLoader modules(vm["module-threads"].as<size_t>(), cache ? &*cache : nullptr);
 
-    auto iter = source_code.begin();
-    auto end = source_code.end();
+    bool ok;
+    if (vm.count("connect")) {
+        try {
+            auto reply = parasl::CompileRemote(vm["connect"].as<std::string>(), options, source_code);
+            std::cout << reply.output;
+            std::cerr << reply.errors;
+            ok = reply.ok;
+        } catch (std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    } else if (cache) {
+        // What the program compiles to depends on the interfaces it imports, they come first
+        parasl::ModuleInterfaces imports;
+        ok = modules.Load(parasl::ScanImports(source_code.begin(), source_code.end()), options, imports, std::cerr);
+        if (ok) {
+            auto key = parasl::CompileCache::Key(options, source_code, imports);
+            auto entry = cache->Lookup(key);
+            if (!entry) {
+                parasl::Parser parser{source_code.begin(), source_code.end(), options, &modules};
+                auto program = parser.Compile();
+                entry = {program.ok, std::move(program.output), std::move(program.errors)};
+                cache->Store(key, *entry);
+            }
+            std::cout << entry->output;
+            std::cerr << entry->errors;
+            ok = entry->ok;
+        }
+    } else {
+        auto iter = source_code.begin();
+        auto end = source_code.end();
+
+        parasl::Parser parser{iter, end, options, &modules, report ? &*report : nullptr};
+        ok = parser.Run();
+    }
+
+    if (report) {
+        report->Finish();
+        auto& stream = report_file.is_open() ? static_cast<std::ostream&>(report_file) : std::cerr;
+        if (json_report)
+            report->DumpJson(stream);
+        else
+            report->Dump(stream);
+    }
 
-    parasl::Parser parser{iter, end};
+    if (cache && vm.count("cache-stats"))
+        cache->Dump(std::cout);
 
-    if (parser.Run()) {
+    if (ok) {
         std::cout << "Parsing succeeded" << "\n";
         return 0;
     } else {
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compile_cache.h"
+#include "wire_format.h"
+
+namespace parasl {
+
+    namespace fs = std::filesystem;
+
+    namespace {
+
+        constexpr char const* entrySuffix = ".pslc";
+        constexpr char const* tmpSuffix = ".tmp";
+        // Temporary files of runs which died before renaming them
+        constexpr auto staleTmpAge = std::chrono::hours(1);
+
+        // Tells apart temporary files of threads of one process storing the same entry, as the
+        // modules of a program compiled on several threads may do
+        std::atomic<uint64_t> tmpCounter = 0;
+
+        // FNV-1a, stable across builds and runs unlike std::hash
+        uint64_t hashOf(std::string const& data) {
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char c : data) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        // Size and time of the executable: any rebuild of the compiler starts over
+        std::string compilerBuild() {
+            struct stat exe{};
+            if (::stat("/proc/self/exe", &exe) < 0)
+                return {};
+            WireWriter wire;
+            wire.u64(static_cast<uint64_t>(exe.st_size));
+            wire.u64(static_cast<uint64_t>(exe.st_mtim.tv_sec));
+            wire.u64(static_cast<uint64_t>(exe.st_mtim.tv_nsec));
+            return wire.take();
+        }
+
+        std::string keyOf(bool interface, Options const& options, std::string const& source,
+                          ModuleInterfaces const& imports) {
+            WireWriter wire;
+            wire.u64(CompileCache::formatVersion);
+            wire.str(compilerBuild());
+            wire.flag(interface);
+            EncodeOptions(wire, options);
+            wire.str(source);
+            EncodeImports(wire, imports);
+            return wire.take();
+        }
+
+        bool readFile(fs::path const& path, std::string& data) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            data.clear();
+            char buffer[1 << 16];
+            for (;;) {
+                auto got = ::read(fd, buffer, sizeof(buffer));
+                if (got < 0 && errno == EINTR)
+                    continue;
+                if (got <= 0) {
+                    ::close(fd);
+                    return got == 0;
+                }
+                data.append(buffer, static_cast<size_t>(got));
+            }
+        }
+
+        bool writeAll(int fd, char const* data, size_t size) {
+            while (size) {
+                auto written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+    }
+
+    CompileCache::CompileCache(fs::path directory, uint64_t limit_bytes) :
+        directory_(std::move(directory)), limit_bytes_(limit_bytes) {
+        fs::create_directories(directory_);
+    }
+
+    std::string CompileCache::Key(Options const& options, std::string const& source, ModuleInterfaces const& imports) {
+        return keyOf(false, options, source, imports);
+    }
+
+    std::string CompileCache::InterfaceKey(Options const& options, std::string const& source,
+                                           ModuleInterfaces const& imports) {
+        return keyOf(true, options, source, imports);
+    }
+
+    fs::path CompileCache::PathOf(std::string const& key) const {
+        char name[17];
+        std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hashOf(key)));
+        return directory_ / (std::string(name) + entrySuffix);
+    }
+
+    std::optional<CompileCache::Entry> CompileCache::Lookup(std::string const& key) {
+        auto path = PathOf(key);
+        std::string data;
+        std::optional<Entry> entry;
+        if (readFile(path, data)) {
+            try {
+                WireReader wire(data, "compile cache entry");
+                if (wire.str() == key) {
+                    Entry found;
+                    found.ok = wire.flag();
+                    found.output = wire.str();
+                    found.errors = wire.str();
+                    if (wire.done())
+                        entry = std::move(found);
+                }
+            } catch (std::runtime_error&) {
+                // Entry of another format, it is replaced on store
+            }
+        }
+
+        if (entry) {
+            std::error_code error;
+            fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+        }
+        Count(entry.has_value());
+        return entry;
+    }
+
+    void CompileCache::Store(std::string const& key, Entry const& entry) {
+        WireWriter wire;
+        wire.str(key);
+        wire.flag(entry.ok);
+        wire.str(entry.output);
+        wire.str(entry.errors);
+        auto data = wire.take();
+
+        auto path = PathOf(key);
+        auto tmp = path;
+        tmp += "." + std::to_string(::getpid()) + "." + std::to_string(tmpCounter++) + tmpSuffix;
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return;
+        bool written = writeAll(fd, data.data(), data.size());
+        ::close(fd);
+        if (!written || ::rename(tmp.c_str(), path.c_str()) < 0) {
+            ::unlink(tmp.c_str());
+            return;
+        }
+        Evict();
+    }
+
+    void CompileCache::Evict() {
+        struct File {
+            fs::file_time_type used;
+            uint64_t size;
+            fs::path path;
+        };
+        std::vector<File> files;
+        uint64_t total = 0;
+        auto now = fs::file_time_type::clock::now();
+        std::error_code error;
+        for (auto& item : fs::directory_iterator(directory_, error)) {
+            auto used = item.last_write_time(error);
+            if (error)
+                continue;
+            auto name = item.path().filename().string();
+            if (name.ends_with(tmpSuffix)) {
+                if (now - used > staleTmpAge)
+                    fs::remove(item.path(), error);
+                continue;
+            }
+            if (!name.ends_with(entrySuffix))
+                continue;
+            auto size = item.file_size(error);
+            if (error)
+                continue;
+            files.push_back({used, size, item.path()});
+            total += size;
+        }
+        if (total <= limit_bytes_)
+            return;
+
+        std::sort(files.begin(), files.end(), [](auto& lhs, auto& rhs) { return lhs.used < rhs.used; });
+        for (auto& file : files) {
+            if (total <= limit_bytes_)
+                break;
+            // Without error also if another run removed it already
+            fs::remove(file.path, error);
+            if (!error)
+                total -= file.size;
+        }
+    }
+
+    void CompileCache::Count(bool hit) {
+        int fd = ::open((directory_ / "stats").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return;
+        if (::flock(fd, LOCK_EX) == 0) {
+            uint64_t counts[2] = {0, 0};
+            if (::pread(fd, counts, sizeof(counts), 0) != sizeof(counts))
+                counts[0] = counts[1] = 0;
+            ++counts[hit ? 0 : 1];
+            // A failed write loses one count, which is all stats can lose
+            [[maybe_unused]] auto written = ::pwrite(fd, counts, sizeof(counts), 0);
+        }
+        ::close(fd);
+    }
+
+    CompileCache::Stats CompileCache::ReadStats() const {
+        Stats stats;
+        std::error_code error;
+        for (auto& item : fs::directory_iterator(directory_, error)) {
+            if (!item.path().filename().string().ends_with(entrySuffix))
+                continue;
+            auto size = item.file_size(error);
+            if (error)
+                continue;
+            ++stats.entries;
+            stats.bytes += size;
+        }
+
+        int fd = ::open((directory_ / "stats").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            uint64_t counts[2];
+            if (::flock(fd, LOCK_SH) == 0 && ::pread(fd, counts, sizeof(counts), 0) == sizeof(counts)) {
+                stats.hits = counts[0];
+                stats.misses = counts[1];
+            }
+            ::close(fd);
+        }
+        return stats;
+    }
+
+    void CompileCache::Dump(std::ostream& stream) const {
+        auto stats = ReadStats();
+        auto lookups = stats.hits + stats.misses;
+        stream << "Compile cache " << directory_.string() << ": " << stats.entries << " entries, "
+               << (stats.bytes + 1023) / 1024 << " of " << limit_bytes_ / 1024 << " KiB, "
+               << stats.hits << " hits, " << stats.misses << " misses";
+        if (lookups)
+            stream << " (" << 100 * stats.hits / lookups << "% hit rate)";
+        stream << std::endl;
+    }
+
+}  // namespace parasl
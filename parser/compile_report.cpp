@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#include <sys/resource.h>
+
+#include "compile_report.h"
+
+namespace {
+    // Constant-initialized, so usable by allocations made before main and while threads start
+    thread_local parasl::Allocations threadAllocated;
+}
+
+// Counting allocations needs the global operator new; it allocates as the default one does
+void* operator new(std::size_t size) {
+    ++threadAllocated.count;
+    threadAllocated.bytes += size;
+    for (;;) {
+        if (auto* memory = std::malloc(size ? size : 1))
+            return memory;
+        auto handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+// Replaced together with operator new, so memory always goes back to the allocator it came from
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::nothrow_t const&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::nothrow_t const&) noexcept {
+    std::free(memory);
+}
+
+namespace parasl {
+
+    namespace {
+
+        Allocations operator-(Allocations lhs, Allocations rhs) {
+            return {lhs.count - rhs.count, lhs.bytes - rhs.bytes};
+        }
+
+        Allocations& operator+=(Allocations& lhs, Allocations rhs) {
+            lhs.count += rhs.count;
+            lhs.bytes += rhs.bytes;
+            return lhs;
+        }
+
+        double milliseconds(std::chrono::nanoseconds time) {
+            return std::chrono::duration<double, std::milli>(time).count();
+        }
+
+        // Of the whole process, in KiB
+        long peakResidentSet() {
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_maxrss;
+        }
+    }
+
+    Allocations ThreadAllocations() {
+        return threadAllocated;
+    }
+
+    CompileReport::Phase::Phase(CompileReport* report, char const* name) : report_(report), name_(name) {
+        if (!report_)
+            return;
+        outer_ = report_->current_;
+        report_->current_ = this;
+        allocated_ = ThreadAllocations();
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    void CompileReport::Phase::End() {
+        if (!report_)
+            return;
+        std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start_;
+        auto allocated = ThreadAllocations() - allocated_;
+        report_->current_ = outer_;
+        if (outer_) {
+            outer_->inner_time_ += time;
+            outer_->inner_allocated_ += allocated;
+        }
+        report_->Add(name_, time - inner_time_, allocated - inner_allocated_);
+        report_ = nullptr;
+    }
+
+    CompileReport::CompileReport(bool time, bool memory) : time_(time), memory_(memory) {
+        // Adding the usual phases doesn't allocate in the middle of a measured one
+        phases_.reserve(32);
+        allocated_ = ThreadAllocations();
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    void CompileReport::Add(std::string_view name, std::chrono::nanoseconds time, Allocations allocated) {
+        if (finished_)
+            return;
+        auto phase = std::find_if(phases_.begin(), phases_.end(), [&](auto& phase) { return phase.name == name; });
+        if (phase == phases_.end())
+            phase = phases_.insert(phase, Measured{name, {}, {}});
+        phase->time += time;
+        phase->allocated += allocated;
+    }
+
+    void CompileReport::Record(ast::Builder const& builder, basic_syntax_nodes::SyntaxNode const* root) {
+        recorded_ = true;
+        tree_ = {};
+        tree_.run(root);
+        types_ = builder.typeCounts();
+        scope_depth_ = builder.scopePeakDepth();
+    }
+
+    void CompileReport::Finish() {
+        if (finished_)
+            return;
+        total_time_ = std::chrono::steady_clock::now() - start_;
+        total_allocated_ = ThreadAllocations() - allocated_;
+        finished_ = true;
+    }
+
+    std::vector<CompileReport::Measured> CompileReport::Phases() const {
+        auto phases = phases_;
+        Measured other{"other", total_time_, total_allocated_};
+        for (auto& phase : phases_) {
+            other.time -= std::min(other.time, phase.time);
+            other.allocated.count -= std::min(other.allocated.count, phase.allocated.count);
+            other.allocated.bytes -= std::min(other.allocated.bytes, phase.allocated.bytes);
+        }
+        phases.push_back(other);
+        return phases;
+    }
+
+    void CompileReport::Dump(std::ostream& stream) const {
+        std::ios format(nullptr);
+        format.copyfmt(stream);
+        stream << std::fixed << std::setprecision(3);
+
+        auto measured = [&](std::chrono::nanoseconds time, Allocations allocated, double share) {
+            if (time_) {
+                stream << milliseconds(time) << " ms";
+                if (share >= 0)
+                    stream << " (" << std::setprecision(1) << share << "%)" << std::setprecision(3);
+            }
+            if (time_ && memory_)
+                stream << ", ";
+            if (memory_)
+                stream << allocated.count << " allocations, " << allocated.bytes << " bytes";
+            stream << std::endl;
+        };
+
+        stream << "Compilation: ";
+        measured(total_time_, total_allocated_, -1);
+        for (auto& phase : Phases()) {
+            stream << "  " << phase.name << ": ";
+            auto share = total_time_.count() ? 100.0 * phase.time.count() / total_time_.count() : 0.0;
+            measured(phase.time, phase.allocated, share);
+        }
+
+        if (memory_) {
+            if (recorded_) {
+                tree_.dump(stream);
+                stream << "Types: " << types_.integral << " integral, " << types_.array << " array, "
+                       << types_.vector << " vector, " << types_.structure << " struct, " << types_.function
+                       << " function, with char, float and double" << std::endl;
+                stream << "Scopes: peak depth " << scope_depth_ << std::endl;
+            }
+            stream << "Peak resident set: " << peakResidentSet() << " KiB" << std::endl;
+        }
+        stream.copyfmt(format);
+    }
+
+    void CompileReport::DumpJson(std::ostream& stream) const {
+        std::ios format(nullptr);
+        format.copyfmt(stream);
+        stream << std::fixed << std::setprecision(3);
+
+        auto measured = [&](std::chrono::nanoseconds time, Allocations allocated) {
+            if (time_)
+                stream << "\"time_ms\": " << milliseconds(time);
+            if (time_ && memory_)
+                stream << ", ";
+            if (memory_)
+                stream << "\"allocations\": " << allocated.count << ", \"allocated_bytes\": " << allocated.bytes;
+        };
+
+        stream << "{" << std::endl << "  ";
+        measured(total_time_, total_allocated_);
+        stream << "," << std::endl << "  \"phases\": [";
+        auto phases = Phases();
+        for (size_t idx = 0; idx < phases.size(); ++idx) {
+            stream << (idx ? "," : "") << std::endl << "    {\"name\": " << std::quoted(phases[idx].name) << ", ";
+            measured(phases[idx].time, phases[idx].allocated);
+            stream << "}";
+        }
+        stream << std::endl << "  ]";
+
+        if (memory_) {
+            if (recorded_) {
+                stream << "," << std::endl << "  \"ast\": {\"nodes\": " << tree_.nodes() << ", \"bytes\": "
+                       << tree_.bytes() << ", \"kinds\": {";
+                bool first = true;
+                for (auto& [kind, counted] : tree_.kinds()) {
+                    stream << (first ? "" : ",") << std::endl << "    " << std::quoted(kind) << ": {\"nodes\": "
+                           << counted.nodes << ", \"bytes\": " << counted.bytes << "}";
+                    first = false;
+                }
+                stream << std::endl << "  }}," << std::endl;
+                stream << "  \"types\": {\"integral\": " << types_.integral << ", \"array\": " << types_.array
+                       << ", \"vector\": " << types_.vector << ", \"struct\": " << types_.structure
+                       << ", \"function\": " << types_.function << "}," << std::endl;
+                stream << "  \"scope_peak_depth\": " << scope_depth_;
+            }
+            stream << "," << std::endl << "  \"peak_rss_kib\": " << peakResidentSet();
+        }
+        stream << std::endl << "}" << std::endl;
+        stream.copyfmt(format);
+    }
+
+}  // namespace parasl
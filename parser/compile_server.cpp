@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "compile_server.h"
+#include "wire_format.h"
+
+namespace parasl {
+
+    namespace {
+
+        // Frames bigger than this are taken for garbage rather than programs
+        constexpr uint64_t maxFrame = uint64_t(1) << 30;
+
+        [[noreturn]] void socketError(std::string const& what) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        std::string encodeRequest(Options const& options, std::string const& source) {
+            WireWriter wire;
+            EncodeOptions(wire, options);
+            wire.str(source);
+            return wire.take();
+        }
+
+        Options decodeRequest(std::string const& request, std::string& source) {
+            WireReader wire(request, "compile request");
+            auto options = DecodeOptions(wire);
+            source = wire.str();
+            return options;
+        }
+
+        std::string encodeReply(CompileReply const& reply) {
+            WireWriter wire;
+            wire.flag(reply.ok);
+            wire.flag(reply.cached);
+            wire.str(reply.output);
+            wire.str(reply.errors);
+            return wire.take();
+        }
+
+        CompileReply decodeReply(std::string const& message) {
+            WireReader wire(message, "compile reply");
+            CompileReply reply;
+            reply.ok = wire.flag();
+            reply.cached = wire.flag();
+            reply.output = wire.str();
+            reply.errors = wire.str();
+            return reply;
+        }
+
+        void writeAll(int fd, char const* data, size_t size) {
+            while (size) {
+                auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    socketError("compile server send");
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+        // False on end of stream before the first byte
+        bool readAll(int fd, char* data, size_t size) {
+            for (size_t done = 0; done < size;) {
+                auto got = ::read(fd, data + done, size - done);
+                if (got < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    socketError("compile server receive");
+                }
+                if (got == 0) {
+                    if (done)
+                        throw std::runtime_error("compile server: connection closed mid-message");
+                    return false;
+                }
+                done += static_cast<size_t>(got);
+            }
+            return true;
+        }
+
+        void sendFrame(int fd, std::string const& message) {
+            WireWriter header;
+            header.u64(message.size());
+            auto prefix = header.take();
+            writeAll(fd, prefix.data(), prefix.size());
+            writeAll(fd, message.data(), message.size());
+        }
+
+        bool receiveFrame(int fd, std::string& message) {
+            std::string prefix(8, '\0');
+            if (!readAll(fd, prefix.data(), prefix.size()))
+                return false;
+            auto size = WireReader(prefix, "message header").u64();
+            if (size > maxFrame)
+                throw std::runtime_error("compile server: message of " + std::to_string(size) + " bytes");
+            message.resize(size);
+            if (size && !readAll(fd, message.data(), size))
+                throw std::runtime_error("compile server: connection closed mid-message");
+            return true;
+        }
+
+        sockaddr_un address(std::string const& path) {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path))
+                throw std::system_error(ENAMETOOLONG, std::generic_category(), "socket path " + path);
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            return addr;
+        }
+
+        // Connected socket, -1 with errno set if nobody listens at path
+        int connectTo(std::string const& path) {
+            auto addr = address(path);
+            int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+                socketError("can't create socket");
+            if (::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) < 0) {
+                auto error = errno;
+                ::close(fd);
+                errno = error;
+                return -1;
+            }
+            return fd;
+        }
+    }
+
+    CompileServer::CompileServer(std::string socket_path, size_t threads, size_t cache_capacity) :
+        socket_path_(std::move(socket_path)),
+        threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+        cache_capacity_(std::max<size_t>(cache_capacity, 1)) {}
+
+    CompileServer::~CompileServer() {
+        if (listen_fd_ >= 0)
+            ::close(listen_fd_);
+    }
+
+    void CompileServer::Listen() {
+        auto addr = address(socket_path_);
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0)
+            socketError("can't create socket");
+
+        auto bound = ::bind(listen_fd_, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr));
+        if (bound < 0 && errno == EADDRINUSE) {
+            // Socket file left by a server which is gone
+            int live = connectTo(socket_path_);
+            if (live >= 0) {
+                ::close(live);
+                errno = EADDRINUSE;
+                socketError("another server listens on " + socket_path_);
+            }
+            ::unlink(socket_path_.c_str());
+            bound = ::bind(listen_fd_, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr));
+        }
+        if (bound < 0 || ::listen(listen_fd_, SOMAXCONN) < 0)
+            socketError("can't listen on " + socket_path_);
+    }
+
+    void CompileServer::Run() {
+        Listen();
+        for (size_t idx = 0; idx < threads_; ++idx)
+            workers_.emplace_back(&CompileServer::Work, this);
+
+        while (!stopping_.load(std::memory_order_acquire)) {
+            int connection = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                break;
+            }
+            std::lock_guard lock(jobs_mutex_);
+            jobs_.push_back(connection);
+            jobs_ready_.notify_one();
+        }
+
+        {
+            std::lock_guard lock(jobs_mutex_);
+            stopping_.store(true, std::memory_order_release);
+        }
+        jobs_ready_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+        workers_.clear();
+        ::unlink(socket_path_.c_str());
+    }
+
+    void CompileServer::Stop() {
+        stopping_.store(true, std::memory_order_release);
+        // Wakes up accept
+        if (listen_fd_ >= 0)
+            ::shutdown(listen_fd_, SHUT_RDWR);
+    }
+
+    void CompileServer::Work() {
+        for (;;) {
+            int connection;
+            {
+                std::unique_lock lock(jobs_mutex_);
+                jobs_ready_.wait(lock, [this] { return !jobs_.empty() || stopping_.load(std::memory_order_relaxed); });
+                // Jobs accepted before Stop() are still served
+                if (jobs_.empty())
+                    return;
+                connection = jobs_.front();
+                jobs_.pop_front();
+            }
+            Serve(connection);
+        }
+    }
+
+    void CompileServer::Serve(int connection) {
+        try {
+            std::string request;
+            if (receiveFrame(connection, request)) {
+                CompileReply reply;
+                try {
+                    reply = Compile(request);
+                } catch (std::exception& e) {
+                    reply.errors = std::string("Error: ") + e.what() + "\n";
+                }
+                sendFrame(connection, encodeReply(reply));
+            }
+        } catch (std::exception&) {
+            // The client is gone, nobody to tell
+        }
+        ::close(connection);
+    }
+
+    CompileReply CompileServer::Compile(std::string const& request) {
+        std::string source;
+        auto options = decodeRequest(request, source);
+
+        // The same program compiles differently once a module it imports changes its interface
+        ModuleInterfaces imports;
+        std::ostringstream import_errors;
+        if (!modules_.Load(ScanImports(source.begin(), source.end()), options, imports, import_errors))
+            return {false, false, {}, std::move(import_errors).str()};
+        auto key = request;
+        if (!imports.empty()) {
+            WireWriter wire;
+            EncodeImports(wire, imports);
+            key += wire.take();
+        }
+
+        auto hash = std::hash<std::string>{}(key);
+        {
+            std::lock_guard lock(cache_mutex_);
+            auto found = cache_.find(hash);
+            if (found != cache_.end() && found->second->key == key) {
+                lru_.splice(lru_.begin(), lru_, found->second);
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                auto& program = *found->second->program;
+                return {program.ok, true, program.output, program.errors};
+            }
+        }
+
+        Parser parser{source.begin(), source.end(), options, &modules_};
+        auto program = std::make_shared<CompiledProgram const>(parser.Compile());
+        misses_.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard lock(cache_mutex_);
+        // Also replaces a program compiled meanwhile by another job or colliding by hash
+        if (auto found = cache_.find(hash); found != cache_.end()) {
+            lru_.erase(found->second);
+            cache_.erase(found);
+        }
+        lru_.push_front({hash, std::move(key), program});
+        cache_.emplace(hash, lru_.begin());
+        while (lru_.size() > cache_capacity_) {
+            cache_.erase(lru_.back().hash);
+            lru_.pop_back();
+        }
+        return {program->ok, false, program->output, program->errors};
+    }
+
+    CompileReply CompileRemote(std::string const& socket_path, Options const& options, std::string const& source) {
+        int fd = connectTo(socket_path);
+        if (fd < 0)
+            socketError("can't connect to compile server at " + socket_path);
+        try {
+            sendFrame(fd, encodeRequest(options, source));
+            std::string message;
+            if (!receiveFrame(fd, message))
+                throw std::runtime_error("compile server closed the connection");
+            ::close(fd);
+            return decodeReply(message);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+}  // namespace parasl
@@ -10,6 +10,8 @@
 
 #include "error_handler.h"
 #include "ast_builder.h"
+#include "ast_image.h"
+#include "compile_report.h"
 
 namespace parasl {
 
@@ -153,9 +155,25 @@ struct prim_types_list : qi::symbols<char, BuiltInType> {
     }
 };
 
+// Checked interface of a module: AST image of its top-level declarations, without initializers
+struct ModuleInterface {
+    // Canonical path of the module file
+    std::string module;
+    std::string image;
+};
+
+// Interfaces of the modules a program imports, by path as the program names them
+using ModuleInterfaces = std::map<std::string, std::shared_ptr<ModuleInterface const>>;
+
     namespace ASTBuilder{
 
-        extern ast::Builder* builderCtx;
+        // Builder and error stream of the compilation running on this thread
+        extern thread_local ast::Builder* builderCtx;
+        extern thread_local std::ostream* errorsCtx;
+        // Interfaces loaded for the imports of that compilation
+        extern thread_local ModuleInterfaces const* importsCtx;
+        // Report the actions are timed into as sema, if the compilation makes one
+        extern thread_local CompileReport* reportCtx;
 
         template<typename Operation>
         using OperationSequence = boost::fusion::vector<node_t, std::vector<boost::fusion::vector<Operation, node_t>>>;
@@ -165,10 +183,11 @@ struct prim_types_list : qi::symbols<char, BuiltInType> {
         struct ActionBase{
             template<typename Input, typename Context>
             void operator()(Input& input, Context &ctx, bool& pass) const {
+                CompileReport::Phase sema(reportCtx, "sema");
                 try {
                     static_cast<Derived const *>(this)->Derived::impl(input, ctx, pass);
                 } catch (ast::SemaError& e){
-                    std::cerr << "Semantic error: "<< e.what() << std::endl;
+                    *errorsCtx << "Semantic error: "<< e.what() << std::endl;
                     pass = false;
                 }
             }
@@ -313,6 +332,30 @@ struct prim_types_list : qi::symbols<char, BuiltInType> {
             }
         };
 
+        struct Import : public ActionBase<Import>{
+            template<typename Context>
+            void impl(std::string const& path, Context &ctx, qi::unused_type) const {
+                if(!importsCtx || !importsCtx->contains(path))
+                    throw ast::SemaError("Module \"" + path + "\" has not been loaded");
+
+                auto& interface = *importsCtx->at(path);
+                basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> declarations;
+                try {
+                    ast::AstImage image(interface.image);
+                    // Types of the interface are made by the importer's context
+                    if(image.fieldReordering() != builderCtx->dataLayout().fieldReordering() ||
+                       image.bitPacking() != builderCtx->dataLayout().bitPacking())
+                        throw ast::SemaError("Module \"" + path + "\" was compiled with another data layout");
+                    declarations = image.materialize(*builderCtx);
+                } catch (ast::SemaError&) {
+                    throw;
+                } catch (std::runtime_error& e) {
+                    throw ast::SemaError("Interface of module \"" + path + "\" is corrupt: " + e.what());
+                }
+                builderCtx->importModule(interface.module, std::move(declarations));
+            }
+        };
+
         struct IntegralTypeWithBitwidth : public ActionBase<IntegralTypeWithBitwidth>{
             template<typename Context>
             void impl(unsigned int width, Context &ctx, qi::unused_type) const {
@@ -476,8 +519,29 @@ struct prim_types_list : qi::symbols<char, BuiltInType> {
 
         struct OutputStatement : public ActionBase<OutputStatement>{
             template<typename Context>
-            void impl(boost::fusion::vector<int, node_t> const& output, Context &ctx, qi::unused_type) const {
-                // TODO
+            void impl(boost::fusion::vector<unsigned int, node_t> const& output, Context &ctx, qi::unused_type) const {
+                boost::fusion::at_c<0>(ctx.attributes) = builderCtx->createOutputStatement(
+                        boost::fusion::at_c<0>(output),
+                        boost::fusion::at_c<1>(output)
+                        );
+            }
+        };
+
+        struct Layer : public ActionBase<Layer>{
+            template<typename Context>
+            void impl(boost::fusion::vector<unsigned int, std::string, node_t> const& layer, Context &ctx, qi::unused_type) const {
+                boost::fusion::at_c<0>(ctx.attributes) = builderCtx->createLayer(
+                        boost::fusion::at_c<0>(layer),
+                        boost::fusion::at_c<1>(layer),
+                        boost::fusion::at_c<2>(layer)
+                        );
+            }
+        };
+
+        struct Layers : public ActionBase<Layers>{
+            template<typename Context>
+            void impl(std::vector<node_t>& layers, Context &ctx, qi::unused_type) const {
+                boost::fusion::at_c<0>(ctx.attributes) = builderCtx->createLayers(std::move(layers));
             }
         };
 
@@ -0,0 +1,72 @@
+#ifndef PARASL_COMPILE_CACHE_H
+#define PARASL_COMPILE_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#include "parser.h"
+
+namespace parasl {
+
+/*
+ * Compilation results kept on disk across runs: one file per program in the cache directory,
+ * named by a hash of the source, the options, the imported interfaces and the compiler build,
+ * and likewise one per interface of an imported module. A hit replays what the
+ * compilation printed without parsing and checking the program again. Entries are written to
+ * a temporary file and renamed into place, so runs sharing the directory never see a partial
+ * entry. Past the size limit the least recently used entries go first; an entry's
+ * modification time is refreshed on every hit. Hit and miss counts live in the directory too,
+ * updated under a file lock.
+ */
+class CompileCache final {
+public:
+    struct Entry {
+        bool ok = false;
+        std::string output;
+        std::string errors;
+    };
+
+    struct Stats {
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // Bumped whenever the layout of entries or keys changes
+    static constexpr uint64_t formatVersion = 3;
+
+    // Creates the directory; throws std::filesystem::filesystem_error if it can't
+    CompileCache(std::filesystem::path directory, uint64_t limit_bytes);
+
+    // Identifies the program, its options, the interfaces it imports and the compiler which compiles it
+    static std::string Key(Options const& options, std::string const& source, ModuleInterfaces const& imports = {});
+
+    // Same for the interface of a module, which is kept as the output of its entry
+    static std::string InterfaceKey(Options const& options, std::string const& source,
+                                    ModuleInterfaces const& imports);
+
+    std::optional<Entry> Lookup(std::string const& key);
+
+    // Failures to write are ignored, the cache is only an optimization
+    void Store(std::string const& key, Entry const& entry);
+
+    [[nodiscard]] Stats ReadStats() const;
+
+    void Dump(std::ostream& stream) const;
+
+private:
+    [[nodiscard]] std::filesystem::path PathOf(std::string const& key) const;
+    void Count(bool hit);
+    void Evict();
+
+    std::filesystem::path directory_;
+    uint64_t limit_bytes_;
+};
+
+}  // namespace parasl
+
+#endif //PARASL_COMPILE_CACHE_H
@@ -0,0 +1,104 @@
+#ifndef PARASL_COMPILE_REPORT_H
+#define PARASL_COMPILE_REPORT_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "ast_builder.h"
+#include "tree_statistics.h"
+
+namespace parasl {
+
+// Made through operator new by the calling thread since it started
+struct Allocations {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+Allocations ThreadAllocations();
+
+/*
+ * Where one compilation spends time and memory: wall time and allocations of its phases,
+ * AST nodes and bytes by node kind, sizes of the type tables and the deepest nesting of
+ * scopes. A phase is what runs while its Phase object lives. A phase started inside another
+ * one is left out of the outer phase, so sema, which runs in the actions of the grammar, is
+ * not counted as parsing; phases of the same name add up. Time of the compilation outside
+ * any phase is reported as "other".
+ *
+ * Allocations are counted per thread by the compiler's global operator new, so they are
+ * those of the compiling thread: modules compiled by the workers of a ModuleLoader are in
+ * the time of the "modules" phase but not in its allocations.
+ */
+class CompileReport final {
+public:
+    class Phase final {
+    public:
+        // Measures nothing without a report
+        Phase(CompileReport* report, char const* name);
+        ~Phase() { End(); }
+
+        Phase(Phase const&) = delete;
+        Phase& operator=(Phase const&) = delete;
+
+        // Ends the phase before the object goes; phases inside it must have ended
+        void End();
+
+    private:
+        CompileReport* report_;
+        char const* name_;
+        Phase* outer_ = nullptr;
+        std::chrono::steady_clock::time_point start_;
+        Allocations allocated_;
+        // Spent in phases started inside this one
+        std::chrono::nanoseconds inner_time_{};
+        Allocations inner_allocated_;
+    };
+
+    // Time of the phases, their allocations and sizes of the program, or both
+    CompileReport(bool time, bool memory);
+
+    CompileReport(CompileReport const&) = delete;
+    CompileReport& operator=(CompileReport const&) = delete;
+
+    // Sizes of the checked program and of the tables of the builder which checked it
+    void Record(ast::Builder const& builder, basic_syntax_nodes::SyntaxNode const* root);
+
+    // Ends the compilation; further phases are not reported
+    void Finish();
+
+    void Dump(std::ostream& stream) const;
+    void DumpJson(std::ostream& stream) const;
+
+private:
+    struct Measured {
+        std::string_view name;
+        std::chrono::nanoseconds time{};
+        Allocations allocated{};
+    };
+
+    void Add(std::string_view name, std::chrono::nanoseconds time, Allocations allocated);
+    // Phases with the rest of the compilation last
+    std::vector<Measured> Phases() const;
+
+    bool time_;
+    bool memory_;
+    bool finished_ = false;
+    std::chrono::steady_clock::time_point start_;
+    Allocations allocated_;
+    std::chrono::nanoseconds total_time_{};
+    Allocations total_allocated_;
+    std::vector<Measured> phases_;
+    Phase* current_ = nullptr;
+
+    bool recorded_ = false;
+    ast::TreeStatistics tree_;
+    ast::Context::TypeCounts types_{};
+    size_t scope_depth_ = 0;
+};
+
+}  // namespace parasl
+
+#endif //PARASL_COMPILE_REPORT_H
@@ -0,0 +1,94 @@
+#ifndef PARASL_COMPILE_SERVER_H
+#define PARASL_COMPILE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "modules.h"
+
+namespace parasl {
+
+// What a compilation job reports back to the client
+struct CompileReply {
+    bool ok = false;
+    // Compiled program came from the cache
+    bool cached = false;
+    std::string output;
+    std::string errors;
+};
+
+/*
+ * Resident compiler. Listens on a Unix socket and compiles programs sent by clients
+ * (CompileRemote) on a persistent pool of threads, so a short job pays neither for process
+ * start-up nor, if the same program was compiled before, for compilation. Compiled programs
+ * are kept by a hash of their source, options and the interfaces of the modules they import,
+ * least recently used ones are dropped past cache_capacity; interfaces are kept by a loader
+ * shared by all jobs. One connection is one job: the request goes in, the reply comes out.
+ */
+class CompileServer final {
+public:
+    CompileServer(std::string socket_path, size_t threads, size_t cache_capacity);
+    ~CompileServer();
+
+    CompileServer(CompileServer const&) = delete;
+    CompileServer& operator=(CompileServer const&) = delete;
+
+    // Serves until Stop(); throws std::system_error if the socket can't be bound
+    void Run();
+
+    // Async-signal-safe
+    void Stop();
+
+    [[nodiscard]] uint64_t Hits() const { return hits_.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t Misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        size_t hash;
+        // Encoded request, options and source, then the imported interfaces
+        std::string key;
+        std::shared_ptr<CompiledProgram const> program;
+    };
+
+    void Listen();
+    void Work();
+    void Serve(int connection);
+    CompileReply Compile(std::string const& request);
+
+    std::string socket_path_;
+    size_t threads_;
+    size_t cache_capacity_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_ = false;
+
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_ready_;
+    std::deque<int> jobs_;
+    std::vector<std::thread> workers_;
+
+    // Most recently used first
+    std::mutex cache_mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<size_t, std::list<Entry>::iterator> cache_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+
+    ModuleLoader modules_;
+};
+
+// Compiles source on the server listening at socket_path. Throws std::system_error if the server
+// can't be reached, std::runtime_error if it drops the job
+CompileReply CompileRemote(std::string const& socket_path, Options const& options, std::string const& source);
+
+}  // namespace parasl
+
+#endif //PARASL_COMPILE_SERVER_H
@@ -20,8 +20,8 @@ struct error_handler {
     template <typename, typename, typename>
     struct result { typedef void type; };
 
-    error_handler(Iterator first, Iterator last)
-            : first(first), last(last) {}
+    error_handler(Iterator first, Iterator last, std::ostream& out = std::cout)
+            : first(first), last(last), out(&out) {}
 
     template <typename Message, typename What>
     void operator()(
@@ -32,15 +32,15 @@ struct error_handler {
         int line;
         Iterator line_start = get_pos(err_pos, line);
         if (err_pos != last) {
-            std::cout << message << what << " line " << line << ':' << std::endl;
-            std::cout << get_line(line_start) << std::endl;
+            *out << message << what << " line " << line << ':' << std::endl;
+            *out << get_line(line_start) << std::endl;
             for (; line_start != err_pos; ++line_start)
-                std::cout << ' ';
-            std::cout << '^' << std::endl;
+                *out << ' ';
+            *out << '^' << std::endl;
         }
         else {
-            std::cout << "Unexpected end of file. ";
-            std::cout << message << what << " line " << line << std::endl;
+            *out << "Unexpected end of file. ";
+            *out << message << what << " line " << line << std::endl;
         }
     }
 
@@ -76,6 +76,8 @@ struct error_handler {
 
     Iterator first;
     Iterator last;
+    // Copied into the grammar's error actions, hence a pointer
+    std::ostream* out;
     std::vector<Iterator> iters;
 };
 
@@ -0,0 +1,76 @@
+#ifndef PARASL_INCREMENTAL_H
+#define PARASL_INCREMENTAL_H
+
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "modules.h"
+
+namespace parasl {
+
+/*
+ * Compiles successive versions of one program, checking again only what changed. The source
+ * is split into units, top-level layers or top-level statements, and each unit is parsed and
+ * checked on its own on top of the symbols declared by the units before it. A unit of the
+ * previous version is reused when its text is the same and so is everything checking it
+ * looked at: every name it mentions is declared at top level with the same type, or is still
+ * undeclared, and if-conversion numbers its predicates from the same point. References of a
+ * reused unit are then pointed at the current declarations of the names. So an edit
+ * rechecks the edited units, and the units after them only if a top-level symbol they
+ * mention appeared, disappeared or changed its type. Checked units are kept as sema left
+ * them, the passes after sema run on a copy of the assembled program.
+ *
+ * If a unit doesn't parse on its own, the whole program is compiled as usual, so errors are
+ * reported exactly as by Parser. So are programs with imports, their modules are loaded again
+ * on every compilation but only checked again when they change.
+ */
+class IncrementalCompiler final {
+public:
+    struct Result {
+        bool ok = false;
+        std::string output;
+        std::string errors;
+        size_t units = 0;
+        // Units parsed and checked in this compilation
+        size_t rechecked = 0;
+        // The program was compiled as a whole
+        bool whole = false;
+        // Splitting, parsing and checking, then everything
+        std::chrono::nanoseconds check_time{};
+        std::chrono::nanoseconds total_time{};
+    };
+
+    explicit IncrementalCompiler(Options const& options);
+
+    IncrementalCompiler(IncrementalCompiler const&) = delete;
+    IncrementalCompiler& operator=(IncrementalCompiler const&) = delete;
+
+    Result Compile(std::string const& source);
+
+private:
+    struct Unit;
+    using Grammar = layers_grammar<StrIter, Skipper<StrIter>>;
+
+    std::shared_ptr<Unit> Check(Grammar const& grammar, StrIter begin, StrIter end, size_t hash);
+    Result CompileWhole(std::string const& source);
+
+    Options options_;
+    // Owns the types of all units, which are shared between versions
+    std::unique_ptr<ast::Builder> builder_;
+    // Units of the last version compiled unit by unit, in source order
+    std::vector<std::shared_ptr<Unit>> units_;
+    ModuleLoader modules_;
+};
+
+// Compiles the file and again on every change until stop is set, reporting the latency of each
+// compilation to err. Returns false if the file can't be read at the start
+bool Watch(std::string const& path, Options const& options, volatile std::sig_atomic_t const& stop,
+           std::ostream& out = std::cout, std::ostream& err = std::cerr);
+
+}  // namespace parasl
+
+#endif //PARASL_INCREMENTAL_H
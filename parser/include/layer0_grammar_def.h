@@ -200,7 +200,7 @@ layer0_grammar<Iterator, Skipper>::layer0_grammar(error_handler<Iterator>& error
      */
 
     OUTPUT_STMT =
-                (lit("output") > '(' > int_(0) >> ',' > EXPR > ')') /* EXPR, not NAME? */  [ASTBuilder::OutputStatement()]
+                (lit("output") > '(' > uint_ >> ',' > EXPR > ')') /* EXPR, not NAME? */  [ASTBuilder::OutputStatement()]
             ;
 
     LOOP_IF_BODY =  STMT            [ASTBuilder::CompoundStatement()]
@@ -297,12 +297,8 @@ layer0_grammar<Iterator, Skipper>::layer0_grammar(error_handler<Iterator>& error
     )
 
 
+    // Body of a single layer, layer(N, "name") { ... } itself is parsed by layers_grammar
     LAYER0 =
-// TODO
-#if 0
-                lit["layer"] >> '(' >> int_ >> char_(',') >> string >> ')' >> char_('{') >> STMTS >> char_('}')
-            |
-#endif
                 STMTS   [ASTBuilder::Pass()]
             ;
 
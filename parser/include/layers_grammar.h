@@ -11,15 +11,38 @@ namespace parasl {
 template<typename Iterator, typename Skipper>
 struct layers_grammar : qi::grammar<Iterator, node_t(), Skipper> {
     layers_grammar(error_handler<Iterator>& error_handler)
-                    : layers_grammar::base_type{LAYERS}, LAYER0(error_handler) {
+                    : layers_grammar::base_type{PROGRAM}, LAYER0(error_handler) {
         using error_handler_function = function<parasl::error_handler<Iterator>>;
 
+        LAYER_NAME = lexeme['"' > *(char_ - '"') > '"'];
+
+        // layer(N, "name") { ... }, program without layers is layer 0 alone
+        LAYER =
+                    ((lit("layer") >> '(') > uint_ > ',' > LAYER_NAME > ')'
+                >   '{' > LAYER0 > '}')                        [ASTBuilder::Layer()]
+                ;
+
         LAYERS =
-                    LAYER0
+                    (+LAYER)                                    [ASTBuilder::Layers()]
+                |   LAYER0                                      [ASTBuilder::Pass()]
+                ;
+
+        MODULE_PATH = lexeme['"' > *(char_ - '"') > '"'];
+
+        // import "path"; brings the top-level declarations of the module, loaded before parsing, into scope
+        IMPORT =
+                    ((lit("import") >> MODULE_PATH) > ';')      [ASTBuilder::Import()]
+                ;
+
+        PROGRAM =
+                    *IMPORT >> LAYERS
                 ;
 
         BOOST_SPIRIT_DEBUG_NODES(
+                (PROGRAM)
+                (IMPORT)
                 (LAYERS)
+                (LAYER)
                 (LAYER0)
         )
 
@@ -27,11 +50,16 @@ struct layers_grammar : qi::grammar<Iterator, node_t(), Skipper> {
         on_error<fail>(LAYERS,
                        error_handler_function(error_handler)(
                                "Error! Expecting ", _4, _3));
+        on_error<fail>(PROGRAM,
+                       error_handler_function(error_handler)(
+                               "Error! Expecting ", _4, _3));
     }
 
 private:
     layer0_grammar<Iterator, Skipper> LAYER0;
-    qi::rule<Iterator, node_t(), Skipper> LAYERS;
+    qi::rule<Iterator, std::string(), Skipper> LAYER_NAME, MODULE_PATH;
+    qi::rule<Iterator, Skipper> IMPORT;
+    qi::rule<Iterator, node_t(), Skipper> LAYER, LAYERS, PROGRAM;
 };
 
 }  // namespace parasl
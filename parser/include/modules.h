@@ -0,0 +1,69 @@
+#ifndef PARASL_MODULES_H
+#define PARASL_MODULES_H
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+
+namespace parasl {
+
+class CompileCache;
+
+// Paths of the import statements a program starts with, as written
+std::vector<std::string> ScanImports(StrIter begin, StrIter end);
+
+/*
+ * Compiles the modules a program imports into interfaces. A module is a source file whose
+ * top-level declarations other files use after import "path"; the path is relative to the
+ * importing file, for the program itself to options.module_dir. Every module is parsed and
+ * checked once per load however many files import it, and only for its interface: names and
+ * types of its top-level declarations, which importers materialize in their own context
+ * instead of parsing the module. Modules run on a pool of threads as soon as the modules they
+ * import are done, so independent ones compile in parallel.
+ *
+ * An interface is reused while the module's source, the options and the interfaces it
+ * imports are the same: in memory by the loader, which keeps the last one of every module
+ * file, and on disk if the loader has a compile cache. Loading an unchanged program again
+ * only reads the module files. Load may be called from several threads at once.
+ */
+class ModuleLoader final {
+public:
+    // 0 threads uses all cores; the cache is optional
+    explicit ModuleLoader(size_t threads = 0, CompileCache* cache = nullptr);
+
+    ModuleLoader(ModuleLoader const&) = delete;
+    ModuleLoader& operator=(ModuleLoader const&) = delete;
+
+    // Interfaces of the imports by path as written; false after printing the errors to err
+    bool Load(std::vector<std::string> const& imports, Options const& options, ModuleInterfaces& interfaces,
+              std::ostream& err);
+
+    // Modules parsed and checked, rather than found in memory or in the cache
+    [[nodiscard]] uint64_t Compiled() const;
+
+private:
+    struct Module;
+    struct Checked;
+    using Modules = std::map<std::filesystem::path, std::unique_ptr<Module>>;
+
+    Module* Resolve(std::filesystem::path const& dir, std::string const& import, Modules& modules,
+                    std::vector<Module*>& stack, std::vector<Module*>& order, std::ostream& err);
+    void Build(Module& module, Options const& options);
+
+    size_t threads_;
+    CompileCache* cache_;
+    mutable std::mutex mutex_;
+    // Last compilation of every module file with its key, by canonical path
+    std::map<std::filesystem::path, std::pair<std::string, std::shared_ptr<Checked const>>> checked_;
+    uint64_t compiled_ = 0;
+};
+
+}  // namespace parasl
+
+#endif //PARASL_MODULES_H
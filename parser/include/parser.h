@@ -1,21 +1,95 @@
 #ifndef PARASL_PARSER_H
 #define PARASL_PARSER_H
 
+#include <iostream>
+#include <memory>
 #include <string>
 
 #include "layers_grammar.h"
+#include "bounds_check.h"
+#include "ownership.h"
+#include "soa_layout.h"
+#include "address_lowering.h"
+#include "loop_nest.h"
+#include "loop_unroll.h"
+#include "layer_pipeline.h"
+#include "dataflow_schedule.h"
+#include "process_placement.h"
+#include "ast_image.h"
+#include "compile_report.h"
 
 namespace parasl {
 
+struct Options {
+    ast::bounds_check_mode_t bounds_checks = ast::bounds_check_mode_t::ELIDE;
+    // Print summaries of optimization analyses
+    bool opt_report = false;
+    // Lay out struct fields by decreasing alignment instead of declaration order
+    bool reorder_fields = false;
+    // Store arrays of narrow int(N) in N bits per element
+    bool pack_ints = false;
+    // Interchange and tiling of perfect loop nests
+    bool loop_nest_opt = true;
+    // Max number of statements in both arms of 'if' turned into selects, 0 disables if-conversion
+    unsigned if_conversion_limit = 4;
+    // Size of unrolled loop body in AST nodes, 0 disables unrolling
+    size_t unroll_budget = 64;
+    // Threads the layers of a pipeline are scheduled onto, 0 for all cores
+    size_t pipeline_threads = 0;
+    // Run layer groups as separate processes
+    bool processes = false;
+    // Placement config of layer groups, empty for a process per scheduled stage
+    std::string placement;
+    ast::transport_t transport = ast::transport_t::SHARED_MEMORY;
+    // File to write the checked AST to as a binary image
+    std::string emit_ast_bin;
+    // Binary image to take the checked AST from instead of parsing the source
+    std::string load_ast_bin;
+    // Directory imports of the program are relative to, the current one if empty
+    std::string module_dir;
+};
+
+class ModuleLoader;
+
+// Checked program with the report of its compilation; the builder owns types of the tree
+struct CompiledProgram {
+    bool ok = false;
+    std::unique_ptr<ast::Builder> builder;
+    std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>> root;
+    std::string output;
+    std::string errors;
+};
+
+// Analyses and transformations of a checked tree; prints the tree and the reports options ask for.
+// Every pass is a phase of the report if there is one
+bool RunPasses(Options const& options, ast::Builder& builder, basic_syntax_nodes::SyntaxNode* root,
+               std::ostream& out, std::ostream& err, CompileReport* report = nullptr);
+
 class Parser final {
 public:
-    Parser(StrIter begin, StrIter end) : parse_begin_(begin), parse_end_(end) {}
+    // Imported modules are compiled by the loader if there is one, so it can reuse them.
+    // Phases of the compilation and sizes of the checked program go to the report if there is one
+    Parser(StrIter begin, StrIter end, Options const& options = {}, ModuleLoader* modules = nullptr,
+           CompileReport* report = nullptr) :
+        parse_begin_(begin), parse_end_(end), options_(options), modules_(modules), report_(report) {}
 
-    bool Run();
+    bool Run(std::ostream& out = std::cout, std::ostream& err = std::cerr);
+
+    // Keeps the tree and captures the output instead of printing it
+    CompiledProgram Compile();
 
 private:
+    bool Run(ast::Builder& builder, std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>& root,
+             std::ostream& out, std::ostream& err);
+    bool Load(ast::Builder& builder, std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>& root,
+              std::ostream& err);
+    bool Emit(ast::Builder const& builder, basic_syntax_nodes::SyntaxNode const* root, std::ostream& err);
+
     StrIter parse_begin_;
     StrIter parse_end_;
+    Options options_;
+    ModuleLoader* modules_;
+    CompileReport* report_;
 };
 
 }  // namespace parasl
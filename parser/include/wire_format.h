@@ -0,0 +1,123 @@
+#ifndef PARASL_WIRE_FORMAT_H
+#define PARASL_WIRE_FORMAT_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "parser.h"
+
+namespace parasl {
+
+// Fixed-order fields: little-endian 64-bit integers, one-byte flags, length-prefixed strings
+class WireWriter {
+public:
+    void u64(uint64_t value) {
+        for (int byte = 0; byte < 8; ++byte)
+            data_.push_back(static_cast<char>(value >> (8 * byte)));
+    }
+
+    void flag(bool value) {
+        data_.push_back(value ? 1 : 0);
+    }
+
+    void str(std::string const& value) {
+        u64(value.size());
+        data_ += value;
+    }
+
+    std::string take() {
+        return std::move(data_);
+    }
+
+private:
+    std::string data_;
+};
+
+// Throws std::runtime_error naming what is read if the data ends early
+class WireReader {
+public:
+    WireReader(std::string const& data, char const* what) : data_(data), what_(what) {}
+
+    uint64_t u64() {
+        need(8);
+        uint64_t value = 0;
+        for (int byte = 0; byte < 8; ++byte)
+            value |= uint64_t(static_cast<unsigned char>(data_[pos_++])) << (8 * byte);
+        return value;
+    }
+
+    bool flag() {
+        need(1);
+        return data_[pos_++] != 0;
+    }
+
+    std::string str() {
+        auto size = u64();
+        need(size);
+        auto value = data_.substr(pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+    [[nodiscard]] bool done() const {
+        return pos_ == data_.size();
+    }
+
+private:
+    void need(uint64_t size) const {
+        if (size > data_.size() - pos_)
+            throw std::runtime_error(std::string("truncated ") + what_);
+    }
+
+    std::string const& data_;
+    char const* what_;
+    size_t pos_ = 0;
+};
+
+// Every option which changes what compilation prints; new options go here too
+inline void EncodeOptions(WireWriter& wire, Options const& options) {
+    wire.u64(static_cast<uint64_t>(options.bounds_checks));
+    wire.flag(options.opt_report);
+    wire.flag(options.reorder_fields);
+    wire.flag(options.pack_ints);
+    wire.flag(options.loop_nest_opt);
+    wire.u64(options.if_conversion_limit);
+    wire.u64(options.unroll_budget);
+    wire.u64(options.pipeline_threads);
+    wire.flag(options.processes);
+    wire.str(options.placement);
+    wire.u64(static_cast<uint64_t>(options.transport));
+    wire.str(options.module_dir);
+}
+
+inline Options DecodeOptions(WireReader& wire) {
+    Options options;
+    options.bounds_checks = static_cast<ast::bounds_check_mode_t>(wire.u64());
+    options.opt_report = wire.flag();
+    options.reorder_fields = wire.flag();
+    options.pack_ints = wire.flag();
+    options.loop_nest_opt = wire.flag();
+    options.if_conversion_limit = static_cast<unsigned>(wire.u64());
+    options.unroll_budget = wire.u64();
+    options.pipeline_threads = wire.u64();
+    options.processes = wire.flag();
+    options.placement = wire.str();
+    options.transport = static_cast<ast::transport_t>(wire.u64());
+    options.module_dir = wire.str();
+    return options;
+}
+
+// All a compilation depends on of the modules it imports
+inline void EncodeImports(WireWriter& wire, ModuleInterfaces const& imports) {
+    wire.u64(imports.size());
+    for (auto& [path, interface] : imports) {
+        wire.str(path);
+        wire.str(interface->module);
+        wire.str(interface->image);
+    }
+}
+
+}  // namespace parasl
+
+#endif //PARASL_WIRE_FORMAT_H
@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include "incremental.h"
+#include "ast_clone.h"
+#include "ast_utils.h"
+
+namespace parasl {
+
+    using basic_syntax_nodes::Ref;
+    using basic_syntax_nodes::SyntaxNode;
+    using Clock = std::chrono::steady_clock;
+
+    namespace {
+
+        constexpr auto pollInterval = std::chrono::milliseconds(50);
+
+        bool isNameStart(char c) {
+            return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        bool isNameChar(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        // Position of the next token, spaces and comments are skipped as by Skipper
+        size_t skipBlanks(std::string_view source, size_t pos) {
+            while (pos < source.size()) {
+                if (std::isspace(static_cast<unsigned char>(source[pos]))) {
+                    ++pos;
+                } else if (source.substr(pos, 2) == "//") {
+                    pos = source.find('\n', pos);
+                    if (pos == std::string_view::npos)
+                        return source.size();
+                } else {
+                    break;
+                }
+            }
+            return pos;
+        }
+
+        // Statement ending with ';' or '}' at next is continued by an 'else' or, after '}', by anything
+        // but the start of another statement
+        bool endsStatement(std::string_view source, char last, size_t next) {
+            if (next == source.size())
+                return true;
+            if (source.substr(next, 4) == "else" && (next + 4 == source.size() || !isNameChar(source[next + 4])))
+                return false;
+            return last == ';' || isNameStart(source[next]) || source[next] == '{';
+        }
+
+        /*
+         * Top-level layers or statements: spans ending with ';' or '}' outside of any brackets.
+         * Blanks before a unit belong to it, blanks after the last one to the last one. A split
+         * in a wrong place only makes a unit which doesn't parse on its own.
+         */
+        std::vector<std::string_view> splitUnits(std::string_view source) {
+            std::vector<std::string_view> units;
+            size_t begin = 0;
+            size_t depth = 0;
+            for (size_t pos = 0; pos < source.size(); ++pos) {
+                char c = source[pos];
+                if (c == '"' || source.substr(pos, 2) == "//") {
+                    pos = source.find(c == '"' ? '"' : '\n', pos + 1);
+                    if (pos == std::string_view::npos)
+                        break;
+                    continue;
+                }
+                if (c == '(' || c == '[' || c == '{') {
+                    ++depth;
+                    continue;
+                }
+                if (c == ')' || c == ']' || c == '}') {
+                    if (depth)
+                        --depth;
+                    if (c != '}')
+                        continue;
+                } else if (c != ';') {
+                    continue;
+                }
+                if (depth || !endsStatement(source, c, skipBlanks(source, pos + 1)))
+                    continue;
+                units.push_back(source.substr(begin, pos + 1 - begin));
+                begin = pos + 1;
+            }
+            if (units.empty() || skipBlanks(source, begin) < source.size())
+                units.push_back(source.substr(begin));
+            else
+                units.back() = source.substr(units.back().data() - source.data());
+            return units;
+        }
+
+        // Names the text may look up when checked: every identifier outside of comments and strings
+        std::vector<std::string> namesIn(std::string_view text) {
+            std::vector<std::string> names;
+            for (size_t pos = 0; pos < text.size();) {
+                if (text[pos] == '"' || text.substr(pos, 2) == "//") {
+                    pos = text.find(text[pos] == '"' ? '"' : '\n', pos + 1);
+                    if (pos == std::string_view::npos)
+                        break;
+                    ++pos;
+                } else if (isNameStart(text[pos])) {
+                    auto end = pos;
+                    while (end < text.size() && isNameChar(text[end]))
+                        ++end;
+                    names.emplace_back(text.substr(pos, end - pos));
+                    pos = end;
+                } else {
+                    ++pos;
+                }
+            }
+            std::sort(names.begin(), names.end());
+            names.erase(std::unique(names.begin(), names.end()), names.end());
+            return names;
+        }
+
+        // Symbol table holds declaration statements
+        expressions::Identifier const* declaredIdentifier(SyntaxNode const* decl) {
+            return dynamic_cast<statements::DeclarationStatement const&>(*decl).identifier();
+        }
+
+        // Type of the top-level declaration of name, none for undeclared names
+        types::Type const* globalType(ast::Builder const& builder, std::string const& name) {
+            auto found = builder.globalSymbols().find(name);
+            if (found == builder.globalSymbols().end())
+                return nullptr;
+            return declaredIdentifier(found->second)->GetType();
+        }
+
+        void collectGlobals(SyntaxNode const* node, ast::Builder const& builder,
+                            std::vector<std::pair<std::string, SyntaxNode*>>& globals) {
+            if (!node)
+                return;
+            if (auto* decl = dynamic_cast<statements::DeclarationStatement const*>(node)) {
+                auto name = decl->identifier()->GetSymbolName();
+                auto found = builder.globalSymbols().find(name);
+                if (found != builder.globalSymbols().end() && found->second == node)
+                    globals.emplace_back(std::move(name), found->second);
+            }
+            for (size_t idx = 0; idx < node->GetChildsNum(); ++idx)
+                collectGlobals(node->GetChildAt(idx), builder, globals);
+        }
+
+        // References to variables declared outside of the unit
+        void collectExternals(SyntaxNode const* node, std::set<expressions::Identifier const*> const& declared,
+                              std::vector<std::pair<expressions::Reference*, std::string>>& externals) {
+            if (!node)
+                return;
+            if (auto* ref = dynamic_cast<expressions::Reference const*>(node); ref && !declared.contains(ref->identifier()))
+                // Units own their trees, a reused one is rebound in place
+                externals.emplace_back(const_cast<expressions::Reference*>(ref), ref->identifier()->GetSymbolName());
+            for (size_t idx = 0; idx < node->GetChildsNum(); ++idx)
+                collectExternals(node->GetChildAt(idx), declared, externals);
+        }
+
+        bool readSource(std::string const& path, std::string& source) {
+            std::ifstream in(path, std::ios_base::in);
+            if (!in)
+                return false;
+            source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            return !in.bad();
+        }
+    }
+
+    struct IncrementalCompiler::Unit {
+        std::string text;
+        size_t hash = 0;
+        // Names the text mentions with the type of their top-level declaration, none if undeclared
+        std::vector<std::pair<std::string, types::Type const*>> context;
+        unsigned first_predicate = 0;
+        unsigned next_predicate = 0;
+        // Compound statement of the layer or of the statements as sema made it
+        Ref<SyntaxNode> tree;
+        // Top-level declarations, pointing into tree
+        std::vector<std::pair<std::string, SyntaxNode*>> globals;
+        // References to other units with the names they refer to; the declarations they point
+        // at may be gone since, they are rebound on every reuse
+        std::vector<std::pair<expressions::Reference*, std::string>> externals;
+        // Semantic errors of alternatives the parser backtracked from
+        std::string errors;
+
+        // Checking the text again would give the same tree
+        [[nodiscard]] bool Reusable(ast::Builder const& builder) const {
+            return builder.predicateCounter() == first_predicate &&
+                   std::all_of(context.begin(), context.end(), [&](auto const& name) {
+                       return globalType(builder, name.first) == name.second;
+                   });
+        }
+
+        void Reuse(ast::Builder& builder) const {
+            for (auto& [ref, name] : externals)
+                ref->rebind(declaredIdentifier(builder.globalSymbols().at(name)));
+            for (auto& [name, decl] : globals)
+                builder.restoreGlobalSymbol(name, decl);
+            builder.setPredicateCounter(next_predicate);
+        }
+    };
+
+    IncrementalCompiler::IncrementalCompiler(Options const& options) :
+        options_(options), builder_(std::make_unique<ast::Builder>()) {
+        builder_->dataLayout().setFieldReordering(options_.reorder_fields);
+        builder_->dataLayout().setBitPacking(options_.pack_ints);
+        builder_->setIfConversionLimit(options_.if_conversion_limit);
+    }
+
+    IncrementalCompiler::Result IncrementalCompiler::Compile(std::string const& source) {
+        auto start = Clock::now();
+        Result result;
+
+        ASTBuilder::builderCtx = builder_.get();
+        builder_->resetSymbols();
+        builder_->setPredicateCounter(0);
+
+        std::unordered_multimap<size_t, std::shared_ptr<Unit>> previous;
+        for (auto& unit : units_)
+            previous.emplace(unit->hash, unit);
+
+        // Units are parsed in place; the error handler only prints if a unit doesn't parse, and then
+        // the whole program is compiled again
+        std::string buffer = source;
+        // Declarations of imported modules are not units of the program
+        if (!ScanImports(buffer.begin(), buffer.end()).empty())
+            return CompileWhole(source);
+        std::ostringstream discarded;
+        error_handler<StrIter> error_handler(buffer.begin(), buffer.end(), discarded);
+        Grammar grammar(error_handler);
+
+        std::vector<std::shared_ptr<Unit>> units;
+        for (auto text : splitUnits(buffer)) {
+            auto hash = std::hash<std::string_view>{}(text);
+            std::shared_ptr<Unit> unit;
+            auto [first, last] = previous.equal_range(hash);
+            for (auto candidate = first; candidate != last; ++candidate) {
+                if (candidate->second->text == text && candidate->second->Reusable(*builder_)) {
+                    unit = std::move(candidate->second);
+                    previous.erase(candidate);
+                    break;
+                }
+            }
+
+            if (unit) {
+                unit->Reuse(*builder_);
+            } else {
+                auto begin = buffer.begin() + (text.data() - buffer.data());
+                unit = Check(grammar, begin, begin + static_cast<std::ptrdiff_t>(text.size()), hash);
+                if (!unit)
+                    return CompileWhole(source);
+                ++result.rechecked;
+            }
+            units.push_back(std::move(unit));
+        }
+
+        // Passes transform the tree, units stay as sema made them for the next version
+        ast::Cloner cloner;
+        std::vector<ast::Builder::Node> nodes;
+        bool layers = false;
+        for (auto& unit : units) {
+            for (size_t idx = 0; idx < unit->tree->GetChildsNum(); ++idx) {
+                auto* node = unit->tree->GetChildAt(idx);
+                bool layer = dynamic_cast<statements::Layer const*>(node);
+                // Layers mixed with statements, which the grammar rejects
+                if (!nodes.empty() && layer != layers)
+                    return CompileWhole(source);
+                layers = layer;
+                nodes.push_back(std::make_shared<Ref<SyntaxNode>>(cloner.clone(node)));
+            }
+        }
+
+        std::ostringstream out, err;
+        ast::Builder::Node program;
+        try {
+            program = layers ? builder_->createLayers(std::move(nodes)) : builder_->createCompoundStatement(std::move(nodes));
+        } catch (ast::SemaError&) {
+            return CompileWhole(source);
+        }
+        units_ = std::move(units);
+        result.units = units_.size();
+        result.check_time = Clock::now() - start;
+
+        for (auto& unit : units_)
+            err << unit->errors;
+        result.ok = RunPasses(options_, *builder_, program->get(), out, err);
+        result.output = std::move(out).str();
+        result.errors = std::move(err).str();
+        result.total_time = Clock::now() - start;
+        return result;
+    }
+
+    std::shared_ptr<IncrementalCompiler::Unit> IncrementalCompiler::Check(Grammar const& grammar, StrIter begin,
+                                                                          StrIter end, size_t hash) {
+        auto unit = std::make_shared<Unit>();
+        unit->text.assign(begin, end);
+        unit->hash = hash;
+        for (auto& name : namesIn(unit->text))
+            unit->context.emplace_back(name, globalType(*builder_, name));
+        unit->first_predicate = builder_->predicateCounter();
+
+        std::ostringstream err;
+        auto* errors = std::exchange(ASTBuilder::errorsCtx, &err);
+        Skipper<StrIter> skipper;
+        ast::Builder::Node root;
+        bool res = phrase_parse(begin, end, grammar, skipper, root);
+        ASTBuilder::errorsCtx = errors;
+        if (!res || begin != end || !root || !*root)
+            return nullptr;
+
+        unit->next_predicate = builder_->predicateCounter();
+        unit->tree = std::move(*root);
+        collectGlobals(unit->tree.get(), *builder_, unit->globals);
+        std::set<expressions::Identifier const*> declared;
+        ast::utils::collectDeclared(unit->tree.get(), declared);
+        collectExternals(unit->tree.get(), declared, unit->externals);
+        unit->errors = std::move(err).str();
+        return unit;
+    }
+
+    IncrementalCompiler::Result IncrementalCompiler::CompileWhole(std::string const& source) {
+        auto start = Clock::now();
+        std::string text = source;
+        auto program = Parser(text.begin(), text.end(), options_, &modules_).Compile();
+
+        Result result;
+        result.ok = program.ok;
+        result.output = std::move(program.output);
+        result.errors = std::move(program.errors);
+        result.whole = true;
+        result.check_time = result.total_time = Clock::now() - start;
+        return result;
+    }
+
+    bool Watch(std::string const& path, Options const& options, volatile std::sig_atomic_t const& stop,
+               std::ostream& out, std::ostream& err) {
+        IncrementalCompiler compiler(options);
+        std::string source;
+        struct stat seen{};
+        bool first = true;
+        while (!stop) {
+            struct stat info{};
+            bool changed = ::stat(path.c_str(), &info) == 0 &&
+                           (first || info.st_size != seen.st_size || info.st_mtim.tv_sec != seen.st_mtim.tv_sec ||
+                            info.st_mtim.tv_nsec != seen.st_mtim.tv_nsec);
+            std::string text;
+            if ((changed || first) && !readSource(path, text)) {
+                if (first) {
+                    err << "Error: Could not open input file: " << path << std::endl;
+                    return false;
+                }
+                // Being replaced by an editor, taken on the next change
+                changed = false;
+            }
+
+            if (changed) {
+                seen = info;
+                if (first || text != source) {
+                    first = false;
+                    source = std::move(text);
+                    auto result = compiler.Compile(source);
+                    out << result.output << std::flush;
+                    err << result.errors;
+                    if (result.ok)
+                        out << "Parsing succeeded" << std::endl;
+                    else
+                        err << "Parsing failed" << std::endl;
+
+                    auto ms = [](std::chrono::nanoseconds time) {
+                        return std::chrono::duration<double, std::milli>(time).count();
+                    };
+                    std::ostringstream report;
+                    report << std::fixed << std::setprecision(2) << "Compiled " << path << " in "
+                           << ms(result.total_time) << " ms";
+                    if (result.whole)
+                        report << " as a whole";
+                    else
+                        report << ", checked " << result.rechecked << " of " << result.units << " units in "
+                               << ms(result.check_time) << " ms";
+                    err << report.str() << std::endl;
+                }
+            }
+            std::this_thread::sleep_for(pollInterval);
+        }
+        return true;
+    }
+
+}  // namespace parasl
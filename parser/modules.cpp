@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include "modules.h"
+#include "compile_cache.h"
+
+namespace parasl {
+
+    namespace fs = std::filesystem;
+
+    struct ModuleLoader::Checked {
+        bool ok = false;
+        std::shared_ptr<ModuleInterface const> interface;
+        std::string errors;
+    };
+
+    struct ModuleLoader::Module {
+        fs::path path;
+        std::string source;
+        // Imports by path as written, with the modules they name
+        std::vector<std::pair<std::string, Module*>> imports;
+        std::vector<Module*> importers;
+        // Imports not built yet
+        size_t pending = 0;
+        // On the path from the program while resolving, a module met again then is a cycle
+        bool resolving = false;
+        // Null if one of the imports failed
+        std::shared_ptr<Checked const> checked;
+    };
+
+    namespace {
+
+        bool readSource(fs::path const& path, std::string& source) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return false;
+            source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            return !in.bad();
+        }
+
+        // Same as the skipper: blanks and // comments
+        StrIter skipBlanks(StrIter begin, StrIter end) {
+            for (;;) {
+                while (begin != end && std::isspace(static_cast<unsigned char>(*begin)))
+                    ++begin;
+                if (end - begin < 2 || begin[0] != '/' || begin[1] != '/')
+                    return begin;
+                begin = std::find(begin, end, '\n');
+            }
+        }
+
+        // Names and types of the top-level declarations the module makes itself
+        std::string interfaceOf(ast::Builder const& builder) {
+            std::vector<basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode>> exports;
+            for (auto& [name, symbol] : builder.globalSymbols()) {
+                // Predicates of if-conversion start with '$', which user names can't
+                if (builder.isImported(symbol) || name.starts_with('$'))
+                    continue;
+                auto* decl = dynamic_cast<statements::DeclarationStatement const*>(symbol);
+                exports.push_back(std::make_unique<statements::DeclarationStatement>(
+                        std::make_unique<expressions::Identifier>(name, decl->identifier()->GetType()), nullptr));
+            }
+            statements::CompoundStatement declarations(exports.begin(), exports.end());
+            return ast::AstImageWriter(builder.dataLayout()).write(&declarations);
+        }
+    }
+
+    std::vector<std::string> ScanImports(StrIter begin, StrIter end) {
+        constexpr std::string_view keyword = "import";
+        std::vector<std::string> imports;
+        for (;;) {
+            begin = skipBlanks(begin, end);
+            if (static_cast<size_t>(end - begin) < keyword.size() || !std::equal(keyword.begin(), keyword.end(), begin))
+                break;
+            begin = skipBlanks(begin + keyword.size(), end);
+            if (begin == end || *begin != '"')
+                break;
+            auto path_end = std::find(begin + 1, end, '"');
+            if (path_end == end)
+                break;
+            imports.emplace_back(begin + 1, path_end);
+            begin = skipBlanks(path_end + 1, end);
+            if (begin == end || *begin != ';')
+                break;
+            ++begin;
+        }
+        return imports;
+    }
+
+    ModuleLoader::ModuleLoader(size_t threads, CompileCache* cache) :
+        threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())), cache_(cache) {}
+
+    bool ModuleLoader::Load(std::vector<std::string> const& imports, Options const& options,
+                            ModuleInterfaces& interfaces, std::ostream& err) {
+        interfaces.clear();
+        if (imports.empty())
+            return true;
+
+        Modules modules;
+        std::vector<Module*> stack, order;
+        std::vector<std::pair<std::string, Module*>> roots;
+        auto dir = options.module_dir.empty() ? fs::current_path() : fs::path(options.module_dir);
+        for (auto& import : imports) {
+            auto* module = Resolve(dir, import, modules, stack, order, err);
+            if (!module)
+                return false;
+            roots.emplace_back(import, module);
+        }
+
+        // Modules in order are built when their imports are, by whichever worker is free
+        std::mutex queue_mutex;
+        std::condition_variable queue_changed;
+        std::deque<Module*> ready;
+        for (auto* module : order) {
+            if (!module->pending)
+                ready.push_back(module);
+        }
+        size_t remaining = order.size();
+        auto work = [&] {
+            std::unique_lock lock(queue_mutex);
+            for (;;) {
+                queue_changed.wait(lock, [&] { return !ready.empty() || !remaining; });
+                if (ready.empty())
+                    return;
+                auto* module = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                try {
+                    Build(*module, options);
+                } catch (std::exception& e) {
+                    module->checked = std::make_shared<Checked const>(
+                            Checked{false, nullptr, std::string("Error: ") + e.what() + "\n"});
+                }
+                lock.lock();
+                --remaining;
+                for (auto* importer : module->importers) {
+                    if (!--importer->pending)
+                        ready.push_back(importer);
+                }
+                queue_changed.notify_all();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t idx = 0; idx < std::min(threads_, order.size()); ++idx)
+            workers.emplace_back(work);
+        for (auto& worker : workers)
+            worker.join();
+
+        bool ok = true;
+        for (auto* module : order) {
+            if (module->checked && !module->checked->ok) {
+                err << "Error: Could not compile module " << module->path.string() << std::endl
+                    << module->checked->errors;
+                ok = false;
+            }
+        }
+        if (!ok)
+            return false;
+        for (auto& [import, module] : roots)
+            interfaces.emplace(import, module->checked->interface);
+        return true;
+    }
+
+    ModuleLoader::Module* ModuleLoader::Resolve(fs::path const& dir, std::string const& import, Modules& modules,
+                                                std::vector<Module*>& stack, std::vector<Module*>& order,
+                                                std::ostream& err) {
+        std::error_code error;
+        auto path = fs::weakly_canonical(dir / import, error);
+        if (error)
+            path = dir / import;
+
+        if (auto found = modules.find(path); found != modules.end()) {
+            auto* module = found->second.get();
+            if (module->resolving) {
+                err << "Error: Import cycle: ";
+                for (auto it = std::find(stack.begin(), stack.end(), module); it != stack.end(); ++it)
+                    err << (*it)->path.string() << " -> ";
+                err << path.string() << std::endl;
+                return nullptr;
+            }
+            return module;
+        }
+
+        std::string source;
+        if (!readSource(path, source)) {
+            err << "Error: Could not open module: " << path.string();
+            if (!stack.empty())
+                err << " imported by " << stack.back()->path.string();
+            err << std::endl;
+            return nullptr;
+        }
+
+        auto& module = *modules.emplace(path, std::make_unique<Module>()).first->second;
+        module.path = path;
+        module.source = std::move(source);
+        module.resolving = true;
+        stack.push_back(&module);
+        for (auto& nested : ScanImports(module.source.begin(), module.source.end())) {
+            auto* imported = Resolve(path.parent_path(), nested, modules, stack, order, err);
+            if (!imported)
+                return nullptr;
+            module.imports.emplace_back(nested, imported);
+            imported->importers.push_back(&module);
+            ++module.pending;
+        }
+        stack.pop_back();
+        module.resolving = false;
+        order.push_back(&module);
+        return &module;
+    }
+
+    void ModuleLoader::Build(Module& module, Options const& options) {
+        ModuleInterfaces imports;
+        for (auto& [import, imported] : module.imports) {
+            // Reported with the import, this module is not compiled
+            if (!imported->checked || !imported->checked->ok)
+                return;
+            imports.emplace(import, imported->checked->interface);
+        }
+
+        auto key = CompileCache::InterfaceKey(options, module.source, imports);
+        std::shared_ptr<Checked const> checked;
+        {
+            std::lock_guard lock(mutex_);
+            if (auto found = checked_.find(module.path); found != checked_.end() && found->second.first == key) {
+                module.checked = found->second.second;
+                return;
+            }
+            if (auto entry = cache_ ? cache_->Lookup(key) : std::nullopt) {
+                auto interface = entry->ok ? std::make_shared<ModuleInterface const>(
+                        ModuleInterface{module.path.string(), std::move(entry->output)}) : nullptr;
+                checked = std::make_shared<Checked const>(Checked{entry->ok, interface, std::move(entry->errors)});
+            }
+        }
+
+        if (!checked) {
+            ast::Builder builder;
+            builder.dataLayout().setFieldReordering(options.reorder_fields);
+            builder.dataLayout().setBitPacking(options.pack_ints);
+            builder.setIfConversionLimit(options.if_conversion_limit);
+            std::ostringstream errors;
+            ASTBuilder::builderCtx = &builder;
+            ASTBuilder::errorsCtx = &errors;
+            ASTBuilder::importsCtx = &imports;
+
+            auto begin = module.source.begin();
+            auto end = module.source.end();
+            Skipper<StrIter> skipper;
+            error_handler<StrIter> error_handler(begin, end, errors);
+            layers_grammar<StrIter, Skipper<StrIter>> grammar(error_handler);
+            node_t root;
+            bool ok = phrase_parse(begin, end, grammar, skipper, root) && begin == end && root;
+            ASTBuilder::importsCtx = nullptr;
+
+            // Only the interface is kept, the tree goes with the builder
+            std::string image;
+            if (ok) {
+                try {
+                    image = interfaceOf(builder);
+                } catch (std::length_error& e) {
+                    errors << "Error: " << e.what() << std::endl;
+                    ok = false;
+                }
+            }
+            auto interface = ok ? std::make_shared<ModuleInterface const>(ModuleInterface{module.path.string(), image})
+                                : nullptr;
+            checked = std::make_shared<Checked const>(Checked{ok, interface, std::move(errors).str()});
+
+            std::lock_guard lock(mutex_);
+            ++compiled_;
+            if (cache_)
+                cache_->Store(key, {ok, std::move(image), checked->errors});
+        }
+
+        std::lock_guard lock(mutex_);
+        checked_[module.path] = {std::move(key), checked};
+        module.checked = std::move(checked);
+    }
+
+    uint64_t ModuleLoader::Compiled() const {
+        std::lock_guard lock(mutex_);
+        return compiled_;
+    }
+
+}  // namespace parasl
@@ -1,35 +1,219 @@
+#include <fstream>
 #include <iomanip>
+#include <sstream>
 
 #include "parser.h"
 #include "ast_printer.h"
+#include "modules.h"
 
 namespace parasl {
 
     namespace ASTBuilder{
-        ast::Builder* builderCtx = nullptr;
+        thread_local ast::Builder* builderCtx = nullptr;
+        thread_local std::ostream* errorsCtx = &std::cerr;
+        thread_local ModuleInterfaces const* importsCtx = nullptr;
+        thread_local CompileReport* reportCtx = nullptr;
     }
-bool Parser::Run() {
+bool Parser::Run(std::ostream& out, std::ostream& err) {
     ast::Builder builder;
-    ASTBuilder::builderCtx = &builder;
-    Skipper<StrIter> skipper;
-    error_handler<StrIter> error_handler(parse_begin_, parse_end_);
-    layers_grammar<StrIter, Skipper<StrIter>> grammar(error_handler);
     std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>> root;
-    bool res = phrase_parse(parse_begin_, parse_end_, grammar, skipper, root);
-    bool is_full_parsed = (parse_begin_ == parse_end_);
+    return Run(builder, root, out, err);
+}
+
+CompiledProgram Parser::Compile() {
+    CompiledProgram program;
+    program.builder = std::make_unique<ast::Builder>();
+    std::ostringstream out, err;
+    program.ok = Run(*program.builder, program.root, out, err);
+    program.output = std::move(out).str();
+    program.errors = std::move(err).str();
+    return program;
+}
+
+bool Parser::Run(ast::Builder& builder, std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>& root,
+                 std::ostream& out, std::ostream& err) {
+    ASTBuilder::builderCtx = &builder;
+    ASTBuilder::errorsCtx = &err;
+    ASTBuilder::reportCtx = report_;
+    bool res, is_full_parsed;
+    if (!options_.load_ast_bin.empty()) {
+        // Image holds a checked tree, it replaces parsing and sema
+        CompileReport::Phase phase(report_, "load image");
+        if (!Load(builder, root, err))
+            return false;
+        res = is_full_parsed = true;
+    } else {
+        // Imported modules are compiled first, the program sees their interfaces only
+        ModuleInterfaces imports;
+        CompileReport::Phase modules_phase(report_, "modules");
+        if (auto paths = ScanImports(parse_begin_, parse_end_); !paths.empty()) {
+            ModuleLoader own_modules;
+            if (!(modules_ ? *modules_ : own_modules).Load(paths, options_, imports, err))
+                return false;
+        }
+        modules_phase.End();
+        ASTBuilder::importsCtx = &imports;
+
+        CompileReport::Phase grammar_phase(report_, "grammar");
+        builder.dataLayout().setFieldReordering(options_.reorder_fields);
+        builder.dataLayout().setBitPacking(options_.pack_ints);
+        builder.setIfConversionLimit(options_.if_conversion_limit);
+        Skipper<StrIter> skipper;
+        error_handler<StrIter> error_handler(parse_begin_, parse_end_, out);
+        layers_grammar<StrIter, Skipper<StrIter>> grammar(error_handler);
+        grammar_phase.End();
+
+        // Actions of the grammar are timed as sema inside of it
+        CompileReport::Phase parse_phase(report_, "parse");
+        res = phrase_parse(parse_begin_, parse_end_, grammar, skipper, root);
+        is_full_parsed = (parse_begin_ == parse_end_);
+        parse_phase.End();
+        ASTBuilder::importsCtx = nullptr;
+    }
     if (!is_full_parsed) {
 #if 0
-        std::cout << "Unparseable: "
-                  << std::quoted(std::string(parse_begin_, parse_end_)) << std::endl;
+        out << "Unparseable: "
+            << std::quoted(std::string(parse_begin_, parse_end_)) << std::endl;
 #endif
     } else{
-        auto printer = ast::Printer();
+        if (report_ && res && root)
+            report_->Record(builder, root->get());
+
+        // Checked tree as it came from sema, before any transformation
+        if (res && root && !options_.emit_ast_bin.empty()) {
+            CompileReport::Phase phase(report_, "emit image");
+            if (!Emit(builder, root->get(), err))
+                return false;
+        }
 
-        printer.visit(root->get());
+        if (!RunPasses(options_, builder, root->get(), out, err, report_))
+            return false;
     }
 
 
     return res && is_full_parsed;
 }
 
+bool RunPasses(Options const& options, ast::Builder& builder, basic_syntax_nodes::SyntaxNode* root,
+               std::ostream& out, std::ostream& err, CompileReport* report) {
+    ast::LoopNestOptimizer loop_nests(builder.dataLayout());
+    if(options.loop_nest_opt){
+        CompileReport::Phase phase(report, "loop nests");
+        loop_nests.run(root);
+    }
+
+    ast::LoopUnroller unroller(options.unroll_budget);
+    {
+        CompileReport::Phase phase(report, "unroll");
+        unroller.run(root);
+    }
+
+    {
+        CompileReport::Phase phase(report, "print");
+        auto printer = ast::Printer(out);
+
+        printer.visit(root);
+    }
+
+    if(options.bounds_checks != ast::bounds_check_mode_t::OFF){
+        CompileReport::Phase phase(report, "bounds checks");
+        ast::BoundsCheckAnalysis bounds_checks(options.bounds_checks);
+        bounds_checks.visit(root);
+        if(options.opt_report)
+            bounds_checks.dump(out);
+    }
+
+    // Layer graph is needed to report it and to place layers into processes
+    ast::LayerPipeline pipeline(builder.dataLayout());
+    ast::DataflowSchedule schedule(options.pipeline_threads);
+    if(options.opt_report || options.processes){
+        CompileReport::Phase phase(report, "schedule");
+        pipeline.run(root);
+        schedule.run(pipeline);
+    }
+
+    if(options.opt_report){
+        ast::OwnershipAnalysis ownership;
+        {
+            CompileReport::Phase phase(report, "ownership");
+            ownership.run(root);
+            ownership.dump(out);
+        }
+
+        ast::SoaLayoutAnalysis soa_layout(builder.dataLayout());
+        {
+            CompileReport::Phase phase(report, "soa layout");
+            soa_layout.run(root);
+            soa_layout.dump(out);
+        }
+
+        {
+            CompileReport::Phase phase(report, "address lowering");
+            ast::AddressLowering address_lowering(builder.dataLayout(), &soa_layout);
+            address_lowering.visit(root);
+            address_lowering.dump(out);
+        }
+
+        CompileReport::Phase phase(report, "opt report");
+        if(options.loop_nest_opt)
+            loop_nests.dump(out);
+        unroller.dump(out);
+
+        pipeline.dump(out);
+        schedule.dump(out);
+    }
+
+    if(options.processes){
+        CompileReport::Phase phase(report, "placement");
+        ast::ProcessPlacement placement(options.transport);
+        try{
+            if(!options.placement.empty())
+                placement.load(options.placement);
+            placement.run(pipeline, schedule);
+        } catch (std::invalid_argument& e){
+            err << "Error: " << e.what() << std::endl;
+            return false;
+        }
+        if(options.opt_report)
+            placement.dump(out);
+    }
+    return true;
+}
+
+bool Parser::Load(ast::Builder& builder, std::shared_ptr<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>& root,
+                  std::ostream& err) {
+    try {
+        auto image = ast::AstImage::map(options_.load_ast_bin);
+        // Member offsets in the tree were computed with the layout of the image
+        builder.dataLayout().setFieldReordering(image.fieldReordering());
+        builder.dataLayout().setBitPacking(image.bitPacking());
+        root = std::make_shared<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>(image.materialize(builder));
+    } catch (std::exception& e) {
+        err << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Parser::Emit(ast::Builder const& builder, basic_syntax_nodes::SyntaxNode const* root, std::ostream& err) {
+    // Declarations of imported modules are not in the tree, its references to them couldn't be loaded
+    if (builder.hasImports()) {
+        err << "Error: AST images of programs with imports are not supported" << std::endl;
+        return false;
+    }
+    std::string image;
+    try {
+        image = ast::AstImageWriter(builder.dataLayout()).write(root);
+    } catch (std::length_error& e) {
+        err << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    std::ofstream file(options_.emit_ast_bin, std::ios::binary | std::ios::trunc);
+    if (!file.write(image.data(), static_cast<std::streamsize>(image.size()))) {
+        err << "Error: Could not write AST image: " << options_.emit_ast_bin << std::endl;
+        return false;
+    }
+    return true;
+}
+
 }  // namespace parasl
\ No newline at end of file
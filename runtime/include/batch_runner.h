@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "ordered_output.h"
+
+namespace parasl::runtime{
+
+    /*
+     * Runs one compiled program over many independent input records. Each worker thread owns
+     * a replica of the program (its global state, made by the factory), so replicas share
+     * nothing but the record queue and the output. The calling thread reads records and deals
+     * them to replicas by chunks through a lock-free MPMC queue, so a record costs a fraction
+     * of a queue operation. Output of every record is one OrderedOutput record tagged with
+     * the record's number: in ORDERED mode output appears in input order, as if records were
+     * run one by one. An exception in a replica stops the batch and is rethrown by run().
+     */
+    template<typename Record, typename Replica>
+    class BatchRunner{
+    public:
+        // Next record, false at the end of input; called by the feeding thread only
+        using Source = std::function<bool(Record&)>;
+        using Factory = std::function<Replica(size_t)>;
+        using Step = std::function<void(Replica&, Record&, OrderedOutput::Writer&)>;
+
+        explicit BatchRunner(OutputChannel& output, output_order_t order = output_order_t::ORDERED,
+                             size_t replicas = std::max(1u, std::thread::hardware_concurrency()),
+                             size_t chunk = 64, size_t queue_capacity = 256):
+                m_output(output), m_order(order), m_replicas(std::max<size_t>(replicas, 1)),
+                m_chunk(std::max<size_t>(chunk, 1)), m_queue_capacity(queue_capacity){}
+
+        BatchRunner(BatchRunner const&) = delete;
+        BatchRunner& operator=(BatchRunner const&) = delete;
+
+        // Returns the number of records run
+        uint64_t run(Source const& source, Factory const& factory, Step const& step){
+            MpmcQueue<std::unique_ptr<Chunk>> queue(m_queue_capacity);
+            OrderedOutput output(m_output, m_order, m_replicas);
+            m_cancelled.store(false, std::memory_order_relaxed);
+            m_error = nullptr;
+            m_ordered = &output;
+            m_queue = &queue;
+
+            std::vector<std::thread> workers;
+            for(size_t idx = 0; idx < m_replicas; ++idx)
+                workers.emplace_back([&, idx]{ work(idx, queue, output, factory, step); });
+
+            uint64_t records = 0;
+            try{
+                records = feed(source, queue);
+            } catch (...) {
+                fail(std::current_exception());
+            }
+            queue.close();
+            for(auto& worker: workers)
+                worker.join();
+            m_ordered = nullptr;
+            m_queue = nullptr;
+
+            if(m_error)
+                std::rethrow_exception(m_error);
+            output.finish();
+            return records;
+        }
+
+    private:
+        struct Chunk{
+            uint64_t first = 0;
+            std::vector<Record> records;
+        };
+
+        uint64_t feed(Source const& source, MpmcQueue<std::unique_ptr<Chunk>>& queue){
+            uint64_t seq = 0;
+            for(auto more = true; more && !m_cancelled.load(std::memory_order_acquire);){
+                auto chunk = std::make_unique<Chunk>();
+                chunk->first = seq;
+                chunk->records.resize(m_chunk);
+                size_t count = 0;
+                while(count < m_chunk && (more = source(chunk->records[count])))
+                    ++count;
+                if(!count)
+                    break;
+                chunk->records.resize(count);
+                seq += count;
+
+                // Sleeps while replicas are behind
+                if(!queue.push(std::move(chunk), [this]{ return m_cancelled.load(std::memory_order_acquire); }))
+                    return seq;
+            }
+            return seq;
+        }
+
+        void work(size_t idx, MpmcQueue<std::unique_ptr<Chunk>>& queue, OrderedOutput& output,
+                  Factory const& factory, Step const& step){
+            try{
+                auto writer = output.writer();
+                auto replica = factory(idx);
+                std::unique_ptr<Chunk> chunk;
+                while(queue.pop(chunk)){
+                    for(size_t rec = 0; rec < chunk->records.size(); ++rec){
+                        if(m_cancelled.load(std::memory_order_relaxed))
+                            return;
+                        writer.begin(chunk->first + rec);
+                        step(replica, chunk->records[rec], writer);
+                        writer.commit();
+                    }
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        }
+
+        void fail(std::exception_ptr error){
+            std::lock_guard lock(m_mutex);
+            if(!m_error)
+                m_error = error;
+            m_cancelled.store(true, std::memory_order_release);
+            // Feeding thread may sleep on the full queue
+            m_queue->wake();
+            // Records following the failed one would wait for it forever
+            m_ordered->abort();
+        }
+
+        OutputChannel& m_output;
+        output_order_t m_order;
+        size_t m_replicas;
+        size_t m_chunk;
+        size_t m_queue_capacity;
+        std::atomic<bool> m_cancelled = false;
+        std::mutex m_mutex;
+        std::exception_ptr m_error;
+        OrderedOutput* m_ordered = nullptr;
+        MpmcQueue<std::unique_ptr<Chunk>>* m_queue = nullptr;
+    };
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace parasl::runtime{
+
+    // Waiting for another thread: spins shortly, then gives the core away
+    class Backoff{
+    public:
+        void wait(){
+            if(m_spins < spinLimit){
+                for(auto idx = 0u; idx < 1u << m_spins; ++idx)
+                    pause();
+                ++m_spins;
+            } else
+                std::this_thread::yield();
+        }
+
+        void reset(){
+            m_spins = 0;
+        }
+
+        // Still spinning, yields the core from now on otherwise
+        [[nodiscard]] bool spinning() const{
+            return m_spins < spinLimit;
+        }
+
+    private:
+        static void pause(){
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        static constexpr unsigned spinLimit = 6;
+        unsigned m_spins = 0;
+    };
+
+    // Sleeps on a 32-bit counter of one process: C++20 atomic wait, a private futex on Linux
+    struct ThreadFutex{
+        static void wait(std::atomic<uint32_t>& word, uint32_t seen){
+            word.wait(seen, std::memory_order_acquire);
+        }
+
+        static void wake(std::atomic<uint32_t>& word){
+            word.notify_all();
+        }
+    };
+
+    /*
+     * Place where threads sleep until another one changes some shared state, e.g. pushes to
+     * a queue. A waiting thread spins shortly, then registers and fences before checking its
+     * condition again; the other thread fences after the change and only bumps the counter
+     * and wakes when somebody is registered. So either the waiting thread sees the change or
+     * it is woken up, and the uncontended path costs a fence. Waking takes the registrations
+     * away, so a sleep costs one system call of the other side however many changes it makes.
+     * Conditions which don't depend on the counters of the queue (closed, cancelled) are
+     * published followed by notify() too.
+     */
+    template<typename Futex = ThreadFutex>
+    class WaitPoint{
+    public:
+        // Returns when done() holds, done() may do the operation waited for
+        template<typename Done>
+        void waitFor(Done done){
+            for(Backoff backoff; backoff.spinning(); backoff.wait())
+                if(done())
+                    return;
+
+            for(;;){
+                // Counter is read first: once a wakeup takes the registration away, it differs
+                auto seen = m_event.load(std::memory_order_acquire);
+                m_waiting.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // Registration left behind costs the next notify() a spare wakeup
+                if(done())
+                    return;
+                Futex::wait(m_event, seen);
+            }
+        }
+
+        // State changed: costs a fence, a system call only when threads wait
+        void notify(){
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_waiting.load(std::memory_order_relaxed) && m_waiting.exchange(0, std::memory_order_relaxed)){
+                m_event.fetch_add(1, std::memory_order_release);
+                Futex::wake(m_event);
+            }
+        }
+
+    private:
+        std::atomic<uint32_t> m_waiting = 0;
+        std::atomic<uint32_t> m_event = 0;
+    };
+
+    /*
+     * Bounded lock-free queue between one producer and one consumer thread.
+     * Head and tail are monotonic counters on separate cache lines, every side keeps
+     * a copy of the other side's counter and only reloads it when the queue looks full
+     * (empty), so a push or pop touches a shared line once per many values.
+     * push() waits while the queue is full, which holds a fast producer back to the
+     * speed of its consumer. close() marks the end of values, pop() drains the rest.
+     * Waiting sides spin shortly, then sleep until the other side moves its counter.
+     */
+    template<typename T>
+    class SpscQueue{
+        static_assert(std::is_default_constructible_v<T> && std::is_move_assignable_v<T>);
+    public:
+        // Slots are allocated from memory, e.g. on the consumer's NUMA node
+        explicit SpscQueue(size_t capacity = 1024, std::pmr::memory_resource* memory = std::pmr::get_default_resource()):
+                m_slots(std::bit_ceil(std::max<size_t>(capacity, 2)), memory), m_mask(m_slots.size() - 1){}
+
+        SpscQueue(SpscQueue const&) = delete;
+        SpscQueue& operator=(SpscQueue const&) = delete;
+
+        [[nodiscard]] size_t capacity() const{
+            return m_slots.size();
+        }
+
+        // Producer only
+        template<typename U>
+        bool tryPush(U&& value){
+            auto head = m_head.load(std::memory_order_relaxed);
+            if(head - m_cached_tail == m_slots.size()){
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if(head - m_cached_tail == m_slots.size())
+                    return false;
+            }
+            m_slots[head & m_mask] = std::forward<U>(value);
+            m_head.store(head + 1, std::memory_order_release);
+            m_readable.notify();
+            return true;
+        }
+
+        template<typename U>
+        void push(U&& value){
+            push(std::forward<U>(value), []{ return false; });
+        }
+
+        // Waits while the queue is full until stop() holds, false if the value wasn't pushed then
+        template<typename U, typename Stop>
+        bool push(U&& value, Stop stop){
+            auto pushed = false;
+            m_writable.waitFor([&]{ return (pushed = tryPush(std::forward<U>(value))) || stop(); });
+            return pushed;
+        }
+
+        // Consumer only
+        bool tryPop(T& value){
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if(tail == m_cached_head){
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if(tail == m_cached_head)
+                    return false;
+            }
+            value = std::move(m_slots[tail & m_mask]);
+            m_tail.store(tail + 1, std::memory_order_release);
+            m_writable.notify();
+            return true;
+        }
+
+        // Waits for the next value, false once the queue is closed and empty
+        bool pop(T& value){
+            return pop(value, []{ return false; });
+        }
+
+        // Same, but also gives up when stop() holds
+        template<typename Stop>
+        bool pop(T& value, Stop stop){
+            auto popped = false;
+            m_readable.waitFor([&]{ return (popped = tryPop(value)) || closed() || stop(); });
+            return popped || tryPop(value);
+        }
+
+        // Producer: no more values
+        void close(){
+            m_closed.store(true, std::memory_order_release);
+            m_readable.notify();
+        }
+
+        // Stop condition of a waiting side changed
+        void wake(){
+            m_readable.notify();
+            m_writable.notify();
+        }
+
+        [[nodiscard]] bool closed() const{
+            return m_closed.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::pmr::vector<T> m_slots;
+        size_t m_mask;
+        std::atomic<bool> m_closed = false;
+        // Producer line: own counter and consumer's counter as last seen
+        alignas(64) std::atomic<size_t> m_head = 0;
+        size_t m_cached_tail = 0;
+        // Consumer line
+        alignas(64) std::atomic<size_t> m_tail = 0;
+        size_t m_cached_head = 0;
+        // Consumer sleeps on readable, producer on writable
+        alignas(64) WaitPoint<> m_readable;
+        WaitPoint<> m_writable;
+    };
+
+    /*
+     * Bounded lock-free queue for any number of producers and consumers (D. Vyukov's
+     * array queue). Every slot carries a sequence number which tells whether it waits
+     * for a value of the current lap or for its consumer, so a push or pop is one CAS
+     * on the shared position and never waits for a thread preempted in the middle of
+     * another operation unless the queue is full (empty) up to that slot. Threads which
+     * have to wait spin shortly, then sleep until a value is pushed (popped).
+     * close() is called once after all producers are done.
+     */
+    template<typename T>
+    class MpmcQueue{
+        static_assert(std::is_default_constructible_v<T> && std::is_move_assignable_v<T>);
+    public:
+        explicit MpmcQueue(size_t capacity = 1024, std::pmr::memory_resource* memory = std::pmr::get_default_resource()):
+                m_size(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask(m_size - 1), m_slots(m_size, memory){
+            for(size_t idx = 0; idx < m_size; ++idx)
+                m_slots[idx].seq.store(idx, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(MpmcQueue const&) = delete;
+        MpmcQueue& operator=(MpmcQueue const&) = delete;
+
+        [[nodiscard]] size_t capacity() const{
+            return m_size;
+        }
+
+        template<typename U>
+        bool tryPush(U&& value){
+            auto pos = m_head.load(std::memory_order_relaxed);
+            while(true){
+                auto& slot = m_slots[pos & m_mask];
+                auto diff = static_cast<intptr_t>(slot.seq.load(std::memory_order_acquire) - pos);
+                if(diff == 0){
+                    if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        slot.value = std::forward<U>(value);
+                        slot.seq.store(pos + 1, std::memory_order_release);
+                        m_readable.notify();
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+
+        template<typename U>
+        void push(U&& value){
+            push(std::forward<U>(value), []{ return false; });
+        }
+
+        // Waits while the queue is full until stop() holds, false if the value wasn't pushed then
+        template<typename U, typename Stop>
+        bool push(U&& value, Stop stop){
+            auto pushed = false;
+            m_writable.waitFor([&]{ return (pushed = tryPush(std::forward<U>(value))) || stop(); });
+            return pushed;
+        }
+
+        bool tryPop(T& value){
+            auto pos = m_tail.load(std::memory_order_relaxed);
+            while(true){
+                auto& slot = m_slots[pos & m_mask];
+                auto diff = static_cast<intptr_t>(slot.seq.load(std::memory_order_acquire) - (pos + 1));
+                if(diff == 0){
+                    if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                        value = std::move(slot.value);
+                        // Slot is free for the push of the next lap
+                        slot.seq.store(pos + m_size, std::memory_order_release);
+                        m_writable.notify();
+                        return true;
+                    }
+                } else if(diff < 0)
+                    return false;
+                else
+                    pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Waits for the next value, false once the queue is closed and empty
+        bool pop(T& value){
+            return pop(value, []{ return false; });
+        }
+
+        // Same, but also gives up when stop() holds
+        template<typename Stop>
+        bool pop(T& value, Stop stop){
+            auto popped = false;
+            m_readable.waitFor([&]{ return (popped = tryPop(value)) || closed() || stop(); });
+            return popped || tryPop(value);
+        }
+
+        void close(){
+            m_closed.store(true, std::memory_order_release);
+            m_readable.notify();
+        }
+
+        // Stop condition of a waiting thread changed
+        void wake(){
+            m_readable.notify();
+            m_writable.notify();
+        }
+
+        [[nodiscard]] bool closed() const{
+            return m_closed.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct alignas(64) Slot{
+            std::atomic<size_t> seq;
+            T value;
+        };
+
+        size_t m_size;
+        size_t m_mask;
+        std::pmr::vector<Slot> m_slots;
+        std::atomic<bool> m_closed = false;
+        alignas(64) std::atomic<size_t> m_head = 0;
+        alignas(64) std::atomic<size_t> m_tail = 0;
+        alignas(64) WaitPoint<> m_readable;
+        WaitPoint<> m_writable;
+    };
+}
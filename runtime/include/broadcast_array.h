@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <numeric>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace parasl::runtime{
+
+    /*
+     * Lazy result of repeat(value, N): one element plus a length until the array is written.
+     * Storage is allocated zeroed on the first write (large blocks come straight from fresh
+     * pages, so untouched parts of it cost no physical memory) and is filled with the
+     * broadcast value one chunk at a time, only for chunks which are actually written.
+     */
+    template<typename T, size_t ChunkSize = 4096>
+    class BroadcastArray{
+        static_assert(std::is_trivially_copyable_v<T>, "runtime values are expected to be trivially copyable");
+        static_assert(std::has_single_bit(ChunkSize), "chunk size is expected to be a power of two");
+    public:
+        BroadcastArray(T const& value, size_t size): m_value(value), m_size(size){}
+
+        BroadcastArray(BroadcastArray&&) noexcept = default;
+        BroadcastArray& operator=(BroadcastArray&&) noexcept = default;
+
+        [[nodiscard]] size_t size() const{
+            return m_size;
+        }
+
+        // No element has been written yet
+        [[nodiscard]] bool isBroadcast() const{
+            return !m_data;
+        }
+
+        [[nodiscard]] T const& broadcastValue() const{
+            return m_value;
+        }
+
+        T const& operator[](size_t idx) const{
+            return isMaterialized(idx / ChunkSize) ? m_data[idx] : m_value;
+        }
+
+        T& mutableAt(size_t idx){
+            materialize(idx / ChunkSize);
+            return m_data[idx];
+        }
+
+        // Contiguous write access to the whole array
+        T* mutableData(){
+            for(size_t chunk = 0; chunk < chunks(); ++chunk)
+                materialize(chunk);
+            return m_data.get();
+        }
+
+        [[nodiscard]] size_t materializedChunks() const{
+            return std::accumulate(m_materialized.begin(), m_materialized.end(), size_t{0}, [](size_t acc, uint64_t word){
+                return acc + std::popcount(word);
+            });
+        }
+
+        // Bytes which have been actually written, last chunk may be shorter than the others
+        [[nodiscard]] size_t touchedBytes() const{
+            auto elements = materializedChunks() * ChunkSize;
+            if(chunks() && isMaterialized(chunks() - 1))
+                elements -= chunks() * ChunkSize - m_size;
+            return elements * sizeof(T);
+        }
+
+    private:
+        struct Deleter{
+            void operator()(T* ptr) const{
+                std::free(ptr);
+            }
+        };
+
+        [[nodiscard]] size_t chunks() const{
+            return (m_size + ChunkSize - 1) / ChunkSize;
+        }
+
+        [[nodiscard]] bool isMaterialized(size_t chunk) const{
+            return m_data && (m_materialized[chunk / 64] >> (chunk % 64) & 1);
+        }
+
+        void materialize(size_t chunk){
+            if(!m_data){
+                m_data.reset(static_cast<T*>(std::calloc(m_size, sizeof(T))));
+                if(!m_data && m_size)
+                    throw std::bad_alloc();
+                m_materialized.assign((chunks() + 63) / 64, 0);
+            }
+
+            if(isMaterialized(chunk))
+                return;
+
+            auto begin = chunk * ChunkSize;
+            std::fill(m_data.get() + begin, m_data.get() + std::min(begin + ChunkSize, m_size), m_value);
+            m_materialized[chunk / 64] |= uint64_t{1} << (chunk % 64);
+        }
+
+        T m_value;
+        size_t m_size;
+        std::unique_ptr<T[], Deleter> m_data;
+        std::vector<uint64_t> m_materialized;
+    };
+}
@@ -0,0 +1,567 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bounded_queue.h"
+
+namespace parasl::runtime{
+
+    class CoroutinePipeline;
+    class CoroutineLayer;
+
+    // Coroutine of a layer body, started and resumed by CoroutinePipeline only
+    class LayerTask{
+    public:
+        struct promise_type{
+            LayerTask get_return_object(){
+                return LayerTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept{
+                return {};
+            }
+
+            // Layer learns it's done while the frame is suspended, so no other thread can touch it
+            struct Finished{
+                bool await_ready() noexcept{
+                    return false;
+                }
+
+                void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+
+                void await_resume() noexcept{}
+            };
+
+            Finished final_suspend() noexcept{
+                return {};
+            }
+
+            void return_void(){}
+
+            void unhandled_exception(){
+                error = std::current_exception();
+            }
+
+            CoroutineLayer* layer = nullptr;
+            std::exception_ptr error;
+            bool done = false;
+        };
+
+        using Handle = std::coroutine_handle<promise_type>;
+
+        LayerTask() = default;
+
+        LayerTask(LayerTask&& other) noexcept: m_handle(std::exchange(other.m_handle, nullptr)){}
+
+        LayerTask& operator=(LayerTask&& other) noexcept{
+            std::swap(m_handle, other.m_handle);
+            return *this;
+        }
+
+        ~LayerTask(){
+            if(m_handle)
+                m_handle.destroy();
+        }
+
+        [[nodiscard]] Handle handle() const{
+            return m_handle;
+        }
+
+    private:
+        explicit LayerTask(Handle handle): m_handle(handle){}
+
+        Handle m_handle;
+    };
+
+    // Lock for a few instructions: spins, then yields the core to a preempted holder
+    class SpinLock{
+    public:
+        void lock(){
+            for(Backoff backoff; m_flag.test_and_set(std::memory_order_acquire);)
+                backoff.wait();
+        }
+
+        void unlock(){
+            m_flag.clear(std::memory_order_release);
+        }
+
+    private:
+        std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+    };
+
+    // Channel from one layer to another, see CoroutinePipeline::connect
+    class CoroutineLink{
+    public:
+        virtual ~CoroutineLink() = default;
+
+        [[nodiscard]] CoroutineLayer const& from() const{
+            return m_from;
+        }
+
+        [[nodiscard]] CoroutineLayer const& to() const{
+            return m_to;
+        }
+
+        [[nodiscard]] virtual size_t capacity() const = 0;
+
+    protected:
+        friend class CoroutinePipeline;
+
+        CoroutineLink(CoroutinePipeline& pipeline, CoroutineLayer& from, CoroutineLayer& to):
+                m_pipeline(pipeline), m_from(from), m_to(to){}
+
+        // Producer layer is done: waiting consumers get no value
+        virtual void close() = 0;
+
+        // Consumer layer is done: waiting and following values are dropped
+        virtual void abandon() = 0;
+
+        CoroutinePipeline& m_pipeline;
+        CoroutineLayer& m_from;
+        CoroutineLayer& m_to;
+    };
+
+    /*
+     * Bounded channel of values of type T between layer coroutines. push() on a full channel
+     * and pop() on an empty one suspend the coroutine instead of blocking its thread: it is
+     * put on the channel's waiting list and rescheduled by the coroutine on the other end,
+     * which hands the value over directly. Any number of coroutines can use either end.
+     * Every operation is a few instructions under the channel's own lock.
+     */
+    template<typename T>
+    class CoroutineChannel final: public CoroutineLink{
+        struct Waiter{
+            LayerTask::Handle handle;
+            Waiter* next = nullptr;
+        };
+
+    public:
+        CoroutineChannel(CoroutinePipeline& pipeline, CoroutineLayer& from, CoroutineLayer& to, size_t capacity):
+                CoroutineLink(pipeline, from, to), m_slots(std::bit_ceil(std::max<size_t>(capacity, 1))),
+                m_mask(m_slots.size() - 1){}
+
+        [[nodiscard]] size_t capacity() const override{
+            return m_slots.size();
+        }
+
+        class PushAwaiter: Waiter{
+        public:
+            // Channel stays locked when the value doesn't fit, until the coroutine is suspended
+            bool await_ready(){
+                return m_channel.tryPush(*this);
+            }
+
+            void await_suspend(LayerTask::Handle coroutine){
+                m_channel.wait(m_channel.m_first_push, m_channel.m_last_push, *this, coroutine);
+            }
+
+            void await_resume() noexcept{}
+
+        private:
+            friend class CoroutineChannel;
+
+            PushAwaiter(CoroutineChannel& channel, T&& value): m_channel(channel), m_value(std::move(value)){}
+
+            CoroutineChannel& m_channel;
+            T m_value;
+        };
+
+        class PopAwaiter: Waiter{
+        public:
+            bool await_ready(){
+                return m_channel.tryPop(*this);
+            }
+
+            void await_suspend(LayerTask::Handle coroutine){
+                m_channel.wait(m_channel.m_first_pop, m_channel.m_last_pop, *this, coroutine);
+            }
+
+            // False once the producer layer is done and the channel is drained
+            bool await_resume() noexcept{
+                return m_received;
+            }
+
+        private:
+            friend class CoroutineChannel;
+
+            PopAwaiter(CoroutineChannel& channel, T& value): m_channel(channel), m_value(value){}
+
+            CoroutineChannel& m_channel;
+            T& m_value;
+            bool m_received = false;
+        };
+
+        // co_await channel.push(value)
+        PushAwaiter push(T value){
+            return PushAwaiter(*this, std::move(value));
+        }
+
+        // while(co_await channel.pop(value))
+        PopAwaiter pop(T& value){
+            return PopAwaiter(*this, value);
+        }
+
+    private:
+        // Done (the lock is released) or false with the channel locked
+        bool tryPush(PushAwaiter& awaiter);
+
+        bool tryPop(PopAwaiter& awaiter);
+
+        // Channel is locked by failed tryPush (tryPop)
+        template<typename W>
+        void wait(W*& first, W*& last, W& awaiter, LayerTask::Handle coroutine);
+
+        void close() override;
+
+        void abandon() override;
+
+        template<typename W>
+        static void append(W*& first, W*& last, W* waiter){
+            waiter->next = nullptr;
+            if(last)
+                last->next = waiter;
+            else
+                first = waiter;
+            last = waiter;
+        }
+
+        template<typename W>
+        static W* take(W*& first, W*& last){
+            auto* waiter = first;
+            first = static_cast<W*>(waiter->next);
+            if(!first)
+                last = nullptr;
+            return waiter;
+        }
+
+        SpinLock m_lock;
+        std::vector<T> m_slots;
+        size_t m_mask;
+        size_t m_head = 0, m_tail = 0;
+        bool m_closed = false, m_abandoned = false;
+        // Waiting coroutines in FIFO order, producers only wait on a full channel, consumers on an empty one
+        PushAwaiter* m_first_push = nullptr;
+        PushAwaiter* m_last_push = nullptr;
+        PopAwaiter* m_first_pop = nullptr;
+        PopAwaiter* m_last_pop = nullptr;
+    };
+
+    // One layer(N, "name") of the program run as coroutines
+    class CoroutineLayer{
+    public:
+        using Body = std::function<LayerTask(size_t)>;
+
+        [[nodiscard]] unsigned level() const{
+            return m_level;
+        }
+
+        [[nodiscard]] std::string const& name() const{
+            return m_name;
+        }
+
+        [[nodiscard]] size_t replicas() const{
+            return m_replicas;
+        }
+
+    private:
+        friend class CoroutinePipeline;
+        friend struct LayerTask::promise_type;
+
+        CoroutineLayer(CoroutinePipeline& pipeline, unsigned level, std::string name, size_t replicas, Body body):
+                m_pipeline(pipeline), m_level(level), m_name(std::move(name)), m_replicas(replicas),
+                m_body(std::move(body)){}
+
+        CoroutinePipeline& m_pipeline;
+        unsigned m_level;
+        std::string m_name;
+        size_t m_replicas;
+        Body m_body;
+        std::vector<LayerTask> m_tasks;
+        std::vector<CoroutineLink*> m_inputs, m_outputs;
+        std::atomic<size_t> m_running = 0;
+    };
+
+    /*
+     * Program of several layers run as coroutines on a small pool of worker threads instead
+     * of a thread per layer. A layer body is a coroutine which passes values through
+     * CoroutineChannel push() and pop(); when a channel is full (empty) the coroutine is
+     * suspended and its thread picks up another runnable layer from the shared ready queue.
+     * So hundreds of layers run on a few cores, and a value handed to a waiting layer costs
+     * a coroutine switch (a few nanoseconds) rather than a thread switch in the kernel.
+     * Coroutines of a body have to await channel operations directly, nested coroutines
+     * aren't scheduled. An exception in a layer stops the others and is rethrown by run(),
+     * as is a deadlock: every remaining layer waiting on a channel.
+     */
+    class CoroutinePipeline{
+    public:
+        CoroutinePipeline() = default;
+
+        CoroutinePipeline(CoroutinePipeline const&) = delete;
+        CoroutinePipeline& operator=(CoroutinePipeline const&) = delete;
+
+        // Body is called once per replica, coroutines of all replicas share the layer's channels
+        CoroutineLayer& layer(unsigned level, std::string name, CoroutineLayer::Body body, size_t replicas = 1){
+            if(!replicas)
+                throw std::invalid_argument("layer " + std::to_string(level) + " needs at least one replica");
+            m_layers.push_back(std::unique_ptr<CoroutineLayer>(
+                    new CoroutineLayer(*this, level, std::move(name), replicas, std::move(body))));
+            return *m_layers.back();
+        }
+
+        template<typename T>
+        CoroutineChannel<T>& connect(CoroutineLayer& from, CoroutineLayer& to, size_t capacity = 1024){
+            auto channel = std::make_unique<CoroutineChannel<T>>(*this, from, to, capacity);
+            auto& result = *channel;
+            from.m_outputs.push_back(channel.get());
+            to.m_inputs.push_back(channel.get());
+            m_links.push_back(std::move(channel));
+            return result;
+        }
+
+        // Calling thread is one of the workers
+        void run(size_t threads = std::max(1u, std::thread::hardware_concurrency())){
+            if(!threads)
+                throw std::invalid_argument("coroutine pipeline needs at least one thread");
+
+            size_t coroutines = 0;
+            for(auto& layer: m_layers)
+                coroutines += layer->replicas();
+            // Coroutine is queued at most once at a time
+            m_ready = std::make_unique<MpmcQueue<LayerTask::Handle>>(coroutines);
+            m_active.store(0, std::memory_order_relaxed);
+            m_cancelled.store(false, std::memory_order_relaxed);
+            m_suspensions.store(0, std::memory_order_relaxed);
+            m_error = nullptr;
+            m_threads = threads;
+
+            for(auto& layer: m_layers){
+                layer->m_tasks.clear();
+                layer->m_running.store(layer->replicas(), std::memory_order_relaxed);
+                for(size_t idx = 0; idx < layer->replicas(); ++idx){
+                    layer->m_tasks.push_back(layer->m_body(idx));
+                    auto handle = layer->m_tasks.back().handle();
+                    handle.promise().layer = layer.get();
+                    schedule(handle);
+                }
+            }
+
+            std::vector<std::thread> workers;
+            for(size_t idx = 1; idx < threads; ++idx)
+                workers.emplace_back([this]{ work(); });
+            work();
+            for(auto& worker: workers)
+                worker.join();
+
+            // Frames of cancelled or deadlocked layers are destroyed where they are suspended
+            std::string waiting;
+            for(auto& layer: m_layers){
+                auto done = std::all_of(layer->m_tasks.begin(), layer->m_tasks.end(),
+                                        [](auto& task){ return task.handle().promise().done; });
+                if(!done)
+                    waiting += (waiting.empty() ? "" : ", ") + std::to_string(layer->level()) + " \"" +
+                               layer->name() + "\"";
+                layer->m_tasks.clear();
+            }
+
+            if(m_error)
+                std::rethrow_exception(m_error);
+            if(!waiting.empty())
+                throw std::runtime_error("pipeline deadlocked, layers " + waiting + " wait on their channels");
+        }
+
+        [[nodiscard]] std::vector<std::unique_ptr<CoroutineLayer>> const& layers() const{
+            return m_layers;
+        }
+
+        // Times a coroutine waited on a channel and gave its thread away
+        [[nodiscard]] uint64_t suspensions() const{
+            return m_suspensions.load(std::memory_order_relaxed);
+        }
+
+        void report(std::ostream& stream) const{
+            size_t coroutines = 0;
+            for(auto& layer: m_layers)
+                coroutines += layer->replicas();
+            stream << m_layers.size() << " layers, " << coroutines << " coroutines on " << m_threads
+                   << (m_threads == 1 ? " thread, " : " threads, ") << suspensions() << " suspensions\n";
+            for(auto& link: m_links)
+                stream << "channel " << link->from().level() << " -> " << link->to().level() << ": "
+                       << link->capacity() << " values\n";
+        }
+
+    private:
+        template<typename T>
+        friend class CoroutineChannel;
+        friend struct LayerTask::promise_type;
+
+        // Runnable: queued or being resumed
+        void schedule(LayerTask::Handle handle){
+            m_active.fetch_add(1, std::memory_order_relaxed);
+            // Can't fail, there is a slot for every coroutine
+            while(!m_ready->tryPush(handle))
+                std::this_thread::yield();
+        }
+
+        void suspended(){
+            m_suspensions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void work(){
+            LayerTask::Handle handle;
+            for(Backoff backoff;;){
+                if(m_ready->tryPop(handle)){
+                    backoff.reset();
+                    // Frame isn't touched after resume(), other thread may already run it again
+                    if(!m_cancelled.load(std::memory_order_acquire))
+                        handle.resume();
+                    m_active.fetch_sub(1, std::memory_order_acq_rel);
+                    continue;
+                }
+                // Nothing is queued or running, so nobody can wake the rest
+                if(m_active.load(std::memory_order_acquire) == 0 || m_cancelled.load(std::memory_order_acquire))
+                    return;
+                backoff.wait();
+            }
+        }
+
+        // Last coroutine of a layer lets the following layers drain its channels
+        // and the preceding ones go on without it
+        void finished(LayerTask::promise_type& promise){
+            if(promise.error){
+                std::lock_guard lock(m_mutex);
+                if(!m_error)
+                    m_error = promise.error;
+                m_cancelled.store(true, std::memory_order_release);
+            }
+
+            auto& layer = *promise.layer;
+            if(layer.m_running.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                for(auto* link: layer.m_outputs)
+                    link->close();
+                for(auto* link: layer.m_inputs)
+                    link->abandon();
+            }
+        }
+
+        std::vector<std::unique_ptr<CoroutineLayer>> m_layers;
+        std::vector<std::unique_ptr<CoroutineLink>> m_links;
+        std::unique_ptr<MpmcQueue<LayerTask::Handle>> m_ready;
+        std::atomic<size_t> m_active = 0;
+        std::atomic<bool> m_cancelled = false;
+        std::atomic<uint64_t> m_suspensions = 0;
+        size_t m_threads = 0;
+        std::mutex m_mutex;
+        std::exception_ptr m_error;
+    };
+
+    inline void LayerTask::promise_type::Finished::await_suspend(std::coroutine_handle<promise_type> handle) noexcept{
+        auto& promise = handle.promise();
+        promise.done = true;
+        promise.layer->m_pipeline.finished(promise);
+    }
+
+    template<typename T>
+    bool CoroutineChannel<T>::tryPush(PushAwaiter& awaiter){
+        m_lock.lock();
+        if(m_abandoned){
+            m_lock.unlock();
+            return true;
+        }
+
+        // Consumers only wait on an empty channel, the value goes straight to the first one
+        if(m_first_pop){
+            auto* consumer = take(m_first_pop, m_last_pop);
+            consumer->m_value = std::move(awaiter.m_value);
+            consumer->m_received = true;
+            m_lock.unlock();
+            m_pipeline.schedule(consumer->handle);
+            return true;
+        }
+
+        if(m_head - m_tail < m_slots.size()){
+            m_slots[m_head++ & m_mask] = std::move(awaiter.m_value);
+            m_lock.unlock();
+            return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    bool CoroutineChannel<T>::tryPop(PopAwaiter& awaiter){
+        m_lock.lock();
+        if(m_head != m_tail){
+            awaiter.m_value = std::move(m_slots[m_tail++ & m_mask]);
+            awaiter.m_received = true;
+
+            // Producers only wait on a full channel, the first one takes the freed slot
+            if(m_first_push){
+                auto* producer = take(m_first_push, m_last_push);
+                m_slots[m_head++ & m_mask] = std::move(producer->m_value);
+                m_lock.unlock();
+                m_pipeline.schedule(producer->handle);
+            } else
+                m_lock.unlock();
+            return true;
+        }
+
+        if(m_closed){
+            m_lock.unlock();
+            return true;
+        }
+        return false;
+    }
+
+    template<typename T>
+    template<typename W>
+    void CoroutineChannel<T>::wait(W*& first, W*& last, W& awaiter, LayerTask::Handle coroutine){
+        awaiter.handle = coroutine;
+        append(first, last, &awaiter);
+        m_lock.unlock();
+        // Awaiter lives in the frame which may already be resumed on another thread, only members are safe
+        m_pipeline.suspended();
+    }
+
+    template<typename T>
+    void CoroutineChannel<T>::close(){
+        std::unique_lock lock(m_lock);
+        m_closed = true;
+        PopAwaiter* consumers = std::exchange(m_first_pop, nullptr);
+        m_last_pop = nullptr;
+        lock.unlock();
+
+        while(consumers){
+            auto* next = static_cast<PopAwaiter*>(consumers->next);
+            m_pipeline.schedule(consumers->handle);
+            consumers = next;
+        }
+    }
+
+    template<typename T>
+    void CoroutineChannel<T>::abandon(){
+        std::unique_lock lock(m_lock);
+        m_abandoned = true;
+        PushAwaiter* producers = std::exchange(m_first_push, nullptr);
+        m_last_push = nullptr;
+        lock.unlock();
+
+        while(producers){
+            auto* next = static_cast<PushAwaiter*>(producers->next);
+            m_pipeline.schedule(producers->handle);
+            producers = next;
+        }
+    }
+}
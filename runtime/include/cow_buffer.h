@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace parasl::runtime{
+
+    /*
+     * Reference counted copy-on-write storage for ParaSL arrays and structures.
+     * Copies share the buffer, first write through non-unique handle detaches it,
+     * so value semantics costs nothing while the value isn't modified or when the
+     * previous owner is dead (see ast::OwnershipAnalysis).
+     */
+    template<typename T>
+    class CowBuffer{
+        static_assert(std::is_trivially_copyable_v<T>, "runtime values are expected to be trivially copyable");
+    public:
+        CowBuffer() = default;
+
+        explicit CowBuffer(size_t size): m_storage(allocate(size)){
+            std::memset(static_cast<void*>(m_storage->data()), 0, size * sizeof(T));
+        }
+
+        CowBuffer(size_t size, T const& value): m_storage(allocate(size)){
+            std::fill_n(m_storage->data(), size, value);
+        }
+
+        CowBuffer(CowBuffer const& another) noexcept: m_storage(another.m_storage){
+            if(m_storage)
+                m_storage->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        CowBuffer(CowBuffer&& another) noexcept: m_storage(std::exchange(another.m_storage, nullptr)){}
+
+        CowBuffer& operator=(CowBuffer const& another) noexcept{
+            CowBuffer(another).swap(*this);
+            return *this;
+        }
+
+        CowBuffer& operator=(CowBuffer&& another) noexcept{
+            CowBuffer(std::move(another)).swap(*this);
+            return *this;
+        }
+
+        ~CowBuffer(){
+            release();
+        }
+
+        void swap(CowBuffer& another) noexcept{
+            std::swap(m_storage, another.m_storage);
+        }
+
+        [[nodiscard]] size_t size() const{
+            return m_storage ? m_storage->size : 0;
+        }
+
+        [[nodiscard]] bool unique() const{
+            return !m_storage || m_storage->refs.load(std::memory_order_acquire) == 1;
+        }
+
+        T const* data() const{
+            return m_storage ? m_storage->data() : nullptr;
+        }
+
+        T const& operator[](size_t idx) const{
+            return m_storage->data()[idx];
+        }
+
+        // Write access, copies shared buffer first
+        T* mutableData(){
+            detach();
+            return m_storage ? m_storage->data() : nullptr;
+        }
+
+        T& mutableAt(size_t idx){
+            return mutableData()[idx];
+        }
+
+    private:
+        struct Storage{
+            std::atomic<size_t> refs;
+            size_t size;
+
+            T* data(){
+                return reinterpret_cast<T*>(reinterpret_cast<std::byte*>(this) + dataOffset());
+            }
+        };
+
+        static constexpr size_t dataOffset(){
+            return (sizeof(Storage) + alignof(T) - 1) / alignof(T) * alignof(T);
+        }
+
+        static constexpr std::align_val_t alignment(){
+            return std::align_val_t{std::max(alignof(Storage), alignof(T))};
+        }
+
+        static Storage* allocate(size_t size){
+            auto* memory = ::operator new(dataOffset() + size * sizeof(T), alignment());
+            return new(memory) Storage{{1}, size};
+        }
+
+        void detach(){
+            if(unique())
+                return;
+
+            auto* copy = allocate(m_storage->size);
+            std::memcpy(static_cast<void*>(copy->data()), m_storage->data(), m_storage->size * sizeof(T));
+            release();
+            m_storage = copy;
+        }
+
+        void release(){
+            if(m_storage && m_storage->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                m_storage->~Storage();
+                ::operator delete(m_storage, alignment());
+            }
+            m_storage = nullptr;
+        }
+
+        Storage* m_storage = nullptr;
+    };
+
+    // Structures are stored as raw bytes laid out according to their type
+    using StructStorage = CowBuffer<std::byte>;
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "int_n.h"
+
+namespace parasl::runtime{
+
+    /*
+     * Reader of whitespace separated numbers fed to one input(N) channel.
+     * Regular files are mapped into memory, pipes and terminals are read as data arrives.
+     * Integers are parsed 8 digits per step (SWAR), floating point values by std::from_chars.
+     */
+    class InputChannel{
+    public:
+        // Doesn't take ownership of descriptor
+        explicit InputChannel(int fd, std::string name = "stdin", size_t buffer_size = 1 << 20):
+                m_fd(fd), m_name(std::move(name)){
+            struct stat info{};
+            if(::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+                auto size = static_cast<size_t>(info.st_size);
+                auto* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mapping != MAP_FAILED){
+                    ::madvise(mapping, size, MADV_SEQUENTIAL);
+                    m_mapping = mapping;
+                    m_mapping_size = size;
+                    m_pos = static_cast<char const*>(mapping);
+                    m_end = m_pos + size;
+                    m_eof = true;
+                    return;
+                }
+            }
+
+            m_buffer.resize(std::max(buffer_size, 2 * maxToken));
+            m_pos = m_end = m_buffer.data();
+        }
+
+        static std::unique_ptr<InputChannel> open(std::string const& path){
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0)
+                throw std::system_error(errno, std::generic_category(), "can't open input " + path);
+
+            auto channel = std::make_unique<InputChannel>(fd, path);
+            channel->m_owns_fd = true;
+            return channel;
+        }
+
+        InputChannel(InputChannel const&) = delete;
+        InputChannel& operator=(InputChannel const&) = delete;
+
+        ~InputChannel(){
+            if(m_mapping)
+                ::munmap(m_mapping, m_mapping_size);
+            if(m_owns_fd)
+                ::close(m_fd);
+        }
+
+        // No values left
+        [[nodiscard]] bool eof(){
+            skipSpaces();
+            return m_pos == m_end;
+        }
+
+        template<typename T>
+        T read(){
+            skipSpaces();
+            if(m_pos == m_end)
+                throw std::runtime_error("input " + m_name + ": unexpected end of input");
+
+            if constexpr (std::is_floating_point_v<T>)
+                return parseFloat<T>();
+            else if constexpr (std::is_integral_v<T>)
+                return parseInteger<T>();
+            else{
+                static_assert(T::bits <= 64, "int(N) wider than 64 bits can't be read");
+                auto value = parseInteger<long long>();
+                if(value < static_cast<long long>(T::min()) || value > static_cast<long long>(T::max()))
+                    throw std::out_of_range("input " + m_name + ": value doesn't fit into int(" + std::to_string(T::bits) + ")");
+                return T(value);
+            }
+        }
+
+        // Fills out[0..count) with next values
+        template<typename T>
+        void read(T* out, size_t count){
+            for(size_t idx = 0; idx < count; ++idx)
+                out[idx] = read<T>();
+        }
+
+    private:
+        // Longer numbers may be split between buffer refills
+        static constexpr size_t maxToken = 512;
+
+        static constexpr uint64_t broadcast(uint8_t byte){
+            return 0x0101010101010101ull * byte;
+        }
+
+        // Number of leading decimal digits of 8 characters, first character in the lowest byte
+        static unsigned leadingDigits(uint64_t chars){
+            auto digits = chars - broadcast('0');
+            // Non-digits either borrow or exceed 9; borrows and carries only affect later characters
+            auto non_digits = (digits | (digits + broadcast(0x76))) & broadcast(0x80);
+            return static_cast<unsigned>(std::countr_zero(non_digits)) / 8;
+        }
+
+        // Value of count leading decimal digits, 0 < count <= 8
+        static uint64_t parseDigits(uint64_t chars, unsigned count){
+            // Drop trailing characters, vacated low bytes act as leading zeros
+            chars <<= 8 * (8 - count);
+            chars = (chars & broadcast(0x0F)) * 2561 >> 8;
+            chars = (chars & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+            return (chars & 0x0000FFFF0000FFFFull) * 42949672960001 >> 32;
+        }
+
+        template<typename T>
+        T parseInteger(){
+            static constexpr uint64_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+            auto* ptr = m_pos;
+            auto negative = *ptr == '-';
+            if(negative || *ptr == '+')
+                ++ptr;
+
+            auto* digits = ptr;
+            uint64_t value = 0;
+            if constexpr (std::endian::native == std::endian::little){
+                while(m_end - ptr >= 8 && ptr - digits < 16){
+                    uint64_t chars;
+                    std::memcpy(&chars, ptr, sizeof(chars));
+                    auto count = leadingDigits(chars);
+                    if(!count)
+                        break;
+                    value = value * pow10[count] + parseDigits(chars, count);
+                    ptr += count;
+                    if(count < 8)
+                        break;
+                }
+            }
+            for(; ptr != m_end && ptr - digits < 19 && static_cast<unsigned char>(*ptr - '0') < 10; ++ptr)
+                value = value * 10 + static_cast<unsigned>(*ptr - '0');
+
+            if(ptr == digits)
+                throw std::runtime_error("input " + m_name + ": expected integer");
+
+            // Up to 19 digits fit into 64 bits, longer numbers are left to the library
+            if(ptr != m_end && static_cast<unsigned char>(*ptr - '0') < 10)
+                return parseLong<T>();
+
+            uint64_t limit = std::numeric_limits<T>::max();
+            if(negative)
+                limit = std::is_signed_v<T> ? limit + 1 : 0;
+            if(value > limit)
+                throw std::out_of_range("input " + m_name + ": integer is out of range");
+
+            m_pos = ptr;
+            return static_cast<T>(negative ? 0 - value : value);
+        }
+
+        template<typename T>
+        T parseLong(){
+            T value;
+            auto* begin = m_pos + (*m_pos == '+');
+            auto [ptr, error] = std::from_chars(begin, m_end, value);
+            if(error == std::errc::invalid_argument)
+                throw std::runtime_error("input " + m_name + ": expected integer");
+            if(error == std::errc::result_out_of_range)
+                throw std::out_of_range("input " + m_name + ": integer is out of range");
+            m_pos = ptr;
+            return value;
+        }
+
+        template<typename T>
+        T parseFloat(){
+            T value;
+            auto* begin = m_pos + (*m_pos == '+');
+            auto [ptr, error] = std::from_chars(begin, m_end, value);
+            if(error == std::errc::invalid_argument)
+                throw std::runtime_error("input " + m_name + ": expected number");
+            if(error == std::errc::result_out_of_range)
+                throw std::out_of_range("input " + m_name + ": number is out of range");
+            m_pos = ptr;
+            return value;
+        }
+
+        static bool isSpace(char c){
+            return c == ' ' || (c >= '\t' && c <= '\r');
+        }
+
+        // Reads more only while the next value isn't buffered whole, so values which have
+        // arrived through a pipe or a terminal are returned without waiting for the next ones
+        void skipSpaces(){
+            while(true){
+                m_pos = std::find_if_not(m_pos, m_end, isSpace);
+                if(m_eof || static_cast<size_t>(m_end - m_pos) >= maxToken || std::find_if(m_pos, m_end, isSpace) != m_end)
+                    return;
+                refill();
+            }
+        }
+
+        // Moves unread tail to the front and reads what is available, waiting only if nothing is
+        void refill(){
+            auto tail = static_cast<size_t>(m_end - m_pos);
+            std::memmove(m_buffer.data(), m_pos, tail);
+            m_pos = m_buffer.data();
+            m_end = m_pos + tail;
+
+            auto* capacity = m_buffer.data() + m_buffer.size();
+            while(true){
+                auto bytes = ::read(m_fd, const_cast<char*>(m_end), static_cast<size_t>(capacity - m_end));
+                if(bytes < 0 && errno == EINTR)
+                    continue;
+                if(bytes < 0)
+                    throw std::system_error(errno, std::generic_category(), "can't read input " + m_name);
+                if(bytes == 0)
+                    m_eof = true;
+                m_end += bytes;
+                return;
+            }
+        }
+
+        int m_fd;
+        bool m_owns_fd = false;
+        std::string m_name;
+        char const* m_pos = nullptr;
+        char const* m_end = nullptr;
+        bool m_eof = false;
+        void* m_mapping = nullptr;
+        size_t m_mapping_size = 0;
+        std::vector<char> m_buffer;
+    };
+
+    /*
+     * Input channels of a program by number. Channel 0 is stdin unless connected to a file,
+     * other channels have to be connected before use.
+     */
+    class InputChannels{
+    public:
+        // "-" is stdin
+        void connect(size_t num, std::string const& path){
+            m_channels[num] = path == "-" ? std::make_unique<InputChannel>(STDIN_FILENO) : InputChannel::open(path);
+        }
+
+        InputChannel& operator[](size_t num){
+            auto it = m_channels.find(num);
+            if(it != m_channels.end())
+                return *it->second;
+            if(num == 0)
+                return *m_channels.emplace(num, std::make_unique<InputChannel>(STDIN_FILENO)).first->second;
+            throw std::runtime_error("input channel " + std::to_string(num) + " is not connected");
+        }
+
+        // input(first..last) : T[last - first + 1] takes next value of every channel in range
+        template<typename T>
+        void fill(size_t first, size_t last, T* out){
+            for(auto num = first; num <= last; ++num)
+                *out++ = (*this)[num].template read<T>();
+        }
+
+    private:
+        std::map<size_t, std::unique_ptr<InputChannel>> m_channels;
+    };
+}
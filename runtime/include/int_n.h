@@ -0,0 +1,298 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace parasl::runtime{
+
+    /*
+     * Value of ParaSL int(N): signed N-bit integer with two's complement wraparound.
+     * Up to 64 bits the value lives in the narrowest native integer and is sign-extended
+     * from bit N after every operation. Wider integers are fixed arrays of 64-bit words.
+     */
+    template<unsigned N>
+    class Int;
+
+    template<unsigned N>
+    using IntStorage = std::conditional_t<N <= 8, int8_t,
+                       std::conditional_t<N <= 16, int16_t,
+                       std::conditional_t<N <= 32, int32_t, int64_t>>>;
+
+    template<unsigned N> requires (N > 0 && N <= 64)
+    class Int<N>{
+    public:
+        using storage_type = IntStorage<N>;
+
+        static constexpr unsigned bits = N;
+
+        constexpr Int() = default;
+
+        constexpr Int(long long value): m_value(wrap(static_cast<uint64_t>(value))) {}
+
+        [[nodiscard]] constexpr storage_type value() const{
+            return m_value;
+        }
+
+        constexpr explicit operator long long() const{
+            return m_value;
+        }
+
+        static constexpr Int min(){
+            return fromBits(uint64_t{1} << (N - 1));
+        }
+
+        static constexpr Int max(){
+            return fromBits((uint64_t{1} << (N - 1)) - 1);
+        }
+
+        // Unsigned arithmetic is modular, so the result only has to be truncated to N bits
+        friend constexpr Int operator+(Int lhs, Int rhs){
+            return fromBits(static_cast<uint64_t>(lhs.m_value) + static_cast<uint64_t>(rhs.m_value));
+        }
+
+        friend constexpr Int operator-(Int lhs, Int rhs){
+            return fromBits(static_cast<uint64_t>(lhs.m_value) - static_cast<uint64_t>(rhs.m_value));
+        }
+
+        friend constexpr Int operator*(Int lhs, Int rhs){
+            return fromBits(static_cast<uint64_t>(lhs.m_value) * static_cast<uint64_t>(rhs.m_value));
+        }
+
+        // Truncates towards zero, min / -1 wraps to min
+        friend constexpr Int operator/(Int lhs, Int rhs){
+            if(!rhs.m_value)
+                throw std::domain_error("int(" + std::to_string(N) + ") division by zero");
+            if(rhs.m_value == -1)
+                return -lhs;
+            return fromBits(static_cast<uint64_t>(static_cast<int64_t>(lhs.m_value) / rhs.m_value));
+        }
+
+        constexpr Int operator-() const{
+            return fromBits(0 - static_cast<uint64_t>(m_value));
+        }
+
+        constexpr Int& operator+=(Int another){
+            return *this = *this + another;
+        }
+
+        constexpr Int& operator-=(Int another){
+            return *this = *this - another;
+        }
+
+        constexpr Int& operator*=(Int another){
+            return *this = *this * another;
+        }
+
+        constexpr Int& operator/=(Int another){
+            return *this = *this / another;
+        }
+
+        friend constexpr bool operator==(Int lhs, Int rhs) = default;
+
+        friend constexpr auto operator<=>(Int lhs, Int rhs){
+            return lhs.m_value <=> rhs.m_value;
+        }
+
+        // Lowest N bits of raw value, sign-extended
+        static constexpr Int fromBits(uint64_t raw){
+            Int result;
+            result.m_value = wrap(raw);
+            return result;
+        }
+
+    private:
+        static constexpr storage_type wrap(uint64_t raw){
+            if constexpr (N == 64)
+                return static_cast<storage_type>(raw);
+
+            constexpr auto shift = 64 - N;
+            return static_cast<storage_type>(static_cast<int64_t>(raw << shift) >> shift);
+        }
+
+        storage_type m_value = 0;
+    };
+
+    template<unsigned N> requires (N > 64)
+    class Int<N>{
+    public:
+        static constexpr unsigned bits = N;
+        static constexpr unsigned words = (N + 63) / 64;
+
+        constexpr Int() = default;
+
+        constexpr Int(long long value){
+            m_words.fill(value < 0 ? ~uint64_t{0} : 0);
+            m_words[0] = static_cast<uint64_t>(value);
+        }
+
+        // Words from least significant, bits above N repeat the sign bit
+        [[nodiscard]] constexpr std::array<uint64_t, words> const& value() const{
+            return m_words;
+        }
+
+        // Lowest 64 bits
+        constexpr explicit operator long long() const{
+            return static_cast<long long>(m_words[0]);
+        }
+
+        [[nodiscard]] constexpr bool isNegative() const{
+            return m_words[words - 1] >> 63;
+        }
+
+        static constexpr Int fromWords(std::array<uint64_t, words> const& raw){
+            Int result;
+            result.m_words = raw;
+            result.normalize();
+            return result;
+        }
+
+        static constexpr Int min(){
+            std::array<uint64_t, words> raw{};
+            raw[(N - 1) / 64] = uint64_t{1} << ((N - 1) % 64);
+            return fromWords(raw);
+        }
+
+        static constexpr Int max(){
+            return -(min() + Int(1));
+        }
+
+        friend constexpr Int operator+(Int lhs, Int const& rhs){
+            uint64_t carry = 0;
+            for(auto i = 0u; i < words; ++i){
+                auto sum = static_cast<unsigned __int128>(lhs.m_words[i]) + rhs.m_words[i] + carry;
+                lhs.m_words[i] = static_cast<uint64_t>(sum);
+                carry = static_cast<uint64_t>(sum >> 64);
+            }
+            lhs.normalize();
+            return lhs;
+        }
+
+        constexpr Int operator~() const{
+            Int result;
+            for(auto i = 0u; i < words; ++i)
+                result.m_words[i] = ~m_words[i];
+            return result;
+        }
+
+        constexpr Int operator-() const{
+            return ~*this + Int(1);
+        }
+
+        friend constexpr Int operator-(Int const& lhs, Int const& rhs){
+            return lhs + -rhs;
+        }
+
+        // Schoolbook multiplication modulo 2^(64 * words)
+        friend constexpr Int operator*(Int const& lhs, Int const& rhs){
+            Int result;
+            for(auto i = 0u; i < words; ++i){
+                uint64_t carry = 0;
+                for(auto j = 0u; i + j < words; ++j){
+                    auto product = static_cast<unsigned __int128>(lhs.m_words[i]) * rhs.m_words[j] +
+                                   result.m_words[i + j] + carry;
+                    result.m_words[i + j] = static_cast<uint64_t>(product);
+                    carry = static_cast<uint64_t>(product >> 64);
+                }
+            }
+            result.normalize();
+            return result;
+        }
+
+        // Truncates towards zero like native division
+        friend constexpr Int operator/(Int const& lhs, Int const& rhs){
+            if(rhs == Int(0))
+                throw std::domain_error("int(" + std::to_string(N) + ") division by zero");
+
+            auto dividend = magnitude(lhs);
+            auto divisor = magnitude(rhs);
+
+            // Bitwise long division of magnitudes
+            std::array<uint64_t, words> quotient{}, remainder{};
+            for(auto bit = words * 64; bit-- > 0;){
+                shiftLeft(remainder);
+                remainder[0] |= dividend[bit / 64] >> (bit % 64) & 1;
+                if(!less(remainder, divisor)){
+                    subtract(remainder, divisor);
+                    quotient[bit / 64] |= uint64_t{1} << (bit % 64);
+                }
+            }
+
+            auto result = fromWords(quotient);
+            return lhs.isNegative() != rhs.isNegative() ? -result : result;
+        }
+
+        constexpr Int& operator+=(Int const& another){
+            return *this = *this + another;
+        }
+
+        constexpr Int& operator-=(Int const& another){
+            return *this = *this - another;
+        }
+
+        constexpr Int& operator*=(Int const& another){
+            return *this = *this * another;
+        }
+
+        constexpr Int& operator/=(Int const& another){
+            return *this = *this / another;
+        }
+
+        friend constexpr bool operator==(Int const& lhs, Int const& rhs) = default;
+
+        friend constexpr std::strong_ordering operator<=>(Int const& lhs, Int const& rhs){
+            if(lhs.isNegative() != rhs.isNegative())
+                return lhs.isNegative() ? std::strong_ordering::less : std::strong_ordering::greater;
+
+            // Same sign: two's complement words compare as unsigned
+            for(auto i = words; i-- > 0;)
+                if(lhs.m_words[i] != rhs.m_words[i])
+                    return lhs.m_words[i] <=> rhs.m_words[i];
+            return std::strong_ordering::equal;
+        }
+
+    private:
+        constexpr void normalize(){
+            if constexpr (N % 64 != 0){
+                constexpr auto shift = 64 - N % 64;
+                auto& top = m_words[words - 1];
+                top = static_cast<uint64_t>(static_cast<int64_t>(top << shift) >> shift);
+            }
+        }
+
+        // |value| as unsigned N-bit number (|min| doesn't fit into Int<N>)
+        static constexpr std::array<uint64_t, words> magnitude(Int const& value){
+            auto raw = value.isNegative() ? (-value).m_words : value.m_words;
+            if constexpr (N % 64 != 0)
+                raw[words - 1] &= (uint64_t{1} << N % 64) - 1;
+            return raw;
+        }
+
+        static constexpr void shiftLeft(std::array<uint64_t, words>& raw){
+            for(auto i = words; i-- > 1;)
+                raw[i] = raw[i] << 1 | raw[i - 1] >> 63;
+            raw[0] <<= 1;
+        }
+
+        static constexpr bool less(std::array<uint64_t, words> const& lhs, std::array<uint64_t, words> const& rhs){
+            for(auto i = words; i-- > 0;)
+                if(lhs[i] != rhs[i])
+                    return lhs[i] < rhs[i];
+            return false;
+        }
+
+        static constexpr void subtract(std::array<uint64_t, words>& lhs, std::array<uint64_t, words> const& rhs){
+            uint64_t borrow = 0;
+            for(auto i = 0u; i < words; ++i){
+                auto diff = static_cast<unsigned __int128>(lhs[i]) - rhs[i] - borrow;
+                lhs[i] = static_cast<uint64_t>(diff);
+                borrow = static_cast<uint64_t>(diff >> 64) & 1;
+            }
+        }
+
+        std::array<uint64_t, words> m_words{};
+    };
+}
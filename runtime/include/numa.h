@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace parasl::runtime{
+
+    enum class numa_policy_t {
+        // Layers aren't pinned, memory goes where the kernel puts it
+        NONE,
+        // Neighbouring layers share a node until its CPUs are taken, so most queues stay local
+        COMPACT,
+        // Layers go round robin over the nodes to use the memory bandwidth of all of them
+        SPREAD
+    };
+
+    /*
+     * NUMA nodes of this machine and their CPUs, read from /sys/devices/system/node.
+     * Without the sysfs tree (or NUMA support) the machine is a single node with all CPUs.
+     */
+    class NumaTopology{
+    public:
+        explicit NumaTopology(std::vector<std::vector<unsigned>> node_cpus): m_node_cpus(std::move(node_cpus)){
+            if(m_node_cpus.empty())
+                m_node_cpus.push_back(allCpus());
+        }
+
+        static NumaTopology const& system(){
+            static NumaTopology const topology(read());
+            return topology;
+        }
+
+        [[nodiscard]] size_t nodes() const{
+            return m_node_cpus.size();
+        }
+
+        [[nodiscard]] std::vector<unsigned> const& cpus(size_t node) const{
+            return m_node_cpus.at(node);
+        }
+
+        [[nodiscard]] std::optional<size_t> nodeOf(unsigned cpu) const{
+            for(size_t node = 0; node < m_node_cpus.size(); ++node)
+                if(std::find(m_node_cpus[node].begin(), m_node_cpus[node].end(), cpu) != m_node_cpus[node].end())
+                    return node;
+            return std::nullopt;
+        }
+
+        // "0-3,8-11" as in cpulist files
+        static std::vector<unsigned> parseCpuList(std::string const& list){
+            std::vector<unsigned> cpus;
+            std::istringstream ranges(list);
+            std::string range;
+            while(std::getline(ranges, range, ',')){
+                unsigned first = 0, last = 0;
+                char dash = 0;
+                std::istringstream bounds(range);
+                if(!(bounds >> first))
+                    continue;
+                if(!(bounds >> dash >> last) || dash != '-')
+                    last = first;
+                for(auto cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(cpu);
+            }
+            return cpus;
+        }
+
+    private:
+        static std::vector<std::vector<unsigned>> read(){
+            std::vector<std::vector<unsigned>> node_cpus;
+            for(size_t node = 0;; ++node){
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string list;
+                if(!file || !std::getline(file, list))
+                    break;
+                node_cpus.push_back(parseCpuList(list));
+            }
+            return node_cpus;
+        }
+
+        static std::vector<unsigned> allCpus(){
+            std::vector<unsigned> cpus(std::max(1u, std::thread::hardware_concurrency()));
+            for(unsigned cpu = 0; cpu < cpus.size(); ++cpu)
+                cpus[cpu] = cpu;
+            return cpus;
+        }
+
+        std::vector<std::vector<unsigned>> m_node_cpus;
+    };
+
+    // Binds the calling thread to the CPUs of node, false if the system didn't allow it
+    inline bool pinToNode(NumaTopology const& topology, size_t node){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(auto cpu: topology.cpus(node))
+            if(cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    /*
+     * Memory placed on one node: blocks are mapped directly and bound to the node (mbind with
+     * a preferred policy) before anything touches them, so pages land there whichever thread
+     * writes first. Meant for large blocks (queue buffers, arrays) with a pool on top for small
+     * ones. Without NUMA support binding fails silently and pages follow first touch.
+     */
+    class NumaMemoryResource final: public std::pmr::memory_resource{
+    public:
+        explicit NumaMemoryResource(size_t node): m_node(node){}
+
+        [[nodiscard]] size_t node() const{
+            return m_node;
+        }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override{
+            if(alignment > pageSize())
+                throw std::bad_alloc();
+            auto size = roundUp(std::max<size_t>(bytes, 1));
+            auto* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(data == MAP_FAILED)
+                throw std::bad_alloc();
+
+            unsigned long mask[(1024 + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))]{};
+            auto bits = 8 * sizeof(unsigned long);
+            if(m_node < 8 * sizeof(mask)){
+                mask[m_node / bits] = 1ul << (m_node % bits);
+                ::syscall(SYS_mbind, data, size, MPOL_PREFERRED, mask, 8 * sizeof(mask) + 1, 0);
+            }
+            return data;
+        }
+
+        void do_deallocate(void* data, size_t bytes, size_t) override{
+            ::munmap(data, roundUp(std::max<size_t>(bytes, 1)));
+        }
+
+        [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override{
+            return this == &other;
+        }
+
+        static size_t pageSize(){
+            static auto const size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+        static size_t roundUp(size_t bytes){
+            return (bytes + pageSize() - 1) / pageSize() * pageSize();
+        }
+
+        size_t m_node;
+    };
+
+    /*
+     * Pages allocated by the kernel on the node which was asked for (local) or on another one
+     * (remote), summed over nodes from numastat. These count allocations rather than accesses,
+     * but a layer whose pages are remote pays for it on every access.
+     */
+    struct NumaCounters{
+        uint64_t local = 0;
+        uint64_t remote = 0;
+        bool available = false;
+
+        static NumaCounters read(){
+            NumaCounters counters;
+            for(size_t node = 0;; ++node){
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/numastat");
+                if(!file)
+                    break;
+                counters.available = true;
+                std::string name;
+                uint64_t value;
+                while(file >> name >> value){
+                    if(name == "local_node")
+                        counters.local += value;
+                    else if(name == "other_node")
+                        counters.remote += value;
+                }
+            }
+            return counters;
+        }
+
+        // Share of remote pages allocated since the earlier snapshot
+        [[nodiscard]] double remoteRatio(NumaCounters const& since) const{
+            auto local_pages = local - since.local, remote_pages = remote - since.remote;
+            return local_pages + remote_pages ? static_cast<double>(remote_pages) / static_cast<double>(local_pages + remote_pages) : 0;
+        }
+    };
+}
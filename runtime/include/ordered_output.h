@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "output_channel.h"
+
+namespace parasl::runtime{
+
+    enum class output_order_t {
+        // Records appear in sequence number order, as if iterations ran one by one
+        ORDERED,
+        // Records appear in any order, only a record itself isn't interleaved
+        RELAXED
+    };
+
+    /*
+     * Output of parallel iterations (or layers) to one channel without a global mutex.
+     * Every worker thread stages output of an iteration in its own ring as one record tagged
+     * with the logical sequence number of the iteration. When its stage gets half full (or full)
+     * the thread tries to become the merger (try-flag, nobody waits for it) and moves records
+     * of all stages to the channel while the record with the next sequence number is staged.
+     * A thread whose stage is full sleeps until records are staged or moved by others.
+     * The rest is moved by finish(), so output of a loop is complete once it returns.
+     * In ordered mode every sequence number starting from first has to be committed exactly
+     * once (records may be empty), and each thread commits its numbers in increasing order.
+     */
+    class OrderedOutput{
+        struct Stage;
+    public:
+        // Staging area of one worker thread
+        class Writer{
+        public:
+            void begin(uint64_t seq){
+                m_seq = seq;
+                m_pending.clear();
+            }
+
+            template<typename T>
+            void write(T const& value){
+                char encoded[OutputChannel::maxEncoded];
+                m_pending.insert(m_pending.end(), encoded, m_output.m_channel.encode(encoded, value));
+            }
+
+            template<typename T>
+            void write(T const* values, size_t count){
+                auto size = m_pending.size();
+                m_pending.resize(size + count * OutputChannel::maxEncoded);
+                auto* end = m_pending.data() + size;
+                for(size_t idx = 0; idx < count; ++idx)
+                    end = m_output.m_channel.encode(end, values[idx], idx + 1 == count ? '\n' : ' ');
+                m_pending.resize(static_cast<size_t>(end - m_pending.data()));
+            }
+
+            void commit(){
+                m_output.commit(m_stage, m_seq, m_pending);
+            }
+
+        private:
+            friend class OrderedOutput;
+
+            Writer(OrderedOutput& output, Stage& stage): m_output(output), m_stage(stage){}
+
+            OrderedOutput& m_output;
+            Stage& m_stage;
+            uint64_t m_seq = 0;
+            std::vector<char> m_pending;
+        };
+
+        explicit OrderedOutput(OutputChannel& channel, output_order_t order = output_order_t::ORDERED,
+                               size_t max_threads = std::max(1u, std::thread::hardware_concurrency()),
+                               uint64_t first = 0, size_t stage_size = 1 << 16):
+                m_channel(channel), m_order(order), m_stages(std::make_unique<Stage[]>(max_threads)),
+                m_max_threads(max_threads), m_stage_size(std::bit_ceil(stage_size)), m_next(first){}
+
+        OrderedOutput(OrderedOutput const&) = delete;
+        OrderedOutput& operator=(OrderedOutput const&) = delete;
+
+        // Called once by every worker thread
+        Writer writer(){
+            auto idx = m_registered.fetch_add(1, std::memory_order_relaxed);
+            if(idx >= m_max_threads)
+                throw std::length_error("ordered output supports " + std::to_string(m_max_threads) + " threads");
+
+            auto& stage = m_stages[idx];
+            stage.ring.resize(m_stage_size);
+            stage.active.store(true, std::memory_order_release);
+            return Writer(*this, stage);
+        }
+
+        // Run failed: records which can't be staged are dropped instead of waiting for missing ones
+        void abort(){
+            m_aborted.store(true, std::memory_order_release);
+            progressed();
+        }
+
+        // Moves the rest of records to the channel when all workers are done
+        void finish(){
+            lockMerging();
+            unlockMerging(merge());
+
+            for(size_t idx = 0; idx < m_max_threads; ++idx)
+                if(m_stages[idx].pending())
+                    throw std::logic_error("output record " + std::to_string(m_next.load()) + " has never been committed");
+        }
+
+    private:
+        struct Header{
+            uint64_t seq;
+            uint64_t size;
+        };
+
+        struct Stage{
+            std::vector<char> ring;
+            // Monotonic byte counters: head is advanced by the owner thread, tail by the merger
+            alignas(64) std::atomic<size_t> head = 0;
+            alignas(64) std::atomic<size_t> tail = 0;
+            std::atomic<bool> active = false;
+
+            [[nodiscard]] bool pending() const{
+                return active.load(std::memory_order_acquire) &&
+                       tail.load(std::memory_order_relaxed) != head.load(std::memory_order_acquire);
+            }
+
+            [[nodiscard]] size_t free() const{
+                return ring.size() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+            }
+
+            void copyIn(size_t pos, char const* data, size_t size){
+                if(!size)
+                    return;
+                auto offset = pos & (ring.size() - 1);
+                auto first = std::min(size, ring.size() - offset);
+                std::memcpy(ring.data() + offset, data, first);
+                std::memcpy(ring.data(), data + first, size - first);
+            }
+
+            void copyOut(size_t pos, char* data, size_t size) const{
+                if(!size)
+                    return;
+                auto offset = pos & (ring.size() - 1);
+                auto first = std::min(size, ring.size() - offset);
+                std::memcpy(data, ring.data() + offset, first);
+                std::memcpy(data + first, ring.data(), size - first);
+            }
+
+            [[nodiscard]] Header front() const{
+                Header header{};
+                copyOut(tail.load(std::memory_order_relaxed), reinterpret_cast<char*>(&header), sizeof(header));
+                return header;
+            }
+        };
+
+        void commit(Stage& stage, uint64_t seq, std::vector<char> const& bytes){
+            auto record = sizeof(Header) + bytes.size();
+            if(record > stage.ring.size())
+                return writeDirectly(seq, bytes);
+
+            // Ring only holds records preceding the current one, so space frees as others commit
+            if(!waitFor([&]{ return stage.free() >= record; }))
+                return;
+
+            auto head = stage.head.load(std::memory_order_relaxed);
+            Header header{seq, bytes.size()};
+            stage.copyIn(head, reinterpret_cast<char const*>(&header), sizeof(header));
+            stage.copyIn(head + sizeof(header), bytes.data(), bytes.size());
+            stage.head.store(head + record, std::memory_order_release);
+            progressed();
+
+            // Records are merged by batches when the stage gets half full
+            auto half = stage.ring.size() / 2;
+            auto used = stage.ring.size() - stage.free();
+            if(used > half && used - record <= half)
+                tryMerge();
+        }
+
+        // Record larger than the stage goes to the channel when its turn comes
+        void writeDirectly(uint64_t seq, std::vector<char> const& bytes){
+            if(m_order == output_order_t::ORDERED &&
+               !waitFor([&]{ return m_next.load(std::memory_order_acquire) == seq; }))
+                return;
+
+            lockMerging();
+            m_channel.writeBytes(bytes.data(), bytes.size());
+            if(m_order == output_order_t::ORDERED)
+                m_next.store(seq + 1, std::memory_order_release);
+            unlockMerging(true);
+            tryMerge();
+        }
+
+        // Goes on while merging moves records and others are left, which may have been staged
+        // by threads that failed to take over merging meanwhile
+        void tryMerge(){
+            while(!m_merging.test_and_set(std::memory_order_acquire)){
+                auto merged = merge();
+                unlockMerging(merged);
+                if(!merged || !staged())
+                    return;
+            }
+        }
+
+        void lockMerging(){
+            while(m_merging.test_and_set(std::memory_order_acquire))
+                m_merging.wait(true, std::memory_order_relaxed);
+        }
+
+        // Wakes up waiting threads if records were moved
+        void unlockMerging(bool merged){
+            m_merging.clear(std::memory_order_release);
+            m_merging.notify_all();
+            if(merged)
+                progressed();
+        }
+
+        /*
+         * Merges until done() holds, sleeping while nothing changes: until another thread stages
+         * or moves records or the run is aborted. False if the run is aborted first.
+         * A thread which stages or moves records fences and then checks for waiting threads,
+         * a waiting thread registers and then fences before checking done(), so either the
+         * waiting thread sees the change or the other one sees it waiting and bumps m_progress.
+         */
+        template<typename Done>
+        bool waitFor(Done done){
+            if(done())
+                return true;
+
+            m_waiting.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto result = false;
+            for(;;){
+                lockMerging();
+                unlockMerging(merge());
+                auto seen = m_progress.load(std::memory_order_acquire);
+                if((result = done()) || m_aborted.load(std::memory_order_acquire))
+                    break;
+                m_progress.wait(seen, std::memory_order_acquire);
+            }
+            m_waiting.fetch_sub(1, std::memory_order_relaxed);
+            return result;
+        }
+
+        // Records were staged or moved: costs a fence, a system call only when threads wait
+        void progressed(){
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_waiting.load(std::memory_order_relaxed)){
+                m_progress.fetch_add(1, std::memory_order_release);
+                m_progress.notify_all();
+            }
+        }
+
+        // Some stage holds records. Only counters are read: headers are read by the merger alone,
+        // since without m_merging the record may be moved and its bytes reused meanwhile
+        bool staged() const{
+            for(size_t idx = 0; idx < m_max_threads; ++idx)
+                if(m_stages[idx].pending())
+                    return true;
+            return false;
+        }
+
+        // Merger only, true if any record was moved
+        bool merge(){
+            auto next = m_next.load(std::memory_order_relaxed);
+            auto merged = false;
+            for(auto progress = true; progress;){
+                progress = false;
+                for(size_t idx = 0; idx < m_max_threads; ++idx){
+                    auto& stage = m_stages[idx];
+                    while(stage.pending()){
+                        auto header = stage.front();
+                        if(m_order == output_order_t::ORDERED && header.seq != next)
+                            break;
+                        emit(stage, header);
+                        ++next;
+                        progress = merged = true;
+                    }
+                }
+            }
+            flushBatch();
+            if(m_order == output_order_t::ORDERED)
+                m_next.store(next, std::memory_order_release);
+            return merged;
+        }
+
+        // Records are collected into batch to pass them to the channel by large blocks
+        void emit(Stage& stage, Header const& header){
+            auto pos = stage.tail.load(std::memory_order_relaxed) + sizeof(Header);
+            auto size = m_batch.size();
+            m_batch.resize(size + header.size);
+            stage.copyOut(pos, m_batch.data() + size, header.size);
+            stage.tail.store(pos + header.size, std::memory_order_release);
+            if(m_batch.size() >= batchSize)
+                flushBatch();
+        }
+
+        void flushBatch(){
+            m_channel.writeBytes(m_batch.data(), m_batch.size());
+            m_batch.clear();
+        }
+
+        OutputChannel& m_channel;
+        output_order_t m_order;
+        std::unique_ptr<Stage[]> m_stages;
+        size_t m_max_threads;
+        size_t m_stage_size;
+        std::atomic<size_t> m_registered = 0;
+        std::atomic<uint64_t> m_next;
+        std::atomic_flag m_merging = ATOMIC_FLAG_INIT;
+        std::atomic<bool> m_aborted = false;
+        // Threads in waitFor() and a counter they sleep on
+        std::atomic<size_t> m_waiting = 0;
+        std::atomic<uint32_t> m_progress = 0;
+        // Merger only
+        std::vector<char> m_batch;
+        static constexpr size_t batchSize = 1 << 14;
+    };
+}
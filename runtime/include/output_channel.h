@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "int_n.h"
+
+namespace parasl::runtime{
+
+    enum class output_format_t {
+        // One value per line, array elements separated by spaces
+        TEXT,
+        // Values back to back as fixed-width native binary, no separators
+        BINARY
+    };
+
+    class OutputChannels;
+
+    /*
+     * Output of one output(N, ...) channel. Values are formatted by the program thread into
+     * a ring buffer which is written out by the background thread of OutputChannels, so the
+     * program only blocks when the ring is full, sleeping until the writer frees space.
+     * Single producer: one thread writes a channel.
+     */
+    class OutputChannel{
+    public:
+        OutputChannel(OutputChannels& owner, int fd, std::string name, output_format_t format,
+                      size_t capacity = 1 << 20):
+                m_owner(owner), m_fd(fd), m_name(std::move(name)), m_format(format),
+                m_ring(std::bit_ceil(capacity)), m_mask(m_ring.size() - 1){}
+
+        OutputChannel(OutputChannel const&) = delete;
+        OutputChannel& operator=(OutputChannel const&) = delete;
+
+        ~OutputChannel(){
+            if(m_owns_fd)
+                ::close(m_fd);
+        }
+
+        template<typename T>
+        void write(T const& value){
+            char encoded[maxEncoded];
+            put(encoded, static_cast<size_t>(encode(encoded, value) - encoded));
+        }
+
+        // Whole array: elements on one line or count values back to back
+        template<typename T>
+        void write(T const* values, size_t count){
+            if constexpr (std::is_arithmetic_v<T>)
+                if(m_format == output_format_t::BINARY)
+                    return put(reinterpret_cast<char const*>(values), count * sizeof(T));
+
+            // Encoded by chunks to copy into the ring once per chunk
+            char encoded[64 * maxEncoded];
+            auto* end = encoded;
+            for(size_t idx = 0; idx < count; ++idx){
+                if(end + maxEncoded > std::end(encoded)){
+                    put(encoded, static_cast<size_t>(end - encoded));
+                    end = encoded;
+                }
+                end = encode(end, values[idx], idx + 1 == count ? '\n' : ' ');
+            }
+            put(encoded, static_cast<size_t>(end - encoded));
+        }
+
+        // Output which is already encoded for this channel
+        void writeBytes(char const* data, size_t size){
+            put(data, size);
+        }
+
+        // Longest encoded scalar: shortest round-trip double and separator
+        static constexpr size_t maxEncoded = 33;
+
+        // Value as written to the channel, followed by separator in text format
+        template<typename T>
+        char* encode(char* out, T const& value, char separator = '\n') const{
+            if(m_format == output_format_t::BINARY){
+                auto raw = binary(value);
+                std::memcpy(out, &raw, sizeof(raw));
+                return out + sizeof(raw);
+            }
+
+            out = formatText(out, value);
+            *out = separator;
+            return out + 1;
+        }
+
+        [[nodiscard]] output_format_t format() const{
+            return m_format;
+        }
+
+        // Waits until everything written so far reached the file
+        void flush();
+
+    private:
+        friend class OutputChannels;
+
+        template<typename T>
+        static auto binary(T const& value){
+            if constexpr (std::is_arithmetic_v<T>)
+                return value;
+            else
+                return value.value();
+        }
+
+        template<typename T>
+        static char* formatText(char* out, T const& value){
+            if constexpr (std::is_same_v<T, char>){
+                *out = value;
+                return out + 1;
+            }
+            else if constexpr (std::is_arithmetic_v<T>)
+                return std::to_chars(out, out + maxEncoded - 1, value).ptr;
+            else{
+                static_assert(T::bits <= 64, "int(N) wider than 64 bits can't be formatted");
+                return std::to_chars(out, out + maxEncoded - 1, value.value()).ptr;
+            }
+        }
+
+        // Copies bytes into the ring, waits for the writer while the ring is full
+        void put(char const* data, size_t size);
+
+        // Writer thread: writes out pending bytes, false if there were none
+        bool drain();
+
+        void checkError() const{
+            if(auto error = m_error.load(std::memory_order_acquire))
+                throw std::system_error(error, std::generic_category(), "can't write output " + m_name);
+        }
+
+        OutputChannels& m_owner;
+        int m_fd;
+        bool m_owns_fd = false;
+        std::string m_name;
+        output_format_t m_format;
+        std::vector<char> m_ring;
+        size_t m_mask;
+        // Monotonic byte counters: head is advanced by the program, tail by the writer
+        alignas(64) std::atomic<size_t> m_head = 0;
+        alignas(64) std::atomic<size_t> m_tail = 0;
+        std::atomic<int> m_error = 0;
+    };
+
+    /*
+     * Output channels of a program by number with the background writer thread.
+     * Channel 0 is stdout unless connected to a file, other channels have to be connected.
+     * Pending output is flushed by destructor, on exit() and on std::terminate, so it isn't
+     * lost when the program fails.
+     */
+    class OutputChannels{
+    public:
+        explicit OutputChannels(output_format_t format = output_format_t::TEXT, size_t ring_size = 1 << 20):
+                m_format(format), m_ring_size(ring_size){
+            static std::once_flag handlers;
+            std::call_once(handlers, []{
+                std::atexit(flushAll);
+                s_terminate = std::set_terminate([]{
+                    flushAll();
+                    if(s_terminate)
+                        s_terminate();
+                    std::abort();
+                });
+            });
+
+            std::lock_guard lock(registry());
+            m_next = s_instances;
+            s_instances = this;
+            m_writer = std::thread([this]{ writerLoop(); });
+        }
+
+        OutputChannels(OutputChannels const&) = delete;
+        OutputChannels& operator=(OutputChannels const&) = delete;
+
+        ~OutputChannels(){
+            {
+                std::lock_guard lock(registry());
+                for(auto** instance = &s_instances; *instance; instance = &(*instance)->m_next)
+                    if(*instance == this){
+                        *instance = m_next;
+                        break;
+                    }
+            }
+
+            flushNoexcept();
+            {
+                std::lock_guard lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_one();
+            m_writer.join();
+        }
+
+        // "-" is stdout
+        void connect(size_t num, std::string const& path){
+            if(path == "-")
+                return connect(num, STDOUT_FILENO, "stdout");
+
+            auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if(fd < 0)
+                throw std::system_error(errno, std::generic_category(), "can't open output " + path);
+            connect(num, fd, path, true);
+        }
+
+        void connect(size_t num, int fd, std::string name, bool owns_fd = false){
+            auto channel = std::make_unique<OutputChannel>(*this, fd, std::move(name), m_format, m_ring_size);
+            channel->m_owns_fd = owns_fd;
+
+            if(auto* replaced = find(num))
+                replaced->flush();
+
+            std::lock_guard lock(m_mutex);
+            auto& slot = m_channels[num];
+            // Writer may still hold the replaced channel, it's released with the others
+            if(slot)
+                m_retired.push_back(std::move(slot));
+            slot = std::move(channel);
+        }
+
+        OutputChannel& operator[](size_t num){
+            std::lock_guard lock(m_mutex);
+            auto it = m_channels.find(num);
+            if(it != m_channels.end())
+                return *it->second;
+            if(num == 0)
+                return *m_channels.emplace(num, std::make_unique<OutputChannel>(*this, STDOUT_FILENO, "stdout",
+                                                                                m_format, m_ring_size)).first->second;
+            throw std::runtime_error("output channel " + std::to_string(num) + " is not connected");
+        }
+
+        void flush(){
+            for(auto* channel: channels())
+                channel->flush();
+        }
+
+    private:
+        friend class OutputChannel;
+
+        OutputChannel* find(size_t num){
+            std::lock_guard lock(m_mutex);
+            auto it = m_channels.find(num);
+            return it != m_channels.end() ? it->second.get() : nullptr;
+        }
+
+        static std::mutex& registry(){
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static void flushAll() noexcept{
+            std::lock_guard lock(registry());
+            for(auto* instance = s_instances; instance; instance = instance->m_next)
+                instance->flushNoexcept();
+        }
+
+        void flushNoexcept() noexcept{
+            try{
+                flush();
+            } catch (...) {}
+        }
+
+        std::vector<OutputChannel*> channels(){
+            std::lock_guard lock(m_mutex);
+            std::vector<OutputChannel*> result;
+            for(auto& channel: m_channels)
+                result.push_back(channel.second.get());
+            return result;
+        }
+
+        void wake(){
+            {
+                std::lock_guard lock(m_mutex);
+                m_pending = true;
+            }
+            m_cv.notify_one();
+        }
+
+        void writerLoop(){
+            std::unique_lock lock(m_mutex);
+            while(!m_stop){
+                m_pending = false;
+                std::vector<OutputChannel*> current;
+                for(auto& channel: m_channels)
+                    current.push_back(channel.second.get());
+
+                lock.unlock();
+                auto progress = false;
+                for(auto* channel: current)
+                    progress |= channel->drain();
+                lock.lock();
+
+                // Idle writer still drains periodically so that text output doesn't lag
+                if(!progress)
+                    m_cv.wait_for(lock, std::chrono::milliseconds(10), [this]{ return m_pending || m_stop; });
+            }
+        }
+
+        output_format_t m_format;
+        size_t m_ring_size;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_pending = false;
+        bool m_stop = false;
+        std::map<size_t, std::unique_ptr<OutputChannel>> m_channels;
+        std::vector<std::unique_ptr<OutputChannel>> m_retired;
+        std::thread m_writer;
+        OutputChannels* m_next = nullptr;
+
+        static inline OutputChannels* s_instances = nullptr;
+        static inline std::terminate_handler s_terminate = nullptr;
+    };
+
+    inline void OutputChannel::put(char const* data, size_t size){
+        checkError();
+        auto head = m_head.load(std::memory_order_relaxed), start = head;
+        while(size){
+            auto tail = m_tail.load(std::memory_order_acquire);
+            auto free = m_ring.size() - (head - tail);
+            if(!free){
+                // Sleeps until the writer moves the tail (futex on Linux), failed writes move it too
+                m_owner.wake();
+                m_tail.wait(tail, std::memory_order_acquire);
+                checkError();
+                continue;
+            }
+
+            auto offset = head & m_mask;
+            auto chunk = std::min({size, free, m_ring.size() - offset});
+            std::memcpy(m_ring.data() + offset, data, chunk);
+            data += chunk;
+            size -= chunk;
+            head += chunk;
+            m_head.store(head, std::memory_order_release);
+        }
+
+        // Writer is woken up early when the ring gets half full
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if(start - tail <= m_ring.size() / 2 && head - tail > m_ring.size() / 2)
+            m_owner.wake();
+    }
+
+    inline void OutputChannel::flush(){
+        auto head = m_head.load(std::memory_order_relaxed);
+        for(auto tail = m_tail.load(std::memory_order_acquire); tail != head; tail = m_tail.load(std::memory_order_acquire)){
+            m_owner.wake();
+            m_tail.wait(tail, std::memory_order_acquire);
+        }
+        checkError();
+    }
+
+    inline bool OutputChannel::drain(){
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        auto head = m_head.load(std::memory_order_acquire);
+        if(tail == head)
+            return false;
+
+        while(tail != head){
+            auto offset = tail & m_mask;
+            auto chunk = std::min(head - tail, m_ring.size() - offset);
+            auto written = ::write(m_fd, m_ring.data() + offset, chunk);
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written < 0){
+                // Output is dropped so that the program doesn't wait forever, it fails on next write
+                m_error.store(errno, std::memory_order_release);
+                written = static_cast<ssize_t>(head - tail);
+            }
+            tail += static_cast<size_t>(written);
+            m_tail.store(tail, std::memory_order_release);
+            // No system call unless the program waits in put() or flush()
+            m_tail.notify_all();
+        }
+        return true;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+
+#include "int_n.h"
+
+namespace parasl::runtime{
+
+    /*
+     * Array of int(N) elements stored back to back in N bits each (see ast::DataLayout::isBitPacked).
+     * Element i occupies bits [i * N, (i + 1) * N) of 64-bit words, storage is the same
+     * ceil(size * N / 64) words as DataLayout reports. Bulk pack/unpack process whole words:
+     * when N divides 64 elements never straddle words and the fixed inner loops are vectorized.
+     */
+    template<unsigned N>
+    class PackedIntArray{
+        static_assert(N > 0 && N <= 32, "bit packing is used for narrow integers only");
+    public:
+        using value_type = Int<N>;
+        using storage_type = typename value_type::storage_type;
+
+        explicit PackedIntArray(size_t size): m_size(size), m_words(wordsFor(size), 0){}
+
+        [[nodiscard]] size_t size() const{
+            return m_size;
+        }
+
+        [[nodiscard]] size_t bytes() const{
+            return m_words.size() * sizeof(uint64_t);
+        }
+
+        value_type operator[](size_t idx) const{
+            auto word = idx * N / 64, shift = idx * N % 64;
+            auto raw = m_words[word] >> shift;
+            if(shift + N > 64)
+                raw |= m_words[word + 1] << (64 - shift);
+            return value_type::fromBits(raw);
+        }
+
+        void set(size_t idx, value_type value){
+            auto word = idx * N / 64, shift = idx * N % 64;
+            auto raw = static_cast<uint64_t>(value.value()) & elementMask;
+            m_words[word] = (m_words[word] & ~(elementMask << shift)) | raw << shift;
+            if(shift + N > 64)
+                m_words[word + 1] = (m_words[word + 1] & ~(elementMask >> (64 - shift))) | raw >> (64 - shift);
+        }
+
+        // out[k] = arr[first + k] for k < count
+        void unpack(size_t first, size_t count, storage_type* out) const{
+            if constexpr (64 % N == 0){
+                constexpr size_t per_word = 64 / N;
+                for(; count && first % per_word; --count)
+                    *out++ = (*this)[first++].value();
+
+                // Word is copied since narrow storage_type may alias it
+                for(auto idx = first / per_word; count >= per_word; count -= per_word, first += per_word, out += per_word){
+                    auto word = m_words[idx++];
+                    for(size_t k = 0; k < per_word; ++k)
+                        out[k] = static_cast<storage_type>(((word >> (k * N) & elementMask) ^ signBit) - signBit);
+                }
+            }
+            for(; count; --count)
+                *out++ = (*this)[first++].value();
+        }
+
+        // arr[first + k] = in[k] for k < count (values are truncated to N bits)
+        void pack(size_t first, size_t count, storage_type const* in){
+            if constexpr (64 % N == 0){
+                constexpr size_t per_word = 64 / N;
+                for(; count && first % per_word; --count)
+                    set(first++, *in++);
+
+                auto* word = m_words.data() + first / per_word;
+                for(; count >= per_word; count -= per_word, first += per_word, in += per_word, ++word){
+                    uint64_t packed = 0;
+                    for(size_t k = 0; k < per_word; ++k)
+                        packed |= (static_cast<uint64_t>(in[k]) & elementMask) << (k * N);
+                    *word = packed;
+                }
+            }
+            for(; count; --count)
+                set(first++, *in++);
+        }
+
+    private:
+        static constexpr uint64_t elementMask = (uint64_t{1} << N) - 1;
+        static constexpr uint64_t signBit = uint64_t{1} << (N - 1);
+
+        static size_t wordsFor(size_t size){
+            return (size * N + 63) / 64;
+        }
+
+        size_t m_size;
+        std::vector<uint64_t> m_words;
+    };
+}
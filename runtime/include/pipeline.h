@@ -0,0 +1,474 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "numa.h"
+
+namespace parasl::runtime{
+
+    class Pipeline;
+    class PipelineLayer;
+    class PipelineWorker;
+
+    // Queue from one layer to another, see Pipeline::connect
+    class PipelineLink{
+    public:
+        virtual ~PipelineLink() = default;
+
+        [[nodiscard]] PipelineLayer const& from() const{
+            return m_from;
+        }
+
+        [[nodiscard]] PipelineLayer const& to() const{
+            return m_to;
+        }
+
+        [[nodiscard]] virtual bool isSpsc() const = 0;
+
+        [[nodiscard]] virtual size_t capacity() const = 0;
+
+    protected:
+        friend class Pipeline;
+
+        PipelineLink(PipelineLayer& from, PipelineLayer& to): m_from(from), m_to(to){}
+
+        // Buffer is allocated when the pipeline starts, on the node of the consumer if it's pinned
+        virtual void allocate(std::pmr::memory_resource* memory) = 0;
+
+        virtual void close() = 0;
+
+        // Wakes threads sleeping on the queue to check cancellation
+        virtual void wake() = 0;
+
+        // Consumer layer returned, following values are dropped instead of waiting for it
+        void abandon(){
+            m_abandoned.store(true, std::memory_order_release);
+            wake();
+        }
+
+        [[nodiscard]] bool abandoned() const{
+            return m_abandoned.load(std::memory_order_acquire);
+        }
+
+        PipelineLayer& m_from;
+        PipelineLayer& m_to;
+        std::atomic<bool> m_abandoned = false;
+    };
+
+    // Values of type T: single-threaded layers on both ends get an SPSC queue, others MPMC
+    template<typename T>
+    class Link final: public PipelineLink{
+    public:
+        Link(PipelineLayer& from, PipelineLayer& to, bool spsc, size_t capacity):
+                PipelineLink(from, to), m_is_spsc(spsc), m_capacity(std::bit_ceil(std::max<size_t>(capacity, 2))){}
+
+        [[nodiscard]] bool isSpsc() const override{
+            return m_is_spsc;
+        }
+
+        [[nodiscard]] size_t capacity() const override{
+            return m_capacity;
+        }
+
+    private:
+        friend class PipelineWorker;
+
+        template<typename U>
+        bool tryPush(U&& value){
+            return m_spsc ? m_spsc->tryPush(std::forward<U>(value)) : m_mpmc->tryPush(std::forward<U>(value));
+        }
+
+        bool tryPop(T& value){
+            return m_spsc ? m_spsc->tryPop(value) : m_mpmc->tryPop(value);
+        }
+
+        template<typename U, typename Stop>
+        bool push(U&& value, Stop stop){
+            return m_spsc ? m_spsc->push(std::forward<U>(value), stop) : m_mpmc->push(std::forward<U>(value), stop);
+        }
+
+        template<typename Stop>
+        bool pop(T& value, Stop stop){
+            return m_spsc ? m_spsc->pop(value, stop) : m_mpmc->pop(value, stop);
+        }
+
+        void allocate(std::pmr::memory_resource* memory) override{
+            if(m_is_spsc)
+                m_spsc = std::make_unique<SpscQueue<T>>(m_capacity, memory);
+            else
+                m_mpmc = std::make_unique<MpmcQueue<T>>(m_capacity, memory);
+        }
+
+        void close() override{
+            if(m_spsc)
+                m_spsc->close();
+            else
+                m_mpmc->close();
+        }
+
+        void wake() override{
+            if(m_spsc)
+                m_spsc->wake();
+            else if(m_mpmc)
+                m_mpmc->wake();
+        }
+
+        bool m_is_spsc;
+        size_t m_capacity;
+        std::unique_ptr<SpscQueue<T>> m_spsc;
+        std::unique_ptr<MpmcQueue<T>> m_mpmc;
+    };
+
+    // One layer(N, "name") of the program and what its threads did
+    class PipelineLayer{
+    public:
+        using Body = std::function<void(PipelineWorker&)>;
+
+        [[nodiscard]] unsigned level() const{
+            return m_level;
+        }
+
+        [[nodiscard]] std::string const& name() const{
+            return m_name;
+        }
+
+        [[nodiscard]] size_t threads() const{
+            return m_threads;
+        }
+
+        // Threads of the layer run on the CPUs of node, its input queues and memory() are allocated there
+        PipelineLayer& pin(size_t node){
+            m_node = node;
+            return *this;
+        }
+
+        [[nodiscard]] std::optional<size_t> node() const{
+            return m_node;
+        }
+
+        // Values taken from input queues and put to output queues by all threads
+        [[nodiscard]] uint64_t itemsIn() const{
+            return m_items_in.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] uint64_t itemsOut() const{
+            return m_items_out.load(std::memory_order_relaxed);
+        }
+
+        // From the start of the pipeline until the last thread of the layer returned
+        [[nodiscard]] std::chrono::nanoseconds elapsed() const{
+            return std::chrono::nanoseconds(m_elapsed.load(std::memory_order_relaxed));
+        }
+
+        // Thread time spent waiting for an empty input queue (starved by preceding layers)
+        [[nodiscard]] std::chrono::nanoseconds starved() const{
+            return std::chrono::nanoseconds(m_starved.load(std::memory_order_relaxed));
+        }
+
+        // Thread time spent waiting for a full output queue (held back by following layers)
+        [[nodiscard]] std::chrono::nanoseconds blocked() const{
+            return std::chrono::nanoseconds(m_blocked.load(std::memory_order_relaxed));
+        }
+
+        // Values per second of the busiest side
+        [[nodiscard]] double throughput() const{
+            auto seconds = std::chrono::duration<double>(elapsed()).count();
+            return seconds > 0 ? static_cast<double>(std::max(itemsIn(), itemsOut())) / seconds : 0;
+        }
+
+    private:
+        friend class Pipeline;
+        friend class PipelineWorker;
+
+        PipelineLayer(unsigned level, std::string name, size_t threads, Body body):
+                m_level(level), m_name(std::move(name)), m_threads(threads), m_body(std::move(body)){}
+
+        unsigned m_level;
+        std::string m_name;
+        size_t m_threads;
+        std::optional<size_t> m_node;
+        Body m_body;
+        std::vector<PipelineLink*> m_inputs, m_outputs;
+        std::atomic<size_t> m_running = 0;
+        std::atomic<uint64_t> m_items_in = 0, m_items_out = 0;
+        std::atomic<int64_t> m_elapsed = 0, m_starved = 0, m_blocked = 0;
+    };
+
+    // Thread of a layer: passes values through the links and counts them
+    class PipelineWorker{
+    public:
+        // Number of the thread within its layer
+        [[nodiscard]] size_t index() const{
+            return m_index;
+        }
+
+        // For arrays of the layer: memory of its node when pinned, first touch by this thread otherwise
+        [[nodiscard]] std::pmr::memory_resource* memory() const{
+            return m_memory;
+        }
+
+        // Sleeps while the queue is full
+        template<typename T, typename U>
+        void push(Link<T>& link, U&& value){
+            ++m_items_out;
+            if(link.tryPush(std::forward<U>(value)))
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            auto pushed = link.push(std::forward<U>(value), [this, &link]{ return link.abandoned() || cancelled(); });
+            m_blocked += std::chrono::steady_clock::now() - start;
+            checkCancelled();
+            if(!pushed)
+                --m_items_out;
+        }
+
+        // Waits for the next value, false once the preceding layer is done and the queue is drained
+        template<typename T>
+        bool pop(Link<T>& link, T& value){
+            if(!link.tryPop(value)){
+                auto start = std::chrono::steady_clock::now();
+                auto received = waitPop(link, value);
+                m_starved += std::chrono::steady_clock::now() - start;
+                if(!received)
+                    return false;
+            }
+            ++m_items_in;
+            return true;
+        }
+
+    private:
+        friend class Pipeline;
+
+        // Thrown into workers of a failed pipeline to unwind them out of waits
+        struct Cancelled{};
+
+        PipelineWorker(Pipeline& pipeline, size_t index, std::pmr::memory_resource* memory):
+                m_pipeline(pipeline), m_index(index), m_memory(memory){}
+
+        template<typename T>
+        bool waitPop(Link<T>& link, T& value){
+            auto received = link.pop(value, [this]{ return cancelled(); });
+            checkCancelled();
+            return received;
+        }
+
+        [[nodiscard]] bool cancelled() const;
+
+        void checkCancelled() const;
+
+        Pipeline& m_pipeline;
+        size_t m_index;
+        std::pmr::memory_resource* m_memory;
+        uint64_t m_items_in = 0, m_items_out = 0;
+        std::chrono::nanoseconds m_starved{}, m_blocked{};
+    };
+
+    /*
+     * Program of several layers run as a pipeline: every layer is a stage with its own
+     * thread(s) which takes values of preceding layers from bounded lock-free queues and
+     * passes its own values on. A full queue stops its producer until the consumer catches
+     * up, so memory stays bounded and the pipeline runs at the speed of its slowest layer;
+     * report() shows which one it is. Waiting threads sleep instead of taking a core. Output queues of a layer are closed when all its
+     * threads returned. An exception in any layer cancels the others and is rethrown by run().
+     * On NUMA machines layers can be pinned to nodes (or placed by a policy, see place()),
+     * and then their threads, input queues and arrays stay on that node.
+     */
+    class Pipeline{
+    public:
+        Pipeline() = default;
+
+        Pipeline(Pipeline const&) = delete;
+        Pipeline& operator=(Pipeline const&) = delete;
+
+        // Body is run once by each of threads threads of the layer
+        PipelineLayer& layer(unsigned level, std::string name, PipelineLayer::Body body, size_t threads = 1){
+            if(!threads)
+                throw std::invalid_argument("layer " + std::to_string(level) + " needs at least one thread");
+            m_layers.push_back(std::unique_ptr<PipelineLayer>(
+                    new PipelineLayer(level, std::move(name), threads, std::move(body))));
+            return *m_layers.back();
+        }
+
+        template<typename T>
+        Link<T>& connect(PipelineLayer& from, PipelineLayer& to, size_t capacity = 1024){
+            auto spsc = from.threads() == 1 && to.threads() == 1;
+            auto link = std::make_unique<Link<T>>(from, to, spsc, capacity);
+            auto& result = *link;
+            from.m_outputs.push_back(link.get());
+            to.m_inputs.push_back(link.get());
+            m_links.push_back(std::move(link));
+            return result;
+        }
+
+        // Pins every layer to a node of topology according to policy
+        void place(numa_policy_t policy, NumaTopology const& topology = NumaTopology::system()){
+            m_topology = &topology;
+            size_t node = 0, used = 0;
+            for(size_t idx = 0; idx < m_layers.size(); ++idx){
+                auto& layer = *m_layers[idx];
+                switch(policy){
+                    case numa_policy_t::NONE:
+                        layer.m_node.reset();
+                        break;
+                    case numa_policy_t::SPREAD:
+                        layer.m_node = idx % topology.nodes();
+                        break;
+                    case numa_policy_t::COMPACT:
+                        if(used && used + layer.threads() > topology.cpus(node).size()){
+                            node = (node + 1) % topology.nodes();
+                            used = 0;
+                        }
+                        layer.m_node = node;
+                        used += layer.threads();
+                        break;
+                }
+            }
+        }
+
+        void run(){
+            // Memory of the nodes is set up before the threads use it
+            m_node_memory.resize(m_topology->nodes());
+            for(auto& layer: m_layers){
+                if(layer->node() && *layer->node() >= m_topology->nodes())
+                    throw std::invalid_argument("layer " + std::to_string(layer->level()) + " is pinned to node " +
+                                                std::to_string(*layer->node()) + " of " +
+                                                std::to_string(m_topology->nodes()));
+                memory(*layer);
+            }
+            for(auto& link: m_links)
+                link->allocate(memory(link->to()));
+
+            auto counters = NumaCounters::read();
+            m_start = std::chrono::steady_clock::now();
+            m_cancelled.store(false, std::memory_order_relaxed);
+            m_error = nullptr;
+
+            std::vector<std::thread> threads;
+            for(auto& layer: m_layers){
+                layer->m_running.store(layer->threads(), std::memory_order_relaxed);
+                for(size_t idx = 0; idx < layer->threads(); ++idx)
+                    threads.emplace_back([this, &layer = *layer, idx]{ work(layer, idx); });
+            }
+            for(auto& thread: threads)
+                thread.join();
+            if(counters.available)
+                m_remote_ratio = NumaCounters::read().remoteRatio(counters);
+
+            if(m_error)
+                std::rethrow_exception(m_error);
+        }
+
+        [[nodiscard]] std::vector<std::unique_ptr<PipelineLayer>> const& layers() const{
+            return m_layers;
+        }
+
+        void report(std::ostream& stream) const{
+            auto flags = stream.flags();
+            auto precision = stream.precision();
+            stream << std::fixed << std::setprecision(1);
+            for(auto& layer: m_layers){
+                auto thread_time = static_cast<double>(layer->elapsed().count()) * static_cast<double>(layer->threads());
+                auto share = [thread_time](std::chrono::nanoseconds time){
+                    return thread_time > 0 ? 100 * static_cast<double>(time.count()) / thread_time : 0;
+                };
+                stream << "layer " << layer->level() << " " << std::quoted(layer->name()) << ": "
+                       << layer->threads() << (layer->threads() == 1 ? " thread, " : " threads, ");
+                if(layer->node())
+                    stream << "node " << *layer->node() << ", ";
+                stream
+                       << layer->itemsIn() << " in, " << layer->itemsOut() << " out, "
+                       << layer->throughput() / 1e6 << " M values/s, starved "
+                       << share(layer->starved()) << "%, blocked " << share(layer->blocked()) << "%\n";
+            }
+            for(auto& link: m_links)
+                stream << "queue " << link->from().level() << " -> " << link->to().level() << ": "
+                       << (link->isSpsc() ? "SPSC, " : "MPMC, ") << link->capacity() << " values\n";
+            // System-wide counters, other programs running meanwhile are counted as well
+            if(m_remote_ratio)
+                stream << "pages allocated on remote NUMA nodes: " << 100 * *m_remote_ratio << "%\n";
+            stream.flags(flags);
+            stream.precision(precision);
+        }
+
+    private:
+        friend class PipelineWorker;
+
+        // Memory of the layer's node, default one if it isn't pinned
+        std::pmr::memory_resource* memory(PipelineLayer const& layer){
+            if(!layer.node())
+                return std::pmr::get_default_resource();
+            auto& memory = m_node_memory[*layer.node()];
+            if(!memory)
+                memory = std::make_unique<NumaMemoryResource>(*layer.node());
+            return memory.get();
+        }
+
+        void work(PipelineLayer& layer, size_t idx){
+            if(layer.node())
+                pinToNode(*m_topology, *layer.node());
+            PipelineWorker worker(*this, idx, memory(layer));
+            try{
+                layer.m_body(worker);
+            } catch (PipelineWorker::Cancelled&) {
+            } catch (...) {
+                std::lock_guard lock(m_mutex);
+                if(!m_error)
+                    m_error = std::current_exception();
+                m_cancelled.store(true, std::memory_order_release);
+                for(auto& link: m_links)
+                    link->wake();
+            }
+
+            layer.m_items_in.fetch_add(worker.m_items_in, std::memory_order_relaxed);
+            layer.m_items_out.fetch_add(worker.m_items_out, std::memory_order_relaxed);
+            layer.m_starved.fetch_add(worker.m_starved.count(), std::memory_order_relaxed);
+            layer.m_blocked.fetch_add(worker.m_blocked.count(), std::memory_order_relaxed);
+
+            // Last thread of the layer lets the following layers drain its queues
+            // and the preceding ones go on without it
+            if(layer.m_running.fetch_sub(1, std::memory_order_acq_rel) == 1){
+                layer.m_elapsed.store((std::chrono::steady_clock::now() - m_start).count(), std::memory_order_relaxed);
+                for(auto* link: layer.m_outputs)
+                    link->close();
+                for(auto* link: layer.m_inputs)
+                    link->abandon();
+            }
+        }
+
+        std::vector<std::unique_ptr<PipelineLayer>> m_layers;
+        NumaTopology const* m_topology = &NumaTopology::system();
+        // Outlive the queues allocated from them
+        std::vector<std::unique_ptr<NumaMemoryResource>> m_node_memory;
+        std::vector<std::unique_ptr<PipelineLink>> m_links;
+        std::chrono::steady_clock::time_point m_start;
+        std::atomic<bool> m_cancelled = false;
+        std::mutex m_mutex;
+        std::exception_ptr m_error;
+        std::optional<double> m_remote_ratio;
+    };
+
+    inline bool PipelineWorker::cancelled() const{
+        return m_pipeline.m_cancelled.load(std::memory_order_acquire);
+    }
+
+    inline void PipelineWorker::checkCancelled() const{
+        if(cancelled())
+            throw Cancelled{};
+    }
+}
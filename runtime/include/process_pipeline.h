@@ -0,0 +1,449 @@
+#pragma once
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared_memory.h"
+
+namespace parasl::runtime{
+
+    class ProcessPipeline;
+    class LayerProcess;
+
+    template<typename>
+    struct is_shared_array: std::false_type{};
+
+    template<typename E>
+    struct is_shared_array<SharedArray<E>>: std::true_type{};
+
+    // Channel from one process to another, see ProcessPipeline::ring and ProcessPipeline::socket
+    class ProcessLink{
+    public:
+        virtual ~ProcessLink() = default;
+
+        [[nodiscard]] LayerProcess const& from() const{
+            return m_from;
+        }
+
+        [[nodiscard]] LayerProcess const& to() const{
+            return m_to;
+        }
+
+        [[nodiscard]] virtual char const* transport() const = 0;
+
+    protected:
+        friend class ProcessPipeline;
+
+        ProcessLink(LayerProcess& from, LayerProcess& to): m_from(from), m_to(to){}
+
+        // In a forked process: drops the ends the process doesn't use
+        virtual void attach(LayerProcess const&){}
+
+        // In the parent after the fork: drops all ends
+        virtual void detach(){}
+
+        // Producer process is done (or died)
+        virtual void close() = 0;
+
+        // Consumer process is done (or died)
+        virtual void abandon() = 0;
+
+        LayerProcess& m_from;
+        LayerProcess& m_to;
+    };
+
+    template<typename T>
+    class RingLink final: public ProcessLink{
+    public:
+        RingLink(LayerProcess& from, LayerProcess& to, size_t capacity): ProcessLink(from, to), m_ring(capacity){}
+
+        [[nodiscard]] char const* transport() const override{
+            return "shared memory ring";
+        }
+
+        ShmRing<T>& ring(){
+            return m_ring;
+        }
+
+    private:
+        void close() override{
+            m_ring.close();
+        }
+
+        void abandon() override{
+            m_ring.abandon();
+        }
+
+        ShmRing<T> m_ring;
+    };
+
+    /*
+     * Channel between processes over a Unix domain socket, the local stand-in for a network
+     * transport. Plain values are batched into messages of up to batch bytes, so a message
+     * carries thousands of them; values are sent when the batch is full and on close().
+     * A SharedArray goes as its own message carrying the descriptor of its memory
+     * (SCM_RIGHTS), the consumer maps the same pages, so arrays aren't copied either.
+     */
+    template<typename T>
+    class SocketChannel final: public ProcessLink{
+        static_assert(std::is_trivially_copyable_v<T> || is_shared_array<T>::value);
+    public:
+        SocketChannel(LayerProcess& from, LayerProcess& to, size_t batch): ProcessLink(from, to){
+            if(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, m_fds) < 0)
+                throw std::system_error(errno, std::generic_category(), "can't create socket channel");
+            m_out.reserve(std::max(batch, sizeof(T)));
+        }
+
+        ~SocketChannel() override{
+            for(auto fd: m_fds)
+                if(fd >= 0)
+                    ::close(fd);
+        }
+
+        [[nodiscard]] char const* transport() const override{
+            return "unix socket";
+        }
+
+        // False if the consumer is gone and value was dropped
+        bool push(T const& value){
+            if(m_abandoned)
+                return false;
+            if constexpr (is_shared_array<T>::value)
+                return sendArray(value);
+            else{
+                auto size = m_out.size();
+                m_out.resize(size + sizeof(T));
+                std::memcpy(m_out.data() + size, &value, sizeof(T));
+                if(m_out.size() + sizeof(T) > m_out.capacity())
+                    flush();
+                return !m_abandoned;
+            }
+        }
+
+        // Waits for the next value, false once the producer is done and the channel is drained
+        bool pop(T& value){
+            if constexpr (is_shared_array<T>::value)
+                return receiveArray(value);
+            else{
+                if(m_in_pos == m_in.size() && !receive())
+                    return false;
+                std::memcpy(&value, m_in.data() + m_in_pos, sizeof(T));
+                m_in_pos += sizeof(T);
+                return true;
+            }
+        }
+
+        // Sends the batch collected so far
+        void flush(){
+            if(m_out.empty())
+                return;
+            if(::send(m_fds[producer], m_out.data(), m_out.size(), MSG_NOSIGNAL) < 0)
+                failed("send");
+            m_out.clear();
+        }
+
+    private:
+        static constexpr int producer = 0, consumer = 1;
+
+        void attach(LayerProcess const& process) override{
+            if(&process != &m_from)
+                closeEnd(producer);
+            if(&process != &m_to)
+                closeEnd(consumer);
+        }
+
+        void detach() override{
+            closeEnd(producer);
+            closeEnd(consumer);
+        }
+
+        void close() override{
+            if(m_fds[producer] < 0)
+                return;
+            flush();
+            ::shutdown(m_fds[producer], SHUT_WR);
+        }
+
+        // Socket tells the producer by EPIPE when the consumer is gone
+        void abandon() override{}
+
+        void closeEnd(int end){
+            if(m_fds[end] >= 0)
+                ::close(m_fds[end]);
+            m_fds[end] = -1;
+        }
+
+        void failed(char const* operation){
+            if(errno == EPIPE || errno == ECONNRESET){
+                m_abandoned = true;
+                m_out.clear();
+                return;
+            }
+            throw std::system_error(errno, std::generic_category(), std::string("socket channel ") + operation);
+        }
+
+        // False at the end of values
+        bool receive(){
+            m_in.resize(m_out.capacity());
+            ssize_t size;
+            while((size = ::recv(m_fds[consumer], m_in.data(), m_in.size(), 0)) < 0 && errno == EINTR);
+            if(size < 0)
+                throw std::system_error(errno, std::generic_category(), "socket channel receive");
+            m_in.resize(static_cast<size_t>(size));
+            m_in_pos = 0;
+            return size > 0;
+        }
+
+        bool sendArray(T const& array){
+            uint64_t count = array.size();
+            iovec data{&count, sizeof(count)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            msghdr message{};
+            message.msg_iov = &data;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            auto* header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            auto fd = array.fd();
+            std::memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+            if(::sendmsg(m_fds[producer], &message, MSG_NOSIGNAL) < 0)
+                failed("send");
+            return !m_abandoned;
+        }
+
+        bool receiveArray(T& array){
+            uint64_t count = 0;
+            iovec data{&count, sizeof(count)};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+            msghdr message{};
+            message.msg_iov = &data;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            ssize_t size;
+            while((size = ::recvmsg(m_fds[consumer], &message, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR);
+            if(size < 0)
+                throw std::system_error(errno, std::generic_category(), "socket channel receive");
+            if(size == 0)
+                return false;
+
+            auto* header = CMSG_FIRSTHDR(&message);
+            if(!header || header->cmsg_type != SCM_RIGHTS)
+                throw std::runtime_error("socket channel: array message without descriptor");
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(header), sizeof(fd));
+            array = T::attach(fd, count);
+            return true;
+        }
+
+        int m_fds[2]{-1, -1};
+        std::vector<char> m_out, m_in;
+        size_t m_in_pos = 0;
+        bool m_abandoned = false;
+    };
+
+    // Group of layers run by one process
+    class LayerProcess{
+    public:
+        using Body = std::function<void()>;
+
+        [[nodiscard]] std::string const& name() const{
+            return m_name;
+        }
+
+        [[nodiscard]] pid_t pid() const{
+            return m_pid;
+        }
+
+        // Wall time from the start of the pipeline until the process exited
+        [[nodiscard]] std::chrono::nanoseconds elapsed() const{
+            return m_elapsed;
+        }
+
+    private:
+        friend class ProcessPipeline;
+
+        LayerProcess(std::string name, Body body): m_name(std::move(name)), m_body(std::move(body)){}
+
+        std::string m_name;
+        Body m_body;
+        std::vector<ProcessLink*> m_inputs, m_outputs;
+        pid_t m_pid = -1;
+        bool m_running = false;
+        int m_status = 0;
+        std::chrono::nanoseconds m_elapsed{};
+    };
+
+    /*
+     * Program of several layer groups run as separate processes. run() forks a process per
+     * group (the placement comes from the compiler, see ast::ProcessPlacement), and groups
+     * exchange values through shared memory rings or Unix sockets created before the fork.
+     * Within a process layers may use Pipeline or FusedLayers as usual, but the process
+     * should only start its threads inside the body, since fork copies the calling thread only.
+     * When a process exits its outputs are closed and its inputs abandoned, even if it died,
+     * so its neighbours don't wait forever. A failed process stops the others and run() throws.
+     */
+    class ProcessPipeline{
+    public:
+        ProcessPipeline() = default;
+
+        ProcessPipeline(ProcessPipeline const&) = delete;
+        ProcessPipeline& operator=(ProcessPipeline const&) = delete;
+
+        LayerProcess& process(std::string name, LayerProcess::Body body){
+            m_processes.push_back(std::unique_ptr<LayerProcess>(new LayerProcess(std::move(name), std::move(body))));
+            return *m_processes.back();
+        }
+
+        template<typename T>
+        ShmRing<T>& ring(LayerProcess& from, LayerProcess& to, size_t capacity = 1024){
+            return add(std::make_unique<RingLink<T>>(from, to, capacity)).ring();
+        }
+
+        template<typename T>
+        SocketChannel<T>& socket(LayerProcess& from, LayerProcess& to, size_t batch = 1 << 16){
+            return add(std::make_unique<SocketChannel<T>>(from, to, batch));
+        }
+
+        void run(){
+            // Buffered output would be written by every child again
+            std::cout.flush();
+            std::cerr.flush();
+            std::fflush(nullptr);
+
+            auto start = std::chrono::steady_clock::now();
+            for(auto& process: m_processes){
+                process->m_pid = ::fork();
+                process->m_running = process->m_pid > 0;
+                if(process->m_pid < 0){
+                    auto error = errno;
+                    stop();
+                    throw std::system_error(error, std::generic_category(), "can't start process " + process->m_name);
+                }
+                if(process->m_pid == 0)
+                    child(*process);
+            }
+
+            // Parent keeps no socket ends, so a dying process is seen by its neighbours
+            for(auto& link: m_links)
+                link->detach();
+
+            std::string failure;
+            for(size_t running = m_processes.size(); running > 0;){
+                int status;
+                auto pid = ::waitpid(-1, &status, 0);
+                if(pid < 0){
+                    if(errno == EINTR)
+                        continue;
+                    throw std::system_error(errno, std::generic_category(), "waiting for layer processes");
+                }
+
+                for(auto& process: m_processes){
+                    if(process->m_pid != pid)
+                        continue;
+                    --running;
+                    process->m_running = false;
+                    process->m_status = status;
+                    process->m_elapsed = std::chrono::steady_clock::now() - start;
+                    finished(*process);
+
+                    if(failure.empty() && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)){
+                        failure = "process " + process->m_name + (WIFSIGNALED(status)
+                                ? " was killed by signal " + std::to_string(WTERMSIG(status))
+                                : " failed with exit status " + std::to_string(WEXITSTATUS(status)));
+                        stop();
+                    }
+                }
+            }
+
+            if(!failure.empty())
+                throw std::runtime_error(failure);
+        }
+
+        [[nodiscard]] std::vector<std::unique_ptr<LayerProcess>> const& processes() const{
+            return m_processes;
+        }
+
+        void report(std::ostream& stream) const{
+            auto flags = stream.flags();
+            auto precision = stream.precision();
+            stream << std::fixed << std::setprecision(1);
+            for(auto& process: m_processes)
+                stream << "process " << std::quoted(process->name()) << ": pid " << process->pid() << ", "
+                       << std::chrono::duration<double, std::milli>(process->elapsed()).count() << " ms\n";
+            for(auto& link: m_links)
+                stream << "channel " << std::quoted(link->from().name()) << " -> " << std::quoted(link->to().name())
+                       << ": " << link->transport() << "\n";
+            stream.flags(flags);
+            stream.precision(precision);
+        }
+
+    private:
+        template<typename L>
+        L& add(std::unique_ptr<L> link){
+            auto& result = *link;
+            link->m_from.m_outputs.push_back(link.get());
+            link->m_to.m_inputs.push_back(link.get());
+            m_links.push_back(std::move(link));
+            return result;
+        }
+
+        [[noreturn]] void child(LayerProcess& process){
+            auto status = 0;
+            try{
+                for(auto& link: m_links)
+                    link->attach(process);
+                process.m_body();
+                finished(process);
+            } catch (std::exception& e) {
+                std::cerr << "process " << process.m_name << ": " << e.what() << std::endl;
+                status = 1;
+            } catch (...) {
+                std::cerr << "process " << process.m_name << ": unknown exception" << std::endl;
+                status = 1;
+            }
+            std::cout.flush();
+            std::fflush(nullptr);
+            // Destructors and exit handlers of the parent's state must not run in the copy
+            ::_exit(status);
+        }
+
+        void finished(LayerProcess& process){
+            for(auto* link: process.m_outputs)
+                link->close();
+            for(auto* link: process.m_inputs)
+                link->abandon();
+        }
+
+        void stop(){
+            for(auto& process: m_processes)
+                if(process->m_running)
+                    ::kill(process->m_pid, SIGTERM);
+        }
+
+        std::vector<std::unique_ptr<LayerProcess>> m_processes;
+        std::vector<std::unique_ptr<ProcessLink>> m_links;
+    };
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "bounded_queue.h"
+
+namespace parasl::runtime{
+
+    /*
+     * Memory shared between processes: an anonymous file (memfd) mapped into this process.
+     * Child processes forked afterwards share the mapping, other processes attach() to the
+     * descriptor passed over a Unix socket (see SocketChannel).
+     */
+    class SharedMemory{
+    public:
+        SharedMemory() = default;
+
+        explicit SharedMemory(size_t size, char const* name = "parasl"){
+            auto fd = ::memfd_create(name, MFD_CLOEXEC);
+            if(fd < 0)
+                throw std::system_error(errno, std::generic_category(), "can't create shared memory");
+            if(::ftruncate(fd, static_cast<off_t>(size)) < 0){
+                auto error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "can't allocate shared memory");
+            }
+            map(fd, size);
+        }
+
+        // Takes ownership of descriptor
+        static SharedMemory attach(int fd){
+            struct stat info{};
+            if(::fstat(fd, &info) < 0){
+                auto error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "can't attach shared memory");
+            }
+            SharedMemory memory;
+            memory.map(fd, static_cast<size_t>(info.st_size));
+            return memory;
+        }
+
+        SharedMemory(SharedMemory&& other) noexcept:
+                m_fd(std::exchange(other.m_fd, -1)), m_data(std::exchange(other.m_data, nullptr)),
+                m_size(std::exchange(other.m_size, 0)){}
+
+        SharedMemory& operator=(SharedMemory&& other) noexcept{
+            std::swap(m_fd, other.m_fd);
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            return *this;
+        }
+
+        ~SharedMemory(){
+            if(m_data)
+                ::munmap(m_data, m_size);
+            if(m_fd >= 0)
+                ::close(m_fd);
+        }
+
+        [[nodiscard]] void* data() const{
+            return m_data;
+        }
+
+        [[nodiscard]] size_t size() const{
+            return m_size;
+        }
+
+        [[nodiscard]] int fd() const{
+            return m_fd;
+        }
+
+    private:
+        void map(int fd, size_t size){
+            m_fd = fd;
+            m_size = size;
+            if(!size)
+                return;
+            auto* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(data == MAP_FAILED)
+                throw std::system_error(errno, std::generic_category(), "can't map shared memory");
+            m_data = data;
+        }
+
+        int m_fd = -1;
+        void* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    // Array in its own shared memory, handed to another process by descriptor without copying
+    template<typename E>
+    class SharedArray{
+        static_assert(std::is_trivially_copyable_v<E>);
+    public:
+        SharedArray() = default;
+
+        explicit SharedArray(size_t count): m_memory(std::max<size_t>(count, 1) * sizeof(E)), m_count(count){}
+
+        // Takes ownership of descriptor
+        static SharedArray attach(int fd, size_t count){
+            SharedArray array;
+            array.m_memory = SharedMemory::attach(fd);
+            if(array.m_memory.size() < count * sizeof(E))
+                throw std::length_error("shared array of " + std::to_string(count) + " elements is truncated");
+            array.m_count = count;
+            return array;
+        }
+
+        [[nodiscard]] E* data() const{
+            return static_cast<E*>(m_memory.data());
+        }
+
+        [[nodiscard]] size_t size() const{
+            return m_count;
+        }
+
+        E& operator[](size_t idx) const{
+            return data()[idx];
+        }
+
+        [[nodiscard]] int fd() const{
+            return m_memory.fd();
+        }
+
+    private:
+        SharedMemory m_memory;
+        size_t m_count = 0;
+    };
+
+    // Sleeps on a counter in shared memory: std::atomic::wait uses private futexes, which don't wake other processes
+    struct ProcessFutex{
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free);
+
+        static void wait(std::atomic<uint32_t>& word, uint32_t seen){
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, nullptr, nullptr, 0);
+        }
+
+        static void wake(std::atomic<uint32_t>& word){
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        }
+    };
+
+    /*
+     * Bounded queue between a producer and a consumer process in shared memory. Same protocol
+     * as SpscQueue: monotonic counters on separate cache lines of the shared control block and
+     * a private copy of the other side's counter in each process. Values are trivially copyable
+     * and can be built in place: reserve() gives the next free slot, commit() publishes it,
+     * front()/release() read it in place, so a large array crosses processes without a copy.
+     * close() ends the values for the consumer, abandon() tells the producer nobody reads them.
+     * A waiting side spins shortly, then sleeps on a futex in the control block.
+     * Has to be created before the processes are forked.
+     */
+    template<typename T>
+    class ShmRing{
+        static_assert(std::is_trivially_copyable_v<T>);
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters have to be address-free");
+
+        struct Control{
+            alignas(64) std::atomic<uint64_t> head = 0;
+            alignas(64) std::atomic<uint64_t> tail = 0;
+            alignas(64) std::atomic<bool> closed = false;
+            std::atomic<bool> abandoned = false;
+            // Consumer sleeps on readable, producer on writable
+            alignas(64) WaitPoint<ProcessFutex> readable;
+            WaitPoint<ProcessFutex> writable;
+        };
+
+    public:
+        explicit ShmRing(size_t capacity = 1024):
+                m_capacity(std::bit_ceil(std::max<size_t>(capacity, 2))), m_mask(m_capacity - 1),
+                m_memory(slotsOffset() + m_capacity * sizeof(T), "parasl-ring"){
+            new(m_memory.data()) Control;
+        }
+
+        ShmRing(ShmRing const&) = delete;
+        ShmRing& operator=(ShmRing const&) = delete;
+
+        [[nodiscard]] size_t capacity() const{
+            return m_capacity;
+        }
+
+        // Producer: next free slot or nullptr while the ring is full
+        T* tryReserve(){
+            auto head = control().head.load(std::memory_order_relaxed);
+            if(head - m_cached_tail == m_capacity){
+                m_cached_tail = control().tail.load(std::memory_order_acquire);
+                if(head - m_cached_tail == m_capacity)
+                    return nullptr;
+            }
+            return slot(head);
+        }
+
+        // Waits while the ring is full, nullptr once the consumer abandoned it
+        T* reserve(){
+            T* value = nullptr;
+            control().writable.waitFor([&]{ return (value = tryReserve()) || abandoned(); });
+            return value;
+        }
+
+        // Publishes the reserved slot
+        void commit(){
+            control().head.store(control().head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            control().readable.notify();
+        }
+
+        // False if the consumer is gone and value was dropped
+        bool push(T const& value){
+            auto* target = reserve();
+            if(!target)
+                return false;
+            *target = value;
+            commit();
+            return true;
+        }
+
+        // Consumer: next value in place or nullptr while the ring is empty
+        T const* tryFront(){
+            auto tail = control().tail.load(std::memory_order_relaxed);
+            if(tail == m_cached_head){
+                m_cached_head = control().head.load(std::memory_order_acquire);
+                if(tail == m_cached_head)
+                    return nullptr;
+            }
+            return slot(tail);
+        }
+
+        // Waits for the next value, nullptr once the ring is closed and drained
+        T const* front(){
+            T const* value = nullptr;
+            control().readable.waitFor([&]{ return (value = tryFront()) || closed(); });
+            return value ? value : tryFront();
+        }
+
+        // Frees the slot returned by front()
+        void release(){
+            control().tail.store(control().tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            control().writable.notify();
+        }
+
+        bool pop(T& value){
+            auto* source = front();
+            if(!source)
+                return false;
+            value = *source;
+            release();
+            return true;
+        }
+
+        void close(){
+            control().closed.store(true, std::memory_order_release);
+            control().readable.notify();
+        }
+
+        void abandon(){
+            control().abandoned.store(true, std::memory_order_release);
+            control().writable.notify();
+        }
+
+        [[nodiscard]] bool closed() const{
+            return control().closed.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] bool abandoned() const{
+            return control().abandoned.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr size_t slotsOffset(){
+            return (sizeof(Control) + alignof(T) - 1) / alignof(T) * alignof(T);
+        }
+
+        [[nodiscard]] Control& control() const{
+            return *std::launder(static_cast<Control*>(m_memory.data()));
+        }
+
+        [[nodiscard]] T* slot(uint64_t pos) const{
+            return reinterpret_cast<T*>(static_cast<char*>(m_memory.data()) + slotsOffset()) + (pos & m_mask);
+        }
+
+        size_t m_capacity;
+        size_t m_mask;
+        SharedMemory m_memory;
+        // Each process keeps its own copy of the other side's counter
+        uint64_t m_cached_tail = 0;
+        uint64_t m_cached_head = 0;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace parasl::runtime{
+
+    /*
+     * Layers fused onto one thread by the compile-time dataflow schedule (ast::DataflowSchedule).
+     * Every layer fires once per period in schedule order, so a value one layer defines is
+     * consumed by the following ones in the same period straight from its variable: there is
+     * no queue and nothing to synchronize. A firing returns false when its layer has no more
+     * values, which ends the period and the run. Fused layers are a body of one Pipeline layer
+     * when the schedule has several stages; buffers between stages are Pipeline links with
+     * the number of slots the schedule computed.
+     */
+    class FusedLayers{
+    public:
+        using Firing = std::function<bool()>;
+
+        // Layers are added in schedule order
+        FusedLayers& add(unsigned level, std::string name, Firing firing){
+            if(!m_layers.empty() && m_layers.back().level >= level)
+                throw std::invalid_argument("layer " + std::to_string(level) + " is scheduled after layer " +
+                                            std::to_string(m_layers.back().level));
+            m_layers.push_back({level, std::move(name), std::move(firing)});
+            return *this;
+        }
+
+        [[nodiscard]] size_t size() const{
+            return m_layers.size();
+        }
+
+        // Fires one period, false if a layer ran out of values
+        bool fire(){
+            for(auto& layer: m_layers)
+                if(!layer.firing())
+                    return false;
+            return true;
+        }
+
+        // Fires periods until a layer runs out of values, returns the number of complete ones
+        uint64_t run(){
+            uint64_t periods = 0;
+            while(fire())
+                ++periods;
+            return periods;
+        }
+
+    private:
+        struct Layer{
+            unsigned level;
+            std::string name;
+            Firing firing;
+        };
+
+        std::vector<Layer> m_layers;
+    };
+}
@@ -0,0 +1,191 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Program state of one replica, nobody else touches it
+    struct Counter{
+        size_t index = 0;
+        uint64_t records = 0;
+    };
+
+    using Runner = BatchRunner<int, Counter>;
+
+    Runner::Source numbers(int count){
+        return [count, next = 0](int& record) mutable {
+            if(next == count)
+                return false;
+            record = next++;
+            return true;
+        };
+    }
+
+    std::vector<std::string> lines(std::string const& text){
+        std::vector<std::string> result;
+        std::istringstream stream(text);
+        for(std::string line; std::getline(stream, line);)
+            result.push_back(line);
+        return result;
+    }
+
+    // Records of many chunks come out in input order, each replica made once for its thread
+    void ordered(){
+        constexpr int count = 50'000;
+        constexpr size_t replicas = 4;
+        OutputFile file;
+        std::atomic<uint64_t> made = 0, run = 0;
+        uint64_t records;
+        {
+            OutputChannels channels;
+            channels.connect(1, file.fd(), "file");
+            Runner runner(channels[1], output_order_t::ORDERED, replicas, 16, 4);
+            records = runner.run(numbers(count), [&](size_t idx){
+                made |= uint64_t{1} << idx;
+                return Counter{idx};
+            }, [&](Counter& replica, int& record, OrderedOutput::Writer& writer){
+                ++replica.records;
+                ++run;
+                writer.write(record * 2);
+            });
+        }
+
+        check(records == count && run == count, "batch lost records");
+        check(made == (uint64_t{1} << replicas) - 1, "replicas are made wrongly");
+        std::string expected;
+        for(int record = 0; record < count; ++record)
+            expected += std::to_string(record * 2) + "\n";
+        check(file.contents() == expected, "ordered batch output is out of order");
+    }
+
+    // Relaxed output has every record once, in any order, and records aren't interleaved
+    void relaxed(){
+        constexpr int count = 10'000;
+        OutputFile file;
+        {
+            OutputChannels channels;
+            channels.connect(1, file.fd(), "file");
+            Runner runner(channels[1], output_order_t::RELAXED, 3, 7, 2);
+            runner.run(numbers(count), [](size_t idx){ return Counter{idx}; },
+                       [](Counter&, int& record, OrderedOutput::Writer& writer){
+                           int pair[] = {record, -record};
+                           writer.write(pair, 2);
+                       });
+        }
+
+        auto output = lines(file.contents());
+        std::vector<std::string> expected;
+        for(int record = 0; record < count; ++record)
+            expected.push_back(std::to_string(record) + " " + std::to_string(-record));
+        std::sort(output.begin(), output.end());
+        std::sort(expected.begin(), expected.end());
+        check(output == expected, "relaxed batch output lost or mixed records");
+    }
+
+    void empty(){
+        OutputFile file;
+        uint64_t records;
+        {
+            OutputChannels channels;
+            channels.connect(1, file.fd(), "file");
+            Runner runner(channels[1]);
+            records = runner.run(numbers(0), [](size_t idx){ return Counter{idx}; },
+                                 [](Counter&, int& record, OrderedOutput::Writer& writer){ writer.write(record); });
+        }
+        check(records == 0 && file.contents().empty(), "empty batch has output");
+    }
+
+    // Error of a replica stops the endless source sleeping on the full queue and is rethrown
+    void failedReplica(){
+        OutputFile file;
+        std::atomic<int> fed = 0;
+        std::string message;
+        {
+            OutputChannels channels;
+            channels.connect(1, file.fd(), "file");
+            Runner runner(channels[1], output_order_t::ORDERED, 2, 4, 2);
+            try{
+                runner.run([&](int& record){
+                    record = fed++;
+                    return true;
+                }, [](size_t idx){ return Counter{idx}; }, [](Counter&, int& record, OrderedOutput::Writer& writer){
+                    if(record == 1000)
+                        throw std::runtime_error("record 1000 failed");
+                    writer.write(record);
+                });
+            } catch (std::runtime_error& error) {
+                message = error.what();
+            }
+        }
+        check(message == "record 1000 failed", "replica's error is reported as '" + message + "'");
+
+        // Output stops before the failed record, the ones preceding it are all there
+        auto output = lines(file.contents());
+        check(output.size() <= 1000, "records after the failed one are written");
+        for(size_t idx = 0; idx < output.size(); ++idx)
+            check(output[idx] == std::to_string(idx), "records before the failed one are lost");
+    }
+
+    void failedSource(){
+        OutputFile file;
+        auto rethrown = false;
+        OutputChannels channels;
+        channels.connect(1, file.fd(), "file");
+        Runner runner(channels[1], output_order_t::ORDERED, 2, 8, 4);
+        try{
+            runner.run([next = 0](int& record) mutable {
+                if(next == 500)
+                    throw std::runtime_error("input failed");
+                record = next++;
+                return true;
+            }, [](size_t idx){ return Counter{idx}; }, [](Counter&, int& record, OrderedOutput::Writer& writer){
+                writer.write(record);
+            });
+        } catch (std::runtime_error& error) {
+            rethrown = std::string(error.what()) == "input failed";
+        }
+        check(rethrown, "source's error isn't rethrown");
+    }
+
+    void failedFactory(){
+        OutputFile file;
+        auto rethrown = false;
+        OutputChannels channels;
+        channels.connect(1, file.fd(), "file");
+        Runner runner(channels[1], output_order_t::ORDERED, 3, 8, 4);
+        try{
+            runner.run(numbers(100'000), [](size_t idx){
+                if(idx == 2)
+                    throw std::runtime_error("replica failed");
+                return Counter{idx};
+            }, [](Counter&, int& record, OrderedOutput::Writer& writer){
+                writer.write(record);
+            });
+        } catch (std::runtime_error& error) {
+            rethrown = std::string(error.what()) == "replica failed";
+        }
+        check(rethrown, "factory's error isn't rethrown");
+    }
+}
+
+int main(){
+    return runTests({
+            {"ordered batch", ordered},
+            {"relaxed batch", relaxed},
+            {"empty batch", empty},
+            {"failed replica", failedReplica},
+            {"failed source", failedSource},
+            {"failed factory", failedFactory},
+    });
+}
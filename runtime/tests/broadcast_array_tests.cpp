@@ -0,0 +1,72 @@
+#include "broadcast_array.h"
+
+#include <cstdint>
+#include <string>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Reads see the broadcast value and allocate nothing
+    void lazy(){
+        BroadcastArray<int, 64> array(7, 1000);
+        check(array.size() == 1000 && array.isBroadcast(), "fresh array isn't a broadcast");
+        for(size_t idx = 0; idx < array.size(); ++idx)
+            check(array[idx] == 7, "broadcast array reads wrong value at " + std::to_string(idx));
+        check(array.isBroadcast() && array.materializedChunks() == 0 && array.touchedBytes() == 0,
+              "reads materialized the array");
+    }
+
+    // Write fills only its own chunk, the rest still reads the broadcast value
+    void writtenChunk(){
+        BroadcastArray<int, 64> array(7, 1000);
+        array.mutableAt(130) = 1;
+        check(!array.isBroadcast() && array.materializedChunks() == 1, "write materialized more than its chunk");
+        check(array.touchedBytes() == 64 * sizeof(int), "written chunk isn't counted");
+        for(size_t idx = 0; idx < array.size(); ++idx)
+            check(array[idx] == (idx == 130 ? 1 : 7), "array reads wrong value at " + std::to_string(idx));
+
+        array.mutableAt(131) = 2;
+        check(array.materializedChunks() == 1 && array[130] == 1 && array[131] == 2, "second write refilled the chunk");
+    }
+
+    // Last chunk is shorter than the others
+    void partialChunk(){
+        BroadcastArray<uint16_t, 64> array(3, 100);
+        array.mutableAt(99) = 4;
+        check(array.materializedChunks() == 1, "write to the last chunk materialized others");
+        check(array.touchedBytes() == 36 * sizeof(uint16_t), "last chunk is counted as a full one");
+        check(array[63] == 3 && array[64] == 3 && array[99] == 4, "last chunk has wrong values");
+    }
+
+    void wholeArray(){
+        BroadcastArray<uint64_t, 64> array(9, 200);
+        auto* data = array.mutableData();
+        check(array.materializedChunks() == 4 && array.touchedBytes() == 200 * sizeof(uint64_t),
+              "whole array isn't materialized");
+        uint64_t sum = 0;
+        for(size_t idx = 0; idx < array.size(); ++idx)
+            sum += data[idx];
+        check(sum == 9 * 200, "materialized array lost the broadcast value");
+    }
+
+    void moved(){
+        BroadcastArray<int, 64> source(5, 100);
+        source.mutableAt(0) = 1;
+        auto target = std::move(source);
+        check(target.size() == 100 && target[0] == 1 && target[99] == 5, "move lost the values");
+    }
+}
+
+int main(){
+    return runTests({
+            {"lazy broadcast", lazy},
+            {"written chunk", writtenChunk},
+            {"partial last chunk", partialChunk},
+            {"whole array", wholeArray},
+            {"moved array", moved},
+    });
+}
@@ -0,0 +1,186 @@
+#include "coroutine_pipeline.h"
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // One-slot channel: nearly every value is handed over to a suspended coroutine
+    void handoff(size_t threads){
+        constexpr uint64_t count = 100'000;
+        CoroutinePipeline pipeline;
+        CoroutineChannel<uint64_t>* channel = nullptr;
+        uint64_t expected = 0;
+        auto ordered = true;
+
+        auto& producer = pipeline.layer(0, "produce", [&](size_t) -> LayerTask {
+            for(uint64_t value = 0; value < count; ++value)
+                co_await channel->push(value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](size_t) -> LayerTask {
+            for(uint64_t value; co_await channel->pop(value); ++expected)
+                ordered &= value == expected;
+        });
+        channel = &pipeline.connect<uint64_t>(producer, consumer, 1);
+
+        pipeline.run(threads);
+        check(expected == count, "coroutine channel lost values");
+        check(ordered, "coroutine channel reordered values");
+        check(pipeline.suspensions() > 0, "full and empty channel didn't suspend coroutines");
+    }
+
+    // Replicas of both layers share the channel, every value is received once
+    void replicas(){
+        constexpr uint64_t perProducer = 20'000;
+        constexpr size_t producers = 3, consumers = 4;
+        CoroutinePipeline pipeline;
+        CoroutineChannel<uint64_t>* channel = nullptr;
+        std::atomic<uint64_t> sum = 0, received = 0;
+
+        auto& producer = pipeline.layer(0, "produce", [&](size_t idx) -> LayerTask {
+            for(uint64_t value = 0; value < perProducer; ++value)
+                co_await channel->push(idx * perProducer + value);
+        }, producers);
+        auto& consumer = pipeline.layer(1, "consume", [&](size_t) -> LayerTask {
+            for(uint64_t value; co_await channel->pop(value);){
+                sum += value;
+                ++received;
+            }
+        }, consumers);
+        channel = &pipeline.connect<uint64_t>(producer, consumer, 8);
+
+        pipeline.run(3);
+        check(received == producers * perProducer, "replicated layers lost values");
+        check(sum == sumTo(producers * perProducer), "replicated layers changed values");
+    }
+
+    // Many more layers than threads, each adding one to the value
+    void longChain(){
+        constexpr size_t stages = 200;
+        constexpr uint64_t count = 1'000;
+        CoroutinePipeline pipeline;
+        std::vector<CoroutineChannel<uint64_t>*> channels(stages - 1);
+        uint64_t sum = 0;
+
+        std::vector<CoroutineLayer*> layers;
+        layers.push_back(&pipeline.layer(0, "source", [&](size_t) -> LayerTask {
+            for(uint64_t value = 0; value < count; ++value)
+                co_await channels[0]->push(value);
+        }));
+        for(size_t idx = 1; idx + 1 < stages; ++idx)
+            layers.push_back(&pipeline.layer(static_cast<unsigned>(idx), "stage", [&, idx](size_t) -> LayerTask {
+                for(uint64_t value; co_await channels[idx - 1]->pop(value);)
+                    co_await channels[idx]->push(value + 1);
+            }));
+        layers.push_back(&pipeline.layer(stages - 1, "sink", [&](size_t) -> LayerTask {
+            for(uint64_t value; co_await channels[stages - 2]->pop(value);)
+                sum += value;
+        }));
+        for(size_t idx = 0; idx + 1 < stages; ++idx)
+            channels[idx] = &pipeline.connect<uint64_t>(*layers[idx], *layers[idx + 1], 4);
+
+        pipeline.run(2);
+        check(sum == sumTo(count) + count * (stages - 2), "long chain of layers lost values");
+    }
+
+    // Consumer which returns early: the producer's remaining pushes are dropped
+    void abandoned(){
+        CoroutinePipeline pipeline;
+        CoroutineChannel<int>* channel = nullptr;
+        auto finished = false;
+
+        auto& producer = pipeline.layer(0, "produce", [&](size_t) -> LayerTask {
+            for(int value = 0; value < 10'000; ++value)
+                co_await channel->push(value);
+            finished = true;
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](size_t) -> LayerTask {
+            int value;
+            co_await channel->pop(value);
+        });
+        channel = &pipeline.connect<int>(producer, consumer, 2);
+
+        pipeline.run(2);
+        check(finished, "producer of an abandoned channel didn't finish");
+    }
+
+    // Exception in one layer stops the others and is rethrown by run()
+    void failed(){
+        CoroutinePipeline pipeline;
+        CoroutineChannel<int>* channel = nullptr;
+
+        auto& producer = pipeline.layer(0, "produce", [&](size_t) -> LayerTask {
+            for(int value = 0;; ++value)
+                co_await channel->push(value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](size_t) -> LayerTask {
+            int value;
+            for(int idx = 0; idx < 1000; ++idx)
+                co_await channel->pop(value);
+            throw std::runtime_error("consumer failed");
+        });
+        channel = &pipeline.connect<int>(producer, consumer, 4);
+
+        auto rethrown = false;
+        try{
+            pipeline.run(2);
+        } catch (std::runtime_error& error) {
+            rethrown = std::string(error.what()) == "consumer failed";
+        }
+        check(rethrown, "failed layer's error isn't rethrown");
+    }
+
+    // Layers which wait on each other's channels are reported by name instead of hanging
+    void deadlocked(size_t threads){
+        CoroutinePipeline pipeline;
+        CoroutineChannel<int>* forward = nullptr;
+        CoroutineChannel<int>* backward = nullptr;
+
+        auto& first = pipeline.layer(0, "first", [&](size_t) -> LayerTask {
+            int value;
+            co_await backward->pop(value);
+            co_await forward->push(value);
+        });
+        auto& second = pipeline.layer(1, "second", [&](size_t) -> LayerTask {
+            int value;
+            co_await forward->pop(value);
+            co_await backward->push(value);
+        });
+        auto& idle = pipeline.layer(2, "idle", [&](size_t) -> LayerTask {
+            co_return;
+        });
+        forward = &pipeline.connect<int>(first, second);
+        backward = &pipeline.connect<int>(second, first);
+        (void)idle;
+
+        std::string message;
+        try{
+            pipeline.run(threads);
+        } catch (std::runtime_error& error) {
+            message = error.what();
+        }
+        check(message == "pipeline deadlocked, layers 0 \"first\", 1 \"second\" wait on their channels",
+              "deadlock is reported as '" + message + "'");
+    }
+}
+
+int main(){
+    return runTests({
+            {"handoff on one thread", []{ handoff(1); }},
+            {"handoff on four threads", []{ handoff(4); }},
+            {"replicated layers", replicas},
+            {"long chain of layers", longChain},
+            {"abandoned channel", abandoned},
+            {"failed layer", failed},
+            {"deadlock on one thread", []{ deadlocked(1); }},
+            {"deadlock on three threads", []{ deadlocked(3); }},
+    });
+}
@@ -0,0 +1,93 @@
+#include "cow_buffer.h"
+
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    void initialized(){
+        CowBuffer<int> zeroed(16), filled(16, 7);
+        check(zeroed.size() == 16 && filled.size() == 16, "buffer has a wrong size");
+        for(size_t idx = 0; idx < 16; ++idx)
+            check(zeroed[idx] == 0 && filled[idx] == 7, "buffer isn't initialized at " + std::to_string(idx));
+
+        CowBuffer<int> empty;
+        check(empty.size() == 0 && empty.unique() && !empty.data(), "default buffer isn't empty");
+    }
+
+    // Copy shares the storage until one of them is written, then only the written one changes
+    void copyOnWrite(){
+        CowBuffer<int> original(8, 1);
+        auto copy = original;
+        check(copy.data() == original.data() && !copy.unique() && !original.unique(), "copy doesn't share storage");
+
+        copy.mutableAt(3) = 5;
+        check(copy.data() != original.data(), "write to shared buffer didn't detach it");
+        check(copy.unique() && original.unique(), "detached buffers are still shared");
+        check(original[3] == 1 && copy[3] == 5 && copy[2] == 1, "detached copy has wrong values");
+    }
+
+    // Write through the only handle, e.g. after the other owner is gone, doesn't copy
+    void uniqueWrite(){
+        CowBuffer<int> buffer(8, 1);
+        auto const* storage = buffer.data();
+        {
+            auto copy = buffer;
+            check(!buffer.unique(), "copy doesn't share storage");
+        }
+        check(buffer.unique(), "buffer is shared after its copy is gone");
+        buffer.mutableAt(0) = 2;
+        check(buffer.data() == storage && buffer[0] == 2, "write through unique buffer copied it");
+    }
+
+    void moved(){
+        CowBuffer<int> source(8, 3);
+        auto const* storage = source.data();
+        auto target = std::move(source);
+        check(target.data() == storage && target.unique(), "move copied the buffer");
+        check(!source.data() && source.size() == 0, "moved-from buffer isn't empty");
+
+        CowBuffer<int> assigned;
+        assigned = std::move(target);
+        check(assigned.data() == storage && assigned[7] == 3, "move assignment lost the storage");
+    }
+
+    // Copies are handed to other threads and detached there, the original never changes
+    void sharedBetweenThreads(){
+        CowBuffer<uint64_t> original(1024, 1);
+        std::vector<std::thread> threads;
+        std::vector<uint64_t> sums(4);
+        for(size_t idx = 0; idx < sums.size(); ++idx)
+            threads.emplace_back([copy = original, &sum = sums[idx], idx]() mutable{
+                for(size_t elt = 0; elt < copy.size(); ++elt)
+                    copy.mutableAt(elt) += idx;
+                for(size_t elt = 0; elt < copy.size(); ++elt)
+                    sum += copy[elt];
+            });
+        for(auto& thread: threads)
+            thread.join();
+
+        check(original.unique(), "copies weren't released");
+        for(size_t idx = 0; idx < sums.size(); ++idx)
+            check(sums[idx] == 1024 * (idx + 1), "thread saw another thread's writes");
+        for(size_t elt = 0; elt < original.size(); ++elt)
+            check(original[elt] == 1, "original changed through a copy");
+    }
+}
+
+int main(){
+    return runTests({
+            {"initialized buffer", initialized},
+            {"copy on write", copyOnWrite},
+            {"write through unique buffer", uniqueWrite},
+            {"moved buffer", moved},
+            {"buffer shared between threads", sharedBetweenThreads},
+    });
+}
@@ -0,0 +1,201 @@
+#include "input_channel.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Text read back through a pipe written by another thread, as data piped into the program
+    void fromPipe(std::string const& text, std::function<void(InputChannel&)> const& read){
+        int fds[2];
+        check(::pipe(fds) == 0, "can't create a pipe");
+        std::thread writer([&]{
+            for(size_t done = 0; done < text.size();){
+                auto bytes = ::write(fds[1], text.data() + done, text.size() - done);
+                if(bytes <= 0)
+                    break;
+                done += static_cast<size_t>(bytes);
+            }
+            ::close(fds[1]);
+        });
+
+        try{
+            // Smallest buffer, so that long inputs are refilled many times
+            InputChannel channel(fds[0], "pipe", 0);
+            read(channel);
+        } catch (...) {
+            ::close(fds[0]);
+            writer.join();
+            throw;
+        }
+        ::close(fds[0]);
+        writer.join();
+    }
+
+    // Text read back from a regular file, which is mapped into memory
+    void fromFile(std::string const& text, std::function<void(InputChannel&)> const& read){
+        auto fd = ::memfd_create("input", 0);
+        check(fd >= 0, "can't create a file");
+        check(::write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()), "can't write a file");
+
+        try{
+            InputChannel channel(fd, "file");
+            read(channel);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    template<typename T>
+    T readOne(std::string const& text, bool file){
+        T value{};
+        (file ? fromFile : fromPipe)(text, [&](InputChannel& channel){
+            value = channel.read<T>();
+            check(channel.eof(), "value '" + text + "' isn't read whole");
+        });
+        return value;
+    }
+
+    template<typename T>
+    bool outOfRange(std::string const& text, bool file){
+        try{
+            readOne<T>(text, file);
+        } catch (std::out_of_range&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Every length of 8-digit steps and the digit-by-digit tail, followed by spaces or by the end of input
+    void integerLengths(bool file){
+        std::string digits = "1234567890123456789";
+        for(size_t length = 1; length <= digits.size(); ++length){
+            auto number = digits.substr(0, length);
+            auto expected = std::stoll(number);
+            for(auto* suffix: {"", " ", "\n7"}){
+                auto text = number + suffix;
+                int64_t value = 0;
+                (file ? fromFile : fromPipe)(text, [&](InputChannel& channel){
+                    value = channel.read<int64_t>();
+                });
+                check(value == expected, "'" + text + "' is read as " + std::to_string(value));
+            }
+            check(readOne<int64_t>("-" + number, file) == -expected, "negative " + number + " is misread");
+            check(readOne<int64_t>("+" + number, file) == expected, "+" + number + " is misread");
+        }
+    }
+
+    // 19 digits are accumulated in 64 bits, 20 and more go to std::from_chars
+    void digitBoundary(bool file){
+        check(readOne<int64_t>("9223372036854775807", file) == INT64_MAX, "int64 max is misread");
+        check(readOne<int64_t>("-9223372036854775808", file) == INT64_MIN, "int64 min is misread");
+        check(outOfRange<int64_t>("9223372036854775808", file), "int64 max + 1 isn't out of range");
+        check(outOfRange<int64_t>("-9223372036854775809", file), "int64 min - 1 isn't out of range");
+        check(outOfRange<int64_t>("9999999999999999999", file), "largest 19 digits fit into int64");
+
+        check(readOne<uint64_t>("9999999999999999999", file) == 9999999999999999999ull, "largest 19 digits are misread");
+        check(readOne<uint64_t>("18446744073709551615", file) == UINT64_MAX, "uint64 max is misread");
+        check(outOfRange<uint64_t>("18446744073709551616", file), "uint64 max + 1 isn't out of range");
+        check(outOfRange<uint64_t>("99999999999999999999", file), "largest 20 digits fit into uint64");
+        check(readOne<int64_t>("00000000000000000000042", file) == 42, "leading zeros beyond 19 digits are misread");
+
+        check(outOfRange<int32_t>("2147483648", file), "int32 max + 1 isn't out of range");
+        check(readOne<int32_t>("-2147483648", file) == INT32_MIN, "int32 min is misread");
+        check(outOfRange<uint32_t>("-1", file), "negative value fits into unsigned");
+        check(readOne<Int<12>>("-2048", file) == Int<12>::min(), "int(12) min is misread");
+        check(outOfRange<Int<12>>("2048", file), "int(12) max + 1 isn't out of range");
+    }
+
+    // Many values of every length split at arbitrary refill boundaries of a small buffer
+    void manyValues(bool file){
+        constexpr int count = 20'000;
+        std::vector<int64_t> values;
+        std::string text;
+        for(int64_t idx = 0, value = 1; idx < count; ++idx, value = value < 100'000'000'000'000'000 ? value * 7 + 3 : idx){
+            values.push_back(idx % 3 ? value : -value);
+            text += std::to_string(values.back()) + (idx % 2 ? "  " : "\n");
+        }
+        text += "2.5 -0.125\n";
+
+        (file ? fromFile : fromPipe)(text, [&](InputChannel& channel){
+            for(auto value: values)
+                check(channel.read<int64_t>() == value, "value " + std::to_string(value) + " is misread");
+            check(channel.read<double>() == 2.5 && channel.read<float>() == -0.125f, "floating point values are misread");
+            check(channel.eof(), "input isn't over");
+        });
+    }
+
+    void malformed(bool file){
+        auto fails = [file](std::string const& text){
+            try{
+                readOne<int>(text, file);
+            } catch (std::runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        check(fails("abc"), "'abc' is read as integer");
+        check(fails("-"), "'-' is read as integer");
+        check(fails(" \n "), "empty input is read as integer");
+    }
+
+    // Value which has arrived through a pipe is returned before the next one is written
+    void pipeDoesNotWait(){
+        // Reader which waits for more input than has been written would hang, so it's killed instead
+        ::alarm(10);
+        int fds[2];
+        check(::pipe(fds) == 0, "can't create a pipe");
+        InputChannel channel(fds[0], "pipe");
+
+        check(::write(fds[1], "5\n", 2) == 2, "can't write a pipe");
+        check(channel.read<int>() == 5, "first value is misread");
+
+        // Value split between writes waits for its delimiter
+        check(::write(fds[1], "12", 2) == 2, "can't write a pipe");
+        std::thread writer([&]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            (void)::write(fds[1], "34 6", 4);
+        });
+        auto split = channel.read<int>();
+        writer.join();
+        check(split == 1234, "split value is read as " + std::to_string(split));
+
+        // Value at the end of input has no delimiter
+        ::close(fds[1]);
+        check(channel.read<int>() == 6 && channel.eof(), "last value is misread");
+        ::close(fds[0]);
+        ::alarm(0);
+    }
+}
+
+int main(){
+    // Writer of a pipe whose reader failed gets an error instead of the signal
+    ::signal(SIGPIPE, SIG_IGN);
+    return runTests({
+            {"integer lengths from pipe", []{ integerLengths(false); }},
+            {"integer lengths from file", []{ integerLengths(true); }},
+            {"19/20 digit boundary from pipe", []{ digitBoundary(false); }},
+            {"19/20 digit boundary from file", []{ digitBoundary(true); }},
+            {"many values from pipe", []{ manyValues(false); }},
+            {"many values from file", []{ manyValues(true); }},
+            {"malformed input from pipe", []{ malformed(false); }},
+            {"malformed input from file", []{ malformed(true); }},
+            {"pipe input doesn't wait for full buffer", pipeDoesNotWait},
+    });
+}
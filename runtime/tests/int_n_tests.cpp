@@ -0,0 +1,169 @@
+#include "int_n.h"
+#include "packed_int_array.h"
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Reference arithmetic in 128 bits, truncated to N bits and sign-extended afterwards
+    using Wide = __int128;
+
+    template<unsigned N>
+    Wide truncate(Wide value){
+        constexpr auto shift = 128 - N;
+        return static_cast<Wide>(static_cast<unsigned __int128>(value) << shift) >> shift;
+    }
+
+    template<unsigned N>
+    Wide toWide(Int<N> const& value){
+        if constexpr (N <= 64)
+            return value.value();
+        else
+            return static_cast<Wide>(static_cast<unsigned __int128>(value.value()[1]) << 64 | value.value()[0]);
+    }
+
+    template<unsigned N>
+    Int<N> fromWide(Wide value){
+        auto raw = static_cast<unsigned __int128>(value);
+        if constexpr (N <= 64)
+            return Int<N>::fromBits(static_cast<uint64_t>(raw));
+        else
+            return Int<N>::fromWords({static_cast<uint64_t>(raw), static_cast<uint64_t>(raw >> 64)});
+    }
+
+    // Bounds and their neighbours first, then random N-bit values
+    template<unsigned N>
+    std::vector<Wide> samples(){
+        auto min = toWide(Int<N>::min()), max = toWide(Int<N>::max());
+        std::vector<Wide> values{min, max};
+        for(Wide value: {0, 1, -1, 2, -2, 7})
+            values.push_back(truncate<N>(value));
+        values.push_back(truncate<N>(min + 1));
+        values.push_back(truncate<N>(max - 1));
+
+        std::mt19937_64 random(N);
+        for(auto idx = 0; idx < 40; ++idx)
+            values.push_back(truncate<N>(static_cast<Wide>(static_cast<unsigned __int128>(random()) << 64 | random())));
+        return values;
+    }
+
+    template<unsigned N>
+    void arithmetic(){
+        auto label = "int(" + std::to_string(N) + ") ";
+        auto top = static_cast<unsigned __int128>(1) << (N - 1);
+        check(toWide(Int<N>::min()) == truncate<N>(static_cast<Wide>(top)) &&
+              toWide(Int<N>::max()) == truncate<N>(static_cast<Wide>(top - 1)), label + "has wrong bounds");
+        check(toWide(Int<N>(-5)) == truncate<N>(-5), label + "doesn't sign-extend a literal");
+
+        auto values = samples<N>();
+        for(auto lhs: values)
+            for(auto rhs: values){
+                auto a = fromWide<N>(lhs), b = fromWide<N>(rhs);
+                check(toWide(a) == lhs && toWide(b) == rhs, label + "doesn't round-trip a value");
+
+                // Unsigned 128-bit arithmetic wraps, which N-bit arithmetic has to agree with
+                auto ua = static_cast<unsigned __int128>(lhs), ub = static_cast<unsigned __int128>(rhs);
+                check(toWide(a + b) == truncate<N>(static_cast<Wide>(ua + ub)), label + "sum is wrong");
+                check(toWide(a - b) == truncate<N>(static_cast<Wide>(ua - ub)), label + "difference is wrong");
+                check(toWide(a * b) == truncate<N>(static_cast<Wide>(ua * ub)), label + "product is wrong");
+                check(toWide(-a) == truncate<N>(static_cast<Wide>(0 - ua)), label + "negation is wrong");
+                check((a < b) == (lhs < rhs) && (a == b) == (lhs == rhs), label + "comparison is wrong");
+
+                if(!rhs){
+                    auto thrown = false;
+                    try{
+                        (void)(a / b);
+                    } catch (std::domain_error&) {
+                        thrown = true;
+                    }
+                    check(thrown, label + "division by zero didn't throw");
+                    continue;
+                }
+                // min / -1 wraps to min
+                auto quotient = rhs == -1 ? static_cast<Wide>(0 - ua) : lhs / rhs;
+                check(toWide(a / b) == truncate<N>(quotient), label + "quotient is wrong");
+            }
+    }
+
+    template<unsigned N>
+    std::vector<typename Int<N>::storage_type> randomElements(size_t count, unsigned seed){
+        std::mt19937_64 random(seed);
+        std::vector<typename Int<N>::storage_type> values(count);
+        for(auto& value: values)
+            value = Int<N>::fromBits(random()).value();
+        return values;
+    }
+
+    // Elements set one by one read back unchanged, including those straddling words
+    template<unsigned N>
+    void packedRoundTrip(){
+        constexpr size_t size = 201;
+        auto label = "packed int(" + std::to_string(N) + ") ";
+        auto values = randomElements<N>(size, N);
+
+        PackedIntArray<N> array(size);
+        check(array.bytes() == (size * N + 63) / 64 * 8, label + "has a wrong storage size");
+        for(size_t idx = 0; idx < size; ++idx)
+            array.set(idx, values[idx]);
+        for(size_t idx = 0; idx < size; ++idx)
+            check(array[idx].value() == values[idx], label + "lost element " + std::to_string(idx));
+
+        // Overwriting one element leaves its neighbours alone
+        array.set(size / 2, Int<N>::min());
+        check(array[size / 2] == Int<N>::min() && array[size / 2 - 1].value() == values[size / 2 - 1] &&
+              array[size / 2 + 1].value() == values[size / 2 + 1], label + "set changed a neighbour");
+    }
+
+    // Bulk pack/unpack of unaligned ranges agree with element access
+    template<unsigned N>
+    void packedBulk(){
+        constexpr size_t size = 300, first = 5, count = 250;
+        auto label = "packed int(" + std::to_string(N) + ") ";
+        auto values = randomElements<N>(size, N + 1);
+
+        PackedIntArray<N> array(size);
+        for(size_t idx = 0; idx < size; ++idx)
+            array.set(idx, values[idx]);
+
+        auto input = randomElements<N>(count, N + 2);
+        array.pack(first, count, input.data());
+        for(size_t idx = 0; idx < size; ++idx){
+            auto inside = idx >= first && idx < first + count;
+            check(array[idx].value() == (inside ? input[idx - first] : values[idx]),
+                  label + "pack wrote a wrong element " + std::to_string(idx));
+        }
+
+        std::vector<typename Int<N>::storage_type> output(count);
+        array.unpack(first, count, output.data());
+        check(output == input, label + "unpack doesn't return packed elements");
+    }
+
+    template<unsigned... N>
+    void arithmeticOf(){
+        (arithmetic<N>(), ...);
+    }
+
+    template<unsigned... N>
+    void packedOf(){
+        (packedRoundTrip<N>(), ...);
+        (packedBulk<N>(), ...);
+    }
+}
+
+int main(){
+    return runTests({
+            {"narrow int(N) arithmetic", arithmeticOf<1, 3, 8, 13, 16, 31, 32>},
+            {"int(N) arithmetic up to 64 bits", arithmeticOf<33, 47, 63, 64>},
+            {"wide int(N) arithmetic", arithmeticOf<65, 100, 127, 128>},
+            {"packed arrays", packedOf<1, 3, 4, 8, 13, 16, 21, 32>},
+    });
+}
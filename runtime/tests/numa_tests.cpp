@@ -0,0 +1,187 @@
+#include "numa.h"
+#include "pipeline.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    void cpuLists(){
+        using cpus = std::vector<unsigned>;
+        check(NumaTopology::parseCpuList("0-3,8-11") == cpus{0, 1, 2, 3, 8, 9, 10, 11}, "ranges are misread");
+        check(NumaTopology::parseCpuList("5") == cpus{5}, "single CPU is misread");
+        check(NumaTopology::parseCpuList("0,2-2,4") == cpus{0, 2, 4}, "mixed list is misread");
+        check(NumaTopology::parseCpuList("").empty(), "empty list has CPUs");
+    }
+
+    void topology(){
+        NumaTopology machine({{0, 1}, {2, 3}});
+        check(machine.nodes() == 2 && machine.cpus(1) == std::vector<unsigned>{2, 3}, "topology lost its nodes");
+        check(machine.nodeOf(3) == 1 && machine.nodeOf(0) == 0 && !machine.nodeOf(7), "CPU is on a wrong node");
+
+        // No sysfs tree: one node with every CPU
+        NumaTopology single({});
+        check(single.nodes() == 1 && single.cpus(0).size() == std::max(1u, std::thread::hardware_concurrency()),
+              "machine without NUMA isn't a single node");
+
+        // Every CPU of this machine is on exactly one node
+        auto& system = NumaTopology::system();
+        check(system.nodes() >= 1, "system has no nodes");
+        std::set<unsigned> seen;
+        for(size_t node = 0; node < system.nodes(); ++node)
+            for(auto cpu: system.cpus(node))
+                check(seen.insert(cpu).second && system.nodeOf(cpu) == node, "CPU " + std::to_string(cpu) + " is on several nodes");
+    }
+
+    // Pinned thread runs on the CPUs of its node only, unless the system doesn't allow pinning
+    void pinned(){
+        auto& system = NumaTopology::system();
+        auto confined = true;
+        std::thread thread([&]{
+            if(!pinToNode(system, 0))
+                return;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            ::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set);
+            for(unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                if(CPU_ISSET(cpu, &set) && system.nodeOf(cpu) != 0)
+                    confined = false;
+        });
+        thread.join();
+        check(confined, "pinned thread may run on another node");
+    }
+
+    // Blocks are whole pages which can be written right away, and go back to the system
+    void nodeMemory(){
+        NumaMemoryResource memory(0), other(0);
+        check(memory.node() == 0 && memory.is_equal(memory) && !memory.is_equal(other), "resources compare wrongly");
+
+        auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        for(size_t bytes: {size_t{1}, size_t{100}, page, 3 * page + 1, size_t{1} << 22}){
+            auto* data = static_cast<char*>(memory.allocate(bytes, 64));
+            check(reinterpret_cast<uintptr_t>(data) % page == 0, "block isn't page aligned");
+            std::memset(data, 0x5a, bytes);
+            check(data[0] == 0x5a && data[bytes - 1] == 0x5a, "block isn't writable");
+            memory.deallocate(data, bytes, 64);
+        }
+
+        auto refused = false;
+        try{
+            (void)memory.allocate(64, 2 * page);
+        } catch (std::bad_alloc&) {
+            refused = true;
+        }
+        check(refused, "alignment above page size is accepted");
+
+        std::pmr::vector<uint64_t> values(&memory);
+        for(uint64_t value = 0; value < 100'000; ++value)
+            values.push_back(value);
+        check(values.size() == 100'000 && values.back() == 99'999, "vector on node memory lost values");
+
+        // Node which doesn't exist: binding fails quietly and pages follow first touch
+        NumaMemoryResource missing(1000);
+        auto* data = static_cast<uint64_t*>(missing.allocate(8 * page, 8));
+        data[page] = 1;
+        missing.deallocate(data, 8 * page, 8);
+    }
+
+    std::vector<std::optional<size_t>> placement(numa_policy_t policy){
+        NumaTopology machine({{0, 1}, {2, 3}});
+        Pipeline pipeline;
+        for(size_t threads: {1, 1, 2, 1, 1})
+            pipeline.layer(0, "layer", [](PipelineWorker&){}, threads);
+        pipeline.place(policy, machine);
+
+        std::vector<std::optional<size_t>> nodes;
+        for(auto& layer: pipeline.layers())
+            nodes.push_back(layer->node());
+        return nodes;
+    }
+
+    // Compact fills a node's CPUs with neighbouring layers, spread goes round robin
+    void placementPolicies(){
+        using nodes = std::vector<std::optional<size_t>>;
+        check(placement(numa_policy_t::COMPACT) == nodes{0, 0, 1, 0, 0}, "compact placement is wrong");
+        check(placement(numa_policy_t::SPREAD) == nodes{0, 1, 0, 1, 0}, "spread placement is wrong");
+        check(placement(numa_policy_t::NONE) == nodes(5), "layers are pinned without a policy");
+    }
+
+    // Pipeline placed on nodes runs as usual, its layers get node memory
+    void placedPipeline(){
+        constexpr uint64_t count = 100'000;
+        // Both nodes have CPU 0, which every machine has
+        NumaTopology machine({{0}, {0}});
+        Pipeline pipeline;
+        Link<uint64_t>* link = nullptr;
+        std::atomic<uint64_t> sum = 0;
+        std::atomic<bool> node_memory = true;
+
+        auto& producer = pipeline.layer(0, "produce", [&](PipelineWorker& worker){
+            node_memory = node_memory && worker.memory() != std::pmr::get_default_resource();
+            std::pmr::vector<uint64_t> values(count, worker.memory());
+            for(uint64_t value = 0; value < count; ++value)
+                values[value] = value;
+            for(auto value: values)
+                worker.push(*link, value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](PipelineWorker& worker){
+            node_memory = node_memory && worker.memory() != std::pmr::get_default_resource();
+            for(uint64_t value; worker.pop(*link, value);)
+                sum += value;
+        });
+        link = &pipeline.connect<uint64_t>(producer, consumer, 64);
+        pipeline.place(numa_policy_t::SPREAD, machine);
+        check(producer.node() == 0 && consumer.node() == 1, "layers are placed wrongly");
+
+        pipeline.run();
+        check(sum == sumTo(count), "placed pipeline lost values");
+        check(node_memory, "pinned layer got default memory");
+
+        // Node outside of the topology is refused before any thread starts
+        consumer.pin(2);
+        auto refused = false;
+        try{
+            pipeline.run();
+        } catch (std::invalid_argument&) {
+            refused = true;
+        }
+        check(refused, "layer pinned to a missing node is run");
+    }
+
+    void remoteRatio(){
+        NumaCounters before{100, 10, true}, after{160, 30, true};
+        check(after.remoteRatio(before) == 0.25, "remote ratio is wrong");
+        check(before.remoteRatio(before) == 0, "remote ratio without allocations isn't zero");
+        auto counters = NumaCounters::read();
+        check(counters.available || (counters.local == 0 && counters.remote == 0), "missing counters are counted");
+    }
+}
+
+int main(){
+    return runTests({
+            {"CPU lists", cpuLists},
+            {"topology", topology},
+            {"pinned thread", pinned},
+            {"node memory", nodeMemory},
+            {"placement policies", placementPolicies},
+            {"placed pipeline", placedPipeline},
+            {"remote ratio", remoteRatio},
+    });
+}
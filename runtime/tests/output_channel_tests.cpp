@@ -0,0 +1,156 @@
+#include "output_channel.h"
+
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Scalars on their own lines, arrays on one line separated by spaces
+    void textFormat(){
+        OutputFile file;
+        {
+            OutputChannels channels;
+            channels.connect(1, file.fd(), "file");
+            auto& channel = channels[1];
+            channel.write(42);
+            channel.write(-7ll);
+            channel.write(0.1);
+            channel.write(2.5f);
+            channel.write('x');
+            channel.write(Int<12>(-2048));
+            int values[] = {1, -2, 3};
+            channel.write(values, 3);
+            double fractions[] = {0.5};
+            channel.write(fractions, 1);
+        }
+        auto expected = "42\n-7\n0.1\n2.5\nx\n-2048\n1 -2 3\n0.5\n";
+        check(file.contents() == expected, "text output is '" + file.contents() + "'");
+    }
+
+    // Values back to back in native representation
+    void binaryFormat(){
+        OutputFile file;
+        {
+            OutputChannels channels(output_format_t::BINARY);
+            channels.connect(1, file.fd(), "file");
+            auto& channel = channels[1];
+            channel.write(int32_t{-3});
+            channel.write(Int<16>(1000));
+            int64_t values[] = {5, -6};
+            channel.write(values, 2);
+        }
+
+        auto text = file.contents();
+        check(text.size() == 4 + 2 + 16, "binary output has " + std::to_string(text.size()) + " bytes");
+        int32_t scalar;
+        int16_t narrow;
+        int64_t array[2];
+        std::memcpy(&scalar, text.data(), 4);
+        std::memcpy(&narrow, text.data() + 4, 2);
+        std::memcpy(array, text.data() + 6, 16);
+        check(scalar == -3 && narrow == 1000 && array[0] == 5 && array[1] == -6, "binary output has wrong values");
+    }
+
+    // Output many times larger than the ring: the program waits for the writer, nothing is lost
+    void smallRing(){
+        constexpr int count = 100'000;
+        int fds[2];
+        check(::pipe(fds) == 0, "can't create a pipe");
+
+        std::string text;
+        std::thread reader([&]{
+            char buffer[4096];
+            for(ssize_t size; (size = ::read(fds[0], buffer, sizeof(buffer))) > 0;)
+                text.append(buffer, static_cast<size_t>(size));
+        });
+
+        {
+            OutputChannels channels(output_format_t::TEXT, 64);
+            channels.connect(1, fds[1], "pipe", true);
+            for(int value = 0; value < count; ++value)
+                channels[1].write(value);
+        }
+        reader.join();
+        ::close(fds[0]);
+
+        std::string expected;
+        for(int value = 0; value < count; ++value)
+            expected += std::to_string(value) + "\n";
+        check(text == expected, "output through a small ring is corrupted");
+    }
+
+    // flush() returns once everything written has reached the file
+    void flushed(){
+        OutputFile file;
+        OutputChannels channels;
+        channels.connect(1, file.fd(), "file");
+        channels[1].write(1);
+        channels[1].flush();
+        check(file.contents() == "1\n", "flushed output hasn't reached the file");
+
+        // Reconnected channel flushes the replaced one first
+        OutputFile other;
+        channels[1].write(2);
+        channels.connect(1, other.fd(), "other");
+        channels[1].write(3);
+        channels.flush();
+        check(file.contents() == "1\n2\n" && other.contents() == "3\n", "reconnected channel lost output");
+    }
+
+    // Failed write is reported to the program instead of blocking it
+    void writeError(){
+        int fds[2];
+        check(::pipe(fds) == 0, "can't create a pipe");
+        ::close(fds[0]);
+
+        OutputChannels channels;
+        channels.connect(1, fds[1], "pipe", true);
+        auto reported = false;
+        try{
+            for(int idx = 0; idx < 1000; ++idx){
+                channels[1].write(idx);
+                channels[1].flush();
+            }
+        } catch (std::system_error& error) {
+            reported = error.code().value() == EPIPE;
+        }
+        check(reported, "write to a closed pipe isn't reported");
+    }
+
+    void notConnected(){
+        OutputChannels channels;
+        auto thrown = false;
+        try{
+            channels[3];
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "unconnected channel is available");
+    }
+}
+
+int main(){
+    // Write to a closed pipe fails with EPIPE instead of the signal
+    ::signal(SIGPIPE, SIG_IGN);
+    return runTests({
+            {"text format", textFormat},
+            {"binary format", binaryFormat},
+            {"small ring", smallRing},
+            {"flush", flushed},
+            {"write error", writeError},
+            {"not connected channel", notConnected},
+    });
+}
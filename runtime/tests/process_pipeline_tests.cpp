@@ -0,0 +1,245 @@
+#include "process_pipeline.h"
+#include "shared_memory.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Runs body in a child process, which exits with the status body returns; a hung child is killed
+    pid_t forked(std::function<int()> const& body){
+        auto pid = ::fork();
+        check(pid >= 0, "can't fork");
+        if(pid == 0){
+            ::alarm(10);
+            auto status = 1;
+            try{
+                status = body();
+            } catch (...) {}
+            ::_exit(status);
+        }
+        return pid;
+    }
+
+    bool exitedCleanly(pid_t pid){
+        int status;
+        while(::waitpid(pid, &status, 0) < 0)
+            check(errno == EINTR, "can't wait for the child");
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // Child writes into memory created before the fork, an attached copy of the descriptor maps the same pages
+    void sharedArray(){
+        SharedArray<uint64_t> array(1000);
+        auto child = forked([&]{
+            for(size_t idx = 0; idx < array.size(); ++idx)
+                array[idx] = idx * idx;
+            return 0;
+        });
+        check(exitedCleanly(child), "child failed");
+
+        auto attached = SharedArray<uint64_t>::attach(::dup(array.fd()), array.size());
+        for(size_t idx = 0; idx < array.size(); ++idx)
+            check(array[idx] == idx * idx && attached[idx] == idx * idx, "shared array lost element " + std::to_string(idx));
+
+        auto truncated = false;
+        try{
+            SharedArray<uint64_t>::attach(::dup(array.fd()), array.size() + 1);
+        } catch (std::length_error&) {
+            truncated = true;
+        }
+        check(truncated, "attach of a truncated array succeeded");
+    }
+
+    // Values come in order from the producer process and end with close()
+    void ringAcrossFork(){
+        constexpr uint64_t count = 1'000'000;
+        ShmRing<uint64_t> ring(64);
+        auto producer = forked([&]{
+            for(uint64_t value = 0; value < count; ++value)
+                if(!ring.push(value))
+                    return 1;
+            ring.close();
+            return 0;
+        });
+
+        uint64_t expected = 0;
+        for(uint64_t value; ring.pop(value); ++expected)
+            check(value == expected, "ring reordered value " + std::to_string(expected));
+        check(exitedCleanly(producer), "producer process failed");
+        check(expected == count, "ring lost values");
+    }
+
+    // Large values are built and read in place in the slots
+    void ringInPlace(){
+        struct Block{
+            uint64_t values[512];
+        };
+        constexpr uint64_t count = 2'000;
+        ShmRing<Block> ring(4);
+        auto producer = forked([&]{
+            for(uint64_t idx = 0; idx < count; ++idx){
+                auto* block = ring.reserve();
+                if(!block)
+                    return 1;
+                for(uint64_t k = 0; k < 512; ++k)
+                    block->values[k] = idx + k;
+                ring.commit();
+            }
+            ring.close();
+            return 0;
+        });
+
+        uint64_t received = 0;
+        for(Block const* block; (block = ring.front()); ring.release(), ++received)
+            for(uint64_t k = 0; k < 512; ++k)
+                check(block->values[k] == received + k, "block " + std::to_string(received) + " is corrupted");
+        check(exitedCleanly(producer), "producer process failed");
+        check(received == count, "ring lost blocks");
+    }
+
+    // Consumer sleeping on an empty ring wakes up when another process closes it
+    void ringClosedWhileWaiting(){
+        ShmRing<int> ring(4);
+        auto consumer = forked([&]{
+            int value;
+            if(!ring.pop(value) || value != 7)
+                return 1;
+            return ring.pop(value) ? 1 : 0;
+        });
+
+        ring.push(7);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ring.close();
+        check(exitedCleanly(consumer), "consumer didn't see the closed ring");
+    }
+
+    // Producer sleeping on a full ring wakes up when another process abandons it, and doesn't push more
+    void ringAbandonedWhileWaiting(){
+        ShmRing<int> ring(4);
+        auto producer = forked([&]{
+            int pushed = 0;
+            while(ring.push(pushed))
+                ++pushed;
+            return pushed == 4 ? 0 : 1;
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ring.abandon();
+        check(exitedCleanly(producer), "producer didn't see the abandoned ring");
+    }
+
+    // Source -> ring -> square -> socket -> sink, the result comes back through shared memory
+    void pipelineOfProcesses(){
+        constexpr uint64_t count = 100'000;
+        SharedArray<uint64_t> result(1);
+        ProcessPipeline pipeline;
+        ShmRing<uint64_t>* ring = nullptr;
+        SocketChannel<uint64_t>* socket = nullptr;
+
+        auto& source = pipeline.process("source", [&]{
+            for(uint64_t value = 0; value < count; ++value)
+                ring->push(value);
+        });
+        auto& square = pipeline.process("square", [&]{
+            for(uint64_t value; ring->pop(value);)
+                socket->push(value * value);
+        });
+        auto& sink = pipeline.process("sink", [&]{
+            uint64_t sum = 0;
+            for(uint64_t value; socket->pop(value);)
+                sum += value;
+            result[0] = sum;
+        });
+        ring = &pipeline.ring<uint64_t>(source, square, 64);
+        socket = &pipeline.socket<uint64_t>(square, sink, 1024);
+
+        pipeline.run();
+        check(result[0] == (count - 1) * count * (2 * count - 1) / 6, "process pipeline lost values");
+        for(auto& process: pipeline.processes())
+            check(process->pid() > 0, "process " + process->name() + " wasn't started");
+    }
+
+    // Arrays cross the socket as descriptors of their memory
+    void arraysOverSocket(){
+        constexpr size_t arrays = 20, size = 10'000;
+        SharedArray<uint64_t> result(1);
+        ProcessPipeline pipeline;
+        SocketChannel<SharedArray<int>>* socket = nullptr;
+
+        auto& producer = pipeline.process("produce", [&]{
+            for(size_t idx = 0; idx < arrays; ++idx){
+                SharedArray<int> array(size);
+                for(size_t k = 0; k < size; ++k)
+                    array[k] = static_cast<int>(idx + k);
+                socket->push(array);
+            }
+        });
+        auto& consumer = pipeline.process("consume", [&]{
+            uint64_t matching = 0;
+            for(SharedArray<int> array; socket->pop(array); ++matching)
+                for(size_t k = 0; k < size; ++k)
+                    if(array.size() != size || array[k] != static_cast<int>(matching + k))
+                        return;
+            result[0] = matching;
+        });
+        socket = &pipeline.socket<SharedArray<int>>(producer, consumer);
+
+        pipeline.run();
+        check(result[0] == arrays, "arrays sent over socket are lost or corrupted");
+    }
+
+    // Process which fails or dies releases its neighbours, run() reports it
+    void failedProcess(bool killed){
+        ProcessPipeline pipeline;
+        ShmRing<int>* ring = nullptr;
+
+        auto& producer = pipeline.process("produce", [&]{
+            for(int value = 0; ring->push(value); ++value);
+        });
+        auto& consumer = pipeline.process("consume", [&]{
+            int value;
+            ring->pop(value);
+            if(killed)
+                ::raise(SIGKILL);
+            throw std::runtime_error("consumer failed");
+        });
+        ring = &pipeline.ring<int>(producer, consumer, 4);
+
+        std::string message;
+        try{
+            pipeline.run();
+        } catch (std::runtime_error& error) {
+            message = error.what();
+        }
+        auto expected = killed ? "process consume was killed by signal 9" : "process consume failed with exit status 1";
+        check(message == expected, "failed process is reported as '" + message + "'");
+    }
+}
+
+int main(){
+    return runTests({
+            {"shared array", sharedArray},
+            {"ring across fork", ringAcrossFork},
+            {"ring values in place", ringInPlace},
+            {"ring closed while consumer waits", ringClosedWhileWaiting},
+            {"ring abandoned while producer waits", ringAbandonedWhileWaiting},
+            {"pipeline of processes", pipelineOfProcesses},
+            {"arrays over socket", arraysOverSocket},
+            {"failed process", []{ failedProcess(false); }},
+            {"killed process", []{ failedProcess(true); }},
+    });
+}
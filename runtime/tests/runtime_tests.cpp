@@ -0,0 +1,234 @@
+// Every runtime header is included, so all of them are compiled with the warnings of the build
+#include "batch_runner.h"
+#include "bounded_queue.h"
+#include "broadcast_array.h"
+#include "coroutine_pipeline.h"
+#include "cow_buffer.h"
+#include "input_channel.h"
+#include "int_n.h"
+#include "numa.h"
+#include "ordered_output.h"
+#include "output_channel.h"
+#include "packed_int_array.h"
+#include "pipeline.h"
+#include "process_pipeline.h"
+#include "shared_memory.h"
+#include "static_schedule.h"
+
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl::runtime;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    void spscQueue(){
+        constexpr uint64_t count = 1'000'000;
+        SpscQueue<uint64_t> queue(64);
+
+        std::thread producer([&]{
+            for(uint64_t value = 0; value < count; ++value)
+                queue.push(value);
+            queue.close();
+        });
+
+        // Values come in order and none is lost after close()
+        uint64_t expected = 0, value = 0;
+        while(queue.pop(value)){
+            check(value == expected, "SPSC queue reordered value " + std::to_string(expected));
+            ++expected;
+        }
+        producer.join();
+        check(expected == count, "SPSC queue lost values");
+        check(!queue.tryPop(value), "SPSC queue isn't empty after close");
+    }
+
+    void mpmcQueue(){
+        constexpr uint64_t perProducer = 200'000;
+        constexpr size_t producers = 4, consumers = 4;
+        MpmcQueue<uint64_t> queue(64);
+
+        std::vector<std::thread> threads;
+        for(size_t idx = 0; idx < producers; ++idx)
+            threads.emplace_back([&, idx]{
+                for(uint64_t value = 0; value < perProducer; ++value)
+                    queue.push(idx * perProducer + value);
+            });
+
+        std::vector<uint64_t> sums(consumers), counts(consumers);
+        std::vector<std::thread> readers;
+        for(size_t idx = 0; idx < consumers; ++idx)
+            readers.emplace_back([&, idx]{
+                for(uint64_t value; queue.pop(value);){
+                    sums[idx] += value;
+                    ++counts[idx];
+                }
+            });
+
+        for(auto& thread: threads)
+            thread.join();
+        queue.close();
+        for(auto& thread: readers)
+            thread.join();
+
+        auto total = producers * perProducer;
+        check(std::accumulate(counts.begin(), counts.end(), uint64_t(0)) == total, "MPMC queue lost values");
+        check(std::accumulate(sums.begin(), sums.end(), uint64_t(0)) == sumTo(total), "MPMC queue changed values");
+    }
+
+    // Producer sleeping on a full queue returns once its stop condition is set and the queue is woken
+    template<typename Queue>
+    void stoppedPush(){
+        Queue queue(2);
+        std::atomic<bool> stop = false;
+        std::atomic<int> pushed = 0;
+
+        std::thread producer([&]{
+            for(int value = 0; queue.push(value, [&]{ return stop.load(); }); ++value)
+                ++pushed;
+        });
+        while(pushed < 2)
+            std::this_thread::yield();
+        stop = true;
+        queue.wake();
+        producer.join();
+
+        check(pushed == 2, "stopped push added a value to the full queue");
+        int value;
+        check(queue.tryPop(value) && value == 0 && queue.tryPop(value) && value == 1, "stopped push lost values");
+    }
+
+    // Producer layer of one thread feeding a consumer layer of several, so the link is MPMC
+    void pipelineRuns(size_t consumers){
+        constexpr uint64_t count = 100'000;
+        Pipeline pipeline;
+        Link<uint64_t>* link = nullptr;
+        std::atomic<uint64_t> sum = 0, received = 0;
+
+        auto& producer = pipeline.layer(0, "produce", [&](PipelineWorker& worker){
+            for(uint64_t value = 0; value < count; ++value)
+                worker.push(*link, value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](PipelineWorker& worker){
+            for(uint64_t value; worker.pop(*link, value);){
+                sum += value;
+                ++received;
+            }
+        }, consumers);
+        link = &pipeline.connect<uint64_t>(producer, consumer, 16);
+        check(link->isSpsc() == (consumers == 1), "pipeline picked a wrong queue");
+
+        pipeline.run();
+        check(received == count && sum == sumTo(count), "pipeline lost values");
+        check(producer.itemsOut() == count && consumer.itemsIn() == count, "pipeline miscounted values");
+    }
+
+    // Consumer which returns early: the producer drops the rest instead of waiting forever
+    void pipelineAbandoned(){
+        Pipeline pipeline;
+        Link<int>* link = nullptr;
+
+        auto& producer = pipeline.layer(0, "produce", [&](PipelineWorker& worker){
+            for(int value = 0; value < 100'000; ++value)
+                worker.push(*link, value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](PipelineWorker& worker){
+            int value;
+            check(worker.pop(*link, value) && value == 0, "pipeline lost the first value");
+        });
+        link = &pipeline.connect<int>(producer, consumer, 4);
+
+        pipeline.run();
+        check(consumer.itemsIn() == 1, "abandoned pipeline miscounted values");
+    }
+
+    // Exception in one layer unwinds the others out of their waits and is rethrown by run()
+    void pipelineCancelled(){
+        Pipeline pipeline;
+        Link<int>* link = nullptr;
+
+        auto& producer = pipeline.layer(0, "produce", [&](PipelineWorker& worker){
+            for(int value = 0;; ++value)
+                worker.push(*link, value);
+        });
+        auto& consumer = pipeline.layer(1, "consume", [&](PipelineWorker& worker){
+            int value;
+            for(int idx = 0; idx < 1000; ++idx)
+                worker.pop(*link, value);
+            throw std::runtime_error("consumer failed");
+        }, 2);
+        link = &pipeline.connect<int>(producer, consumer, 4);
+
+        auto rethrown = false;
+        try{
+            pipeline.run();
+        } catch (std::runtime_error& error) {
+            rethrown = std::string(error.what()) == "consumer failed";
+        }
+        check(rethrown, "cancelled pipeline didn't rethrow the error");
+    }
+
+    // Records of several threads read back from a pipe in sequence number order
+    void orderedOutput(){
+        constexpr int count = 20'000, threads = 4;
+        int fds[2];
+        check(::pipe(fds) == 0, "can't create a pipe");
+
+        std::string text;
+        std::thread reader([&]{
+            char buffer[4096];
+            for(ssize_t size; (size = ::read(fds[0], buffer, sizeof(buffer))) > 0;)
+                text.append(buffer, static_cast<size_t>(size));
+        });
+
+        {
+            // Small rings make writers wait for each other and for the reader
+            OutputChannels channels(output_format_t::TEXT, 256);
+            channels.connect(1, fds[1], "pipe", true);
+            OrderedOutput output(channels[1], output_order_t::ORDERED, threads, 0, 64);
+
+            std::vector<std::thread> workers;
+            for(int idx = 0; idx < threads; ++idx)
+                workers.emplace_back([&, idx]{
+                    auto writer = output.writer();
+                    for(int value = idx; value < count; value += threads){
+                        writer.begin(static_cast<uint64_t>(value));
+                        writer.write(value);
+                        writer.commit();
+                    }
+                });
+            for(auto& worker: workers)
+                worker.join();
+            output.finish();
+        }
+        reader.join();
+        ::close(fds[0]);
+
+        std::string expected;
+        for(int value = 0; value < count; ++value)
+            expected += std::to_string(value) + "\n";
+        check(text == expected, "ordered output is out of order");
+    }
+}
+
+int main(){
+    return runTests({
+            {"SPSC queue", spscQueue},
+            {"MPMC queue", mpmcQueue},
+            {"stopped SPSC push", stoppedPush<SpscQueue<int>>},
+            {"stopped MPMC push", stoppedPush<MpmcQueue<int>>},
+            {"SPSC pipeline", []{ pipelineRuns(1); }},
+            {"MPMC pipeline", []{ pipelineRuns(3); }},
+            {"abandoned pipeline", pipelineAbandoned},
+            {"cancelled pipeline", pipelineCancelled},
+            {"ordered output", orderedOutput},
+    });
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace parasl::runtime::testing{
+
+    inline void check(bool condition, std::string const& what){
+        if(!condition)
+            throw std::runtime_error(what);
+    }
+
+    // Sum of 0..count-1
+    inline uint64_t sumTo(uint64_t count){
+        return count * (count - 1) / 2;
+    }
+
+    // Anonymous file which output is written to and read back from
+    class OutputFile{
+    public:
+        OutputFile(): m_fd(::memfd_create("output", 0)){
+            check(m_fd >= 0, "can't create a file");
+        }
+
+        OutputFile(OutputFile const&) = delete;
+        OutputFile& operator=(OutputFile const&) = delete;
+
+        ~OutputFile(){
+            ::close(m_fd);
+        }
+
+        [[nodiscard]] int fd() const{
+            return m_fd;
+        }
+
+        [[nodiscard]] std::string contents() const{
+            std::string text;
+            char buffer[4096];
+            for(ssize_t size; (size = ::pread(m_fd, buffer, sizeof(buffer), static_cast<off_t>(text.size()))) > 0;)
+                text.append(buffer, static_cast<size_t>(size));
+            return text;
+        }
+
+    private:
+        int m_fd;
+    };
+
+    struct Test{
+        char const* name;
+        std::function<void()> run;
+    };
+
+    // Runs every test and prints its result, exit status of the test program
+    inline int runTests(std::initializer_list<Test> tests){
+        auto failed = 0;
+        for(auto& test: tests){
+            try{
+                test.run();
+                std::cout << test.name << ": ok" << std::endl;
+            } catch (std::exception& error) {
+                std::cout << test.name << ": FAILED, " << error.what() << std::endl;
+                ++failed;
+            }
+        }
+        return failed ? 1 : 0;
+    }
+}
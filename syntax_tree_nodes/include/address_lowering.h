@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "ast_visitor.h"
+#include "data_layout.h"
+#include "soa_layout.h"
+
+namespace parasl::ast{
+
+    // Address of element is address of base variable + offset + sum of index * stride
+    struct LinearAddress{
+        expressions::Identifier const* base;
+        size_t offset;
+        std::vector<std::pair<expressions::Expression const*, size_t>> terms;
+        // Element width for accesses into bit-packed arrays, offset and strides are in bits then
+        size_t bits = 0;
+    };
+
+    /*
+     * Lowers chains of subscripts and member accesses (m[i][j], arr[i].p.x) to a single
+     * address computation over contiguous storage. Multi-dimensional arrays are row-major,
+     * every subscript contributes index * (stride of its dimension in the array layout), constant indices
+     * and member offsets are folded. Arrays chosen by SoaLayoutAnalysis use its field addressing,
+     * subscripts of bit-packed arrays produce bit addresses.
+     */
+    class AddressLowering: public depth_first_visitor<AddressLowering>{
+    public:
+        explicit AddressLowering(DataLayout& data_layout, SoaLayoutAnalysis const* soa_layout = nullptr):
+                m_data_layout(data_layout), m_soa_layout(soa_layout) {}
+
+        void PreAction(basic_syntax_nodes::SyntaxNode const* node);
+
+        void PostAction(basic_syntax_nodes::SyntaxNode const*) {}
+
+        std::optional<LinearAddress> linearize(expressions::Expression const* access);
+
+        // Lowered address of outermost access in chain, nullptr if it can't be linearized
+        LinearAddress const* getAddress(expressions::Expression const* access) const;
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        size_t m_accesses = 0;
+        size_t m_multi_dimensional = 0;
+        size_t m_bit_addressed = 0;
+        DataLayout& m_data_layout;
+        SoaLayoutAnalysis const* m_soa_layout;
+        std::map<expressions::Expression const*, LinearAddress> m_addresses;
+    };
+}
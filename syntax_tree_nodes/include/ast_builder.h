@@ -4,13 +4,23 @@
 #include <string_view>
 #include <map>
 #include <optional>
+#include <set>
 
 namespace types{
     class Type;
 }
 
+namespace expressions{
+    class Expression;
+}
+
+namespace statements{
+    class CompoundStatement;
+}
+
 #include "syntax_node.h"
 #include "types.h"
+#include "data_layout.h"
 
 namespace parasl::ast{
 
@@ -50,6 +60,7 @@ namespace parasl::ast{
 
         void pushScope() {
             m_table.template emplace_back();
+            m_peak_depth = std::max(m_peak_depth, m_table.size());
         }
         void popScope() {
             m_table.pop_back();
@@ -62,9 +73,19 @@ namespace parasl::ast{
             pushScope();
         }
 
+        std::map<Key, T> const& outermost() const{
+            return m_table.front();
+        }
+
+        // Most scopes open at once since the table was made
+        size_t peakDepth() const{
+            return m_peak_depth;
+        }
+
     private:
 
         std::vector<std::map<Key, T>> m_table;
+        size_t m_peak_depth = 0;
     };
 
     class Context{
@@ -89,6 +110,24 @@ namespace parasl::ast{
         // type cast
         types::Type const* typeOfOperatorExpression(types::Type const* lhs, types::Type const* rhs, operator_t op);
 
+        // memory representation of types
+        DataLayout& dataLayout(){
+            return m_data_layout;
+        }
+
+        DataLayout const& dataLayout() const{
+            return m_data_layout;
+        }
+
+        // Types made so far by kind; float, double and char always exist
+        struct TypeCounts{
+            size_t integral, array, vector, structure, function;
+        };
+        TypeCounts typeCounts() const{
+            return {m_integral_types.size(), m_array_types.size(), m_vector_types.size(),
+                    m_structure_types.size(), m_function_types.size()};
+        }
+
         void clear();
 
 
@@ -100,6 +139,7 @@ namespace parasl::ast{
         std::map<std::pair<types::Type const*, unsigned>, TypeRef> m_vector_types;
         std::multimap<unsigned long long, TypeRef> m_structure_types;
         std::multimap<std::pair<unsigned long long, types::Type const*>, TypeRef> m_function_types;
+        DataLayout m_data_layout;
 
     protected:
         SymbolTable<std::string, basic_syntax_nodes::SyntaxNode*> m_symbol_table;
@@ -128,6 +168,9 @@ namespace parasl::ast{
         Node createForHeader(std::string var, Node const& range);
         Node createForLoop(Node const& header, Node const& body);
         Node createWhileLoop(Node const& condition, Node const& body);
+        Node createOutputStatement(unsigned channel, Node const& expr);
+        Node createLayer(unsigned level, std::string name, Node const& body);
+        Node createLayers(std::vector<Node>&& layers);
 
         void pushScope() {
             m_symbol_table.pushScope();
@@ -136,6 +179,52 @@ namespace parasl::ast{
             m_symbol_table.popScope();
         }
 
+        // Top-level symbols, for reusing checked parts of a program without checking them again
+        std::map<std::string, basic_syntax_nodes::SyntaxNode*> const& globalSymbols() const{
+            return m_symbol_table.outermost();
+        }
+        void restoreGlobalSymbol(std::string const& name, basic_syntax_nodes::SyntaxNode* decl){
+            m_symbol_table.registerSymbol(name, std::move(decl));
+        }
+        void resetSymbols(){
+            m_symbol_table.flush();
+        }
+        size_t scopePeakDepth() const{
+            return m_symbol_table.peakDepth();
+        }
+
+        // Declarations of an imported module: the tree refers to them but doesn't contain them.
+        // Importing the same module again does nothing
+        void importModule(std::string const& module, basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> declarations);
+        bool isImported(basic_syntax_nodes::SyntaxNode const* decl) const{
+            return m_imported.contains(decl);
+        }
+        bool hasImports() const{
+            return !m_imports.empty();
+        }
+
+        // Predicates made by if-conversion are numbered through the program
+        unsigned predicateCounter() const{
+            return m_predicate_counter;
+        }
+        void setPredicateCounter(unsigned counter){
+            m_predicate_counter = counter;
+        }
+
+        // Max number of statements in both arms of 'if' which is still turned into selects, 0 disables
+        void setIfConversionLimit(unsigned limit) {
+            m_if_conversion_limit = limit;
+        }
+
+    private:
+        Node convertIfStatement(basic_syntax_nodes::Ref<expressions::Expression>& condition,
+                                basic_syntax_nodes::Ref<statements::CompoundStatement>& then_clause,
+                                basic_syntax_nodes::Ref<statements::CompoundStatement>& else_clause);
+
+        unsigned m_if_conversion_limit = 4;
+        unsigned m_predicate_counter = 0;
+        std::map<std::string, basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode>> m_imports;
+        std::set<basic_syntax_nodes::SyntaxNode const*> m_imported;
 
     };
 
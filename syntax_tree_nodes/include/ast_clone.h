@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+
+#include "expressions.h"
+#include "statements.h"
+
+namespace parasl::ast{
+
+    /*
+     * Deep copy of AST subtrees. Declarations inside the copied subtree get new
+     * identifiers and references to them are redirected, references to outer
+     * variables are kept. Substituted variables are replaced by copies of given expression.
+     */
+    class Cloner{
+    public:
+        void substitute(expressions::Identifier const* var, expressions::Expression const* value){
+            m_substitutions[var] = value;
+        }
+
+        basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> clone(basic_syntax_nodes::SyntaxNode const* node);
+
+        template<typename T>
+        basic_syntax_nodes::Ref<T> cloneAs(T const* node){
+            return basic_syntax_nodes::Ref<T>(dynamic_cast<T*>(clone(node).release()));
+        }
+
+    private:
+        basic_syntax_nodes::Ref<expressions::Expression> expression(expressions::Expression const* expr);
+
+        basic_syntax_nodes::Ref<statements::Statement> statement(statements::Statement const* stmt);
+
+        std::vector<basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode>> children(basic_syntax_nodes::SyntaxNode const* node);
+
+        std::map<expressions::Identifier const*, expressions::Identifier const*> m_identifiers;
+        std::map<expressions::Identifier const*, expressions::Expression const*> m_substitutions;
+    };
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ast_builder.h"
+#include "expressions.h"
+#include "statements.h"
+
+namespace parasl::ast{
+
+    /*
+     * Binary image of a checked AST with its types, meant to be mapped and read in place.
+     *     header | strings | types | type members | nodes
+     * Sections are arrays of 4-byte aligned records of 32-bit little-endian words; a record
+     * refers to another by its offset from the start of its section (strings, nodes) or by
+     * index (types), none is noneRef. Strings are interned: every name is stored once as
+     * length, bytes and a terminating zero. Nodes go in preorder, a node record is followed
+     * by the offsets of its children. The header records the data layout flags the program
+     * was checked with, member offsets in the tree depend on them.
+     */
+    namespace image{
+        constexpr char magic[8] = {'P', 'S', 'L', 'A', 'S', 'T', '\r', '\n'};
+        // Bumped on every change of the records below
+        constexpr uint32_t version = 1;
+        constexpr uint32_t noneRef = ~0u;
+
+        enum layout_flags_t : uint32_t {REORDER_FIELDS = 1, PACK_INTS = 2};
+
+        struct Header{
+            char magic[8];
+            uint32_t version;
+            uint32_t layout_flags;
+            uint32_t size;
+            uint32_t strings, strings_size;
+            uint32_t types, type_count;
+            uint32_t members, member_count;
+            uint32_t nodes, nodes_size, node_count;
+            uint32_t root;
+        };
+
+        // VAR: a = bit length. ARRAY, VECTOR: a = element type, b = size.
+        // STRUCT: a = field count, c = first member. FUNC: a = argument count, b = result type, c = first member
+        struct TypeRecord{
+            uint8_t entity;
+            uint8_t prim;
+            uint16_t reserved;
+            uint32_t a, b, c;
+        };
+
+        struct MemberRecord{
+            uint32_t name;
+            uint32_t type;
+        };
+
+        enum node_flags_t : uint8_t {UNARY = 1, POSTFIX = 2, HAS_OFFSET = 4, ARRAY_RANGE = 8};
+
+        // Payload by node kind:
+        //   literal: op = alternative of the value, a = value or string
+        //   identifier: a = name; reference: a = identifier node; input: a = number
+        //   member access: a = member name, b = field index, c = byte offset if HAS_OFFSET
+        //   repeat: a = times; indexed range: a, b, c = begin, end, step
+        //   output: a = channel; layer: a = level, b = name; operator: op = operator
+        struct NodeRecord{
+            uint8_t syntax;
+            uint8_t category;
+            uint8_t op;
+            uint8_t flags;
+            uint32_t type;
+            uint32_t a, b, c;
+            uint32_t child_count;
+        };
+    }
+
+    class AstImage;
+
+    class TypeView{
+    public:
+        TypeView(AstImage const* image, image::TypeRecord const* record): m_image(image), m_record(record) {}
+
+        [[nodiscard]] entity_type_t entity() const{
+            return static_cast<entity_type_t>(m_record->entity);
+        }
+
+        [[nodiscard]] prim_type_t primType() const{
+            return static_cast<prim_type_t>(m_record->prim);
+        }
+
+        [[nodiscard]] size_t bitLength() const{
+            return m_record->a;
+        }
+
+        // Array and vector types
+        [[nodiscard]] TypeView element() const;
+        [[nodiscard]] size_t size() const{
+            return m_record->b;
+        }
+
+        // Fields of structures, arguments of functions
+        [[nodiscard]] size_t memberCount() const{
+            return m_record->a;
+        }
+        [[nodiscard]] std::string_view memberName(size_t idx) const;
+        [[nodiscard]] TypeView memberType(size_t idx) const;
+
+        [[nodiscard]] TypeView result() const;
+
+        // Position in the type table, unique per type
+        [[nodiscard]] uint32_t index() const;
+
+        explicit operator bool() const{
+            return m_record;
+        }
+
+    private:
+        AstImage const* m_image;
+        image::TypeRecord const* m_record;
+    };
+
+    // Node of a mapped image; a null view stands for an empty child slot
+    class NodeView{
+    public:
+        NodeView(AstImage const* image, image::NodeRecord const* record): m_image(image), m_record(record) {}
+
+        [[nodiscard]] syntax_node_t syntax() const{
+            return static_cast<syntax_node_t>(m_record->syntax);
+        }
+
+        [[nodiscard]] expr_type_t exprCategory() const{
+            return static_cast<expr_type_t>(m_record->category);
+        }
+
+        [[nodiscard]] stmt_type_t stmtType() const{
+            return static_cast<stmt_type_t>(m_record->category);
+        }
+
+        [[nodiscard]] operator_t op() const{
+            return static_cast<operator_t>(m_record->op);
+        }
+
+        [[nodiscard]] bool is(image::node_flags_t flag) const{
+            return m_record->flags & flag;
+        }
+
+        // Untyped expressions and statements give a null view
+        [[nodiscard]] TypeView type() const;
+
+        [[nodiscard]] size_t childCount() const{
+            return m_record->child_count;
+        }
+        [[nodiscard]] NodeView child(size_t idx) const;
+
+        // Name of identifier, member or layer, string literal
+        [[nodiscard]] std::string_view name() const;
+
+        // Declared identifier of a reference
+        [[nodiscard]] NodeView target() const;
+
+        // Raw payload words, see image::NodeRecord
+        [[nodiscard]] uint32_t a() const{
+            return m_record->a;
+        }
+        [[nodiscard]] uint32_t b() const{
+            return m_record->b;
+        }
+        [[nodiscard]] uint32_t c() const{
+            return m_record->c;
+        }
+
+        // Position in the node section, unique per node
+        [[nodiscard]] uint32_t offset() const;
+
+        explicit operator bool() const{
+            return m_record;
+        }
+
+    private:
+        AstImage const* m_image;
+        image::NodeRecord const* m_record;
+    };
+
+    /*
+     * Image produced by AstImageWriter, either mapped from a file or borrowed from memory.
+     * Loading only checks the header and section bounds; records are read when visited, and
+     * offsets are checked as they are followed, so a corrupt image throws std::runtime_error
+     * instead of reading outside of it.
+     */
+    class AstImage{
+    public:
+        // Borrows data, which has to be 4-byte aligned and outlive the image
+        explicit AstImage(std::string_view data);
+
+        // Maps the file read-only; throws std::system_error if it can't be read
+        static AstImage map(std::string const& path);
+
+        AstImage(AstImage&& another) noexcept;
+        AstImage& operator=(AstImage&&) = delete;
+        AstImage(AstImage const&) = delete;
+        ~AstImage();
+
+        [[nodiscard]] image::Header const& header() const{
+            return *m_header;
+        }
+
+        [[nodiscard]] bool fieldReordering() const{
+            return m_header->layout_flags & image::REORDER_FIELDS;
+        }
+
+        [[nodiscard]] bool bitPacking() const{
+            return m_header->layout_flags & image::PACK_INTS;
+        }
+
+        [[nodiscard]] NodeView root() const{
+            return node(m_header->root);
+        }
+
+        [[nodiscard]] NodeView node(uint32_t offset) const;
+        [[nodiscard]] TypeView type(uint32_t index) const;
+        [[nodiscard]] image::MemberRecord const& member(uint32_t index) const;
+        [[nodiscard]] std::string_view string(uint32_t offset) const;
+
+        /*
+         * Builds the tree for analyses and transformations which need AST objects. Types are
+         * made by context, which has to use the data layout of the image.
+         */
+        [[nodiscard]] basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> materialize(Context& context) const;
+
+    private:
+        friend class NodeView;
+        friend class TypeView;
+
+        [[noreturn]] static void corrupt(std::string const& what);
+
+        char const* m_data;
+        size_t m_size;
+        image::Header const* m_header;
+        // Non-null for mapped files
+        void* m_mapping = nullptr;
+    };
+
+    class AstImageWriter{
+    public:
+        explicit AstImageWriter(DataLayout const& data_layout): m_data_layout(data_layout) {}
+
+        // Image of the tree; throws std::length_error past 4 GiB
+        std::string write(basic_syntax_nodes::SyntaxNode const* root);
+
+    private:
+        uint32_t node(basic_syntax_nodes::SyntaxNode const* node);
+        uint32_t type(types::Type const* type);
+        uint32_t string(std::string_view text);
+
+        DataLayout const& m_data_layout;
+        std::string m_strings;
+        std::unordered_map<std::string, uint32_t> m_string_offsets;
+        std::vector<image::TypeRecord> m_types;
+        std::vector<image::MemberRecord> m_members;
+        std::map<types::Type const*, uint32_t> m_type_indices;
+        std::vector<uint32_t> m_nodes;
+        uint32_t m_node_count = 0;
+        std::map<expressions::Identifier const*, uint32_t> m_identifiers;
+        // Reference payload slots waiting for their identifier
+        std::vector<std::pair<size_t, expressions::Identifier const*>> m_fixups;
+    };
+}
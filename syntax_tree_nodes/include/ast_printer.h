@@ -1,11 +1,14 @@
 #pragma once
 
+#include <iostream>
+
 #include "ast_visitor.h"
 
 namespace parasl::ast{
 
     class Printer: public depth_first_visitor<Printer>, public ast_visitor<Printer>{
     public:
+        explicit Printer(std::ostream& stream = std::cout): m_stream(stream){}
 
         void operator()(basic_syntax_nodes::SyntaxNode const* node);
 
@@ -25,6 +28,10 @@ namespace parasl::ast{
 
         void operator()(expressions::ArrayRange const* node);
 
+        void operator()(expressions::SelectExpr const* node);
+
+        void operator()(expressions::RepeatExpr const* node);
+
         void operator()(statements::AssignmentStatement const* node);
 
         void operator()(statements::CompoundStatement const* node);
@@ -39,6 +46,10 @@ namespace parasl::ast{
 
         void operator()(statements::WhileLoop const* node);
 
+        void operator()(statements::OutputStmt const* node);
+
+        void operator()(statements::Layer const* node);
+
         void operator()(statements::Statement const* node);
 
         void operator()(std::nullptr_t);
@@ -50,6 +61,7 @@ namespace parasl::ast{
         }
     private:
         void tabulate();
+        std::ostream& m_stream;
         unsigned n_tabs = 0;
     };
 
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <optional>
+#include <set>
+
+#include "expressions.h"
+#include "statements.h"
+
+/*
+ * Small helpers shared by AST analyses and transformations
+ */
+namespace parasl::ast::utils{
+
+    inline expressions::Expression const* childExpr(basic_syntax_nodes::SyntaxNode const* node, size_t idx){
+        return dynamic_cast<expressions::Expression const*>(node->GetChildAt(idx));
+    }
+
+    inline bool isOperator(basic_syntax_nodes::SyntaxNode const* node, operator_t op_type){
+        auto* op = dynamic_cast<expressions::OperatorExpression const*>(node);
+        return op && op->GetOperatorType() == op_type;
+    }
+
+    // Variable which is modified by store to lvalue: a, a[i], a.x, a[i].x ...
+    inline expressions::Identifier const* storedVariable(expressions::Expression const* lvalue){
+        while(lvalue){
+            if(auto* ref = dynamic_cast<expressions::Reference const*>(lvalue))
+                return ref->identifier();
+
+            if(lvalue->GetExprCategory() != expr_type_t::MEMBER_ACCESS && !isOperator(lvalue, operator_t::SQUARE_BR))
+                return nullptr;
+            lvalue = childExpr(lvalue, 0);
+        }
+        return nullptr;
+    }
+
+    inline void collectReferenced(basic_syntax_nodes::SyntaxNode const* node,
+                                  std::set<expressions::Identifier const*>& ids){
+        if(!node)
+            return;
+
+        if(auto* ref = dynamic_cast<expressions::Reference const*>(node))
+            ids.insert(ref->identifier());
+
+        for(auto i = 0u; i < node->GetChildsNum(); ++i)
+            collectReferenced(node->GetChildAt(i), ids);
+    }
+
+    // Variables which may be (re)defined while executing node: assignment targets and declarations
+    inline void collectStored(basic_syntax_nodes::SyntaxNode const* node,
+                              std::set<expressions::Identifier const*>& ids){
+        if(!node)
+            return;
+
+        if(auto* decl = dynamic_cast<statements::DeclarationStatement const*>(node))
+            ids.insert(decl->identifier());
+
+        if(isOperator(node, operator_t::ASSIGN))
+            if(auto* var = storedVariable(childExpr(node, 0)))
+                ids.insert(var);
+
+        for(auto i = 0u; i < node->GetChildsNum(); ++i)
+            collectStored(node->GetChildAt(i), ids);
+    }
+
+    // Variables declared inside node
+    inline void collectDeclared(basic_syntax_nodes::SyntaxNode const* node,
+                                std::set<expressions::Identifier const*>& ids){
+        if(!node)
+            return;
+
+        if(auto* decl = dynamic_cast<statements::DeclarationStatement const*>(node))
+            ids.insert(decl->identifier());
+
+        for(auto i = 0u; i < node->GetChildsNum(); ++i)
+            collectDeclared(node->GetChildAt(i), ids);
+    }
+
+    // Number of iterations of 'for' loop, nullopt when the range isn't known statically
+    inline std::optional<size_t> tripCount(statements::ForLoop const* loop){
+        auto* range = loop->GetHeader()->range();
+        if(auto* indexed = dynamic_cast<expressions::IndexedRange const*>(range)){
+            long long begin = indexed->begin(), end = indexed->end(), step = indexed->step();
+            if(step > 0 && begin < end)
+                return static_cast<size_t>((end - begin + step - 1) / step);
+            if(step < 0 && begin > end)
+                return static_cast<size_t>((begin - end - step - 1) / -step);
+            return 0;
+        }
+
+        auto* array = dynamic_cast<types::ArrayType const*>(childExpr(range, 0)->GetType());
+        if(!array)
+            return std::nullopt;
+        return array->GetSize();
+    }
+
+    // Structural equality of side-effect free expressions
+    inline bool isSame(expressions::Expression const* lhs, expressions::Expression const* rhs){
+        if(!lhs || !rhs)
+            return lhs == rhs;
+
+        if(lhs->GetExprCategory() != rhs->GetExprCategory() || lhs->GetChildsNum() != rhs->GetChildsNum())
+            return false;
+
+        switch (lhs->GetExprCategory()) {
+            case expr_type_t::LITERAL:
+                return dynamic_cast<expressions::Literal const*>(lhs)->GetLiteralValue<unsigned int>() ==
+                       dynamic_cast<expressions::Literal const*>(rhs)->GetLiteralValue<unsigned int>();
+            case expr_type_t::REFERENCE:
+                return dynamic_cast<expressions::Reference const*>(lhs)->identifier() ==
+                       dynamic_cast<expressions::Reference const*>(rhs)->identifier();
+            case expr_type_t::MEMBER_ACCESS:
+                if(dynamic_cast<expressions::MemberAccess const*>(lhs)->fieldIndex() !=
+                   dynamic_cast<expressions::MemberAccess const*>(rhs)->fieldIndex())
+                    return false;
+                break;
+            case expr_type_t::OPERATOR:
+                if(dynamic_cast<expressions::OperatorExpression const*>(lhs)->GetOperatorType() !=
+                   dynamic_cast<expressions::OperatorExpression const*>(rhs)->GetOperatorType())
+                    return false;
+                break;
+            default:
+                return false;
+        }
+
+        for(auto i = 0u; i < lhs->GetChildsNum(); ++i)
+            if(!isSame(childExpr(lhs, i), childExpr(rhs, i)))
+                return false;
+        return true;
+    }
+}
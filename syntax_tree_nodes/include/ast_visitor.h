@@ -87,6 +87,12 @@ namespace parasl::ast{
                             derived.Derived::operator()(repeat);
                             break;
                         }
+                        case expr_type_t::SELECT:{
+                            auto *select = dynamic_cast<const expressions::SelectExpr *>(expr);
+                            assert(select && "expected select expression");
+                            derived.Derived::operator()(select);
+                            break;
+                        }
                         case expr_type_t::RANGE:{
                             auto *range = dynamic_cast<const expressions::RangeExpr *>(expr);
                             assert(range && "expected range expression");
@@ -164,6 +170,12 @@ namespace parasl::ast{
                             derived.Derived::operator()(while_stmt);
                             break;
                         }
+                        case stmt_type_t::LAYER:{
+                            auto* layer = dynamic_cast<const statements::Layer*>(node);
+                            assert(layer && "expected layer statement");
+                            derived.Derived::operator()(layer);
+                            break;
+                        }
                     }
                     break;
                 }
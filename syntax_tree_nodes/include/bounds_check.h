@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <optional>
+#include <ostream>
+
+#include "ast_visitor.h"
+
+namespace parasl::ast{
+
+    enum class bounds_check_mode_t {FULL, ELIDE, OFF};
+
+    enum class bounds_check_t {
+        NONE,       // checks are disabled
+        ELIDED,     // access is proven to be in bounds
+        HOISTED,    // single check before the loop covers all iterations
+        RUNTIME     // check on every access
+    };
+
+    struct BoundsCheck{
+        bounds_check_t kind;
+        // loop which is preceded by hoisted check
+        statements::ForLoop const* hoisted_to = nullptr;
+    };
+
+    /*
+     * Range analysis of array subscripts. Inductive variables of 'for' loops over
+     * indexed ranges get [begin, end) interval (unless loop body writes to them),
+     * intervals are propagated through +, -, * and / by constant.
+     */
+    class BoundsCheckAnalysis: public depth_first_visitor<BoundsCheckAnalysis>{
+    public:
+        explicit BoundsCheckAnalysis(bounds_check_mode_t mode): m_mode(mode) {}
+
+        void PreAction(basic_syntax_nodes::SyntaxNode const* node);
+
+        void PostAction(basic_syntax_nodes::SyntaxNode const* node);
+
+        std::optional<BoundsCheck> getCheck(expressions::BinaryOperatorExpr const* subscript) const;
+
+        size_t total() const{
+            return m_checks.size();
+        }
+
+        size_t count(bounds_check_t kind) const;
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        struct Interval{
+            long long lo, hi;
+        };
+
+        struct LoopInfo{
+            statements::ForLoop const* loop;
+            expressions::Identifier const* var;
+            std::optional<Interval> range;
+            bool empty;
+            std::set<expressions::Identifier const*> stored;
+        };
+
+        BoundsCheck classify(expressions::BinaryOperatorExpr const* subscript) const;
+
+        std::optional<Interval> rangeOf(expressions::Expression const* expr) const;
+
+        bool isAffine(expressions::Expression const* expr) const;
+
+        LoopInfo const* loopOf(expressions::Identifier const* var) const;
+
+        bounds_check_mode_t m_mode;
+        std::vector<LoopInfo> m_loops;
+        std::map<expressions::BinaryOperatorExpr const*, BoundsCheck> m_checks;
+    };
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "types.h"
+
+namespace parasl::ast{
+
+    // Rounds value up to the multiple of alignment
+    inline size_t alignTo(size_t value, size_t alignment){
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    struct TypeLayout{
+        size_t size;
+        size_t alignment;
+    };
+
+    struct StructLayout{
+        TypeLayout layout;
+        // Indexed by field number in declaration order
+        std::vector<size_t> offsets;
+        // Field numbers in memory order
+        std::vector<size_t> order;
+        size_t padding;
+    };
+
+    /*
+     * Nested array types stored as one contiguous row-major block.
+     * Dimensions go from the outermost ArrayType (indexed first) inwards,
+     * bit-packed innermost array is treated as the element.
+     */
+    struct ArrayLayout{
+        std::vector<size_t> extents;
+        // Byte distance between neighbouring indices of each dimension
+        std::vector<size_t> strides;
+        // Innermost non-array element
+        types::Type const* element;
+        TypeLayout element_layout;
+    };
+
+    /*
+     * Memory representation of ParaSL types shared by all execution engines.
+     * int(N) takes the narrowest of 1, 2, 4, 8 bytes (multiple of 8 bytes above 64 bits),
+     * aggregates are laid out C-like. Layout is unknown for types with untyped members.
+     * With bit packing enabled arrays of narrow int(N) store elements in N bits each.
+     */
+    class DataLayout{
+    public:
+        // With reordering struct fields are placed by decreasing alignment to minimize padding
+        explicit DataLayout(bool reorder_fields = false): m_reorder_fields(reorder_fields) {}
+
+        void setFieldReordering(bool reorder_fields){
+            m_reorder_fields = reorder_fields;
+            m_struct_layouts.clear();
+            m_array_layouts.clear();
+        }
+
+        void setBitPacking(bool pack_ints){
+            m_pack_ints = pack_ints;
+            m_struct_layouts.clear();
+            m_array_layouts.clear();
+        }
+
+        bool fieldReordering() const{
+            return m_reorder_fields;
+        }
+
+        bool bitPacking() const{
+            return m_pack_ints;
+        }
+
+        std::optional<TypeLayout> getLayout(types::Type const* type);
+
+        // Array of int(N), N <= 32, packed when it takes at most 3/4 of native storage
+        bool isBitPacked(types::ArrayType const* type) const;
+
+        StructLayout const* getStructLayout(types::StructType const* type);
+
+        // Stride table of the array type chain, nullptr if element layout is unknown
+        ArrayLayout const* getArrayLayout(types::ArrayType const* type);
+
+    private:
+        bool m_reorder_fields;
+        bool m_pack_ints = false;
+        std::map<types::StructType const*, std::optional<StructLayout>> m_struct_layouts;
+        std::map<types::ArrayType const*, std::optional<ArrayLayout>> m_array_layouts;
+    };
+}
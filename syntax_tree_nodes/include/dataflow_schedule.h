@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "layer_pipeline.h"
+
+namespace parasl::ast{
+
+    /*
+     * Compile-time (synchronous dataflow) schedule of a layer pipeline. Every firing of a
+     * layer defines each of its variables once and reads one value of every variable of
+     * preceding layers it uses, so all production and consumption rates are 1: each layer
+     * fires once per period and source order is a valid periodic schedule.
+     * Layers are mapped onto at most `threads` stages: the chain is split into contiguous
+     * groups minimizing the largest estimated work per firing, and no stage is lighter than
+     * a queue transfer, since pipelining it would cost more than it saves. Layers of a stage
+     * run back to back on one thread and pass values in their variables; values between
+     * stages need a buffer of (stage distance + 1) slots. Work of a layer with 'while' loops
+     * isn't known statically, such layer is a stage on its own with dynamic queues (unless
+     * there are fewer threads than such layers) and so are buffers spanning it.
+     */
+    class DataflowSchedule{
+    public:
+        struct Stage{
+            std::vector<statements::Layer const*> layers;
+            // Estimated AST nodes evaluated per firing, nullopt for dynamic work
+            std::optional<size_t> work;
+        };
+
+        struct Buffer{
+            LayerPipeline::Queue const* queue;
+            // 0 when both layers share a stage
+            size_t slots;
+            // Size isn't known statically, runtime default queue is used
+            bool dynamic;
+        };
+
+        // Work of queue transfer (synchronization of two threads) in AST nodes
+        static constexpr size_t defaultQueueCost = 200;
+
+        // 0 threads are all cores of this machine
+        explicit DataflowSchedule(size_t threads, size_t queue_cost = defaultQueueCost):
+                m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+                m_queue_cost(queue_cost) {}
+
+        void run(LayerPipeline const& pipeline);
+
+        [[nodiscard]] std::vector<Stage> const& stages() const{
+            return m_stages;
+        }
+
+        [[nodiscard]] std::vector<Buffer> const& buffers() const{
+            return m_buffers;
+        }
+
+        // Work of a firing of node, nullopt if it depends on data
+        static std::optional<size_t> work(basic_syntax_nodes::SyntaxNode const* node);
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        // Groups of contiguous layers with at most budget work each (dynamic layers stand alone)
+        std::vector<Stage> split(std::vector<statements::Layer const*> const& layers,
+                                 std::vector<std::optional<size_t>> const& works, size_t budget) const;
+
+        size_t m_threads;
+        size_t m_queue_cost;
+        std::vector<Stage> m_stages;
+        std::vector<Buffer> m_buffers;
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <variant>
 
 #include "syntax_node.h"
@@ -79,9 +80,15 @@ namespace expressions {
     class MemberAccess : public Expression, public basic_syntax_nodes::ChildedSyntaxNode<1>{
     public:
 
-        MemberAccess(basic_syntax_nodes::Ref<Expression> expr, std::string_view member):
-                Expression(expr_type_t::MEMBER_ACCESS, inferType(*expr, member)),
-                basic_syntax_nodes::ChildedSyntaxNode<1>(std::move(expr)), m_member(member){
+        /*
+         * Member is resolved by sema: field number in structure type and its byte offset
+         * (unknown when layout of structure can't be computed)
+         */
+        MemberAccess(basic_syntax_nodes::Ref<Expression> expr, std::string_view member, size_t field_index,
+                     std::optional<size_t> offset):
+                Expression(expr_type_t::MEMBER_ACCESS, fieldType(*expr, field_index)),
+                basic_syntax_nodes::ChildedSyntaxNode<1>(std::move(expr)), m_member(member),
+                m_field_index(field_index), m_offset(offset){
 
         };
 
@@ -89,26 +96,26 @@ namespace expressions {
         std::string_view member() const{
             return m_member;
         }
-    private:
-
-        types::Type const* inferType(Expression const& expr, std::string_view member){
-            auto* expr_type = expr.GetType();
-            if(!expr_type)
-                return nullptr;
 
-            auto* casted_type = dynamic_cast<types::StructType const*>(expr_type);
-            if(!casted_type)
-                throw std::runtime_error("Expression type expected to be a structure");
+        size_t fieldIndex() const{
+            return m_field_index;
+        }
 
-            auto foundMember = std::find_if(casted_type->begin(), casted_type->end(), [member](auto& elem){
-                return elem.first == member;});
+        std::optional<size_t> offset() const{
+            return m_offset;
+        }
+    private:
 
-            if(foundMember == casted_type->end())
-                throw std::runtime_error("Expected member not found in type");
+        static types::Type const* fieldType(Expression const& expr, size_t field_index){
+            auto* struct_type = dynamic_cast<types::StructType const*>(expr.GetType());
+            if(!struct_type)
+                throw std::runtime_error("Expression type expected to be a structure");
 
-            return foundMember->second;
+            return struct_type->GetFieldAt(field_index).second;
         }
         std::string m_member;
+        size_t m_field_index;
+        std::optional<size_t> m_offset;
     };
 
 
@@ -126,6 +133,10 @@ namespace expressions {
             return std::get<T>(literal_value_);
         }
 
+        std::variant<unsigned int, int, std::string> const& GetLiteralVariant() const {
+            return literal_value_;
+        }
+
     private:
         std::variant<unsigned int, int, std::string> literal_value_;
     };
@@ -151,6 +162,11 @@ namespace expressions {
         Identifier const* identifier() const{
             return m_identifier;
         }
+
+        // Redirects the reference to another declaration of the same name and type
+        void rebind(Identifier const* identifier){
+            m_identifier = identifier;
+        }
     private:
         Identifier const* m_identifier;
     };
@@ -202,6 +218,30 @@ namespace expressions {
                 basic_syntax_nodes::ChildedSyntaxNode<2>{std::move(func), std::move(member)}{};
     };
 
+    /*
+     * cond ? on_true : on_false without control flow. Produced by if-conversion,
+     * both values are evaluated unconditionally.
+     */
+    class SelectExpr: public Expression, public basic_syntax_nodes::ChildedSyntaxNode<3>{
+    public:
+        SelectExpr(types::Type const* type, basic_syntax_nodes::Ref<Expression> cond,
+                   basic_syntax_nodes::Ref<Expression> on_true, basic_syntax_nodes::Ref<Expression> on_false):
+                Expression(expr_type_t::SELECT, type),
+                basic_syntax_nodes::ChildedSyntaxNode<3>{std::move(cond), std::move(on_true), std::move(on_false)}{};
+
+        Expression const* condition() const{
+            return dynamic_cast<Expression const*>(GetChildAt(0));
+        }
+
+        Expression const* onTrue() const{
+            return dynamic_cast<Expression const*>(GetChildAt(1));
+        }
+
+        Expression const* onFalse() const{
+            return dynamic_cast<Expression const*>(GetChildAt(2));
+        }
+    };
+
     class RangeExpr: public Expression{
     public:
 
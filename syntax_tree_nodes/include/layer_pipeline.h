@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "statements.h"
+#include "data_layout.h"
+
+namespace parasl::ast{
+
+    /*
+     * Stages and queues of a multi-layer program run as a pipeline (see runtime/pipeline.h).
+     * Every layer(N, "name") is a stage; a variable declared by one layer and read by a
+     * following one is passed through a queue between them, one queue per reading layer.
+     * Program without layers is a single layer 0 and has no queues.
+     */
+    class LayerPipeline{
+    public:
+        struct Queue{
+            statements::Layer const* from;
+            statements::Layer const* to;
+            expressions::Identifier const* variable;
+            // Bytes per value passed, nullopt for unknown layout
+            std::optional<size_t> value_size;
+        };
+
+        explicit LayerPipeline(DataLayout& data_layout): m_data_layout(data_layout) {}
+
+        void run(basic_syntax_nodes::SyntaxNode const* root);
+
+        [[nodiscard]] std::vector<statements::Layer const*> const& layers() const{
+            return m_layers;
+        }
+
+        [[nodiscard]] std::vector<Queue> const& queues() const{
+            return m_queues;
+        }
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        DataLayout& m_data_layout;
+        std::vector<statements::Layer const*> m_layers;
+        std::vector<Queue> m_queues;
+    };
+}
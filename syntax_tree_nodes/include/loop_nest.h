@@ -0,0 +1,80 @@
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "address_lowering.h"
+
+namespace parasl::ast{
+
+    struct CacheModel{
+        size_t line = 64;
+        size_t l1 = 32 * 1024;
+        size_t l2 = 1024 * 1024;
+
+        // Data cache parameters of the machine running the compiler, defaults if they are unknown
+        static CacheModel host();
+    };
+
+    struct LoopNestPlan{
+        // Perfectly nested loops from outermost to innermost
+        std::vector<statements::ForLoop const*> loops;
+        // Inductive variables in original order and after interchange
+        std::vector<expressions::Identifier const*> vars;
+        std::vector<expressions::Identifier const*> order;
+        // Tile size of every loop after interchange, 0 if loop is not tiled
+        std::vector<size_t> tiles;
+
+        [[nodiscard]] bool interchanged() const{
+            return vars != order;
+        }
+
+        [[nodiscard]] bool tiled() const;
+    };
+
+    /*
+     * Optimizes perfect nests of 'for' loops over indexed ranges. The loop whose variable
+     * gives the smallest address strides in the innermost body is moved innermost when
+     * the interchange preserves semantics: arrays written by the body are accessed at the
+     * same address only, scalars are only accumulated by + or *, no I/O is done.
+     * Loops carrying reuse whose footprint overflows L1 (L2 for the third loop) are tiled.
+     * Interchange is applied to the AST, tiling is planned since indexed ranges have
+     * constant bounds only.
+     */
+    class LoopNestOptimizer{
+    public:
+        explicit LoopNestOptimizer(DataLayout& data_layout, CacheModel cache = CacheModel::host()):
+                m_data_layout(data_layout), m_cache(cache) {}
+
+        void run(basic_syntax_nodes::SyntaxNode* root);
+
+        std::vector<LoopNestPlan> const& plans() const{
+            return m_plans;
+        }
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        struct Access{
+            expressions::Expression const* expr;
+            LinearAddress address;
+        };
+
+        void findNests(basic_syntax_nodes::SyntaxNode const* node);
+
+        LoopNestPlan plan(std::vector<statements::ForLoop const*> loops);
+
+        bool isInterchangeLegal(LoopNestPlan const& plan, std::vector<Access> const& accesses) const;
+
+        void planTiles(LoopNestPlan& plan, std::vector<Access> const& accesses) const;
+
+        void interchange(LoopNestPlan const& plan);
+
+        DataLayout& m_data_layout;
+        CacheModel m_cache;
+        std::optional<SoaLayoutAnalysis> m_soa_layout;
+        std::optional<AddressLowering> m_lowering;
+        std::vector<LoopNestPlan> m_plans;
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "expressions.h"
+#include "statements.h"
+
+namespace parasl::ast{
+
+    /*
+     * Unrolls innermost 'for' loops over indexed ranges. Loop is fully unrolled when all
+     * its iterations fit into budget (counted in AST nodes), inductive variable is replaced
+     * by constants then. Otherwise body is replicated 8, 4 or 2 times (factor dividing the
+     * trip count is preferred) with step scaled accordingly, and remaining iterations are
+     * executed by a copy of the original loop. Loops whose body doesn't fit are kept.
+     */
+    class LoopUnroller{
+    public:
+        explicit LoopUnroller(size_t budget = 64): m_budget(budget) {}
+
+        void run(basic_syntax_nodes::SyntaxNode* root);
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        void walk(basic_syntax_nodes::SyntaxNode* node);
+
+        // Takes the loop and returns statement to be placed instead of it
+        basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> unroll(basic_syntax_nodes::Ref<statements::ForLoop> loop);
+
+        basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> unrollFully(basic_syntax_nodes::Ref<statements::ForLoop> loop,
+                                                                            size_t trips);
+
+        basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> unrollPartially(basic_syntax_nodes::Ref<statements::ForLoop> loop,
+                                                                                size_t trips, size_t factor);
+
+        size_t m_budget;
+        size_t m_loops = 0;
+        size_t m_full = 0;
+        size_t m_partial = 0;
+        size_t m_remainders = 0;
+        // Fully unrolled loops are kept alive: results of earlier passes may refer to them
+        std::vector<basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode>> m_detached;
+    };
+}
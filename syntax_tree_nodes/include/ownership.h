@@ -0,0 +1,45 @@
+#pragma once
+
+#include <set>
+#include <ostream>
+
+#include "expressions.h"
+#include "statements.h"
+
+namespace parasl::ast{
+
+    /*
+     * Backward liveness over aggregate (array, vector, struct) variables.
+     * Whole-value use of a variable which is dead afterwards is its last use: the
+     * value can be moved instead of copied, so copy-on-write storage keeps a single
+     * owner and following writes (e.g. arr = bubble(arr, 16)) are done in place.
+     */
+    class OwnershipAnalysis{
+    public:
+        void run(basic_syntax_nodes::SyntaxNode const* root);
+
+        [[nodiscard]] bool isMovable(expressions::Reference const* ref) const{
+            return m_movable.contains(ref);
+        }
+
+        [[nodiscard]] size_t aggregateUses() const{
+            return m_aggregate_uses.size();
+        }
+
+        [[nodiscard]] size_t moves() const{
+            return m_movable.size();
+        }
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        using LiveSet = std::set<expressions::Identifier const*>;
+
+        LiveSet statement(basic_syntax_nodes::SyntaxNode const* node, LiveSet live, bool record);
+
+        void expression(expressions::Expression const* expr, LiveSet& live, bool record, bool whole = true);
+
+        std::set<expressions::Reference const*> m_movable;
+        std::set<expressions::Reference const*> m_aggregate_uses;
+    };
+}
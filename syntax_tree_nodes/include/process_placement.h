@@ -0,0 +1,78 @@
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "layer_pipeline.h"
+#include "dataflow_schedule.h"
+
+namespace parasl::ast{
+
+    enum class transport_t {SHARED_MEMORY, UNIX_SOCKET};
+
+    /*
+     * Placement of layers into processes for multi-process runs (see runtime/process_pipeline.h).
+     * Groups come from a placement config, one process per line:
+     *     # comment
+     *     front: 0, "square"
+     *     back: 2
+     * where layers are given by level or by quoted name; every layer is placed exactly once.
+     * Without config every stage of the dataflow schedule is a process. Queues between layers
+     * of different processes become channels of the transport: shared memory rings of about
+     * ringBytes, or batched Unix socket messages. Values of at least zeroCopyThreshold bytes
+     * cross without a copy: built in place in the ring, or handed over by memory descriptor.
+     */
+    class ProcessPlacement{
+    public:
+        struct Process{
+            std::string name;
+            std::vector<statements::Layer const*> layers;
+        };
+
+        struct Channel{
+            LayerPipeline::Queue const* queue;
+            size_t from;
+            size_t to;
+            // Ring slots, batch of values for sockets
+            size_t slots;
+            bool zero_copy;
+        };
+
+        static constexpr size_t zeroCopyThreshold = 4096;
+        static constexpr size_t ringBytes = 1 << 20;
+        static constexpr size_t maxSlots = 1024;
+
+        explicit ProcessPlacement(transport_t transport = transport_t::SHARED_MEMORY): m_transport(transport) {}
+
+        // Throws std::invalid_argument for malformed config
+        void load(std::string const& config);
+
+        // Throws std::invalid_argument if loaded groups don't match layers of pipeline
+        void run(LayerPipeline const& pipeline, DataflowSchedule const& schedule);
+
+        [[nodiscard]] std::vector<Process> const& processes() const{
+            return m_processes;
+        }
+
+        [[nodiscard]] std::vector<Channel> const& channels() const{
+            return m_channels;
+        }
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        struct Group{
+            size_t line;
+            std::string name;
+            // Levels or names of layers
+            std::vector<std::string> layers;
+        };
+
+        transport_t m_transport;
+        std::optional<std::vector<Group>> m_groups;
+        std::vector<Process> m_processes;
+        std::vector<Channel> m_channels;
+    };
+}
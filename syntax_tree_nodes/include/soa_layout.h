@@ -0,0 +1,63 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "ast_visitor.h"
+#include "data_layout.h"
+
+namespace parasl::ast{
+
+    // Address of arr[i].field is base address of arr + base + i * stride
+    struct FieldAddress{
+        size_t base;
+        size_t stride;
+    };
+
+    /*
+     * Chooses memory layout of arrays of structures. Array which is accessed field-wise
+     * (arr[i].x) is stored as structure of arrays: one packed array per field, so loops
+     * over a single field read contiguous memory instead of striding over whole structures.
+     * Arrays used as a whole value keep array of structures layout, since they have to be
+     * bitwise compatible with other arrays of the same type.
+     */
+    class SoaLayoutAnalysis: public depth_first_visitor<SoaLayoutAnalysis>{
+    public:
+        explicit SoaLayoutAnalysis(DataLayout& data_layout): m_data_layout(data_layout) {}
+
+        void run(basic_syntax_nodes::SyntaxNode const* root);
+
+        void PreAction(basic_syntax_nodes::SyntaxNode const* node);
+
+        void PostAction(basic_syntax_nodes::SyntaxNode const*) {}
+
+        [[nodiscard]] bool isSoa(expressions::Identifier const* array) const;
+
+        // Address of field for every element of array (either layout), nullopt for unknown layout
+        std::optional<FieldAddress> fieldAddress(expressions::Identifier const* array, size_t field) const;
+
+        // Lowering of arr[i].field access
+        std::optional<FieldAddress> fieldAddress(expressions::MemberAccess const* access) const;
+
+        void dump(std::ostream& stream) const;
+
+    private:
+        struct ArrayInfo{
+            types::ArrayType const* type;
+            types::StructType const* elt_type;
+            size_t field_accesses = 0;
+            size_t element_accesses = 0;
+            size_t whole_uses = 0;
+            std::vector<bool> used_fields;
+            bool soa = false;
+            std::vector<FieldAddress> fields;
+        };
+
+        void layOut(ArrayInfo& info);
+
+        DataLayout& m_data_layout;
+        std::map<expressions::Identifier const*, ArrayInfo> m_arrays;
+    };
+}
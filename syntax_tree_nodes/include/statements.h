@@ -108,7 +108,22 @@ namespace statements {
         }
 
         const CompoundStatement *GetBody() const {
-            return dynamic_cast<const CompoundStatement *>(GetChildAt(3));
+            return dynamic_cast<const CompoundStatement *>(GetChildAt(1));
+        }
+
+        basic_syntax_nodes::Ref<CompoundStatement> TakeBody() {
+            return basic_syntax_nodes::Ref<CompoundStatement>(dynamic_cast<CompoundStatement*>(TakeChildAt(1).release()));
+        }
+
+        void SetBody(basic_syntax_nodes::Ref<CompoundStatement> body) {
+            SetChildAt(1, std::move(body));
+        }
+
+        // Exchanges iteration spaces of two loops (loop interchange)
+        void SwapHeader(ForLoop& another) {
+            auto header = TakeChildAt(0);
+            SetChildAt(0, another.TakeChildAt(0));
+            another.SetChildAt(0, std::move(header));
         }
     };
 
@@ -125,7 +140,7 @@ namespace statements {
         }
 
         const CompoundStatement *GetBody() const {
-            return dynamic_cast<const CompoundStatement *>(GetChildAt(3));
+            return dynamic_cast<const CompoundStatement *>(GetChildAt(1));
         }
     };
 
@@ -139,9 +154,43 @@ namespace statements {
 
     class OutputStmt : public Statement, basic_syntax_nodes::ChildedSyntaxNode<1> {
     public:
-        OutputStmt(std::unique_ptr<expressions::Expression> opnd) :
+        OutputStmt(size_t channel, std::unique_ptr<expressions::Expression> opnd) :
                 Statement(stmt_type_t::OUTPUT_STMT),
-                ChildedSyntaxNode<1>(std::move(opnd)) {}
+                ChildedSyntaxNode<1>(std::move(opnd)), m_channel(channel) {}
+
+        size_t channel() const{
+            return m_channel;
+        }
+
+        expressions::Expression const* value() const{
+            return dynamic_cast<expressions::Expression const*>(GetChildAt(0));
+        }
+
+    private:
+        size_t m_channel;
+    };
+
+    // layer(N, "name") { ... }: stage of the program pipeline, reads values of preceding layers
+    class Layer : public Statement, public basic_syntax_nodes::ChildedSyntaxNode<1> {
+    public:
+        Layer(unsigned level, std::string name, basic_syntax_nodes::Ref<CompoundStatement> body) :
+                Statement(stmt_type_t::LAYER),
+                ChildedSyntaxNode<1>(std::move(body)), m_level(level), m_name(std::move(name)) {}
+
+        unsigned level() const{
+            return m_level;
+        }
+
+        std::string const& name() const{
+            return m_name;
+        }
+
+        CompoundStatement const* body() const{
+            return dynamic_cast<CompoundStatement const*>(GetChildAt(0));
+        }
 
+    private:
+        unsigned m_level;
+        std::string m_name;
     };
 }
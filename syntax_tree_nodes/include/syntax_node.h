@@ -4,6 +4,7 @@
 #include <limits>
 #include <memory>
 #include <algorithm>
+#include <array>
 
 #include "types.h"
 
@@ -59,7 +60,19 @@ namespace basic_syntax_nodes {
             return children_.at(idx).get();
         }
 
+        // Detaches child from the node leaving an empty slot behind
+        Ref<SyntaxNode> TakeChildAt(size_t idx) {
+            auto child = std::move(children_.at(idx));
+            if(child)
+                child->SetParent(nullptr);
+            return child;
+        }
 
+        void SetChildAt(size_t idx, Ref<SyntaxNode> child) {
+            children_.at(idx) = std::move(child);
+            if(children_[idx])
+                children_[idx]->SetParent(this);
+        }
 
         ChildedSyntaxNode(ChildedSyntaxNode&& another) noexcept: children_(std::move(another.children_)){
             rebindParent();
@@ -109,6 +122,20 @@ namespace basic_syntax_nodes {
             return children_.at(idx).get();
         }
 
+        // Detaches child from the node leaving an empty slot behind
+        Ref<SyntaxNode> TakeChildAt(size_t idx) {
+            auto child = std::move(children_.at(idx));
+            if(child)
+                child->SetParent(nullptr);
+            return child;
+        }
+
+        void SetChildAt(size_t idx, Ref<SyntaxNode> child) {
+            children_.at(idx) = std::move(child);
+            if(children_[idx])
+                children_[idx]->SetParent(this);
+        }
+
         ChildedSyntaxNode(ChildedSyntaxNode&& another) noexcept: children_(std::move(another.children_)){
             rebindParent();
         }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <string_view>
+
+#include "ast_visitor.h"
+
+namespace parasl::ast{
+
+    /*
+     * Counts nodes of a tree by node class, with the bytes they take: the node object
+     * and, for nodes with any number of children, their list of child pointers. Names,
+     * types and declarations referenced from the tree are not counted.
+     */
+    class TreeStatistics: public ast_visitor<TreeStatistics>{
+    public:
+        struct Kind{
+            size_t nodes = 0;
+            size_t bytes = 0;
+        };
+
+        void run(basic_syntax_nodes::SyntaxNode const* root);
+
+        [[nodiscard]] size_t nodes() const{
+            return m_nodes;
+        }
+
+        [[nodiscard]] size_t bytes() const{
+            return m_bytes;
+        }
+
+        [[nodiscard]] std::map<std::string_view, Kind> const& kinds() const{
+            return m_kinds;
+        }
+
+        void dump(std::ostream& stream) const;
+
+        void operator()(std::nullptr_t) {}
+        void operator()(expressions::OperatorExpression const* node);
+        void operator()(expressions::Literal const* node);
+        void operator()(expressions::Identifier const* node);
+        void operator()(expressions::Reference const* node);
+        void operator()(expressions::MemberAccess const* node);
+        void operator()(expressions::InputExpr const* node);
+        void operator()(expressions::InitializationList const* node);
+        void operator()(expressions::GlueExpr const* node);
+        void operator()(expressions::BindExpr const* node);
+        void operator()(expressions::RepeatExpr const* node);
+        void operator()(expressions::SelectExpr const* node);
+        void operator()(expressions::ArrayRange const* node);
+        void operator()(expressions::IndexedRange const* node);
+        void operator()(statements::IfStatement const* node);
+        void operator()(statements::ForLoop const* node);
+        void operator()(statements::AssignmentStatement const* node);
+        void operator()(statements::CompoundStatement const* node);
+        void operator()(statements::DeclarationStatement const* node);
+        void operator()(statements::RetStmt const* node);
+        void operator()(statements::OutputStmt const* node);
+        void operator()(statements::ForHeader const* node);
+        void operator()(statements::WhileLoop const* node);
+        void operator()(statements::Layer const* node);
+
+    private:
+        void add(std::string_view kind, size_t bytes);
+
+        size_t m_nodes = 0;
+        size_t m_bytes = 0;
+        std::map<std::string_view, Kind> m_kinds;
+    };
+}
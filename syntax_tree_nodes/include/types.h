@@ -1,12 +1,17 @@
 #pragma once
 
 #include <cstddef>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
 
 enum class syntax_node_t {STMT, EXPR};
 
 enum class stmt_type_t {ASSIGNMENT, FOR_STMT, RET_STMT,
-                        OUTPUT_STMT, COMPOUND_STMT, IF_STMT, DECL, FOR_HEADER, WHILE_STMT};
-enum class expr_type_t {OPERATOR, LITERAL, SYMBOL, INPUT, MEMBER_ACCESS, REFERENCE, INIT_LIST, REPEAT, GLUE, BIND, RANGE};
+                        OUTPUT_STMT, COMPOUND_STMT, IF_STMT, DECL, FOR_HEADER, WHILE_STMT, LAYER};
+enum class expr_type_t {OPERATOR, LITERAL, SYMBOL, INPUT, MEMBER_ACCESS, REFERENCE, INIT_LIST, REPEAT, GLUE, BIND, RANGE, SELECT};
 enum class entity_type_t {VAR, ARRAY, VECTOR, STRUCT, FUNC};
 
 enum class operator_t {ASSIGN, PLUS, MINUS, MULT, DIV, AND, OR, LT, GT, LE, GE, NOT, DOT, SQUARE_BR, PAREN, EQ, NE};
@@ -122,7 +127,7 @@ namespace types {
             return arg_list_.at(idx).second;
         }
 
-        const Type *GetRetType() {
+        const Type *GetRetType() const {
             return ret_type_;
         }
 
@@ -157,17 +162,35 @@ namespace types {
     public:
         template <typename ...FieldType>
         StructType(FieldType&& ...field) : Type(entity_type_t::STRUCT),
-        fields_{std::forward<FieldType>(field)...} {}
+        fields_{std::forward<FieldType>(field)...} {
+            indexFields();
+        }
 
         template <typename Iter>
         StructType(Iter begin , Iter end) :
         Type(entity_type_t::STRUCT){
             fields_.resize(end - begin);
             std::copy(begin, end, fields_.begin());
+            indexFields();
         }
 
         using FieldContainer = std::vector<std::pair<std::string, const Type *>>;
 
+        [[nodiscard]] size_t GetFieldsNum() const {
+            return fields_.size();
+        }
+
+        [[nodiscard]] FieldContainer::value_type const& GetFieldAt(size_t idx) const {
+            return fields_.at(idx);
+        }
+
+        [[nodiscard]] std::optional<size_t> GetFieldIndex(std::string_view name) const {
+            auto found = field_indices_.find(name);
+            if(found == field_indices_.end())
+                return std::nullopt;
+            return found->second;
+        }
+
         FieldContainer::iterator begin(){
             return fields_.begin();
         }
@@ -185,7 +208,7 @@ namespace types {
         }
 
         bool operator==(StructType const& another) const{
-            return std::mismatch(fields_.begin(), fields_.end(), another.begin()).first != fields_.end();
+            return fields_ == another.fields_;
         }
 
         void dump(std::ostream& ostream) const override{
@@ -198,6 +221,12 @@ namespace types {
             ostream << " }";
         }
     protected:
+        void indexFields(){
+            for(size_t idx = 0; idx < fields_.size(); ++idx)
+                field_indices_.emplace(fields_[idx].first, idx);
+        }
+
         FieldContainer fields_;
+        std::map<std::string, size_t, std::less<>> field_indices_;
     };
 }
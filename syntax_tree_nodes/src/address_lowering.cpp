@@ -0,0 +1,150 @@
+#include "address_lowering.h"
+#include <algorithm>
+#include <string>
+#include <tuple>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        bool isAccess(basic_syntax_nodes::SyntaxNode const* node){
+            auto* expr = dynamic_cast<expressions::Expression const*>(node);
+            return expr && (expr->GetExprCategory() == expr_type_t::MEMBER_ACCESS ||
+                            utils::isOperator(expr, operator_t::SQUARE_BR));
+        }
+
+        void addIndex(LinearAddress& address, expressions::Expression const* index, size_t stride){
+            if(auto* literal = dynamic_cast<expressions::Literal const*>(index))
+                address.offset += literal->GetLiteralValue<unsigned int>() * stride;
+            else
+                address.terms.emplace_back(index, stride);
+        }
+    }
+
+    void AddressLowering::PreAction(basic_syntax_nodes::SyntaxNode const* node) {
+        if(!isAccess(node))
+            return;
+
+        // Only the outermost access of a chain is lowered
+        auto* parent = node->GetParent();
+        if(isAccess(parent) && parent->GetChildAt(0) == node)
+            return;
+
+        auto* access = dynamic_cast<expressions::Expression const*>(node);
+        ++m_accesses;
+        auto address = linearize(access);
+        if(!address)
+            return;
+
+        auto subscripts = 0;
+        for(auto* expr = access; isAccess(expr); expr = utils::childExpr(expr, 0))
+            subscripts += utils::isOperator(expr, operator_t::SQUARE_BR);
+        if(subscripts > 1)
+            ++m_multi_dimensional;
+        if(address->bits)
+            ++m_bit_addressed;
+
+        m_addresses.emplace(access, std::move(*address));
+    }
+
+    std::optional<LinearAddress> AddressLowering::linearize(expressions::Expression const* access) {
+        if(auto* ref = dynamic_cast<expressions::Reference const*>(access))
+            return LinearAddress{ref->identifier(), 0, {}};
+
+        if(auto* member = dynamic_cast<expressions::MemberAccess const*>(access)){
+            auto* subscript = utils::childExpr(member, 0);
+            auto* array = utils::isOperator(subscript, operator_t::SQUARE_BR) ?
+                    dynamic_cast<expressions::Reference const*>(utils::childExpr(subscript, 0)) : nullptr;
+
+            // arr[i].x of SoA array indexes packed array of field x
+            if(array && m_soa_layout && m_soa_layout->isSoa(array->identifier())){
+                auto field = m_soa_layout->fieldAddress(member);
+                if(!field)
+                    return std::nullopt;
+                LinearAddress address{array->identifier(), field->base, {}};
+                addIndex(address, utils::childExpr(subscript, 1), field->stride);
+                return address;
+            }
+
+            auto address = linearize(subscript);
+            if(!address || !member->offset())
+                return std::nullopt;
+            address->offset += *member->offset();
+            return address;
+        }
+
+        if(utils::isOperator(access, operator_t::SQUARE_BR)){
+            auto* array = utils::childExpr(access, 0);
+
+            // Whole element of SoA array is spread over field arrays, it has no single address
+            auto* ref = dynamic_cast<expressions::Reference const*>(array);
+            if(ref && m_soa_layout && m_soa_layout->isSoa(ref->identifier()))
+                return std::nullopt;
+
+            auto address = linearize(array);
+            if(!address)
+                return std::nullopt;
+
+            // Packed row starts at byte boundary, so outer part of address is scaled to bits
+            auto* array_type = dynamic_cast<types::ArrayType const*>(array->GetType());
+            if(array_type && m_data_layout.isBitPacked(array_type)){
+                address->bits = static_cast<types::VarType const*>(array_type->GetEltType())->bitlength();
+                address->offset *= 8;
+                for(auto& term: address->terms)
+                    term.second *= 8;
+                addIndex(*address, utils::childExpr(access, 1), address->bits);
+                return address;
+            }
+
+            // Subscripts of one array chain take strides of its dimensions, outermost first
+            auto* base = array;
+            size_t dimension = 0;
+            for(; utils::isOperator(base, operator_t::SQUARE_BR); base = utils::childExpr(base, 0))
+                ++dimension;
+
+            auto* base_type = dynamic_cast<types::ArrayType const*>(base->GetType());
+            if(!base_type){
+                auto element = m_data_layout.getLayout(access->GetType());
+                if(!element)
+                    return std::nullopt;
+                addIndex(*address, utils::childExpr(access, 1), element->size);
+                return address;
+            }
+
+            auto* layout = m_data_layout.getArrayLayout(base_type);
+            if(!layout || dimension >= layout->strides.size())
+                return std::nullopt;
+            addIndex(*address, utils::childExpr(access, 1), layout->strides[dimension]);
+            return address;
+        }
+
+        return std::nullopt;
+    }
+
+    LinearAddress const* AddressLowering::getAddress(expressions::Expression const* access) const {
+        auto it = m_addresses.find(access);
+        return it != m_addresses.end() ? &it->second : nullptr;
+    }
+
+    void AddressLowering::dump(std::ostream& stream) const {
+        auto constant = std::count_if(m_addresses.begin(), m_addresses.end(), [](auto& address){
+            return address.second.terms.empty();
+        });
+        stream << "Address lowering: " << m_accesses << " accesses, " << m_addresses.size() << " linearized, "
+               << m_multi_dimensional << " multi-dimensional, " << constant << " constant offsets, "
+               << m_bit_addressed << " bit-addressed" << std::endl;
+
+        // Folded addresses by variable name, so that the order doesn't depend on the allocator
+        std::vector<std::pair<std::string, LinearAddress const*>> folded;
+        for(auto& [access, address]: m_addresses)
+            if(address.terms.empty())
+                folded.emplace_back(address.base->GetSymbolName(), &address);
+        std::stable_sort(folded.begin(), folded.end(), [](auto& lhs, auto& rhs){
+            return std::tie(lhs.first, lhs.second->offset) < std::tie(rhs.first, rhs.second->offset);
+        });
+        for(auto& [name, address]: folded)
+            stream << "  " << name << ": constant offset " << address->offset
+                   << (address->bits ? " bits" : " bytes") << std::endl;
+    }
+}
@@ -4,6 +4,7 @@
 #include <sstream>
 #include "expressions.h"
 #include "statements.h"
+#include "ast_utils.h"
 
 namespace parasl::ast{
 
@@ -184,6 +185,12 @@ namespace parasl::ast{
                 dynamic_cast<statements::CompoundStatement*>(else_clause ? else_clause->release() : nullptr)
         );
 
+        if(m_if_conversion_limit) {
+            auto converted = convertIfStatement(conv_cond, conv_then_clause, conv_else_clause);
+            if(converted)
+                return converted;
+        }
+
         return std::make_shared<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>(
                 std::make_unique<statements::IfStatement>(std::move(conv_cond),
                                                          std::move(conv_then_clause),
@@ -219,15 +226,31 @@ namespace parasl::ast{
         if(!expr_type) {
             std::stringstream ss;
             ss << "Type \"";
+            if(casted_expr->GetType())
+                casted_expr->GetType()->dump(ss);
+            ss << "\" is not struct -> it has no member \"" << member << "\"";
+            delete casted_expr;
+            throw SemaError(ss.str());
+        }
+
+        auto field_index = expr_type->GetFieldIndex(member);
+
+        if(!field_index) {
+            std::stringstream ss;
+            ss << "Struct \"";
             expr_type->dump(ss);
-            ss << "\" is not sctruct -> it has no member \"" << member << "\"";
-            throw SemaError("Cannot access member on non-struct type");
+            ss << "\" has no member \"" << member << "\"";
+            delete casted_expr;
+            throw SemaError(ss.str());
         }
 
+        std::optional<size_t> offset;
+        if(auto* layout = dataLayout().getStructLayout(expr_type))
+            offset = layout->offsets[*field_index];
 
         return std::make_shared<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>(
                 std::make_unique<expressions::MemberAccess>(std::unique_ptr<expressions::Expression> {casted_expr},
-                                                           member));
+                                                           member, *field_index, offset));
     }
 
     Builder::Node Builder::createSubscriptAccess(Node const& expr, Node const& id_expr) {
@@ -372,6 +395,9 @@ namespace parasl::ast{
     Builder::Node Builder::createForHeader(std::string var, Node const& range) {
         auto* casted = dynamic_cast<expressions::RangeExpr*>(range->release());
         assert(casted && "expected range expression here");
+
+        // Inductive variable and loop body live in their own scope which is closed by createForLoop
+        pushScope();
         auto id = createDeclaration(var, casted->GetType());
         auto* casted_id = dynamic_cast<statements::DeclarationStatement*>(id->release());
         assert(casted_id && "expected declaration here");
@@ -415,6 +441,8 @@ namespace parasl::ast{
     }
 
     Builder::Node Builder::createForLoop(Node const& header, Node const& body) {
+        popScope();
+
         auto* casted_header = dynamic_cast<statements::ForHeader*>(header->release());
         assert(casted_header && "expected \'for\' header here");
 
@@ -441,4 +469,69 @@ namespace parasl::ast{
                         std::unique_ptr<statements::CompoundStatement>(casted_body)
                 ));
     }
-}
\ No newline at end of file
+
+    Builder::Node Builder::createOutputStatement(unsigned channel, const Builder::Node &expr) {
+        auto* casted = dynamic_cast<expressions::Expression*>(expr->release());
+        assert(casted && "expected expression here");
+
+        return std::make_shared<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>(
+                std::make_unique<statements::OutputStmt>(channel, std::unique_ptr<expressions::Expression>(casted)));
+    }
+
+    Builder::Node Builder::createLayer(unsigned level, std::string name, const Builder::Node &body) {
+        auto* casted_body = dynamic_cast<statements::CompoundStatement*>(body->release());
+        assert(casted_body && "expected compound statement here");
+        auto layer = std::make_unique<statements::Layer>(level, std::move(name),
+                                                         std::unique_ptr<statements::CompoundStatement>(casted_body));
+
+        // Values only flow down the pipeline: variables of preceding layers are read-only
+        std::set<expressions::Identifier const*> stored, declared;
+        utils::collectStored(casted_body, stored);
+        utils::collectDeclared(casted_body, declared);
+        for(auto* var: stored)
+            if(!declared.contains(var))
+                throw SemaError("layer " + std::to_string(level) + " can't modify '" + var->GetSymbolName() +
+                                "' of a preceding layer");
+
+        return std::make_shared<std::unique_ptr<basic_syntax_nodes::SyntaxNode>>(std::move(layer));
+    }
+
+    Builder::Node Builder::createLayers(std::vector<Builder::Node>&& layers) {
+        for(size_t idx = 1; idx < layers.size(); ++idx){
+            auto* prev = dynamic_cast<statements::Layer const*>(layers[idx - 1]->get());
+            auto* layer = dynamic_cast<statements::Layer const*>(layers[idx]->get());
+            assert(prev && layer && "expected layer here");
+            if(layer->level() <= prev->level())
+                throw SemaError("layer " + std::to_string(layer->level()) + " has to follow layer " +
+                                std::to_string(prev->level()) + ", layers go in increasing order");
+        }
+        return createCompoundStatement(std::move(layers));
+    }
+
+    void Builder::importModule(std::string const& module, basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode> declarations) {
+        if(m_imports.contains(module))
+            return;
+
+        auto* interface = declarations.get();
+        std::vector<statements::DeclarationStatement*> decls;
+        for(size_t idx = 0; idx < interface->GetChildsNum(); ++idx){
+            auto* decl = dynamic_cast<statements::DeclarationStatement const*>(interface->GetChildAt(idx));
+            if(!decl || decl->initializer())
+                throw SemaError("Interface of module \"" + module + "\" holds more than declarations");
+            auto name = decl->identifier()->GetSymbolName();
+            if(m_symbol_table.getSymbol(name)){
+                std::stringstream ss;
+                ss << "Symbol \"" << name << "\" of module \"" << module << "\" has already been declared";
+                throw SemaError(ss.str());
+            }
+            decls.push_back(const_cast<statements::DeclarationStatement*>(decl));
+        }
+
+        // Registered only when all of them can be, a failed import leaves no symbols behind
+        for(auto* decl: decls){
+            m_symbol_table.registerSymbol(decl->identifier()->GetSymbolName(), decl);
+            m_imported.insert(decl);
+        }
+        m_imports.emplace(module, std::move(declarations));
+    }
+}
@@ -0,0 +1,159 @@
+#include "ast_clone.h"
+#include <cassert>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    using basic_syntax_nodes::Ref;
+    using basic_syntax_nodes::SyntaxNode;
+    using expressions::Expression;
+
+    namespace {
+
+        template<typename T>
+        Ref<T> cast(Ref<SyntaxNode> node){
+            return Ref<T>(dynamic_cast<T*>(node.release()));
+        }
+    }
+
+    Ref<SyntaxNode> Cloner::clone(SyntaxNode const* node) {
+        if(!node)
+            return nullptr;
+
+        if(auto* expr = dynamic_cast<Expression const*>(node))
+            return expression(expr);
+
+        auto* stmt = dynamic_cast<statements::Statement const*>(node);
+        assert(stmt && "unknown syntax node");
+        return statement(stmt);
+    }
+
+    std::vector<Ref<SyntaxNode>> Cloner::children(SyntaxNode const* node) {
+        std::vector<Ref<SyntaxNode>> copies;
+        for(auto i = 0u; i < node->GetChildsNum(); ++i)
+            copies.push_back(clone(node->GetChildAt(i)));
+        return copies;
+    }
+
+    Ref<Expression> Cloner::expression(Expression const* expr) {
+        auto* type = expr->GetType();
+        switch (expr->GetExprCategory()) {
+            case expr_type_t::LITERAL:
+                return std::make_unique<expressions::Literal>(*dynamic_cast<expressions::Literal const*>(expr));
+            case expr_type_t::SYMBOL: {
+                auto* id = dynamic_cast<expressions::Identifier const*>(expr);
+                auto copy = std::make_unique<expressions::Identifier>(id->GetSymbolName(), type);
+                m_identifiers[id] = copy.get();
+                return copy;
+            }
+            case expr_type_t::REFERENCE: {
+                auto* id = dynamic_cast<expressions::Reference const*>(expr)->identifier();
+                if(auto value = m_substitutions.find(id); value != m_substitutions.end())
+                    return Cloner{}.cloneAs(value->second);
+                if(auto copy = m_identifiers.find(id); copy != m_identifiers.end())
+                    id = copy->second;
+                return std::make_unique<expressions::Reference>(id);
+            }
+            case expr_type_t::INPUT:
+                return std::make_unique<expressions::InputExpr>(
+                        dynamic_cast<expressions::InputExpr const*>(expr)->GetInputNum(), type);
+            case expr_type_t::MEMBER_ACCESS: {
+                auto* member = dynamic_cast<expressions::MemberAccess const*>(expr);
+                return std::make_unique<expressions::MemberAccess>(
+                        expression(utils::childExpr(expr, 0)), member->member(), member->fieldIndex(), member->offset());
+            }
+            case expr_type_t::OPERATOR: {
+                if(auto* unary = dynamic_cast<expressions::UnaryOperatorExpr const*>(expr))
+                    return std::make_unique<expressions::UnaryOperatorExpr>(
+                            expression(utils::childExpr(expr, 0)), type, unary->IsPostfix(), unary->GetOperatorType());
+
+                auto* binary = dynamic_cast<expressions::BinaryOperatorExpr const*>(expr);
+                assert(binary && "expected binary operator");
+                return std::make_unique<expressions::BinaryOperatorExpr>(
+                        expression(utils::childExpr(expr, 0)), expression(utils::childExpr(expr, 1)),
+                        type, binary->GetOperatorType());
+            }
+            case expr_type_t::INIT_LIST: {
+                auto members = children(expr);
+                return std::make_unique<expressions::InitializationList>(type, members.begin(), members.end());
+            }
+            case expr_type_t::REPEAT:
+                return std::make_unique<expressions::RepeatExpr>(type, expression(utils::childExpr(expr, 0)),
+                                                                 dynamic_cast<expressions::RepeatExpr const*>(expr)->times());
+            case expr_type_t::GLUE: {
+                auto members = children(expr);
+                return std::make_unique<expressions::GlueExpr>(type, members.begin(), members.end());
+            }
+            case expr_type_t::BIND:
+                return std::make_unique<expressions::BindExpr>(type, expression(utils::childExpr(expr, 0)),
+                                                               expression(utils::childExpr(expr, 1)));
+            case expr_type_t::SELECT:
+                return std::make_unique<expressions::SelectExpr>(type, expression(utils::childExpr(expr, 0)),
+                                                                 expression(utils::childExpr(expr, 1)),
+                                                                 expression(utils::childExpr(expr, 2)));
+            case expr_type_t::RANGE: {
+                if(auto* range = dynamic_cast<expressions::IndexedRange const*>(expr))
+                    return std::make_unique<expressions::IndexedRange>(type, range->begin(), range->end(), range->step());
+                return std::make_unique<expressions::ArrayRange>(type, expression(utils::childExpr(expr, 0)));
+            }
+        }
+
+        assert(0 && "Unhandled expression");
+        return nullptr;
+    }
+
+    Ref<statements::Statement> Cloner::statement(statements::Statement const* stmt) {
+        switch (stmt->GetStmtType()) {
+            case stmt_type_t::ASSIGNMENT:
+                return std::make_unique<statements::AssignmentStatement>(expression(utils::childExpr(stmt, 0)));
+            case stmt_type_t::DECL: {
+                auto* decl = dynamic_cast<statements::DeclarationStatement const*>(stmt);
+                // Initializer is evaluated before the new variable comes into scope
+                auto initializer = decl->initializer() ? expression(decl->initializer()) : nullptr;
+                return std::make_unique<statements::DeclarationStatement>(
+                        cast<expressions::Identifier>(expression(decl->identifier())), std::move(initializer));
+            }
+            case stmt_type_t::COMPOUND_STMT: {
+                auto stmts = children(stmt);
+                return std::make_unique<statements::CompoundStatement>(stmts.begin(), stmts.end());
+            }
+            case stmt_type_t::IF_STMT: {
+                auto* if_stmt = dynamic_cast<statements::IfStatement const*>(stmt);
+                return std::make_unique<statements::IfStatement>(
+                        expression(if_stmt->condition()),
+                        cast<statements::CompoundStatement>(clone(if_stmt->then_clause())),
+                        cast<statements::CompoundStatement>(clone(if_stmt->else_clause())));
+            }
+            case stmt_type_t::FOR_HEADER: {
+                auto* header = dynamic_cast<statements::ForHeader const*>(stmt);
+                auto range = cast<expressions::RangeExpr>(clone(header->range()));
+                return std::make_unique<statements::ForHeader>(
+                        cast<statements::DeclarationStatement>(clone(header->inductiveVar())), std::move(range));
+            }
+            case stmt_type_t::FOR_STMT: {
+                auto* loop = dynamic_cast<statements::ForLoop const*>(stmt);
+                auto header = cast<statements::ForHeader>(clone(loop->GetHeader()));
+                return std::make_unique<statements::ForLoop>(
+                        std::move(header), cast<statements::CompoundStatement>(clone(loop->GetBody())));
+            }
+            case stmt_type_t::WHILE_STMT: {
+                auto* loop = dynamic_cast<statements::WhileLoop const*>(stmt);
+                return std::make_unique<statements::WhileLoop>(
+                        expression(loop->GetCondition()), cast<statements::CompoundStatement>(clone(loop->GetBody())));
+            }
+            case stmt_type_t::RET_STMT:
+                return std::make_unique<statements::RetStmt>(expression(utils::childExpr(stmt, 0)));
+            case stmt_type_t::OUTPUT_STMT:
+                return std::make_unique<statements::OutputStmt>(dynamic_cast<statements::OutputStmt const*>(stmt)->channel(),
+                                                                expression(utils::childExpr(stmt, 0)));
+            case stmt_type_t::LAYER: {
+                auto* layer = dynamic_cast<statements::Layer const*>(stmt);
+                return std::make_unique<statements::Layer>(
+                        layer->level(), layer->name(), cast<statements::CompoundStatement>(clone(layer->body())));
+            }
+        }
+
+        assert(0 && "Unhandled statement");
+        return nullptr;
+    }
+}
@@ -0,0 +1,638 @@
+#include "ast_image.h"
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace parasl::ast{
+
+    using basic_syntax_nodes::Ref;
+    using basic_syntax_nodes::SyntaxNode;
+    using expressions::Expression;
+
+    static_assert(std::endian::native == std::endian::little, "AST images are little-endian");
+    static_assert(sizeof(image::Header) % 4 == 0 && sizeof(image::NodeRecord) % 4 == 0 &&
+                  sizeof(image::TypeRecord) % 4 == 0 && sizeof(image::MemberRecord) % 4 == 0);
+
+    namespace {
+
+        constexpr uint32_t nodeWords = sizeof(image::NodeRecord) / sizeof(uint32_t);
+
+        template<typename T>
+        Ref<T> cast(Ref<SyntaxNode> node){
+            if(!node)
+                return nullptr;
+            auto* casted = dynamic_cast<T*>(node.get());
+            if(!casted)
+                throw std::runtime_error("AST image: unexpected kind of node");
+            node.release();
+            return Ref<T>(casted);
+        }
+
+        class Materializer{
+        public:
+            Materializer(AstImage const& image, Context& context):
+                    m_context(context), m_types(image.header().type_count, nullptr),
+                    m_made(image.header().type_count, false) {}
+
+            Ref<SyntaxNode> node(NodeView view);
+
+        private:
+            // Slots which sema always fills, as the passes after it rely on
+            Ref<Expression> expression(NodeView view){
+                if(!view)
+                    throw std::runtime_error("AST image: required node is missing");
+                return cast<Expression>(node(view));
+            }
+
+            template<typename T>
+            Ref<T> child(NodeView view, size_t idx, bool optional = false){
+                auto child = view.child(idx);
+                if(!child && !optional)
+                    throw std::runtime_error("AST image: required node is missing");
+                return cast<T>(node(child));
+            }
+
+            std::vector<Ref<SyntaxNode>> children(NodeView view){
+                std::vector<Ref<SyntaxNode>> nodes;
+                for(size_t idx = 0; idx < view.childCount(); ++idx)
+                    nodes.push_back(child<SyntaxNode>(view, idx));
+                return nodes;
+            }
+
+            types::Type const* type(TypeView view);
+            Ref<Expression> expressionNode(NodeView view);
+            Ref<statements::Statement> statementNode(NodeView view);
+
+            Context& m_context;
+            std::vector<types::Type const*> m_types;
+            std::vector<bool> m_made;
+            std::map<uint32_t, expressions::Identifier const*> m_identifiers;
+        };
+
+        types::Type const* Materializer::type(TypeView view) {
+            if(!view)
+                return nullptr;
+            auto index = view.index();
+            if(m_made[index])
+                return m_types[index];
+
+            types::Type const* made = nullptr;
+            switch (view.entity()) {
+                case entity_type_t::VAR:
+                    switch (view.primType()) {
+                        case prim_type_t::INT:    made = m_context.getIntegralType(static_cast<unsigned>(view.bitLength())); break;
+                        case prim_type_t::CHAR:   made = m_context.getCharType(); break;
+                        case prim_type_t::DOUBLE: made = m_context.getDoubleType(); break;
+                        case prim_type_t::FLOAT:  made = m_context.getFloatType(); break;
+                    }
+                    break;
+                case entity_type_t::ARRAY:
+                    made = m_context.getArrayType(type(view.element()), static_cast<unsigned>(view.size()));
+                    break;
+                case entity_type_t::VECTOR:
+                    made = m_context.getVectorType(type(view.element()), static_cast<unsigned>(view.size()));
+                    break;
+                case entity_type_t::STRUCT: {
+                    std::vector<std::pair<std::string, types::Type const*>> fields;
+                    for(size_t idx = 0; idx < view.memberCount(); ++idx)
+                        fields.emplace_back(view.memberName(idx), type(view.memberType(idx)));
+                    made = m_context.getStructType(fields);
+                    break;
+                }
+                case entity_type_t::FUNC:
+                    // Context has no function types yet, nor does the grammar have functions
+                    throw std::runtime_error("AST image: function types aren't supported");
+            }
+            if(!made)
+                throw std::runtime_error("AST image: unknown type record");
+            m_made[index] = true;
+            return m_types[index] = made;
+        }
+
+        // Children of fixed-size nodes, none for lists
+        std::optional<size_t> arity(NodeView view){
+            if(view.syntax() == syntax_node_t::STMT){
+                switch (view.stmtType()) {
+                    case stmt_type_t::COMPOUND_STMT: return std::nullopt;
+                    case stmt_type_t::IF_STMT:       return 3;
+                    case stmt_type_t::DECL:
+                    case stmt_type_t::FOR_HEADER:
+                    case stmt_type_t::FOR_STMT:
+                    case stmt_type_t::WHILE_STMT:    return 2;
+                    default:                         return 1;
+                }
+            }
+            switch (view.exprCategory()) {
+                case expr_type_t::INIT_LIST:
+                case expr_type_t::GLUE:          return std::nullopt;
+                case expr_type_t::OPERATOR:      return view.is(image::UNARY) ? 1 : 2;
+                case expr_type_t::MEMBER_ACCESS:
+                case expr_type_t::REPEAT:        return 1;
+                case expr_type_t::BIND:          return 2;
+                case expr_type_t::SELECT:        return 3;
+                case expr_type_t::RANGE:         return view.is(image::ARRAY_RANGE) ? 1 : 0;
+                default:                         return 0;
+            }
+        }
+
+        Ref<SyntaxNode> Materializer::node(NodeView view) {
+            if(!view)
+                return nullptr;
+            if(auto count = arity(view); count && *count != view.childCount())
+                throw std::runtime_error("AST image: node " + std::to_string(view.offset()) + " has " +
+                                         std::to_string(view.childCount()) + " children instead of " + std::to_string(*count));
+            if(view.syntax() == syntax_node_t::EXPR)
+                return expressionNode(view);
+            if(view.syntax() == syntax_node_t::STMT)
+                return statementNode(view);
+            throw std::runtime_error("AST image: unknown syntax node");
+        }
+
+        Ref<Expression> Materializer::expressionNode(NodeView view) {
+            auto* type = this->type(view.type());
+            switch (view.exprCategory()) {
+                case expr_type_t::LITERAL:
+                    // Sema only makes unsigned literals, and passes read them as such
+                    if(view.op() != operator_t{0})
+                        throw std::runtime_error("AST image: literal isn't an unsigned integer");
+                    return std::make_unique<expressions::Literal>(view.a(), type);
+                case expr_type_t::SYMBOL: {
+                    auto id = std::make_unique<expressions::Identifier>(view.name(), type);
+                    m_identifiers[view.offset()] = id.get();
+                    return id;
+                }
+                case expr_type_t::REFERENCE: {
+                    // Sema resolves names to declarations made earlier, which come earlier in preorder
+                    auto found = m_identifiers.find(view.target().offset());
+                    if(found == m_identifiers.end())
+                        throw std::runtime_error("AST image: reference to an identifier which isn't declared before");
+                    return std::make_unique<expressions::Reference>(found->second);
+                }
+                case expr_type_t::INPUT:
+                    return std::make_unique<expressions::InputExpr>(view.a(), type);
+                case expr_type_t::MEMBER_ACCESS:
+                    return std::make_unique<expressions::MemberAccess>(
+                            expression(view.child(0)), view.name(), view.b(),
+                            view.is(image::HAS_OFFSET) ? std::optional<size_t>(view.c()) : std::nullopt);
+                case expr_type_t::OPERATOR:
+                    if(view.op() > operator_t::NE)
+                        throw std::runtime_error("AST image: unknown operator");
+                    if(view.is(image::UNARY))
+                        return std::make_unique<expressions::UnaryOperatorExpr>(
+                                expression(view.child(0)), type, view.is(image::POSTFIX), view.op());
+                    return std::make_unique<expressions::BinaryOperatorExpr>(
+                            expression(view.child(0)), expression(view.child(1)), type, view.op());
+                case expr_type_t::INIT_LIST: {
+                    auto members = children(view);
+                    return std::make_unique<expressions::InitializationList>(type, members.begin(), members.end());
+                }
+                case expr_type_t::REPEAT:
+                    return std::make_unique<expressions::RepeatExpr>(type, expression(view.child(0)), view.a());
+                case expr_type_t::GLUE: {
+                    auto members = children(view);
+                    return std::make_unique<expressions::GlueExpr>(type, members.begin(), members.end());
+                }
+                case expr_type_t::BIND:
+                    return std::make_unique<expressions::BindExpr>(type, expression(view.child(0)), expression(view.child(1)));
+                case expr_type_t::SELECT:
+                    return std::make_unique<expressions::SelectExpr>(type, expression(view.child(0)),
+                                                                     expression(view.child(1)), expression(view.child(2)));
+                case expr_type_t::RANGE:
+                    if(view.is(image::ARRAY_RANGE))
+                        return std::make_unique<expressions::ArrayRange>(type, expression(view.child(0)));
+                    return std::make_unique<expressions::IndexedRange>(type, static_cast<int>(view.a()),
+                                                                       static_cast<int>(view.b()), static_cast<int>(view.c()));
+            }
+            throw std::runtime_error("AST image: unknown expression");
+        }
+
+        Ref<statements::Statement> Materializer::statementNode(NodeView view) {
+            switch (view.stmtType()) {
+                case stmt_type_t::ASSIGNMENT:
+                    return std::make_unique<statements::AssignmentStatement>(expression(view.child(0)));
+                case stmt_type_t::DECL: {
+                    auto id = child<expressions::Identifier>(view, 0);
+                    return std::make_unique<statements::DeclarationStatement>(std::move(id), child<Expression>(view, 1, true));
+                }
+                case stmt_type_t::COMPOUND_STMT: {
+                    auto stmts = children(view);
+                    return std::make_unique<statements::CompoundStatement>(stmts.begin(), stmts.end());
+                }
+                case stmt_type_t::IF_STMT: {
+                    auto condition = expression(view.child(0));
+                    auto then_clause = child<statements::CompoundStatement>(view, 1);
+                    return std::make_unique<statements::IfStatement>(std::move(condition), std::move(then_clause),
+                                                                     child<statements::CompoundStatement>(view, 2, true));
+                }
+                case stmt_type_t::FOR_HEADER: {
+                    auto var = child<statements::DeclarationStatement>(view, 0);
+                    return std::make_unique<statements::ForHeader>(std::move(var), child<expressions::RangeExpr>(view, 1));
+                }
+                case stmt_type_t::FOR_STMT: {
+                    auto header = child<statements::ForHeader>(view, 0);
+                    return std::make_unique<statements::ForLoop>(std::move(header), child<statements::CompoundStatement>(view, 1));
+                }
+                case stmt_type_t::WHILE_STMT: {
+                    auto condition = expression(view.child(0));
+                    return std::make_unique<statements::WhileLoop>(std::move(condition),
+                                                                   child<statements::CompoundStatement>(view, 1));
+                }
+                case stmt_type_t::RET_STMT:
+                    return std::make_unique<statements::RetStmt>(expression(view.child(0)));
+                case stmt_type_t::OUTPUT_STMT:
+                    return std::make_unique<statements::OutputStmt>(view.a(), expression(view.child(0)));
+                case stmt_type_t::LAYER:
+                    return std::make_unique<statements::Layer>(view.a(), std::string(view.name()),
+                                                               child<statements::CompoundStatement>(view, 0));
+            }
+            throw std::runtime_error("AST image: unknown statement");
+        }
+    }
+
+    // Types are written after the types they are made of, which rules out cycles
+    static TypeView component(TypeView const& type, AstImage const* image, uint32_t index){
+        auto found = image->type(index);
+        if(found && found.index() >= type.index())
+            throw std::runtime_error("AST image: type " + std::to_string(type.index()) + " refers to a later type");
+        return found;
+    }
+
+    TypeView TypeView::element() const {
+        return component(*this, m_image, m_record->a);
+    }
+
+    std::string_view TypeView::memberName(size_t idx) const {
+        if(idx >= memberCount())
+            throw std::out_of_range("type member");
+        return m_image->string(m_image->member(static_cast<uint32_t>(m_record->c + idx)).name);
+    }
+
+    TypeView TypeView::memberType(size_t idx) const {
+        if(idx >= memberCount())
+            throw std::out_of_range("type member");
+        return component(*this, m_image, m_image->member(static_cast<uint32_t>(m_record->c + idx)).type);
+    }
+
+    TypeView TypeView::result() const {
+        return component(*this, m_image, m_record->b);
+    }
+
+    uint32_t TypeView::index() const {
+        auto* first = reinterpret_cast<image::TypeRecord const*>(m_image->m_data + m_image->m_header->types);
+        return static_cast<uint32_t>(m_record - first);
+    }
+
+    TypeView NodeView::type() const {
+        return m_image->type(m_record->type);
+    }
+
+    NodeView NodeView::child(size_t idx) const {
+        if(idx >= childCount())
+            throw std::out_of_range("node child");
+        auto* children = reinterpret_cast<uint32_t const*>(m_record + 1);
+        // Preorder puts children after their parent, so following them always ends
+        if(children[idx] != image::noneRef && children[idx] <= offset())
+            AstImage::corrupt("child of node " + std::to_string(offset()) + " comes before it");
+        return m_image->node(children[idx]);
+    }
+
+    std::string_view NodeView::name() const {
+        auto is_layer = syntax() == syntax_node_t::STMT && stmtType() == stmt_type_t::LAYER;
+        return m_image->string(is_layer ? m_record->b : m_record->a);
+    }
+
+    NodeView NodeView::target() const {
+        if(m_record->a >= offset())
+            AstImage::corrupt("reference at " + std::to_string(offset()) + " to a later node");
+        return m_image->node(m_record->a);
+    }
+
+    uint32_t NodeView::offset() const {
+        return static_cast<uint32_t>(reinterpret_cast<char const*>(m_record) - (m_image->m_data + m_image->m_header->nodes));
+    }
+
+    AstImage::AstImage(std::string_view data): m_data(data.data()), m_size(data.size()),
+                                               m_header(reinterpret_cast<image::Header const*>(data.data())) {
+        if(m_size < sizeof(image::Header) || std::memcmp(m_header->magic, image::magic, sizeof(image::magic)) != 0)
+            corrupt("not an AST image");
+        if(reinterpret_cast<uintptr_t>(m_data) % alignof(uint32_t))
+            throw std::invalid_argument("AST image: data isn't aligned");
+        if(m_header->version != image::version)
+            corrupt("version " + std::to_string(m_header->version) + " instead of " + std::to_string(image::version));
+        if(m_header->size != m_size)
+            corrupt("size " + std::to_string(m_header->size) + " doesn't match " + std::to_string(m_size) + " bytes");
+
+        auto section = [&](uint64_t begin, uint64_t bytes, char const* name){
+            if(begin < sizeof(image::Header) || begin % 4 || begin + bytes > m_size)
+                corrupt(std::string(name) + " section out of bounds");
+        };
+        section(m_header->strings, m_header->strings_size, "string");
+        section(m_header->types, uint64_t(m_header->type_count) * sizeof(image::TypeRecord), "type");
+        section(m_header->members, uint64_t(m_header->member_count) * sizeof(image::MemberRecord), "member");
+        section(m_header->nodes, m_header->nodes_size, "node");
+    }
+
+    AstImage AstImage::map(std::string const& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+            throw std::system_error(errno, std::generic_category(), "can't open AST image " + path);
+        struct stat info{};
+        if(::fstat(fd, &info) < 0){
+            auto error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "can't read AST image " + path);
+        }
+        auto size = static_cast<size_t>(info.st_size);
+        void* data = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        auto error = errno;
+        ::close(fd);
+        if(data == MAP_FAILED)
+            throw std::system_error(size ? error : EINVAL, std::generic_category(), "can't map AST image " + path);
+
+        try{
+            AstImage image(std::string_view(static_cast<char const*>(data), size));
+            image.m_mapping = data;
+            return image;
+        } catch (...) {
+            ::munmap(data, size);
+            throw;
+        }
+    }
+
+    AstImage::AstImage(AstImage&& another) noexcept: m_data(another.m_data), m_size(another.m_size),
+                                                    m_header(another.m_header), m_mapping(another.m_mapping) {
+        another.m_mapping = nullptr;
+    }
+
+    AstImage::~AstImage() {
+        if(m_mapping)
+            ::munmap(m_mapping, m_size);
+    }
+
+    void AstImage::corrupt(std::string const& what) {
+        throw std::runtime_error("AST image: " + what);
+    }
+
+    NodeView AstImage::node(uint32_t offset) const {
+        if(offset == image::noneRef)
+            return {this, nullptr};
+        if(offset % 4 || uint64_t(offset) + sizeof(image::NodeRecord) > m_header->nodes_size)
+            corrupt("node offset " + std::to_string(offset) + " out of bounds");
+        auto* record = reinterpret_cast<image::NodeRecord const*>(m_data + m_header->nodes + offset);
+        if(uint64_t(offset) + sizeof(image::NodeRecord) + uint64_t(record->child_count) * 4 > m_header->nodes_size)
+            corrupt("children of node " + std::to_string(offset) + " out of bounds");
+        return {this, record};
+    }
+
+    TypeView AstImage::type(uint32_t index) const {
+        if(index == image::noneRef)
+            return {this, nullptr};
+        if(index >= m_header->type_count)
+            corrupt("type " + std::to_string(index) + " out of bounds");
+        return {this, reinterpret_cast<image::TypeRecord const*>(m_data + m_header->types) + index};
+    }
+
+    image::MemberRecord const& AstImage::member(uint32_t index) const {
+        if(index >= m_header->member_count)
+            corrupt("type member " + std::to_string(index) + " out of bounds");
+        return reinterpret_cast<image::MemberRecord const*>(m_data + m_header->members)[index];
+    }
+
+    std::string_view AstImage::string(uint32_t offset) const {
+        if(offset == image::noneRef)
+            return {};
+        if(offset % 4 || uint64_t(offset) + 4 > m_header->strings_size)
+            corrupt("string offset " + std::to_string(offset) + " out of bounds");
+        uint32_t length;
+        std::memcpy(&length, m_data + m_header->strings + offset, sizeof(length));
+        if(uint64_t(offset) + 4 + length + 1 > m_header->strings_size)
+            corrupt("string at " + std::to_string(offset) + " out of bounds");
+        return {m_data + m_header->strings + offset + 4, length};
+    }
+
+    Ref<SyntaxNode> AstImage::materialize(Context& context) const {
+        return Materializer(*this, context).node(root());
+    }
+
+    uint32_t AstImageWriter::string(std::string_view text) {
+        auto [found, added] = m_string_offsets.try_emplace(std::string(text), static_cast<uint32_t>(m_strings.size()));
+        if(added){
+            auto length = static_cast<uint32_t>(text.size());
+            m_strings.append(reinterpret_cast<char const*>(&length), sizeof(length));
+            m_strings.append(text);
+            m_strings.push_back('\0');
+            m_strings.resize((m_strings.size() + 3) / 4 * 4, '\0');
+        }
+        return found->second;
+    }
+
+    uint32_t AstImageWriter::type(types::Type const* type) {
+        if(!type)
+            return image::noneRef;
+        if(auto found = m_type_indices.find(type); found != m_type_indices.end())
+            return found->second;
+
+        // Types a type is made of get lower indices
+        image::TypeRecord record{static_cast<uint8_t>(type->GetEntityType()), 0, 0, 0, 0, 0};
+        auto members = [&](auto const& compound){
+            std::vector<image::MemberRecord> added;
+            for(auto& [name, member_type]: compound)
+                added.push_back({string(name), this->type(member_type)});
+            record.a = static_cast<uint32_t>(added.size());
+            record.c = static_cast<uint32_t>(m_members.size());
+            m_members.insert(m_members.end(), added.begin(), added.end());
+        };
+        switch (type->GetEntityType()) {
+            case entity_type_t::VAR: {
+                auto* var = static_cast<types::VarType const*>(type);
+                record.prim = static_cast<uint8_t>(var->primType());
+                record.a = static_cast<uint32_t>(var->bitlength());
+                break;
+            }
+            case entity_type_t::ARRAY: {
+                auto* array = static_cast<types::ArrayType const*>(type);
+                record.a = this->type(array->GetEltType());
+                record.b = static_cast<uint32_t>(array->GetSize());
+                break;
+            }
+            case entity_type_t::VECTOR: {
+                auto* vector = static_cast<types::VectorType const*>(type);
+                record.a = this->type(vector->GetEltType());
+                record.b = static_cast<uint32_t>(vector->GetSize());
+                break;
+            }
+            case entity_type_t::STRUCT:
+                members(*static_cast<types::StructType const*>(type));
+                break;
+            case entity_type_t::FUNC: {
+                auto* func = static_cast<types::FuncType const*>(type);
+                auto result = this->type(func->GetRetType());
+                members(*func);
+                record.b = result;
+                break;
+            }
+        }
+
+        auto index = static_cast<uint32_t>(m_types.size());
+        m_types.push_back(record);
+        m_type_indices.emplace(type, index);
+        return index;
+    }
+
+    uint32_t AstImageWriter::node(SyntaxNode const* node) {
+        image::NodeRecord record{};
+        record.type = image::noneRef;
+        expressions::Identifier const* referenced = nullptr;
+
+        if(auto* expr = dynamic_cast<Expression const*>(node)){
+            record.syntax = static_cast<uint8_t>(syntax_node_t::EXPR);
+            record.category = static_cast<uint8_t>(expr->GetExprCategory());
+            record.type = type(expr->GetType());
+            switch (expr->GetExprCategory()) {
+                case expr_type_t::LITERAL: {
+                    auto& value = dynamic_cast<expressions::Literal const*>(expr)->GetLiteralVariant();
+                    record.op = static_cast<uint8_t>(value.index());
+                    if(auto* text = std::get_if<std::string>(&value))
+                        record.a = string(*text);
+                    else if(auto* number = std::get_if<int>(&value))
+                        record.a = static_cast<uint32_t>(*number);
+                    else
+                        record.a = std::get<unsigned int>(value);
+                    break;
+                }
+                case expr_type_t::SYMBOL:
+                    record.a = string(dynamic_cast<expressions::Identifier const*>(expr)->GetSymbolName());
+                    break;
+                case expr_type_t::REFERENCE:
+                    referenced = dynamic_cast<expressions::Reference const*>(expr)->identifier();
+                    record.a = image::noneRef;
+                    break;
+                case expr_type_t::INPUT:
+                    record.a = static_cast<uint32_t>(dynamic_cast<expressions::InputExpr const*>(expr)->GetInputNum());
+                    break;
+                case expr_type_t::MEMBER_ACCESS: {
+                    auto* member = dynamic_cast<expressions::MemberAccess const*>(expr);
+                    record.a = string(member->member());
+                    record.b = static_cast<uint32_t>(member->fieldIndex());
+                    if(member->offset()){
+                        record.flags |= image::HAS_OFFSET;
+                        record.c = static_cast<uint32_t>(*member->offset());
+                    }
+                    break;
+                }
+                case expr_type_t::OPERATOR:
+                    record.op = static_cast<uint8_t>(dynamic_cast<expressions::OperatorExpression const*>(expr)->GetOperatorType());
+                    if(auto* unary = dynamic_cast<expressions::UnaryOperatorExpr const*>(expr))
+                        record.flags |= image::UNARY | (unary->IsPostfix() ? image::POSTFIX : 0);
+                    break;
+                case expr_type_t::REPEAT:
+                    record.a = dynamic_cast<expressions::RepeatExpr const*>(expr)->times();
+                    break;
+                case expr_type_t::RANGE:
+                    if(auto* range = dynamic_cast<expressions::IndexedRange const*>(expr)){
+                        record.a = static_cast<uint32_t>(range->begin());
+                        record.b = static_cast<uint32_t>(range->end());
+                        record.c = static_cast<uint32_t>(range->step());
+                    } else
+                        record.flags |= image::ARRAY_RANGE;
+                    break;
+                default:
+                    break;
+            }
+        } else{
+            auto* stmt = dynamic_cast<statements::Statement const*>(node);
+            assert(stmt && "unknown syntax node");
+            record.syntax = static_cast<uint8_t>(syntax_node_t::STMT);
+            record.category = static_cast<uint8_t>(stmt->GetStmtType());
+            if(auto* output = dynamic_cast<statements::OutputStmt const*>(stmt))
+                record.a = static_cast<uint32_t>(output->channel());
+            if(auto* layer = dynamic_cast<statements::Layer const*>(stmt)){
+                record.a = layer->level();
+                record.b = string(layer->name());
+            }
+        }
+
+        auto children = node->GetChildsNum();
+        record.child_count = static_cast<uint32_t>(children);
+        auto first_word = m_nodes.size();
+        if((first_word + nodeWords + children) * 4 > std::numeric_limits<uint32_t>::max())
+            throw std::length_error("AST image over 4 GiB");
+        m_nodes.resize(first_word + nodeWords + children, image::noneRef);
+        std::memcpy(&m_nodes[first_word], &record, sizeof(record));
+        ++m_node_count;
+
+        auto offset = static_cast<uint32_t>(first_word * 4);
+        if(auto* id = dynamic_cast<expressions::Identifier const*>(node))
+            m_identifiers.emplace(id, offset);
+        if(referenced)
+            m_fixups.emplace_back(first_word + offsetof(image::NodeRecord, a) / 4, referenced);
+
+        for(size_t idx = 0; idx < children; ++idx)
+            if(auto* child = node->GetChildAt(idx)){
+                auto child_offset = this->node(child);
+                m_nodes[first_word + nodeWords + idx] = child_offset;
+            }
+        return offset;
+    }
+
+    std::string AstImageWriter::write(SyntaxNode const* root) {
+        m_strings.clear();
+        m_string_offsets.clear();
+        m_types.clear();
+        m_members.clear();
+        m_type_indices.clear();
+        m_nodes.clear();
+        m_node_count = 0;
+        m_identifiers.clear();
+        m_fixups.clear();
+
+        auto root_offset = root ? node(root) : image::noneRef;
+        for(auto& [slot, id]: m_fixups){
+            auto found = m_identifiers.find(id);
+            m_nodes[slot] = found != m_identifiers.end() ? found->second : image::noneRef;
+        }
+
+        image::Header header{};
+        std::memcpy(header.magic, image::magic, sizeof(image::magic));
+        header.version = image::version;
+        header.layout_flags = (m_data_layout.fieldReordering() ? uint32_t(image::REORDER_FIELDS) : 0) |
+                              (m_data_layout.bitPacking() ? uint32_t(image::PACK_INTS) : 0);
+        uint64_t end = sizeof(header);
+        auto section = [&](uint32_t& begin, uint64_t bytes){
+            begin = static_cast<uint32_t>(end);
+            end += bytes;
+            if(end > std::numeric_limits<uint32_t>::max())
+                throw std::length_error("AST image over 4 GiB");
+        };
+        section(header.strings, m_strings.size());
+        header.strings_size = static_cast<uint32_t>(m_strings.size());
+        section(header.types, m_types.size() * sizeof(image::TypeRecord));
+        header.type_count = static_cast<uint32_t>(m_types.size());
+        section(header.members, m_members.size() * sizeof(image::MemberRecord));
+        header.member_count = static_cast<uint32_t>(m_members.size());
+        section(header.nodes, m_nodes.size() * sizeof(uint32_t));
+        header.nodes_size = static_cast<uint32_t>(m_nodes.size() * sizeof(uint32_t));
+        header.node_count = m_node_count;
+        header.root = root_offset;
+        header.size = static_cast<uint32_t>(end);
+
+        std::string data;
+        data.reserve(end);
+        data.append(reinterpret_cast<char const*>(&header), sizeof(header));
+        data += m_strings;
+        data.append(reinterpret_cast<char const*>(m_types.data()), m_types.size() * sizeof(image::TypeRecord));
+        data.append(reinterpret_cast<char const*>(m_members.data()), m_members.size() * sizeof(image::MemberRecord));
+        data.append(reinterpret_cast<char const*>(m_nodes.data()), m_nodes.size() * sizeof(uint32_t));
+        return data;
+    }
+}
@@ -2,6 +2,7 @@
 #include "statements.h"
 #include "expressions.h"
 #include <cassert>
+#include <iomanip>
 
 namespace parasl::ast{
     namespace {
@@ -28,24 +29,24 @@ namespace parasl::ast{
             }
             return stream;
         }
-        void expression_preamble(){
-            std::cout << "EXPR(";
+        void expression_preamble(std::ostream& stream){
+            stream << "EXPR(";
         }
 
-        void expression_epilogue(expressions::Expression const* expr){
-            std::cout << "): <type>=";
+        void expression_epilogue(std::ostream& stream, expressions::Expression const* expr){
+            stream << "): <type>=";
             if(expr->GetType())
-                expr->GetType()->dump(std::cout);
+                expr->GetType()->dump(stream);
             else
-                std::cout << "<null>";
+                stream << "<null>";
         }
 
-        void statement_preamble(){
-            std::cout << "STMT(";
+        void statement_preamble(std::ostream& stream){
+            stream << "STMT(";
         }
 
-        void statement_epilogue(){
-            std::cout << ")";
+        void statement_epilogue(std::ostream& stream){
+            stream << ")";
         }
 
     }
@@ -53,122 +54,149 @@ namespace parasl::ast{
 
     void Printer::operator()(basic_syntax_nodes::SyntaxNode const*){
 
-        std::cout << "<unknown node>";
+        m_stream << "<unknown node>";
 
     }
 
     void Printer::operator()(expressions::OperatorExpression const* node){
-        expression_preamble();
-        std::cout << "operator " << node->GetOperatorType();
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "operator " << node->GetOperatorType();
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(expressions::MemberAccess const* node){
-        expression_preamble();
-        std::cout << "Member access: ." << node->member();
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "Member access: ." << node->member() << " (field " << node->fieldIndex();
+        if(node->offset())
+            m_stream << ", offset " << *node->offset();
+        m_stream << ")";
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(expressions::Identifier const* node){
-        expression_preamble();
-        std::cout << "ID: \"" << node->GetSymbolName() << "\"";
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "ID: \"" << node->GetSymbolName() << "\"";
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(expressions::Literal const* node){
-        expression_preamble();
-        std::cout << "literal: " << node->GetLiteralValue<unsigned int>();
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "literal: " << node->GetLiteralValue<unsigned int>();
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(expressions::Reference const* node){
-        expression_preamble();
-        std::cout << "reference of: " << node->identifier()->GetSymbolName();
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "reference of: " << node->identifier()->GetSymbolName();
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(expressions::Expression const* node){
-        expression_preamble();
-        std::cout << "unknown";
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "unknown";
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(statements::AssignmentStatement const*){
-        statement_preamble();
-        std::cout << "ASSIGNMENT";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "ASSIGNMENT";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(statements::CompoundStatement const*){
-        statement_preamble();
-        std::cout << "COMPOUND";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "COMPOUND";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(statements::IfStatement const*){
-        statement_preamble();
-        std::cout << "IF";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "IF";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(statements::DeclarationStatement const* node){
-        statement_preamble();
-        std::cout << "DECLARATION<id = " << node->identifier()->GetSymbolName()
+        statement_preamble(m_stream);
+        m_stream << "DECLARATION<id = " << node->identifier()->GetSymbolName()
                   << "; type = ";
-        node->identifier()->GetType()->dump(std::cout);
-        std::cout << ">";
-        statement_epilogue();
+        node->identifier()->GetType()->dump(m_stream);
+        m_stream << ">";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(statements::Statement const*){
-        statement_preamble();
-        std::cout << "<unknown>";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "<unknown>";
+        statement_epilogue(m_stream);
     }
 
     void Printer::tabulate() {
         for(unsigned i = 0; i < n_tabs; ++i)
-            std::cout << '\t';
+            m_stream << '\t';
     }
 
     void Printer::operator()(std::nullptr_t) {
-        std::cout << "<null>" << std::endl;
+        m_stream << "<null>" << std::endl;
     }
 
     void Printer::PreAction(basic_syntax_nodes::SyntaxNode const*node) {
         tabulate();
         visit_impl(node);
-        std::cout << std::endl;
+        m_stream << std::endl;
         n_tabs++;
     }
 
     void Printer::operator()(const statements::ForLoop *) {
-        statement_preamble();
-        std::cout << "FOR";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "FOR";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(const statements::WhileLoop *) {
-        statement_preamble();
-        std::cout << "WHILE";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "WHILE";
+        statement_epilogue(m_stream);
+    }
+
+    void Printer::operator()(const statements::OutputStmt *node) {
+        statement_preamble(m_stream);
+        m_stream << "OUTPUT<channel = " << node->channel() << ">";
+        statement_epilogue(m_stream);
+    }
+
+    void Printer::operator()(const statements::Layer *node) {
+        statement_preamble(m_stream);
+        m_stream << "LAYER<level = " << node->level() << "; name = " << std::quoted(node->name()) << ">";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(const statements::ForHeader *) {
-        statement_preamble();
-        std::cout << "FOR HEADER";
-        statement_epilogue();
+        statement_preamble(m_stream);
+        m_stream << "FOR HEADER";
+        statement_epilogue(m_stream);
     }
 
     void Printer::operator()(const expressions::ArrayRange *node) {
-        expression_preamble();
-        std::cout << "Range over array";
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "Range over array";
+        expression_epilogue(m_stream, node);
     }
 
     void Printer::operator()(const expressions::IndexedRange *node) {
-        expression_preamble();
-        std::cout << "indexed range: from " << node->begin() << " to " << node->end() << " with step " << node->step();
-        expression_epilogue(node);
+        expression_preamble(m_stream);
+        m_stream << "indexed range: from " << node->begin() << " to " << node->end() << " with step " << node->step();
+        expression_epilogue(m_stream, node);
+    }
+
+    void Printer::operator()(const expressions::SelectExpr *node) {
+        expression_preamble(m_stream);
+        m_stream << "select";
+        expression_epilogue(m_stream, node);
+    }
+
+    void Printer::operator()(const expressions::RepeatExpr *node) {
+        expression_preamble(m_stream);
+        m_stream << "repeat " << node->times() << " times";
+        expression_epilogue(m_stream, node);
     }
 }
\ No newline at end of file
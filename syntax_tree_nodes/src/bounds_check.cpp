@@ -0,0 +1,231 @@
+#include "bounds_check.h"
+#include <cassert>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        std::optional<size_t> sizeOf(types::Type const* type){
+            if(auto* array_type = dynamic_cast<types::ArrayType const*>(type))
+                return array_type->GetSize();
+            if(auto* vector_type = dynamic_cast<types::VectorType const*>(type))
+                return vector_type->GetSize();
+            return std::nullopt;
+        }
+
+        std::optional<long long> constantOf(expressions::Expression const* expr){
+            if(auto* literal = dynamic_cast<expressions::Literal const*>(expr))
+                return literal->GetLiteralValue<unsigned int>();
+            return std::nullopt;
+        }
+
+        // Loops the node runs on every iteration of: those around it with no 'if', 'while'
+        // or right operand of && and || in between
+        std::set<statements::ForLoop const*> unconditionalLoops(basic_syntax_nodes::SyntaxNode const* node){
+            std::set<statements::ForLoop const*> loops;
+            for(auto* parent = node->GetParent(); parent; node = parent, parent = parent->GetParent()){
+                if(auto* loop = dynamic_cast<statements::ForLoop const*>(parent)){
+                    loops.insert(loop);
+                    continue;
+                }
+
+                bool guarded = dynamic_cast<statements::WhileLoop const*>(parent) ||
+                        (dynamic_cast<statements::IfStatement const*>(parent) && parent->GetChildAt(0) != node) ||
+                        ((utils::isOperator(parent, operator_t::AND) || utils::isOperator(parent, operator_t::OR)) &&
+                         parent->GetChildAt(1) == node);
+                if(guarded)
+                    break;
+            }
+            return loops;
+        }
+    }
+
+    void BoundsCheckAnalysis::PreAction(basic_syntax_nodes::SyntaxNode const* node) {
+        if(auto* loop = dynamic_cast<statements::ForLoop const*>(node)){
+            LoopInfo info{loop, loop->GetHeader()->inductiveVar()->identifier(), std::nullopt, false, {}};
+            utils::collectStored(loop->GetBody(), info.stored);
+
+            // Ranges are half-open: for(i in 0:16) iterates i = 0..15
+            auto* range = dynamic_cast<expressions::IndexedRange const*>(loop->GetHeader()->range());
+            if(range && !info.stored.contains(info.var)){
+                long long begin = range->begin(), end = range->end(), step = range->step();
+                if(step > 0){
+                    info.empty = begin >= end;
+                    info.range = Interval{begin, begin + ((end - 1 - begin) / step) * step};
+                } else if(step < 0){
+                    info.empty = begin <= end;
+                    info.range = Interval{begin - ((begin - end - 1) / -step) * -step, begin};
+                }
+            }
+            m_loops.push_back(std::move(info));
+            return;
+        }
+
+        if(utils::isOperator(node, operator_t::SQUARE_BR)){
+            auto* subscript = dynamic_cast<expressions::BinaryOperatorExpr const*>(node);
+            assert(subscript && "expected binary operator");
+            m_checks.emplace(subscript, classify(subscript));
+        }
+    }
+
+    void BoundsCheckAnalysis::PostAction(basic_syntax_nodes::SyntaxNode const* node) {
+        if(!m_loops.empty() && m_loops.back().loop == node)
+            m_loops.pop_back();
+    }
+
+    BoundsCheck BoundsCheckAnalysis::classify(expressions::BinaryOperatorExpr const* subscript) const {
+        switch (m_mode) {
+            case bounds_check_mode_t::OFF: return {bounds_check_t::NONE};
+            case bounds_check_mode_t::FULL: return {bounds_check_t::RUNTIME};
+            case bounds_check_mode_t::ELIDE: break;
+        }
+
+        // Code which is never executed needs no checks
+        if(std::any_of(m_loops.begin(), m_loops.end(), [](auto& loop){ return loop.empty; }))
+            return {bounds_check_t::ELIDED};
+
+        auto size = sizeOf(utils::childExpr(subscript, 0)->GetType());
+        auto* index = utils::childExpr(subscript, 1);
+        if(!size)
+            return {bounds_check_t::RUNTIME};
+
+        auto range = rangeOf(index);
+        if(range && range->lo >= 0 && range->hi < static_cast<long long>(*size))
+            return {bounds_check_t::ELIDED};
+
+        if(!isAffine(index))
+            return {bounds_check_t::RUNTIME};
+
+        std::set<expressions::Identifier const*> vars;
+        utils::collectReferenced(index, vars);
+
+        // Outermost loop where every variable of index is either invariant or inductive with known range,
+        // affine index reaches its extremes on range bounds, so they are checked once before the loop.
+        // The access must run on every iteration, a guarded one may be out of bounds where it doesn't run
+        auto unconditional = unconditionalLoops(subscript);
+        for(auto loop = m_loops.begin(); loop != m_loops.end(); ++loop){
+            if(!unconditional.contains(loop->loop))
+                continue;
+
+            bool hoistable = std::all_of(vars.begin(), vars.end(), [this, &loop](auto* var){
+                auto* var_loop = loopOf(var);
+                if(var_loop && var_loop >= &*loop)
+                    return var_loop->range.has_value();
+                return !loop->stored.contains(var);
+            });
+
+            if(hoistable)
+                return {bounds_check_t::HOISTED, loop->loop};
+        }
+
+        return {bounds_check_t::RUNTIME};
+    }
+
+    std::optional<BoundsCheckAnalysis::Interval> BoundsCheckAnalysis::rangeOf(expressions::Expression const* expr) const {
+        if(!expr)
+            return std::nullopt;
+
+        if(auto constant = constantOf(expr))
+            return Interval{*constant, *constant};
+
+        if(auto* ref = dynamic_cast<expressions::Reference const*>(expr)){
+            auto* loop = loopOf(ref->identifier());
+            return loop ? loop->range : std::nullopt;
+        }
+
+        if(auto* unary = dynamic_cast<expressions::UnaryOperatorExpr const*>(expr)){
+            auto opnd = rangeOf(utils::childExpr(unary, 0));
+            if(!opnd)
+                return std::nullopt;
+            switch (unary->GetOperatorType()) {
+                case operator_t::PLUS: return opnd;
+                case operator_t::MINUS: return Interval{-opnd->hi, -opnd->lo};
+                default: return std::nullopt;
+            }
+        }
+
+        auto* binary = dynamic_cast<expressions::BinaryOperatorExpr const*>(expr);
+        if(!binary)
+            return std::nullopt;
+
+        auto lhs = rangeOf(utils::childExpr(binary, 0));
+        auto rhs = rangeOf(utils::childExpr(binary, 1));
+        if(!lhs || !rhs)
+            return std::nullopt;
+
+        switch (binary->GetOperatorType()) {
+            case operator_t::PLUS:
+                return Interval{lhs->lo + rhs->lo, lhs->hi + rhs->hi};
+            case operator_t::MINUS:
+                return Interval{lhs->lo - rhs->hi, lhs->hi - rhs->lo};
+            case operator_t::MULT: {
+                auto bounds = {lhs->lo * rhs->lo, lhs->lo * rhs->hi, lhs->hi * rhs->lo, lhs->hi * rhs->hi};
+                return Interval{std::min(bounds), std::max(bounds)};
+            }
+            case operator_t::DIV: {
+                if(rhs->lo != rhs->hi || rhs->lo <= 0)
+                    return std::nullopt;
+                return Interval{lhs->lo / rhs->lo, lhs->hi / rhs->lo};
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    bool BoundsCheckAnalysis::isAffine(expressions::Expression const* expr) const {
+        if(!expr)
+            return false;
+
+        switch (expr->GetExprCategory()) {
+            case expr_type_t::LITERAL:
+            case expr_type_t::REFERENCE:
+                return true;
+            case expr_type_t::OPERATOR: {
+                auto* op = dynamic_cast<expressions::OperatorExpression const*>(expr);
+                auto* lhs = utils::childExpr(expr, 0);
+                switch (op->GetOperatorType()) {
+                    case operator_t::PLUS:
+                    case operator_t::MINUS:
+                        for(auto i = 0u; i < expr->GetChildsNum(); ++i)
+                            if(!isAffine(utils::childExpr(expr, i)))
+                                return false;
+                        return true;
+                    case operator_t::MULT: {
+                        auto* rhs = utils::childExpr(expr, 1);
+                        return (constantOf(lhs) && isAffine(rhs)) || (constantOf(rhs) && isAffine(lhs));
+                    }
+                    default:
+                        return false;
+                }
+            }
+            default:
+                return false;
+        }
+    }
+
+    BoundsCheckAnalysis::LoopInfo const* BoundsCheckAnalysis::loopOf(expressions::Identifier const* var) const {
+        auto found = std::find_if(m_loops.rbegin(), m_loops.rend(), [var](auto& loop){ return loop.var == var; });
+        return found != m_loops.rend() ? &*found : nullptr;
+    }
+
+    std::optional<BoundsCheck> BoundsCheckAnalysis::getCheck(expressions::BinaryOperatorExpr const* subscript) const {
+        auto found = m_checks.find(subscript);
+        if(found == m_checks.end())
+            return std::nullopt;
+        return found->second;
+    }
+
+    size_t BoundsCheckAnalysis::count(bounds_check_t kind) const {
+        return std::count_if(m_checks.begin(), m_checks.end(), [kind](auto& check){
+            return check.second.kind == kind;
+        });
+    }
+
+    void BoundsCheckAnalysis::dump(std::ostream& stream) const {
+        stream << "Bounds checks: " << total() << " subscripts, "
+               << count(bounds_check_t::ELIDED) << " eliminated, "
+               << count(bounds_check_t::HOISTED) << " hoisted out of loops, "
+               << count(bounds_check_t::RUNTIME) << " kept" << std::endl;
+    }
+}
@@ -0,0 +1,142 @@
+#include "data_layout.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+namespace parasl::ast{
+
+    namespace {
+
+        size_t integralSize(size_t bitlength){
+            if(bitlength > 64)
+                return alignTo(bitlength, 64) / 8;
+            return std::bit_ceil(std::max<size_t>(alignTo(bitlength, 8) / 8, 1));
+        }
+    }
+
+    std::optional<TypeLayout> DataLayout::getLayout(types::Type const* type) {
+        if(!type)
+            return std::nullopt;
+
+        switch (type->GetEntityType()) {
+            case entity_type_t::VAR: {
+                auto* var_type = static_cast<types::VarType const*>(type);
+                switch (var_type->primType()) {
+                    case prim_type_t::CHAR:   return TypeLayout{1, 1};
+                    case prim_type_t::FLOAT:  return TypeLayout{4, 4};
+                    case prim_type_t::DOUBLE: return TypeLayout{8, 8};
+                    case prim_type_t::INT: {
+                        auto size = integralSize(var_type->bitlength());
+                        return TypeLayout{size, std::min<size_t>(size, 8)};
+                    }
+                }
+                return std::nullopt;
+            }
+            case entity_type_t::ARRAY: {
+                auto* array_type = static_cast<types::ArrayType const*>(type);
+                if(isBitPacked(array_type)){
+                    auto bits = static_cast<types::VarType const*>(array_type->GetEltType())->bitlength();
+                    return TypeLayout{alignTo(bits * array_type->GetSize(), 64) / 8, 8};
+                }
+                auto elt = getLayout(array_type->GetEltType());
+                if(!elt)
+                    return std::nullopt;
+                return TypeLayout{elt->size * array_type->GetSize(), elt->alignment};
+            }
+            case entity_type_t::VECTOR: {
+                // Vectors are aligned as a whole (up to 32 bytes) to be loaded by single SIMD instruction
+                auto* vector_type = static_cast<types::VectorType const*>(type);
+                auto elt = getLayout(vector_type->GetEltType());
+                if(!elt)
+                    return std::nullopt;
+                auto size = elt->size * vector_type->GetSize();
+                auto alignment = std::clamp<size_t>(std::bit_ceil(size), elt->alignment, 32);
+                return TypeLayout{alignTo(size, alignment), alignment};
+            }
+            case entity_type_t::STRUCT: {
+                auto* layout = getStructLayout(static_cast<types::StructType const*>(type));
+                return layout ? std::optional{layout->layout} : std::nullopt;
+            }
+            case entity_type_t::FUNC:
+                // Code pointer
+                return TypeLayout{sizeof(void*), alignof(void*)};
+        }
+        return std::nullopt;
+    }
+
+    bool DataLayout::isBitPacked(types::ArrayType const* type) const {
+        auto* elt = dynamic_cast<types::VarType const*>(type->GetEltType());
+        if(!m_pack_ints || !elt || elt->primType() != prim_type_t::INT || elt->bitlength() > 32)
+            return false;
+
+        auto packed = alignTo(elt->bitlength() * type->GetSize(), 64) / 8;
+        auto native = integralSize(elt->bitlength()) * type->GetSize();
+        return 4 * packed <= 3 * native;
+    }
+
+    ArrayLayout const* DataLayout::getArrayLayout(types::ArrayType const* type) {
+        auto cached = m_array_layouts.find(type);
+        if(cached != m_array_layouts.end())
+            return cached->second ? &*cached->second : nullptr;
+
+        ArrayLayout layout{};
+        types::Type const* elt = type;
+        for(auto* array_type = type; array_type && !isBitPacked(array_type);
+            array_type = dynamic_cast<types::ArrayType const*>(elt)){
+            layout.extents.push_back(array_type->GetSize());
+            elt = array_type->GetEltType();
+        }
+
+        auto elt_layout = getLayout(elt);
+        if(!elt_layout) {
+            m_array_layouts.emplace(type, std::nullopt);
+            return nullptr;
+        }
+
+        layout.element = elt;
+        layout.element_layout = *elt_layout;
+        layout.strides.resize(layout.extents.size());
+        size_t stride = elt_layout->size;
+        for(auto i = layout.extents.size(); i > 0; --i){
+            layout.strides[i - 1] = stride;
+            stride *= layout.extents[i - 1];
+        }
+        return &*m_array_layouts.emplace(type, std::move(layout)).first->second;
+    }
+
+    StructLayout const* DataLayout::getStructLayout(types::StructType const* type) {
+        auto cached = m_struct_layouts.find(type);
+        if(cached != m_struct_layouts.end())
+            return cached->second ? &*cached->second : nullptr;
+
+        std::vector<TypeLayout> fields;
+        for(auto& field: *type){
+            auto field_layout = getLayout(field.second);
+            if(!field_layout) {
+                m_struct_layouts.emplace(type, std::nullopt);
+                return nullptr;
+            }
+            fields.push_back(*field_layout);
+        }
+
+        StructLayout layout{{0, 1}, std::vector<size_t>(fields.size()), std::vector<size_t>(fields.size()), 0};
+        std::iota(layout.order.begin(), layout.order.end(), 0);
+        if(m_reorder_fields)
+            std::stable_sort(layout.order.begin(), layout.order.end(), [&fields](size_t lhs, size_t rhs){
+                return fields[lhs].alignment > fields[rhs].alignment;
+            });
+
+        size_t offset = 0, payload = 0;
+        for(auto idx: layout.order){
+            offset = alignTo(offset, fields[idx].alignment);
+            layout.offsets[idx] = offset;
+            offset += fields[idx].size;
+            payload += fields[idx].size;
+            layout.layout.alignment = std::max(layout.layout.alignment, fields[idx].alignment);
+        }
+        layout.layout.size = alignTo(offset, layout.layout.alignment);
+        layout.padding = layout.layout.size - payload;
+
+        return &*m_struct_layouts.emplace(type, std::move(layout)).first->second;
+    }
+}
@@ -0,0 +1,212 @@
+#include "dataflow_schedule.h"
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        constexpr auto unbounded = std::numeric_limits<size_t>::max();
+
+        size_t add(size_t lhs, size_t rhs){
+            return lhs > unbounded - rhs ? unbounded : lhs + rhs;
+        }
+
+        size_t mult(size_t lhs, size_t rhs){
+            return rhs && lhs > unbounded / rhs ? unbounded : lhs * rhs;
+        }
+    }
+
+    std::optional<size_t> DataflowSchedule::work(basic_syntax_nodes::SyntaxNode const* node) {
+        if(!node)
+            return 0;
+
+        if(auto* stmt = dynamic_cast<statements::Statement const*>(node)){
+            switch (stmt->GetStmtType()) {
+                case stmt_type_t::WHILE_STMT:
+                    return std::nullopt;
+                case stmt_type_t::FOR_STMT: {
+                    auto* loop = dynamic_cast<statements::ForLoop const*>(stmt);
+                    auto trips = utils::tripCount(loop);
+                    auto body = work(loop->GetBody());
+                    if(!trips || !body)
+                        return std::nullopt;
+                    // Inductive variable update and exit check per iteration
+                    return add(1, mult(*trips, add(*body, 1)));
+                }
+                case stmt_type_t::IF_STMT: {
+                    auto* if_stmt = dynamic_cast<statements::IfStatement const*>(stmt);
+                    auto condition = work(if_stmt->condition());
+                    auto then_work = work(if_stmt->then_clause());
+                    auto else_work = work(if_stmt->else_clause());
+                    if(!condition || !then_work || !else_work)
+                        return std::nullopt;
+                    return add(*condition, std::max(*then_work, *else_work));
+                }
+                default:
+                    break;
+            }
+        }
+
+        // Expression nodes are evaluated once, other statements are sums of their parts
+        size_t total = dynamic_cast<expressions::Expression const*>(node) ? 1 : 0;
+        for(auto i = 0u; i < node->GetChildsNum(); ++i){
+            auto child = work(node->GetChildAt(i));
+            if(!child)
+                return std::nullopt;
+            total = add(total, *child);
+        }
+        return total;
+    }
+
+    std::vector<DataflowSchedule::Stage> DataflowSchedule::split(std::vector<statements::Layer const*> const& layers,
+                                                                 std::vector<std::optional<size_t>> const& works,
+                                                                 size_t budget) const {
+        std::vector<Stage> stages;
+        auto open = false;
+        for(size_t idx = 0; idx < layers.size(); ++idx){
+            auto& layer_work = works[idx];
+            if(!layer_work){
+                stages.push_back({{layers[idx]}, std::nullopt});
+                open = false;
+                continue;
+            }
+
+            if(!open || add(*stages.back().work, *layer_work) > budget){
+                stages.push_back({{}, 0});
+                open = true;
+            }
+            stages.back().layers.push_back(layers[idx]);
+            stages.back().work = add(*stages.back().work, *layer_work);
+        }
+        return stages;
+    }
+
+    void DataflowSchedule::run(LayerPipeline const& pipeline) {
+        m_stages.clear();
+        m_buffers.clear();
+
+        auto& layers = pipeline.layers();
+        if(layers.empty())
+            return;
+
+        std::vector<std::optional<size_t>> works;
+        size_t heaviest = 0, total = 0;
+        for(auto* layer: layers){
+            works.push_back(work(layer->body()));
+            if(works.back()){
+                heaviest = std::max(heaviest, *works.back());
+                total = add(total, *works.back());
+            }
+        }
+
+        // Smallest bottleneck which still fits into the threads (dynamic layers take one each)
+        auto low = std::max(heaviest, m_queue_cost), high = std::max(total, low);
+        while(low < high){
+            auto mid = low + (high - low) / 2;
+            if(split(layers, works, mid).size() <= m_threads)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        m_stages = split(layers, works, low);
+
+        // Stage at the end of a chain may still be too light to pay for its queue
+        for(size_t idx = 0; idx < m_stages.size() && m_stages.size() > 1;){
+            auto& stage = m_stages[idx];
+            if(!stage.work || *stage.work >= m_queue_cost){
+                ++idx;
+                continue;
+            }
+
+            auto prev = idx > 0 && m_stages[idx - 1].work;
+            auto next = idx + 1 < m_stages.size() && m_stages[idx + 1].work;
+            if(!prev && !next){
+                ++idx;
+                continue;
+            }
+            auto into = prev && (!next || *m_stages[idx - 1].work <= *m_stages[idx + 1].work) ? idx - 1 : idx + 1;
+            auto& target = m_stages[into];
+            if(into < idx)
+                target.layers.insert(target.layers.end(), stage.layers.begin(), stage.layers.end());
+            else
+                target.layers.insert(target.layers.begin(), stage.layers.begin(), stage.layers.end());
+            target.work = add(*target.work, *stage.work);
+            m_stages.erase(m_stages.begin() + static_cast<std::ptrdiff_t>(idx));
+            idx = into < idx ? into : idx;
+        }
+
+        // Too many dynamic layers for the threads: neighbours with the least work share a thread
+        while(m_stages.size() > m_threads){
+            auto cost = [this](size_t idx){
+                auto& lhs = m_stages[idx].work;
+                auto& rhs = m_stages[idx + 1].work;
+                return lhs && rhs ? add(*lhs, *rhs) : unbounded;
+            };
+            size_t best = 0;
+            for(size_t idx = 1; idx + 1 < m_stages.size(); ++idx)
+                if(cost(idx) < cost(best))
+                    best = idx;
+
+            auto& stage = m_stages[best];
+            auto& next = m_stages[best + 1];
+            stage.layers.insert(stage.layers.end(), next.layers.begin(), next.layers.end());
+            stage.work = stage.work && next.work ? std::optional(add(*stage.work, *next.work)) : std::nullopt;
+            m_stages.erase(m_stages.begin() + static_cast<std::ptrdiff_t>(best + 1));
+        }
+
+        std::map<statements::Layer const*, size_t> stage_of;
+        for(size_t idx = 0; idx < m_stages.size(); ++idx)
+            for(auto* layer: m_stages[idx].layers)
+                stage_of[layer] = idx;
+
+        // Consumer of stage j works on the period (j - i) behind the producer of stage i,
+        // unless a dynamic stage in between lags behind by as much as its queue holds
+        for(auto& queue: pipeline.queues()){
+            auto from = stage_of.at(queue.from), to = stage_of.at(queue.to);
+            auto dynamic = from != to && std::any_of(m_stages.begin() + static_cast<std::ptrdiff_t>(from),
+                                                     m_stages.begin() + static_cast<std::ptrdiff_t>(to + 1),
+                                                     [](auto& stage){ return !stage.work; });
+            m_buffers.push_back({&queue, from == to || dynamic ? 0 : to - from + 1, dynamic});
+        }
+    }
+
+    void DataflowSchedule::dump(std::ostream& stream) const {
+        if(m_stages.empty())
+            return;
+
+        size_t layers = 0;
+        for(auto& stage: m_stages)
+            layers += stage.layers.size();
+        stream << "Dataflow schedule: " << layers << " layers, " << m_stages.size() << " stages, "
+               << m_threads << " threads; every layer fires once per period" << std::endl;
+
+        for(size_t idx = 0; idx < m_stages.size(); ++idx){
+            auto& stage = m_stages[idx];
+            stream << "  stage " << idx << ":";
+            for(auto* layer: stage.layers)
+                stream << " " << layer->level() << " " << std::quoted(layer->name());
+            stream << ", work ";
+            if(stage.work)
+                stream << *stage.work;
+            else
+                stream << "dynamic";
+            stream << std::endl;
+        }
+
+        for(auto& buffer: m_buffers){
+            stream << "  " << buffer.queue->variable->GetSymbolName() << ": layer " << buffer.queue->from->level()
+                   << " -> " << buffer.queue->to->level() << ", ";
+            if(buffer.dynamic)
+                stream << "dynamic queue";
+            else if(buffer.slots)
+                stream << buffer.slots << " slots";
+            else
+                stream << "fused";
+            stream << std::endl;
+        }
+    }
+}
@@ -0,0 +1,267 @@
+#include "ast_builder.h"
+#include <cassert>
+#include "ast_utils.h"
+#include "ast_clone.h"
+
+/*
+ * If-conversion: small 'if' statements whose arms only contain side-effect free
+ * assignments are rewritten into straight-line code
+ *
+ *      if(c) { a = x; } else { b = y; }
+ *  ->
+ *      $pred0 = c;
+ *      a = select($pred0, x, a);
+ *      b = select($pred0, b, y);
+ *
+ * Inactive arm stores back the unchanged value, so both arms may be executed
+ * unconditionally. Loads in the arms are speculated, so every subscript in the arms
+ * has to be statically in bounds or already performed by the condition with the same
+ * (not modified by arms) index. Only subscripts the condition always evaluates count,
+ * those on the right of && and || may be skipped.
+ */
+
+namespace parasl::ast{
+    namespace {
+
+        using basic_syntax_nodes::SyntaxNode;
+        using basic_syntax_nodes::Ref;
+        using expressions::Expression;
+        using utils::childExpr;
+        using utils::collectReferenced;
+        using utils::isSame;
+        using utils::storedVariable;
+
+        void flatten(SyntaxNode const* node, std::vector<SyntaxNode const*>& leafs){
+            if(!node)
+                return;
+
+            auto* compound = dynamic_cast<statements::CompoundStatement const*>(node);
+            if(!compound) {
+                leafs.push_back(node);
+                return;
+            }
+
+            for(auto i = 0u; i < compound->GetChildsNum(); ++i)
+                flatten(compound->GetChildAt(i), leafs);
+        }
+
+        expressions::BinaryOperatorExpr const* asAssignment(SyntaxNode const* node){
+            if(auto* stmt = dynamic_cast<statements::AssignmentStatement const*>(node))
+                node = stmt->GetChildAt(0);
+
+            auto* op = dynamic_cast<expressions::BinaryOperatorExpr const*>(node);
+            if(!op || op->GetOperatorType() != operator_t::ASSIGN)
+                return nullptr;
+            return op;
+        }
+
+        bool isNonZeroLiteral(Expression const* expr){
+            auto* literal = dynamic_cast<expressions::Literal const*>(expr);
+            if(!literal)
+                return false;
+
+            auto& value = literal->GetLiteralVariant();
+            if(auto* number = std::get_if<unsigned int>(&value))
+                return *number != 0;
+            if(auto* number = std::get_if<int>(&value))
+                return *number != 0;
+            return false;
+        }
+
+        // Evaluating it when the condition is false has no effect and can't trap
+        bool isSideEffectFree(Expression const* expr){
+            if(!expr)
+                return false;
+
+            switch (expr->GetExprCategory()) {
+                case expr_type_t::LITERAL:
+                case expr_type_t::REFERENCE:
+                    return true;
+                case expr_type_t::MEMBER_ACCESS:
+                    return isSideEffectFree(childExpr(expr, 0));
+                case expr_type_t::OPERATOR: {
+                    auto* op = dynamic_cast<expressions::OperatorExpression const*>(expr);
+                    if(op->GetOperatorType() == operator_t::ASSIGN)
+                        return false;
+                    // Division by zero traps, the condition may be what guards against it
+                    if(op->GetOperatorType() == operator_t::DIV && !isNonZeroLiteral(childExpr(expr, 1)))
+                        return false;
+                    [[fallthrough]];
+                }
+                case expr_type_t::SELECT: {
+                    for(auto i = 0u; i < expr->GetChildsNum(); ++i)
+                        if(!isSideEffectFree(childExpr(expr, i)))
+                            return false;
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+        void collectSubscripts(Expression const* expr, std::vector<Expression const*>& subscripts){
+            if(!expr)
+                return;
+
+            if(utils::isOperator(expr, operator_t::SQUARE_BR))
+                subscripts.push_back(expr);
+
+            for(auto i = 0u; i < expr->GetChildsNum(); ++i)
+                collectSubscripts(childExpr(expr, i), subscripts);
+        }
+
+        // Subscripts of the condition performed whenever it is evaluated: right operand
+        // of && and || runs only when the left one allows it
+        void collectGuards(Expression const* expr, std::vector<Expression const*>& guards){
+            if(!expr)
+                return;
+
+            if(utils::isOperator(expr, operator_t::SQUARE_BR))
+                guards.push_back(expr);
+
+            bool short_circuit = utils::isOperator(expr, operator_t::AND) || utils::isOperator(expr, operator_t::OR);
+            auto nchild = short_circuit ? 1u : expr->GetChildsNum();
+            for(auto i = 0u; i < nchild; ++i)
+                collectGuards(childExpr(expr, i), guards);
+        }
+
+        // Constant index into fixed size array can be loaded speculatively
+        bool isInBounds(Expression const* subscript){
+            auto* index = dynamic_cast<expressions::Literal const*>(childExpr(subscript, 1));
+            auto* array_type = dynamic_cast<types::ArrayType const*>(childExpr(subscript, 0)->GetType());
+
+            return index && array_type && index->GetLiteralValue<unsigned int>() < array_type->GetSize();
+        }
+
+        bool isConvertible(std::vector<SyntaxNode const*> const& arms, Expression const* condition){
+            std::vector<Expression const*> speculated;
+            std::set<expressions::Identifier const*> stored;
+
+            for(auto* stmt: arms){
+                if(auto* decl = dynamic_cast<statements::DeclarationStatement const*>(stmt)){
+                    if(!isSideEffectFree(decl->initializer()))
+                        return false;
+                    stored.insert(decl->identifier());
+                    collectSubscripts(decl->initializer(), speculated);
+                    continue;
+                }
+
+                auto* assign = asAssignment(stmt);
+                if(!assign)
+                    return false;
+
+                auto* lhs = childExpr(assign, 0);
+                auto* rhs = childExpr(assign, 1);
+                auto* var = storedVariable(lhs);
+                if(!var || !isSideEffectFree(lhs) || !isSideEffectFree(rhs))
+                    return false;
+
+                stored.insert(var);
+                collectSubscripts(lhs, speculated);
+                collectSubscripts(rhs, speculated);
+            }
+
+            std::vector<Expression const*> guarded;
+            collectGuards(condition, guarded);
+
+            return std::all_of(speculated.begin(), speculated.end(), [&guarded, &stored](auto* subscript){
+                if(isInBounds(subscript))
+                    return true;
+
+                std::set<expressions::Identifier const*> index_vars;
+                collectReferenced(childExpr(subscript, 1), index_vars);
+
+                bool index_stable = std::none_of(index_vars.begin(), index_vars.end(), [&stored](auto* id){
+                    return stored.contains(id);
+                });
+
+                return index_stable && std::any_of(guarded.begin(), guarded.end(), [subscript](auto* guard){
+                    return isSame(guard, subscript);
+                });
+            });
+        }
+
+        void takeLeafs(Ref<SyntaxNode> node, std::vector<Ref<SyntaxNode>>& leafs){
+            auto* compound = dynamic_cast<statements::CompoundStatement*>(node.get());
+            if(!compound) {
+                leafs.push_back(std::move(node));
+                return;
+            }
+
+            for(auto i = 0u; i < compound->GetChildsNum(); ++i)
+                if(compound->GetChildAt(i))
+                    takeLeafs(compound->TakeChildAt(i), leafs);
+        }
+
+        // lhs = rhs  ->  lhs = select(pred, rhs, lhs) (or select(pred, lhs, rhs) for 'else' arm)
+        Ref<SyntaxNode> predicate(Ref<SyntaxNode> stmt, expressions::Identifier const* pred, bool on_true){
+            if(dynamic_cast<statements::DeclarationStatement*>(stmt.get()))
+                return stmt;
+
+            Ref<SyntaxNode> assign_node = std::move(stmt);
+            if(auto* assign_stmt = dynamic_cast<statements::AssignmentStatement*>(assign_node.get()))
+                assign_node = assign_stmt->TakeChildAt(0);
+
+            auto* assign = dynamic_cast<expressions::BinaryOperatorExpr*>(assign_node.get());
+            assert(assign && "expected assignment");
+
+            auto lhs = Ref<Expression>(dynamic_cast<Expression*>(assign->TakeChildAt(0).release()));
+            auto rhs = Ref<Expression>(dynamic_cast<Expression*>(assign->TakeChildAt(1).release()));
+            auto old_value = Cloner{}.cloneAs(lhs.get());
+            auto* type = assign->GetType();
+
+            auto select = std::make_unique<expressions::SelectExpr>(
+                    type, std::make_unique<expressions::Reference>(pred),
+                    on_true ? std::move(rhs) : std::move(old_value),
+                    on_true ? std::move(old_value) : std::move(rhs));
+
+            return std::make_unique<statements::AssignmentStatement>(
+                    std::make_unique<expressions::BinaryOperatorExpr>(std::move(lhs), std::move(select),
+                                                                     type, operator_t::ASSIGN));
+        }
+
+        // Arm which declares variables keeps its own block, so that both arms may declare the same name
+        void appendArm(std::vector<Ref<SyntaxNode>>& leafs, expressions::Identifier const* pred, bool on_true,
+                       std::vector<Ref<SyntaxNode>>& converted){
+            bool declares = std::any_of(leafs.begin(), leafs.end(), [](auto& leaf){
+                return dynamic_cast<statements::DeclarationStatement*>(leaf.get()) != nullptr;
+            });
+
+            std::vector<Ref<SyntaxNode>> stmts;
+            for(auto& leaf: leafs)
+                (declares ? stmts : converted).push_back(predicate(std::move(leaf), pred, on_true));
+            if(declares)
+                converted.push_back(std::make_unique<statements::CompoundStatement>(stmts.begin(), stmts.end()));
+        }
+    }
+
+    Builder::Node Builder::convertIfStatement(Ref<Expression>& condition,
+                                              Ref<statements::CompoundStatement>& then_clause,
+                                              Ref<statements::CompoundStatement>& else_clause){
+        std::vector<SyntaxNode const*> arms;
+        flatten(then_clause.get(), arms);
+        flatten(else_clause.get(), arms);
+
+        if(arms.empty() || arms.size() > m_if_conversion_limit || !isConvertible(arms, condition.get()))
+            return nullptr;
+
+        // '$' can not appear in user identifiers, so predicate never clashes with them
+        auto pred_name = "$pred" + std::to_string(m_predicate_counter++);
+        auto pred_decl = createDeclaration(pred_name, nullptr,
+                                           std::make_shared<Ref<SyntaxNode>>(std::move(condition)));
+
+        auto* pred = dynamic_cast<statements::DeclarationStatement*>(pred_decl->get())->identifier();
+
+        std::vector<Ref<SyntaxNode>> then_leafs, else_leafs, converted;
+        takeLeafs(std::move(then_clause), then_leafs);
+        if(else_clause)
+            takeLeafs(std::move(else_clause), else_leafs);
+
+        converted.push_back(std::move(*pred_decl));
+        appendArm(then_leafs, pred, true, converted);
+        appendArm(else_leafs, pred, false, converted);
+
+        return std::make_shared<Ref<SyntaxNode>>(
+                std::make_unique<statements::CompoundStatement>(converted.begin(), converted.end()));
+    }
+}
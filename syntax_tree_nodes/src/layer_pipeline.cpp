@@ -0,0 +1,64 @@
+#include "layer_pipeline.h"
+#include <algorithm>
+#include <iomanip>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    void LayerPipeline::run(basic_syntax_nodes::SyntaxNode const* root) {
+        m_layers.clear();
+        m_queues.clear();
+        if(!root)
+            return;
+
+        for(auto i = 0u; i < root->GetChildsNum(); ++i)
+            if(auto* layer = dynamic_cast<statements::Layer const*>(root->GetChildAt(i)))
+                m_layers.push_back(layer);
+
+        // Layers may only read variables of preceding ones, so the owner is always found first
+        std::map<expressions::Identifier const*, size_t> owners;
+        for(size_t idx = 0; idx < m_layers.size(); ++idx){
+            auto* layer = m_layers[idx];
+            std::set<expressions::Identifier const*> referenced;
+            utils::collectReferenced(layer->body(), referenced);
+
+            // Queues go by producer and name, not by where variables happen to be allocated
+            std::vector<std::pair<size_t, expressions::Identifier const*>> inputs;
+            for(auto* var: referenced)
+                if(auto owner = owners.find(var); owner != owners.end())
+                    inputs.emplace_back(owner->second, var);
+            std::sort(inputs.begin(), inputs.end(), [](auto& lhs, auto& rhs){
+                return lhs.first != rhs.first ? lhs.first < rhs.first
+                                              : lhs.second->GetSymbolName() < rhs.second->GetSymbolName();
+            });
+
+            for(auto [owner, var]: inputs){
+                std::optional<size_t> value_size;
+                if(auto layout = m_data_layout.getLayout(var->GetType()))
+                    value_size = layout->size;
+                m_queues.push_back({m_layers[owner], layer, var, value_size});
+            }
+
+            std::set<expressions::Identifier const*> declared;
+            utils::collectDeclared(layer->body(), declared);
+            for(auto* var: declared)
+                owners.emplace(var, idx);
+        }
+    }
+
+    void LayerPipeline::dump(std::ostream& stream) const {
+        if(m_layers.empty())
+            return;
+
+        stream << "Layer pipeline: " << m_layers.size() << " stages, " << m_queues.size() << " queues" << std::endl;
+        for(auto& queue: m_queues){
+            stream << "  layer " << queue.from->level() << " " << std::quoted(queue.from->name())
+                   << " -> layer " << queue.to->level() << " " << std::quoted(queue.to->name()) << ": "
+                   << queue.variable->GetSymbolName() << " : ";
+            queue.variable->GetType()->dump(stream);
+            if(queue.value_size)
+                stream << ", " << *queue.value_size << " bytes per value";
+            stream << std::endl;
+        }
+    }
+}
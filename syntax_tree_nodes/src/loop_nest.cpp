@@ -0,0 +1,438 @@
+#include "loop_nest.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <unistd.h>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        using basic_syntax_nodes::SyntaxNode;
+        using expressions::Expression;
+        using expressions::Identifier;
+
+        bool isAccess(SyntaxNode const* node){
+            auto* expr = dynamic_cast<Expression const*>(node);
+            return expr && (expr->GetExprCategory() == expr_type_t::MEMBER_ACCESS ||
+                            utils::isOperator(expr, operator_t::SQUARE_BR));
+        }
+
+        // Outermost accesses of subscript / member access chains
+        void collectAccesses(SyntaxNode const* node, std::vector<Expression const*>& accesses){
+            if(!node)
+                return;
+
+            if(isAccess(node)){
+                auto* parent = node->GetParent();
+                if(!isAccess(parent) || parent->GetChildAt(0) != node)
+                    accesses.push_back(dynamic_cast<Expression const*>(node));
+            }
+
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                collectAccesses(node->GetChildAt(i), accesses);
+        }
+
+        void collectReferences(SyntaxNode const* node, Identifier const* id,
+                               std::vector<expressions::Reference const*>& refs){
+            if(!node)
+                return;
+
+            auto* ref = dynamic_cast<expressions::Reference const*>(node);
+            if(ref && ref->identifier() == id)
+                refs.push_back(ref);
+
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                collectReferences(node->GetChildAt(i), id, refs);
+        }
+
+        bool references(Expression const* expr, Identifier const* id){
+            std::vector<expressions::Reference const*> refs;
+            collectReferences(expr, id, refs);
+            return !refs.empty();
+        }
+
+        bool hasIO(SyntaxNode const* node){
+            if(!node)
+                return false;
+
+            if(auto* stmt = dynamic_cast<statements::Statement const*>(node); stmt &&
+               stmt->GetStmtType() == stmt_type_t::OUTPUT_STMT)
+                return true;
+            if(auto* expr = dynamic_cast<Expression const*>(node); expr &&
+               expr->GetExprCategory() == expr_type_t::INPUT)
+                return true;
+
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                if(hasIO(node->GetChildAt(i)))
+                    return true;
+            return false;
+        }
+
+        void collectAssignments(SyntaxNode const* node, std::vector<expressions::BinaryOperatorExpr const*>& assigns){
+            if(!node)
+                return;
+
+            if(utils::isOperator(node, operator_t::ASSIGN))
+                assigns.push_back(dynamic_cast<expressions::BinaryOperatorExpr const*>(node));
+
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                collectAssignments(node->GetChildAt(i), assigns);
+        }
+
+        // Operator of x = x + e or x = x * e, where x is a store into var (a, a[i], a.x) and e doesn't use var
+        std::optional<operator_t> reductionOf(expressions::BinaryOperatorExpr const* assign, Identifier const* var){
+            auto* lhs = utils::childExpr(assign, 0);
+            auto* value = utils::childExpr(assign, 1);
+            auto* op = dynamic_cast<expressions::OperatorExpression const*>(value);
+            if(!op || (op->GetOperatorType() != operator_t::PLUS && op->GetOperatorType() != operator_t::MULT))
+                return std::nullopt;
+
+            for(auto i = 0u; i < 2; ++i){
+                if(utils::isSame(utils::childExpr(value, i), lhs) && !references(utils::childExpr(value, 1 - i), var))
+                    return op->GetOperatorType();
+            }
+            return std::nullopt;
+        }
+
+        // Integer accumulation with a single operator gives the same result in any order;
+        // var has to be used by the accumulations only, that is by 2 of its references each
+        bool isAccumulation(std::vector<expressions::BinaryOperatorExpr const*> const& assigns, Identifier const* var,
+                            size_t refs){
+            std::optional<operator_t> op;
+            size_t reductions = 0;
+            for(auto* assign: assigns){
+                auto* lhs = utils::childExpr(assign, 0);
+                if(utils::storedVariable(lhs) != var)
+                    continue;
+
+                auto* type = lhs->GetType();
+                if(!type || type->GetEntityType() != entity_type_t::VAR ||
+                   static_cast<types::VarType const*>(type)->primType() != prim_type_t::INT)
+                    return false;
+
+                auto reduction = reductionOf(assign, var);
+                if(!reduction || (op && *op != *reduction))
+                    return false;
+                op = reduction;
+                ++reductions;
+            }
+            return refs == 2 * reductions;
+        }
+
+        // d(index) / d(var) for index affine in var
+        std::optional<long long> coefficient(Expression const* index, Identifier const* var){
+            if(!references(index, var))
+                return 0;
+
+            if(auto* ref = dynamic_cast<expressions::Reference const*>(index))
+                return ref->identifier() == var ? 1 : 0;
+
+            auto* op = dynamic_cast<expressions::OperatorExpression const*>(index);
+            if(!op)
+                return std::nullopt;
+
+            if(index->GetChildsNum() == 1){
+                auto coef = coefficient(utils::childExpr(index, 0), var);
+                if(op->GetOperatorType() == operator_t::MINUS && coef)
+                    return -*coef;
+                return op->GetOperatorType() == operator_t::PAREN ? coef : std::nullopt;
+            }
+
+            auto* lhs = utils::childExpr(index, 0);
+            auto* rhs = utils::childExpr(index, 1);
+            switch (op->GetOperatorType()) {
+                case operator_t::PLUS:
+                case operator_t::MINUS: {
+                    auto lhs_coef = coefficient(lhs, var), rhs_coef = coefficient(rhs, var);
+                    if(!lhs_coef || !rhs_coef)
+                        return std::nullopt;
+                    return op->GetOperatorType() == operator_t::PLUS ? *lhs_coef + *rhs_coef : *lhs_coef - *rhs_coef;
+                }
+                case operator_t::MULT: {
+                    auto* literal = dynamic_cast<expressions::Literal const*>(lhs);
+                    auto* scaled = rhs;
+                    if(!literal){
+                        literal = dynamic_cast<expressions::Literal const*>(rhs);
+                        scaled = lhs;
+                    }
+                    auto coef = literal ? coefficient(scaled, var) : std::nullopt;
+                    if(!coef)
+                        return std::nullopt;
+                    return *coef * literal->GetLiteralValue<unsigned int>();
+                }
+                default:
+                    return std::nullopt;
+            }
+        }
+
+        // Loop nested into body of another one, blocks { { ... } } are looked through
+        statements::ForLoop const* nestedLoop(statements::ForLoop const* loop){
+            SyntaxNode const* body = loop->GetBody();
+            while(dynamic_cast<statements::CompoundStatement const*>(body) && body->GetChildsNum() == 1)
+                body = body->GetChildAt(0);
+            return dynamic_cast<statements::ForLoop const*>(body);
+        }
+
+        Identifier const* inductiveVar(statements::ForLoop const* loop){
+            return loop->GetHeader()->inductiveVar()->identifier();
+        }
+
+        bool dependsOn(LinearAddress const& address, Identifier const* var){
+            return std::any_of(address.terms.begin(), address.terms.end(), [var](auto& term){
+                return references(term.first, var);
+            });
+        }
+
+        bool isSameAddress(LinearAddress const& lhs, LinearAddress const& rhs){
+            if(lhs.base != rhs.base || lhs.offset != rhs.offset || lhs.terms.size() != rhs.terms.size())
+                return false;
+
+            for(auto i = 0u; i < lhs.terms.size(); ++i)
+                if(lhs.terms[i].second != rhs.terms[i].second || !utils::isSame(lhs.terms[i].first, rhs.terms[i].first))
+                    return false;
+            return true;
+        }
+    }
+
+    CacheModel CacheModel::host() {
+        CacheModel cache;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL1_DCACHE_LINESIZE)
+        if(auto line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE); line > 0)
+            cache.line = line;
+        if(auto l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE); l1 > 0)
+            cache.l1 = l1;
+        if(auto l2 = sysconf(_SC_LEVEL2_CACHE_SIZE); l2 > 0)
+            cache.l2 = l2;
+#endif
+        return cache;
+    }
+
+    bool LoopNestPlan::tiled() const {
+        return std::any_of(tiles.begin(), tiles.end(), [](size_t tile){ return tile != 0; });
+    }
+
+    void LoopNestOptimizer::run(basic_syntax_nodes::SyntaxNode* root) {
+        m_plans.clear();
+        m_soa_layout.emplace(m_data_layout);
+        m_soa_layout->run(root);
+        m_lowering.emplace(m_data_layout, &*m_soa_layout);
+
+        findNests(root);
+
+        for(auto& plan: m_plans)
+            if(plan.interchanged())
+                interchange(plan);
+    }
+
+    void LoopNestOptimizer::findNests(basic_syntax_nodes::SyntaxNode const* node) {
+        if(!node)
+            return;
+
+        auto* loop = dynamic_cast<statements::ForLoop const*>(node);
+        if(!loop){
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                findNests(node->GetChildAt(i));
+            return;
+        }
+
+        std::vector<statements::ForLoop const*> loops{loop};
+        while(auto* inner = nestedLoop(loops.back()))
+            loops.push_back(inner);
+
+        auto indexed = std::all_of(loops.begin(), loops.end(), [](auto* nested){
+            return !nested->GetHeader()->range()->arrayBased();
+        });
+        if(loops.size() > 1 && indexed)
+            m_plans.push_back(plan(loops));
+
+        findNests(loops.back()->GetBody());
+    }
+
+    LoopNestPlan LoopNestOptimizer::plan(std::vector<statements::ForLoop const*> loops) {
+        LoopNestPlan plan;
+        plan.loops = std::move(loops);
+        std::transform(plan.loops.begin(), plan.loops.end(), std::back_inserter(plan.vars), inductiveVar);
+        plan.order = plan.vars;
+        plan.tiles.assign(plan.vars.size(), 0);
+
+        std::vector<Expression const*> exprs;
+        collectAccesses(plan.loops.back()->GetBody(), exprs);
+        std::vector<Access> accesses;
+        for(auto* expr: exprs)
+            if(auto address = m_lowering->linearize(expr))
+                accesses.push_back({expr, std::move(*address)});
+
+        // Bytes between memory touched by neighbouring iterations, capped by cache line
+        std::vector<size_t> costs;
+        for(auto* var: plan.vars){
+            size_t cost = 0;
+            for(auto& access: accesses)
+                for(auto& [index, stride]: access.address.terms){
+                    auto coef = coefficient(index, var);
+                    cost += coef ? std::min<size_t>(std::abs(*coef) * stride, m_cache.line) : m_cache.line;
+                }
+            costs.push_back(cost);
+        }
+
+        auto innermost = plan.vars.size() - 1;
+        for(auto i = 0u; i < costs.size(); ++i)
+            if(costs[i] < costs[innermost])
+                innermost = i;
+
+        // Tiling reorders iterations as well
+        if(!isInterchangeLegal(plan, accesses))
+            return plan;
+
+        if(innermost != plan.vars.size() - 1){
+            plan.order.erase(plan.order.begin() + innermost);
+            plan.order.push_back(plan.vars[innermost]);
+        }
+
+        planTiles(plan, accesses);
+        return plan;
+    }
+
+    bool LoopNestOptimizer::isInterchangeLegal(LoopNestPlan const& plan, std::vector<Access> const& accesses) const {
+        auto* body = plan.loops.back()->GetBody();
+        if(hasIO(body))
+            return false;
+
+        std::set<Identifier const*> stored, declared;
+        utils::collectStored(body, stored);
+        utils::collectDeclared(body, declared);
+
+        std::vector<expressions::BinaryOperatorExpr const*> assigns;
+        collectAssignments(body, assigns);
+
+        for(auto* var: stored){
+            // Variables local to loop body get new value on every iteration
+            if(declared.contains(var))
+                continue;
+            if(std::find(plan.vars.begin(), plan.vars.end(), var) != plan.vars.end())
+                return false;
+
+            std::vector<expressions::Reference const*> refs;
+            collectReferences(body, var, refs);
+
+            auto* type = var->GetType();
+            if(type && type->GetEntityType() == entity_type_t::VAR){
+                if(!isAccumulation(assigns, var, refs.size()))
+                    return false;
+                continue;
+            }
+
+            // Every iteration has to touch its own element of aggregate, elements shared by iterations
+            // of some loop are only accumulated into
+            LinearAddress const* address = nullptr;
+            size_t accessed = 0;
+            for(auto& access: accesses){
+                if(access.address.base != var)
+                    continue;
+                if(address && !isSameAddress(*address, access.address))
+                    return false;
+                address = &access.address;
+                ++accessed;
+            }
+            if(!address || accessed != refs.size())
+                return false;
+
+            bool own = std::all_of(plan.vars.begin(), plan.vars.end(), [address](auto* loop_var){
+                return dependsOn(*address, loop_var);
+            });
+            if(!own && !isAccumulation(assigns, var, refs.size()))
+                return false;
+        }
+        return true;
+    }
+
+    void LoopNestOptimizer::planTiles(LoopNestPlan& plan, std::vector<Access> const& accesses) const {
+        auto depth = plan.order.size();
+        plan.tiles.assign(depth, 0);
+        if(accesses.empty())
+            return;
+
+        std::vector<size_t> extents;
+        for(auto* var: plan.order){
+            auto it = std::find(plan.vars.begin(), plan.vars.end(), var);
+            extents.push_back(*utils::tripCount(plan.loops[it - plan.vars.begin()]));
+        }
+
+        size_t elt_size = 1;
+        for(auto& access: accesses)
+            elt_size = std::max(elt_size, m_data_layout.getLayout(access.expr->GetType()).value_or(TypeLayout{1, 1}).size);
+
+        // Bytes touched by the innermost loops starting from given one and whether some access is reused there
+        auto footprint = [&](size_t from){
+            size_t bytes = 0;
+            bool reuse = false;
+            for(auto& access: accesses){
+                size_t touched = elt_size;
+                for(auto pos = from; pos < depth; ++pos){
+                    if(dependsOn(access.address, plan.order[pos]))
+                        touched *= extents[pos];
+                    else
+                        reuse = true;
+                }
+                bytes += touched;
+            }
+            return std::pair{bytes, reuse};
+        };
+
+        auto line_elts = std::max<size_t>(m_cache.line / elt_size, 1);
+        auto round = [line_elts](size_t tile){
+            return std::max(tile / line_elts * line_elts, line_elts);
+        };
+
+        // Two innermost loops: square tile of every accessed array fits into half of L1
+        auto [l1_bytes, l1_reuse] = footprint(depth - 2);
+        if(!l1_reuse || l1_bytes <= m_cache.l1)
+            return;
+
+        auto l1_tile = round(static_cast<size_t>(std::sqrt(m_cache.l1 / 2.0 / (accesses.size() * elt_size))));
+        for(auto pos = depth - 2; pos < depth; ++pos)
+            if(extents[pos] > l1_tile)
+                plan.tiles[pos] = l1_tile;
+
+        if(depth < 3)
+            return;
+
+        // Third loop: panel of L1 tiles fits into half of L2
+        auto [l2_bytes, l2_reuse] = footprint(depth - 3);
+        if(!l2_reuse || l2_bytes <= m_cache.l2)
+            return;
+
+        auto l2_tile = std::max(m_cache.l2 / 2 / (accesses.size() * l1_tile * elt_size) / l1_tile * l1_tile, l1_tile);
+        if(extents[depth - 3] > l2_tile)
+            plan.tiles[depth - 3] = l2_tile;
+    }
+
+    void LoopNestOptimizer::interchange(LoopNestPlan const& plan) {
+        // Only innermost loop is chosen, so the moved header bubbles down the nest
+        auto moved = std::find(plan.vars.begin(), plan.vars.end(), plan.order.back()) - plan.vars.begin();
+        for(auto pos = static_cast<size_t>(moved); pos + 1 < plan.loops.size(); ++pos)
+            const_cast<statements::ForLoop*>(plan.loops[pos])->SwapHeader(
+                    *const_cast<statements::ForLoop*>(plan.loops[pos + 1]));
+    }
+
+    void LoopNestOptimizer::dump(std::ostream& stream) const {
+        auto interchanged = std::count_if(m_plans.begin(), m_plans.end(), [](auto& plan){ return plan.interchanged(); });
+        auto tiled = std::count_if(m_plans.begin(), m_plans.end(), [](auto& plan){ return plan.tiled(); });
+        stream << "Loop nests: " << m_plans.size() << " perfect nests, " << interchanged << " interchanged, "
+               << tiled << " tiled" << std::endl;
+
+        for(auto& plan: m_plans){
+            stream << "  (";
+            for(auto i = 0u; i < plan.vars.size(); ++i)
+                stream << (i ? ", " : "") << plan.vars[i]->GetSymbolName();
+            stream << ") -> (";
+            for(auto i = 0u; i < plan.order.size(); ++i){
+                stream << (i ? ", " : "") << plan.order[i]->GetSymbolName();
+                if(plan.tiles[i])
+                    stream << " tile " << plan.tiles[i];
+            }
+            stream << ")" << std::endl;
+        }
+    }
+}
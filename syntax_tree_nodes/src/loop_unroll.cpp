@@ -0,0 +1,178 @@
+#include "loop_unroll.h"
+#include <set>
+#include "ast_clone.h"
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    using basic_syntax_nodes::Ref;
+    using basic_syntax_nodes::SyntaxNode;
+
+    namespace {
+
+        // Compound statements only group other statements, so they aren't counted
+        size_t countNodes(SyntaxNode const* node){
+            if(!node)
+                return 0;
+
+            size_t count = dynamic_cast<statements::CompoundStatement const*>(node) ? 0 : 1;
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                count += countNodes(node->GetChildAt(i));
+            return count;
+        }
+
+        bool hasLoops(SyntaxNode const* node){
+            if(!node)
+                return false;
+
+            if(dynamic_cast<statements::ForLoop const*>(node) || dynamic_cast<statements::WhileLoop const*>(node))
+                return true;
+
+            for(auto i = 0u; i < node->GetChildsNum(); ++i)
+                if(hasLoops(node->GetChildAt(i)))
+                    return true;
+            return false;
+        }
+
+        Ref<statements::CompoundStatement> compound(std::vector<Ref<SyntaxNode>>& stmts){
+            return std::make_unique<statements::CompoundStatement>(stmts.begin(), stmts.end());
+        }
+    }
+
+    void LoopUnroller::run(SyntaxNode* root) {
+        if(m_budget)
+            walk(root);
+    }
+
+    void LoopUnroller::walk(SyntaxNode* node) {
+        if(!node)
+            return;
+
+        auto* block = dynamic_cast<statements::CompoundStatement*>(node);
+        for(auto i = 0u; i < node->GetChildsNum(); ++i){
+            auto* child = const_cast<SyntaxNode*>(node->GetChildAt(i));
+
+            // Inner loops go first: loop becomes innermost when its inner loops are fully unrolled
+            walk(child);
+
+            if(block && dynamic_cast<statements::ForLoop*>(child)){
+                auto loop = Ref<statements::ForLoop>(dynamic_cast<statements::ForLoop*>(block->TakeChildAt(i).release()));
+                block->SetChildAt(i, unroll(std::move(loop)));
+            }
+        }
+    }
+
+    Ref<SyntaxNode> LoopUnroller::unroll(Ref<statements::ForLoop> loop) {
+        auto* range = dynamic_cast<expressions::IndexedRange const*>(loop->GetHeader()->range());
+        auto* var = loop->GetHeader()->inductiveVar()->identifier();
+        auto* body = loop->GetBody();
+        if(!range || !range->step() || hasLoops(body))
+            return loop;
+
+        std::set<expressions::Identifier const*> stored;
+        utils::collectStored(body, stored);
+        if(stored.contains(var))
+            return loop;
+
+        // Copies of empty body give nothing to schedule
+        auto size = countNodes(body);
+        if(!size)
+            return loop;
+
+        ++m_loops;
+
+        long long begin = range->begin(), end = range->end(), step = range->step();
+        auto trips = static_cast<size_t>(step > 0 ? std::max(0ll, (end - begin + step - 1) / step)
+                                                  : std::max(0ll, (begin - end - step - 1) / -step));
+        auto last = begin + static_cast<long long>(trips ? trips - 1 : 0) * step;
+
+        // Inductive variable is replaced by literals, which are non-negative
+        if(trips && trips * size <= m_budget && begin >= 0 && last >= 0)
+            return unrollFully(std::move(loop), trips);
+
+        size_t factor = 0;
+        for(size_t candidate: {8, 4, 2}){
+            if(candidate * size > m_budget || trips < 2 * candidate)
+                continue;
+            if(!factor)
+                factor = candidate;
+            if(trips % candidate == 0){
+                factor = candidate;
+                break;
+            }
+        }
+
+        if(!factor)
+            return loop;
+        return unrollPartially(std::move(loop), trips, factor);
+    }
+
+    Ref<SyntaxNode> LoopUnroller::unrollFully(Ref<statements::ForLoop> loop, size_t trips) {
+        auto* range = dynamic_cast<expressions::IndexedRange const*>(loop->GetHeader()->range());
+        auto* var = loop->GetHeader()->inductiveVar()->identifier();
+
+        std::vector<Ref<SyntaxNode>> copies;
+        for(size_t trip = 0; trip < trips; ++trip){
+            auto index = range->begin() + static_cast<int>(trip) * range->step();
+            expressions::Literal value(static_cast<unsigned int>(index), var->GetType());
+            Cloner cloner;
+            cloner.substitute(var, &value);
+            copies.push_back(cloner.clone(loop->GetBody()));
+        }
+
+        ++m_full;
+        m_detached.push_back(std::move(loop));
+        return compound(copies);
+    }
+
+    Ref<SyntaxNode> LoopUnroller::unrollPartially(Ref<statements::ForLoop> loop, size_t trips, size_t factor) {
+        auto* header = const_cast<statements::ForHeader*>(loop->GetHeader());
+        auto* range = dynamic_cast<expressions::IndexedRange const*>(header->range());
+        auto* var = header->inductiveVar()->identifier();
+        auto* type = range->GetType();
+        int begin = range->begin(), end = range->end(), step = range->step();
+        int split = begin + static_cast<int>(trips / factor * factor) * step;
+
+        // Remaining iterations run by the copy of original loop with its own inductive variable
+        Ref<SyntaxNode> remainder;
+        if(trips % factor){
+            Cloner cloner;
+            auto decl = cloner.cloneAs(header->inductiveVar());
+            auto body = cloner.cloneAs(loop->GetBody());
+            remainder = std::make_unique<statements::ForLoop>(
+                    std::make_unique<statements::ForHeader>(
+                            std::move(decl), std::make_unique<expressions::IndexedRange>(type, split, end, step)),
+                    std::move(body));
+            ++m_remainders;
+        }
+
+        // i, i + step, i + 2 * step, ...
+        std::vector<Ref<SyntaxNode>> copies;
+        for(size_t copy = 1; copy < factor; ++copy){
+            auto offset = static_cast<unsigned int>(copy * std::abs(step));
+            expressions::BinaryOperatorExpr value(std::make_unique<expressions::Reference>(var),
+                                                  std::make_unique<expressions::Literal>(offset, type),
+                                                  var->GetType(), step > 0 ? operator_t::PLUS : operator_t::MINUS);
+            Cloner cloner;
+            cloner.substitute(var, &value);
+            copies.push_back(cloner.clone(loop->GetBody()));
+        }
+        copies.insert(copies.begin(), loop->TakeBody());
+        loop->SetBody(compound(copies));
+        header->SetChildAt(1, std::make_unique<expressions::IndexedRange>(type, begin, split, step * static_cast<int>(factor)));
+
+        ++m_partial;
+        if(!remainder)
+            return loop;
+
+        std::vector<Ref<SyntaxNode>> stmts;
+        stmts.push_back(std::move(loop));
+        stmts.push_back(std::move(remainder));
+        return compound(stmts);
+    }
+
+    void LoopUnroller::dump(std::ostream& stream) const {
+        stream << "Loop unrolling: " << m_loops << " innermost loops, " << m_full << " fully unrolled, "
+               << m_partial << " partially unrolled (" << m_remainders << " with remainder)" << std::endl;
+    }
+}
@@ -0,0 +1,146 @@
+#include "ownership.h"
+#include <algorithm>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        bool isAggregate(types::Type const* type){
+            if(!type)
+                return false;
+
+            auto entity = type->GetEntityType();
+            return entity == entity_type_t::ARRAY || entity == entity_type_t::VECTOR || entity == entity_type_t::STRUCT;
+        }
+    }
+
+    void OwnershipAnalysis::run(basic_syntax_nodes::SyntaxNode const* root) {
+        m_movable.clear();
+        m_aggregate_uses.clear();
+        statement(root, {}, true);
+    }
+
+    OwnershipAnalysis::LiveSet OwnershipAnalysis::statement(basic_syntax_nodes::SyntaxNode const* node, LiveSet live,
+                                                            bool record) {
+        if(!node)
+            return live;
+
+        if(auto* expr = dynamic_cast<expressions::Expression const*>(node)){
+            expression(expr, live, record);
+            return live;
+        }
+
+        auto* stmt = dynamic_cast<statements::Statement const*>(node);
+        switch (stmt->GetStmtType()) {
+            case stmt_type_t::COMPOUND_STMT: {
+                for(auto i = stmt->GetChildsNum(); i > 0; --i)
+                    live = statement(stmt->GetChildAt(i - 1), std::move(live), record);
+                return live;
+            }
+            case stmt_type_t::DECL: {
+                auto* decl = dynamic_cast<statements::DeclarationStatement const*>(stmt);
+                live.erase(decl->identifier());
+                expression(decl->initializer(), live, record);
+                return live;
+            }
+            case stmt_type_t::IF_STMT: {
+                auto* if_stmt = dynamic_cast<statements::IfStatement const*>(stmt);
+                auto then_live = statement(if_stmt->then_clause(), live, record);
+                auto else_live = statement(if_stmt->else_clause(), live, record);
+                then_live.insert(else_live.begin(), else_live.end());
+                expression(if_stmt->condition(), then_live, record);
+                return then_live;
+            }
+            case stmt_type_t::FOR_STMT: {
+                auto* loop = dynamic_cast<statements::ForLoop const*>(stmt);
+                auto* var = loop->GetHeader()->inductiveVar()->identifier();
+
+                // Value live at loop head is either used after the loop or by next iteration
+                auto head = live;
+                for(bool changed = true; changed;){
+                    auto body_live = statement(loop->GetBody(), head, false);
+                    body_live.erase(var);
+                    auto size = head.size();
+                    head.insert(body_live.begin(), body_live.end());
+                    changed = head.size() != size;
+                }
+                if(record)
+                    statement(loop->GetBody(), head, true);
+
+                head.erase(var);
+                auto* range = loop->GetHeader()->range();
+                if(range && range->arrayBased())
+                    expression(utils::childExpr(range, 0), head, record, false);
+                return head;
+            }
+            case stmt_type_t::WHILE_STMT: {
+                auto* loop = dynamic_cast<statements::WhileLoop const*>(stmt);
+
+                // Condition is followed either by loop exit or by next iteration
+                auto head = live, after_condition = live;
+                for(bool changed = true; changed;){
+                    after_condition = live;
+                    auto body_live = statement(loop->GetBody(), head, false);
+                    after_condition.insert(body_live.begin(), body_live.end());
+
+                    auto new_head = after_condition;
+                    expression(loop->GetCondition(), new_head, false);
+                    changed = new_head != head;
+                    head = std::move(new_head);
+                }
+                if(record){
+                    statement(loop->GetBody(), head, true);
+                    expression(loop->GetCondition(), after_condition, true);
+                }
+                return head;
+            }
+            default: {
+                for(auto i = stmt->GetChildsNum(); i > 0; --i)
+                    live = statement(stmt->GetChildAt(i - 1), std::move(live), record);
+                return live;
+            }
+        }
+    }
+
+    void OwnershipAnalysis::expression(expressions::Expression const* expr, LiveSet& live, bool record, bool whole) {
+        if(!expr)
+            return;
+
+        if(auto* ref = dynamic_cast<expressions::Reference const*>(expr)){
+            auto* var = ref->identifier();
+            if(whole && isAggregate(ref->GetType()) && record){
+                m_aggregate_uses.insert(ref);
+                if(!live.contains(var))
+                    m_movable.insert(ref);
+            }
+            live.insert(var);
+            return;
+        }
+
+        if(utils::isOperator(expr, operator_t::ASSIGN)){
+            auto* lhs = utils::childExpr(expr, 0);
+            // Store to the whole variable kills its value, partial store reads the rest of it
+            if(auto* ref = dynamic_cast<expressions::Reference const*>(lhs)) {
+                live.erase(ref->identifier());
+                expression(utils::childExpr(expr, 1), live, record);
+            } else {
+                expression(utils::childExpr(expr, 1), live, record);
+                expression(lhs, live, record, false);
+            }
+            return;
+        }
+
+        // Element and member loads don't consume the aggregate itself
+        bool partial = expr->GetExprCategory() == expr_type_t::MEMBER_ACCESS ||
+                       utils::isOperator(expr, operator_t::SQUARE_BR);
+
+        for(auto i = expr->GetChildsNum(); i > 0; --i)
+            expression(utils::childExpr(expr, i - 1), live, record, !(partial && i == 1));
+    }
+
+    void OwnershipAnalysis::dump(std::ostream& stream) const {
+        stream << "Aggregate values: " << aggregateUses() << " whole-value uses, "
+               << moves() << " moved instead of copied" << std::endl;
+    }
+}
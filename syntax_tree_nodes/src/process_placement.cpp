@@ -0,0 +1,141 @@
+#include "process_placement.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace parasl::ast{
+
+    namespace {
+
+        std::string trim(std::string const& text){
+            auto begin = text.find_first_not_of(" \t\r");
+            if(begin == std::string::npos)
+                return {};
+            return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+        }
+
+        std::invalid_argument error(size_t line, std::string const& what){
+            return std::invalid_argument("placement line " + std::to_string(line) + ": " + what);
+        }
+    }
+
+    void ProcessPlacement::load(std::string const& config) {
+        std::vector<Group> groups;
+        std::istringstream lines(config);
+        std::string text;
+        for(size_t line = 1; std::getline(lines, text); ++line){
+            text = trim(text.substr(0, text.find('#')));
+            if(text.empty())
+                continue;
+
+            auto colon = text.find(':');
+            if(colon == std::string::npos)
+                throw error(line, "expected 'process: layers'");
+            Group group{line, trim(text.substr(0, colon)), {}};
+            if(group.name.empty())
+                throw error(line, "process has no name");
+            if(std::any_of(groups.begin(), groups.end(), [&](auto& other){ return other.name == group.name; }))
+                throw error(line, "process '" + group.name + "' is placed twice");
+
+            // Comma or space separated levels and quoted names
+            auto rest = text.substr(colon + 1);
+            for(size_t pos = 0; pos < rest.size();){
+                if(rest[pos] == ' ' || rest[pos] == '\t' || rest[pos] == ','){
+                    ++pos;
+                    continue;
+                }
+                if(rest[pos] == '"'){
+                    auto end = rest.find('"', pos + 1);
+                    if(end == std::string::npos)
+                        throw error(line, "unterminated layer name");
+                    group.layers.push_back(rest.substr(pos, end - pos + 1));
+                    pos = end + 1;
+                    continue;
+                }
+                auto end = rest.find_first_of(" \t,", pos);
+                auto level = rest.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+                if(!std::all_of(level.begin(), level.end(), [](char c){ return c >= '0' && c <= '9'; }))
+                    throw error(line, "expected layer level or quoted name, got '" + level + "'");
+                group.layers.push_back(level);
+                pos = end == std::string::npos ? rest.size() : end;
+            }
+            if(group.layers.empty())
+                throw error(line, "process '" + group.name + "' has no layers");
+            groups.push_back(std::move(group));
+        }
+        m_groups = std::move(groups);
+    }
+
+    void ProcessPlacement::run(LayerPipeline const& pipeline, DataflowSchedule const& schedule) {
+        m_processes.clear();
+        m_channels.clear();
+
+        std::map<statements::Layer const*, size_t> process_of;
+        if(m_groups){
+            for(auto& group: *m_groups){
+                Process process{group.name, {}};
+                for(auto& ref: group.layers){
+                    auto layer = std::find_if(pipeline.layers().begin(), pipeline.layers().end(), [&](auto* candidate){
+                        return ref.front() == '"' ? '"' + candidate->name() + '"' == ref
+                                                  : std::to_string(candidate->level()) == ref;
+                    });
+                    if(layer == pipeline.layers().end())
+                        throw error(group.line, "there is no layer " + ref);
+                    if(!process_of.emplace(*layer, m_processes.size()).second)
+                        throw error(group.line, "layer " + ref + " is placed twice");
+                    process.layers.push_back(*layer);
+                }
+                m_processes.push_back(std::move(process));
+            }
+
+            for(auto* layer: pipeline.layers())
+                if(!process_of.count(layer))
+                    throw std::invalid_argument("placement: layer " + std::to_string(layer->level()) + " \"" +
+                                                layer->name() + "\" isn't placed");
+        } else{
+            for(auto& stage: schedule.stages()){
+                for(auto* layer: stage.layers)
+                    process_of[layer] = m_processes.size();
+                m_processes.push_back({"stage" + std::to_string(m_processes.size()), stage.layers});
+            }
+        }
+
+        for(auto& queue: pipeline.queues()){
+            auto from = process_of.at(queue.from), to = process_of.at(queue.to);
+            if(from == to)
+                continue;
+            auto size = queue.value_size.value_or(0);
+            auto slots = size ? std::clamp<size_t>(ringBytes / size, 2, maxSlots) : maxSlots;
+            m_channels.push_back({&queue, from, to, slots, size >= zeroCopyThreshold});
+        }
+    }
+
+    void ProcessPlacement::dump(std::ostream& stream) const {
+        if(m_processes.size() < 2)
+            return;
+
+        stream << "Process placement: " << m_processes.size() << " processes, " << m_channels.size() << " channels over "
+               << (m_transport == transport_t::SHARED_MEMORY ? "shared memory" : "unix sockets") << std::endl;
+        for(auto& process: m_processes){
+            stream << "  process " << std::quoted(process.name) << ":";
+            for(auto* layer: process.layers)
+                stream << " " << layer->level() << " " << std::quoted(layer->name());
+            stream << std::endl;
+        }
+
+        for(auto& channel: m_channels){
+            stream << "  " << channel.queue->variable->GetSymbolName() << ": layer " << channel.queue->from->level()
+                   << " -> " << channel.queue->to->level() << ", " << std::quoted(m_processes[channel.from].name)
+                   << " -> " << std::quoted(m_processes[channel.to].name) << ", ";
+            if(m_transport == transport_t::SHARED_MEMORY)
+                stream << channel.slots << "-slot ring" << (channel.zero_copy ? ", built in place" : "");
+            else if(channel.zero_copy)
+                stream << "memory descriptor per value";
+            else
+                stream << "batches of " << channel.slots << " values";
+            stream << std::endl;
+        }
+    }
+}
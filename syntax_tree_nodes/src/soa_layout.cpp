@@ -0,0 +1,119 @@
+#include "soa_layout.h"
+#include <algorithm>
+#include "ast_utils.h"
+
+namespace parasl::ast{
+
+    namespace {
+
+        // arr[i].field -> arr
+        expressions::Reference const* accessedArray(expressions::MemberAccess const* access){
+            auto* subscript = utils::childExpr(access, 0);
+            if(!utils::isOperator(subscript, operator_t::SQUARE_BR))
+                return nullptr;
+            return dynamic_cast<expressions::Reference const*>(utils::childExpr(subscript, 0));
+        }
+    }
+
+    void SoaLayoutAnalysis::run(basic_syntax_nodes::SyntaxNode const* root) {
+        m_arrays.clear();
+        visit(root);
+
+        for(auto& [array, info]: m_arrays){
+            // Every whole element read from SoA storage gathers all fields, so they shouldn't dominate
+            info.soa = info.field_accesses && !info.whole_uses && info.element_accesses <= info.field_accesses;
+            layOut(info);
+            if(info.fields.empty())
+                info.soa = false;
+        }
+    }
+
+    void SoaLayoutAnalysis::PreAction(basic_syntax_nodes::SyntaxNode const* node) {
+        auto* ref = dynamic_cast<expressions::Reference const*>(node);
+        if(!ref)
+            return;
+
+        auto* array_type = dynamic_cast<types::ArrayType const*>(ref->GetType());
+        auto* elt_type = array_type ? dynamic_cast<types::StructType const*>(array_type->GetEltType()) : nullptr;
+        if(!elt_type)
+            return;
+
+        auto it = m_arrays.find(ref->identifier());
+        if(it == m_arrays.end()){
+            ArrayInfo array{};
+            array.type = array_type;
+            array.elt_type = elt_type;
+            array.used_fields.assign(elt_type->GetFieldsNum(), false);
+            it = m_arrays.emplace(ref->identifier(), std::move(array)).first;
+        }
+        auto& info = it->second;
+
+        auto* parent = node->GetParent();
+        if(utils::isOperator(parent, operator_t::SQUARE_BR) && parent->GetChildAt(0) == node){
+            auto* access = dynamic_cast<expressions::MemberAccess const*>(parent->GetParent());
+            if(access && access->GetChildAt(0) == parent){
+                ++info.field_accesses;
+                info.used_fields[access->fieldIndex()] = true;
+            } else
+                ++info.element_accesses;
+        } else if(dynamic_cast<expressions::ArrayRange const*>(parent))
+            // for(p : arr) reads every element as a whole
+            ++info.element_accesses;
+        else
+            ++info.whole_uses;
+    }
+
+    void SoaLayoutAnalysis::layOut(ArrayInfo& info) {
+        info.fields.clear();
+        auto* struct_layout = m_data_layout.getStructLayout(info.elt_type);
+        if(!struct_layout)
+            return;
+
+        if(!info.soa){
+            for(auto offset: struct_layout->offsets)
+                info.fields.push_back({offset, struct_layout->layout.size});
+            return;
+        }
+
+        // Field arrays follow each other in declaration order
+        size_t base = 0;
+        for(auto& field: *info.elt_type){
+            auto field_layout = m_data_layout.getLayout(field.second);
+            base = alignTo(base, field_layout->alignment);
+            info.fields.push_back({base, field_layout->size});
+            base += field_layout->size * info.type->GetSize();
+        }
+    }
+
+    bool SoaLayoutAnalysis::isSoa(expressions::Identifier const* array) const {
+        auto it = m_arrays.find(array);
+        return it != m_arrays.end() && it->second.soa;
+    }
+
+    std::optional<FieldAddress> SoaLayoutAnalysis::fieldAddress(expressions::Identifier const* array,
+                                                                size_t field) const {
+        auto it = m_arrays.find(array);
+        if(it == m_arrays.end() || field >= it->second.fields.size())
+            return std::nullopt;
+        return it->second.fields[field];
+    }
+
+    std::optional<FieldAddress> SoaLayoutAnalysis::fieldAddress(expressions::MemberAccess const* access) const {
+        auto* array = accessedArray(access);
+        if(!array)
+            return std::nullopt;
+        return fieldAddress(array->identifier(), access->fieldIndex());
+    }
+
+    void SoaLayoutAnalysis::dump(std::ostream& stream) const {
+        auto soa = std::count_if(m_arrays.begin(), m_arrays.end(), [](auto& array){ return array.second.soa; });
+        stream << "Struct arrays: " << m_arrays.size() << " candidates, " << soa << " stored as SoA" << std::endl;
+
+        for(auto& [array, info]: m_arrays){
+            stream << "  " << array->GetSymbolName() << ": " << info.field_accesses << " field accesses ("
+                   << std::count(info.used_fields.begin(), info.used_fields.end(), true) << " of "
+                   << info.used_fields.size() << " fields), " << info.element_accesses << " element accesses, "
+                   << info.whole_uses << " whole uses -> " << (info.soa ? "SoA" : "AoS") << std::endl;
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#include "tree_statistics.h"
+#include <algorithm>
+#include <vector>
+
+namespace parasl::ast{
+
+    namespace {
+
+        // Child pointers of a node with any number of children are stored out of the node
+        size_t childList(basic_syntax_nodes::SyntaxNode const* node){
+            return node->GetChildsNum() * sizeof(basic_syntax_nodes::Ref<basic_syntax_nodes::SyntaxNode>);
+        }
+    }
+
+    void TreeStatistics::run(basic_syntax_nodes::SyntaxNode const* root) {
+        if(!root)
+            return;
+
+        visit_impl(root);
+        for(size_t idx = 0; idx < root->GetChildsNum(); ++idx)
+            run(root->GetChildAt(idx));
+    }
+
+    void TreeStatistics::add(std::string_view kind, size_t bytes) {
+        auto& counted = m_kinds[kind];
+        ++counted.nodes;
+        counted.bytes += bytes;
+        ++m_nodes;
+        m_bytes += bytes;
+    }
+
+    void TreeStatistics::operator()(expressions::OperatorExpression const* node) {
+        if(dynamic_cast<expressions::UnaryOperatorExpr const*>(node))
+            add("UnaryOperatorExpr", sizeof(expressions::UnaryOperatorExpr));
+        else
+            add("BinaryOperatorExpr", sizeof(expressions::BinaryOperatorExpr));
+    }
+
+    void TreeStatistics::operator()(expressions::Literal const*) {
+        add("Literal", sizeof(expressions::Literal));
+    }
+
+    void TreeStatistics::operator()(expressions::Identifier const*) {
+        add("Identifier", sizeof(expressions::Identifier));
+    }
+
+    void TreeStatistics::operator()(expressions::Reference const*) {
+        add("Reference", sizeof(expressions::Reference));
+    }
+
+    void TreeStatistics::operator()(expressions::MemberAccess const*) {
+        add("MemberAccess", sizeof(expressions::MemberAccess));
+    }
+
+    void TreeStatistics::operator()(expressions::InputExpr const*) {
+        add("InputExpr", sizeof(expressions::InputExpr));
+    }
+
+    void TreeStatistics::operator()(expressions::InitializationList const* node) {
+        add("InitializationList", sizeof(expressions::InitializationList) + childList(node));
+    }
+
+    void TreeStatistics::operator()(expressions::GlueExpr const* node) {
+        add("GlueExpr", sizeof(expressions::GlueExpr) + childList(node));
+    }
+
+    void TreeStatistics::operator()(expressions::BindExpr const*) {
+        add("BindExpr", sizeof(expressions::BindExpr));
+    }
+
+    void TreeStatistics::operator()(expressions::RepeatExpr const*) {
+        add("RepeatExpr", sizeof(expressions::RepeatExpr));
+    }
+
+    void TreeStatistics::operator()(expressions::SelectExpr const*) {
+        add("SelectExpr", sizeof(expressions::SelectExpr));
+    }
+
+    void TreeStatistics::operator()(expressions::ArrayRange const*) {
+        add("ArrayRange", sizeof(expressions::ArrayRange));
+    }
+
+    void TreeStatistics::operator()(expressions::IndexedRange const*) {
+        add("IndexedRange", sizeof(expressions::IndexedRange));
+    }
+
+    void TreeStatistics::operator()(statements::IfStatement const*) {
+        add("IfStatement", sizeof(statements::IfStatement));
+    }
+
+    void TreeStatistics::operator()(statements::ForLoop const*) {
+        add("ForLoop", sizeof(statements::ForLoop));
+    }
+
+    void TreeStatistics::operator()(statements::AssignmentStatement const*) {
+        add("AssignmentStatement", sizeof(statements::AssignmentStatement));
+    }
+
+    void TreeStatistics::operator()(statements::CompoundStatement const* node) {
+        add("CompoundStatement", sizeof(statements::CompoundStatement) + childList(node));
+    }
+
+    void TreeStatistics::operator()(statements::DeclarationStatement const*) {
+        add("DeclarationStatement", sizeof(statements::DeclarationStatement));
+    }
+
+    void TreeStatistics::operator()(statements::RetStmt const*) {
+        add("RetStmt", sizeof(statements::RetStmt));
+    }
+
+    void TreeStatistics::operator()(statements::OutputStmt const*) {
+        add("OutputStmt", sizeof(statements::OutputStmt));
+    }
+
+    void TreeStatistics::operator()(statements::ForHeader const*) {
+        add("ForHeader", sizeof(statements::ForHeader));
+    }
+
+    void TreeStatistics::operator()(statements::WhileLoop const*) {
+        add("WhileLoop", sizeof(statements::WhileLoop));
+    }
+
+    void TreeStatistics::operator()(statements::Layer const*) {
+        add("Layer", sizeof(statements::Layer));
+    }
+
+    void TreeStatistics::dump(std::ostream& stream) const {
+        stream << "AST: " << m_nodes << " nodes, " << m_bytes << " bytes" << std::endl;
+
+        // Largest kinds first
+        std::vector<std::pair<std::string_view, Kind>> kinds(m_kinds.begin(), m_kinds.end());
+        std::stable_sort(kinds.begin(), kinds.end(), [](auto& lhs, auto& rhs){
+            return lhs.second.bytes > rhs.second.bytes;
+        });
+        for(auto& [kind, counted]: kinds)
+            stream << "  " << kind << ": " << counted.nodes << " nodes, " << counted.bytes << " bytes" << std::endl;
+    }
+}
@@ -0,0 +1,73 @@
+#include "compile_server.h"
+#include "parser.h"
+
+#include <chrono>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <unistd.h>
+
+#include "testing.h"
+
+using namespace parasl;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    constexpr char const* program = "x = 0;\ny = 1;\nif (x < y) {\n  x = y + 1;\n}\noutput(0, x);\n";
+
+    // Server is listening once the socket accepts a job
+    CompileReply connect(std::string const& socket_path, std::string const& source){
+        for(auto attempt = 0;; ++attempt){
+            try{
+                return CompileRemote(socket_path, Options{}, source);
+            } catch (std::system_error&) {
+                if(attempt == 100)
+                    throw;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    }
+
+    // Repeated job is replied from the cache with what compiling it printed the first time
+    void repeatedJob(){
+        auto socket_path = "compile_server_tests." + std::to_string(::getpid()) + ".sock";
+        CompileServer server(socket_path, 2, 16);
+        std::thread serving([&]{ server.Run(); });
+
+        std::string source = program;
+        auto expected = Parser(source.begin(), source.end()).Compile();
+        auto first = connect(socket_path, program);
+        auto second = connect(socket_path, program);
+        auto other = connect(socket_path, "output(0, 1);\n");
+        server.Stop();
+        serving.join();
+
+        check(expected.ok && first.ok && second.ok && other.ok, "compilation on the server failed");
+        check(first.output == expected.output && first.errors == expected.errors,
+              "server's output differs from the local one");
+        check(!first.cached && second.cached && !other.cached, "cached replies are wrong");
+        check(second.output == first.output && second.errors == first.errors, "cached reply differs");
+        check(server.Hits() == 1 && server.Misses() == 2,
+              std::to_string(server.Hits()) + " hits and " + std::to_string(server.Misses()) + " misses");
+        check(::access(socket_path.c_str(), F_OK) != 0, "stopped server left its socket");
+    }
+
+    void noServer(){
+        auto refused = false;
+        try{
+            CompileRemote("compile_server_tests.missing.sock", Options{}, program);
+        } catch (std::system_error&) {
+            refused = true;
+        }
+        check(refused, "job without a server isn't refused");
+    }
+}
+
+int main(){
+    return runTests({
+            {"repeated job", repeatedJob},
+            {"no server", noServer},
+    });
+}
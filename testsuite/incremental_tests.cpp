@@ -0,0 +1,100 @@
+#include "incremental.h"
+#include "parser.h"
+
+#include <string>
+
+#include "testing.h"
+
+using namespace parasl;
+using namespace parasl::runtime::testing;
+
+namespace {
+
+    // Compiles a version after the other and checks each is compiled as by a fresh Parser
+    class Versions{
+    public:
+        IncrementalCompiler::Result compile(std::string const& source){
+            auto result = m_compiler.Compile(source);
+
+            std::string text = source;
+            auto expected = Parser(text.begin(), text.end()).Compile();
+            check(result.ok == expected.ok, "incremental compilation succeeds differently");
+            check(result.output == expected.output, "incremental output differs:\n" + result.output +
+                                                    "\nfrom the fresh one:\n" + expected.output);
+            check(result.errors == expected.errors, "incremental errors differ: '" + result.errors + "'");
+            return result;
+        }
+
+    private:
+        IncrementalCompiler m_compiler{Options{}};
+    };
+
+    std::string pipeline(std::string const& square){
+        return "layer(0, \"generate\") {\n"
+               "    a : int[16];\n"
+               "    for(i in 0:16)\n"
+               "        a[i] = i;\n"
+               "}\n"
+               "\n"
+               "layer(1, \"square\") {\n"
+               "    b : int[16];\n"
+               "    for(i in 0:16)\n"
+               "        b[i] = " + square + ";\n"
+               "}\n"
+               "\n"
+               "layer(2, \"sum\") {\n"
+               "    sum = 0;\n"
+               "    for(i in 0:16)\n"
+               "        sum = sum + b[i] - a[i];\n"
+               "    output(0, sum);\n"
+               "}\n";
+    }
+
+    // Edited layer is checked again, the others are reused
+    void layerBody(){
+        Versions versions;
+        auto first = versions.compile(pipeline("a[i] * a[i]"));
+        check(first.ok && !first.whole && first.units == 3 && first.rechecked == 3, "pipeline isn't split into layers");
+
+        auto edited = versions.compile(pipeline("a[i] + a[i]"));
+        check(edited.ok && !edited.whole && edited.rechecked == 1, "unchanged layers are checked again");
+    }
+
+    // Statements mentioning the declaration are checked again with its new type, and so are
+    // those mentioning the variables whose type follows from it
+    void declarationType(){
+        Versions versions;
+        versions.compile("x : int;\ny = 2;\nz = x;\noutput(0, z);\n");
+
+        auto edited = versions.compile("x : int(16);\ny = 2;\nz = x;\noutput(0, z);\n");
+        check(edited.ok && !edited.whole && edited.rechecked == 3,
+              "rechecked " + std::to_string(edited.rechecked) + " units after the type change");
+    }
+
+    // New 'if' converted before the others shifts their predicates
+    void shiftedPredicates(){
+        auto program = [](std::string const& inserted){
+            return "x = 0;\ny = 1;\n" + inserted +
+                   "if (x < y) {\n  x = y + 1;\n} else {\n  y = x - 1;\n}\n"
+                   "if (y < x) {\n  y = 2;\n}\n";
+        };
+
+        Versions versions;
+        versions.compile(program(""));
+
+        auto edited = versions.compile(program("if (y > 0) {\n  x = 3;\n}\n"));
+        check(edited.ok && !edited.whole && edited.rechecked == 3, "units after the new 'if' keep their predicates");
+        check(edited.output.find("$pred2") != std::string::npos, "new 'if' isn't converted");
+
+        // Back to the first version, and its predicates
+        versions.compile(program(""));
+    }
+}
+
+int main(){
+    return runTests({
+            {"layer body", layerBody},
+            {"declaration type", declarationType},
+            {"shifted predicates", shiftedPredicates},
+    });
+}